@@ -73,6 +73,12 @@ void MainGameEntry( PLAY_IGNORE_COMMAND_LINE )
 	Play::CreateGameObject(typePlayer, { displayWidth / 2, displayHeight / 2 }, 50, "agent8_fly");
 	Play::LoadBackground("Data\\Backgrounds\\background.png");
 	Play::StartAudioLoop("music");
+	Play::SetFrameBudget(15.0f);
+	Play::AddQualityKnob("playerParticles", 0.25f, 1.0f);                                                    //Fraction of frames which spawn a player particle
+	Play::CompressSprite("agent8_left");                                                                      //Big animated sheets with only one frame on screen at a time
+	Play::CompressSprite("agent8_right");
+	Play::CompressSprite("agent8_dead");
+	Play::SetSpriteMemorySaving(true);                                                                         //Drawing data and collision masks are all the game needs once loaded
 	SpawnAsteroids(gameState.remainingGems);
 	SpawnMeteors(gameState.rounds);
 }
@@ -80,6 +86,7 @@ void MainGameEntry( PLAY_IGNORE_COMMAND_LINE )
 // Called by PlayBuffer every frame (60 times a second!)
 bool MainGameUpdate( float elapsedTime )
 {
+	Play::BeginTimingBar(Play::cWhite);                                                                        //Starts timing the frame for the quality governor
 	Play::DrawBackground();
 	UpdateGems();
 	UpdateAsteroidsAndPieces();
@@ -99,6 +106,7 @@ bool MainGameUpdate( float elapsedTime )
 // Gets called once when the player quits the game 
 int MainGameExit( void )
 {
+	Play::ReportSpriteMemory();
 	Play::DestroyManager();
 	return PLAY_OK;
 }
@@ -355,14 +363,21 @@ void UpdatePlayerParticles()
 	//if player is not on asteroids then
 	//spawn particles while its moving maybe spawning on oldPos
 	GameObject& playerObj = Play::GetGameObjectByType(typePlayer);
+	static float particlesToSpawn = 0.0f;
 
 	if (gameState.playerState == stateNotGrounded) 
 	{
-		int playerParticleID = Play::CreateGameObject(typePlayerParticle, playerObj.pos, 20, "particle");
-		GameObject& particleObj = Play::GetGameObject(playerParticleID);
-		float playerToAsteroidAng = atan2f(particleObj.pos.y - playerObj.pos.y, particleObj.pos.x - playerObj.pos.x);
-		particleObj.pos.x = playerObj.pos.x + 2 * cos(playerToAsteroidAng);                                            //Spawn Particle So it follows path of playerobj
-		particleObj.pos.y = playerObj.pos.y + 2 * sin(playerToAsteroidAng);
+		particlesToSpawn += Play::GetQualityKnob("playerParticles");                                                 //Spawns fewer particles when frames are over budget
+
+		if (particlesToSpawn >= 1.0f)
+		{
+			particlesToSpawn -= 1.0f;
+			int playerParticleID = Play::CreateGameObject(typePlayerParticle, playerObj.pos, 20, "particle");
+			GameObject& particleObj = Play::GetGameObject(playerParticleID);
+			float playerToAsteroidAng = atan2f(particleObj.pos.y - playerObj.pos.y, particleObj.pos.x - playerObj.pos.x);
+			particleObj.pos.x = playerObj.pos.x + 2 * cos(playerToAsteroidAng);                                        //Spawn Particle So it follows path of playerobj
+			particleObj.pos.y = playerObj.pos.y + 2 * sin(playerToAsteroidAng);
+		}
 	}
 
 	std::vector<int> vPlayerParticles = Play::CollectGameObjectIDsByType(typePlayerParticle);
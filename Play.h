@@ -41,6 +41,29 @@
 #include <filesystem>
 #include <thread>
 #include <future>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+// SSE2 is used to fill and blend spans of pixels on x86/x64 (available on every x64 CPU)
+#if defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 ) || defined( __SSE2__ )
+#define PLAY_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+// Selects the platform layer: Windows builds present to a window and every other build runs headless (no window at all)
+// > Define PLAY_PLATFORM_HEADLESS before including Play.h to run a Windows build without a window too
+// > Define PLAY_PLATFORM_X11 before including Play.h to present to an X11 window on Linux (link with -lX11 -lXext)
+// > Define PLAY_PLATFORM_WAYLAND before including Play.h to present to a Wayland window on Linux (link with -lwayland-client)
+#if !defined( PLAY_PLATFORM_WINDOWS ) && !defined( PLAY_PLATFORM_HEADLESS ) && !defined( PLAY_PLATFORM_X11 ) && !defined( PLAY_PLATFORM_WAYLAND )
+#ifdef _WIN32
+#define PLAY_PLATFORM_WINDOWS
+#else
+#define PLAY_PLATFORM_HEADLESS
+#endif
+#endif
+
+#ifdef PLAY_PLATFORM_WINDOWS
 
 #define WIN32_LEAN_AND_MEAN // Exclude rarely-used content from the Windows headers
 #define NOMINMAX // Stop windows macros defining their own min and max macros
@@ -67,6 +90,145 @@ namespace Gdiplus
 #include <GdiPlus.h>
 #pragma warning(pop)
 
+#else
+
+#include <cstdio>
+#include <cstring>
+#include <cstdarg>
+#include <csignal>
+
+#ifdef PLAY_PLATFORM_X11
+// X11 Header Files (MIT-SHM lets the X server read presented frames straight from shared memory)
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/XKBlib.h>
+#include <X11/extensions/XShm.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#endif
+
+#ifdef PLAY_PLATFORM_WAYLAND
+// Wayland Header Files (the parts of the xdg-shell protocol we use are defined with the window code further down this header,
+// so there's nothing to generate)
+#include <wayland-client.h>
+#include <linux/input-event-codes.h>
+#include <sys/mman.h>
+#include <poll.h>
+#include <unistd.h>
+
+struct xdg_wm_base;
+struct xdg_surface;
+struct xdg_toplevel;
+#endif
+
+// Stand-ins for the few Windows types and functions used outside of the platform specific code
+#define UNREFERENCED_PARAMETER( P ) (void)( P )
+
+struct LARGE_INTEGER
+{
+	long long QuadPart{ 0 };
+};
+
+// Reads a nanosecond timer in place of the Windows performance counter
+inline int QueryPerformanceCounter( LARGE_INTEGER* pCount )
+{
+	pCount->QuadPart = std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+	return 1;
+}
+
+// The performance counter counts in nanoseconds
+inline int QueryPerformanceFrequency( LARGE_INTEGER* pFrequency )
+{
+	pFrequency->QuadPart = 1000000000;
+	return 1;
+}
+
+#if defined( PLAY_PLATFORM_X11 ) || defined( PLAY_PLATFORM_WAYLAND )
+// Reads the key state kept by the PlayWindow from its key events (the top bit is set while the key is down)
+short GetAsyncKeyState( int vKey );
+#else
+// There is no keyboard without a window, so no key is ever down
+inline short GetAsyncKeyState( int vKey )
+{
+	UNREFERENCED_PARAMETER( vKey );
+	return 0;
+}
+#endif
+
+// There is no audio device outside of Windows, so sounds are silent
+inline unsigned long mciSendStringA( const char* command, char* returnString, unsigned int returnLength, void* hCallback )
+{
+	UNREFERENCED_PARAMETER( command );
+	UNREFERENCED_PARAMETER( returnString );
+	UNREFERENCED_PARAMETER( returnLength );
+	UNREFERENCED_PARAMETER( hCallback );
+	return 0;
+}
+
+// The Windows virtual key codes used by the library and games (letters and digits are their upper case ASCII codes)
+constexpr int VK_BACK = 0x08;
+constexpr int VK_TAB = 0x09;
+constexpr int VK_RETURN = 0x0D;
+constexpr int VK_SHIFT = 0x10;
+constexpr int VK_CONTROL = 0x11;
+constexpr int VK_ESCAPE = 0x1B;
+constexpr int VK_SPACE = 0x20;
+constexpr int VK_PRIOR = 0x21;
+constexpr int VK_NEXT = 0x22;
+constexpr int VK_END = 0x23;
+constexpr int VK_HOME = 0x24;
+constexpr int VK_LEFT = 0x25;
+constexpr int VK_UP = 0x26;
+constexpr int VK_RIGHT = 0x27;
+constexpr int VK_DOWN = 0x28;
+constexpr int VK_INSERT = 0x2D;
+constexpr int VK_DELETE = 0x2E;
+constexpr int VK_F1 = 0x70;
+constexpr int VK_F2 = 0x71;
+constexpr int VK_F3 = 0x72;
+constexpr int VK_F4 = 0x73;
+constexpr int VK_F5 = 0x74;
+constexpr int VK_F6 = 0x75;
+constexpr int VK_F7 = 0x76;
+constexpr int VK_F8 = 0x77;
+constexpr int VK_F9 = 0x78;
+constexpr int VK_F10 = 0x79;
+constexpr int VK_F11 = 0x7A;
+constexpr int VK_F12 = 0x7B;
+
+// Only the Microsoft C runtime provides the bounds checked string functions and aligned allocation
+#ifndef _WIN32
+template< size_t N > int sprintf_s( char ( &buffer )[N], const char* format, ... )
+{
+	va_list args;
+	va_start( args, format );
+	int len = vsnprintf( buffer, N, format, args );
+	va_end( args );
+	return len;
+}
+
+template< size_t N > int strcpy_s( char ( &dest )[N], const char* source )
+{
+	snprintf( dest, N, "%s", source );
+	return 0;
+}
+
+// > aligned_alloc needs the size to be a multiple of the alignment
+inline void* _aligned_malloc( size_t size, size_t alignment )
+{
+	return std::aligned_alloc( alignment, ( ( size + alignment - 1 ) / alignment ) * alignment );
+}
+
+inline void _aligned_free( void* p )
+{
+	std::free( p );
+}
+
+#define __debugbreak() raise( SIGTRAP )
+#endif
+
+#endif // PLAY_PLATFORM_WINDOWS
+
 // Macros for Assertion and Tracing
 void TracePrintf(const char* file, int line, const char* fmt, ...);
 void AssertFailMessage(const char* message, const char* file, long line );
@@ -424,12 +586,62 @@ const Pixel PIX_GREY{ 0x80, 0x80, 0x80 };
 const Pixel PIX_TRANS{ 0x00, 0x00, 0x00, 0x00 };
 
 
+// A rectangular area of pixels (top left corner and size)
+struct PixelRect
+{
+	int x{ 0 };
+	int y{ 0 };
+	int width{ 0 };
+	int height{ 0 };
+};
+
+// The ways the pixels in a PixelData can be stored
+enum PixelFormat
+{
+	PIXEL_FORMAT_ARGB = 0,	// 32 bits per pixel: alpha<<24 | red<<16 | green<<8 | blue
+	PIXEL_FORMAT_RGB565,	// 16 bits per pixel: red<<11 | green<<5 | blue (5, 6 and 5 bits with no alpha) for render targets
+	PIXEL_FORMAT_INDEXED8,	// 8 bits per pixel: an index into a palette of up to 256 pixels in the sprite pre-multiplied format
+};
+
 struct PixelData
 {
 	int width{ 0 };
 	int height{ 0 };
 	Pixel* pPixels{ nullptr };
 	bool preMultiplied = false;
+	// The number of pixels from the start of one row to the start of the next (0 means the rows are tightly packed)
+	int stride{ 0 };
+	// How the pixels are stored (pPixels points at 16-bit values for PIXEL_FORMAT_RGB565 and 8-bit values for PIXEL_FORMAT_INDEXED8)
+	PixelFormat format{ PIXEL_FORMAT_ARGB };
+	// The colours which the pixels of a PIXEL_FORMAT_INDEXED8 image index (not owned, like pPixels)
+	uint32_t* pPalette{ nullptr };
+
+	// Gets the number of pixels from the start of one row to the start of the next
+	int Stride() const { return stride ? stride : width; }
+	// Gets the number of bytes used by each pixel
+	int BytesPerPixel() const { return ( format == PIXEL_FORMAT_RGB565 ) ? 2 : ( format == PIXEL_FORMAT_INDEXED8 ) ? 1 : 4; }
+	// Gets a pointer to the first pixel in a row
+	Pixel* Row( int y ) const { return pPixels + ( static_cast<size_t>( Stride() ) * y ); }
+	// Gets a pointer to the first pixel in a row of a 16-bit PIXEL_FORMAT_RGB565 image
+	uint16_t* Row565( int y ) const { return reinterpret_cast<uint16_t*>( pPixels ) + ( static_cast<size_t>( Stride() ) * y ); }
+	// Gets a pointer to the first palette index in a row of an 8-bit PIXEL_FORMAT_INDEXED8 image
+	uint8_t* Row8( int y ) const { return reinterpret_cast<uint8_t*>( pPixels ) + ( static_cast<size_t>( Stride() ) * y ); }
+	// Gets a pointer to the first byte of a row in any format
+	uint8_t* RowBytes( int y ) const { return reinterpret_cast<uint8_t*>( pPixels ) + ( static_cast<size_t>( Stride() ) * y * BytesPerPixel() ); }
+	// Returns a PixelData for an area within this one which shares the same pixels without copying them
+	// > The view doesn't own its pixels, so it mustn't be deleted or outlive the PixelData it came from
+	PixelData View( PixelRect rect ) const
+	{
+		PixelData view;
+		view.width = rect.width;
+		view.height = rect.height;
+		view.stride = Stride();
+		view.pPixels = reinterpret_cast<Pixel*>( RowBytes( rect.y ) + ( static_cast<size_t>( rect.x ) * BytesPerPixel() ) );
+		view.preMultiplied = preMultiplied;
+		view.format = format;
+		view.pPalette = pPalette;
+		return view;
+	}
 };
 
 #endif
@@ -456,8 +668,12 @@ struct MouseData
 //********************************************************************************************************************************
 // File:		PlayWindow.h
 // Description:	Platform specific code to provide a window to draw into
-// Platform:	Windows
-// Notes:		Uses a 32-bit ARGB display buffer
+// Platform:	Windows, Headless, X11, Wayland
+// Notes:		Uses a 32-bit ARGB display buffer. The headless platform has no window and presents into memory instead.
+//				At a scale of one, X11 and Wayland draw straight into the image or shared buffers they present. On Wayland the
+//				display buffer's pixels move to another buffer after each present and hold an older frame (which doesn't matter
+//				to games that draw the whole frame every update, but anything keeping a pointer to the pixels has to get it
+//				again after presenting).
 //********************************************************************************************************************************
 
 // The target frame rate
@@ -469,6 +685,38 @@ constexpr int FRAMES_PER_SECOND = 60;
 constexpr int PLAY_OK = 0;
 constexpr int PLAY_ERROR = -1;
 
+#ifndef PLAY_PLATFORM_WINDOWS
+// Settings controlling how the game loop steps time
+// > Headless runs default to a fixed time step as fast as possible, while X11 windows run in real time like Windows
+// > Wayland windows run in real time at the pace of the compositor's frame callbacks
+struct GameLoopSettings
+{
+#if defined( PLAY_PLATFORM_HEADLESS )
+	// The time passed to MainGameUpdate each frame in seconds (zero passes the real time taken instead)
+	float fixedDeltaTime{ 1.0f / FRAMES_PER_SECOND };
+	// The frame rate the loop is held to (zero runs as fast as possible)
+	int framesPerSecond{ 0 };
+	// The number of frames to run before quitting (zero runs until MainGameUpdate returns true)
+	// > Limited to half a minute of game time by default, so unattended runs always finish
+	int frameLimit{ FRAMES_PER_SECOND * 30 };
+#elif defined( PLAY_PLATFORM_WAYLAND )
+	// The time passed to MainGameUpdate each frame in seconds (zero passes the real time taken instead)
+	float fixedDeltaTime{ 0.0f };
+	// The frame rate the loop is held to (zero leaves it to the frame callbacks)
+	int framesPerSecond{ 0 };
+	// The number of frames to run before quitting (zero runs until MainGameUpdate returns true)
+	int frameLimit{ 0 };
+#else
+	// The time passed to MainGameUpdate each frame in seconds (zero passes the real time taken instead)
+	float fixedDeltaTime{ 0.0f };
+	// The frame rate the loop is held to (zero runs as fast as possible)
+	int framesPerSecond{ FRAMES_PER_SECOND };
+	// The number of frames to run before quitting (zero runs until MainGameUpdate returns true)
+	int frameLimit{ 0 };
+#endif
+};
+#endif
+
 // Encapsulates the platform specific functionality of creating and managing a window 
 // > Singleton class accessed using PlayWindow::Instance()
 class PlayWindow
@@ -485,6 +733,7 @@ public:
 	// Destroys the PlayWindow instance
 	static void Destroy();
 
+#ifdef PLAY_PLATFORM_WINDOWS
 	// Windows functions
 	//********************************************************************************************************************************
 
@@ -495,6 +744,39 @@ public:
 	// Copies the display buffer pixels to the window
 	// > Returns the time taken for the present in seconds
 	double Present();
+#else
+	// Game loop functions
+	//********************************************************************************************************************************
+
+	// Call within main to run the game loop (and handle the window's events), then reports the frame rate achieved
+	// > The command line options -frames <count>, -dt <seconds> and -fps <rate> override the GameLoopSettings
+	// > Returns the value returned by MainGameExit, which main() returns as the program's exit code
+	int HandleFrames( int argc, char* argv[] );
+	// Copies the display buffer pixels into the presented frame in memory (headless) or to the window (X11 and Wayland)
+	// > Returns the time taken for the present in milliseconds
+	double Present();
+	// Sets how the game loop steps time
+	void SetGameLoopSettings( const GameLoopSettings& settings ) { m_gameLoop = settings; }
+	// Gets how the game loop steps time
+	const GameLoopSettings& GetGameLoopSettings() const { return m_gameLoop; }
+	// Gets the number of frames presented so far
+	int GetPresentCount() const { return m_presentCount; }
+#endif
+#ifdef PLAY_PLATFORM_HEADLESS
+	// Gets the most recently presented frame
+	const PixelData& GetPresentedFrame() const { return m_presentBuffer; }
+#endif
+#if defined( PLAY_PLATFORM_X11 ) || defined( PLAY_PLATFORM_WAYLAND )
+	// Whether a key (given as a Windows virtual key code) is held down in the window
+	bool IsKeyDown( int vKey ) const { return vKey >= 0 && vKey < 256 && m_keyDown[vKey]; }
+#endif
+#ifdef PLAY_PLATFORM_X11
+	// Whether frames are presented through MIT-SHM shared memory, rather than being sent over the socket
+	bool IsSharedMemory() const { return m_bSharedMemory; }
+	// Gets the connection to the X server and the window (e.g. to read back what has been presented)
+	Display* GetX11Display() const { return m_pDisplay; }
+	Window GetX11Window() const { return m_window; }
+#endif
 	// Sets the pointer to write mouse input data to
 	void RegisterMouse( MouseData* pMouseData ) { m_pMouseData = pMouseData; }
 
@@ -515,6 +797,9 @@ public:
 	static int ReadPNGImage( std::string& fileAndPath, int& width, int& height );
 	// Loads a png image and puts the image data into the destination image provided
 	static int LoadPNGImage( std::string& fileAndPath, PixelData& destImage );
+	// Finds a file from a Windows style path (backslash separators and any letter case) on the current platform
+	// > Returns the path unchanged on Windows, or when nothing matches
+	static std::string FindFile( const std::string& fileAndPath );
 
 private:
 
@@ -542,10 +827,111 @@ private:
 	MouseData* m_pMouseData{ nullptr };
 	// Pointer to the instance.
 	static PlayWindow* s_pInstance;
+#ifdef PLAY_PLATFORM_WINDOWS
 	// The handle to the Window 
 	HWND m_hWindow{ nullptr };
 	// A GDI+ token
 	static unsigned long long s_pGDIToken;
+#else
+	// How the game loop steps time
+	GameLoopSettings m_gameLoop;
+	// The number of frames presented so far
+	int m_presentCount{ 0 };
+#endif
+#ifdef PLAY_PLATFORM_HEADLESS
+	// A copy of the display buffer made by each present
+	PixelData m_presentBuffer;
+#endif
+#if defined( PLAY_PLATFORM_X11 ) || defined( PLAY_PLATFORM_WAYLAND )
+	// Handles the window's pending events, returning false once the window has been closed
+	bool HandleEvents();
+	// Scales up a row of pixels by repeating each one
+	static void ReplicatePixels( const Pixel* pSource, Pixel* pDest, int width, int scale );
+
+	// Which keys are down, indexed by Windows virtual key code
+	bool m_keyDown[256]{};
+#endif
+#ifdef PLAY_PLATFORM_X11
+	// The connection to the X server
+	Display* m_pDisplay{ nullptr };
+	// The window
+	Window m_window{ 0 };
+	// The graphics context used to put the image in the window
+	GC m_gc{ nullptr };
+	// The message sent when the window's close button is pressed
+	Atom m_deleteMessage{ 0 };
+	// The window sized image which the display buffer is scaled into (or drawn into directly at a scale of one)
+	XImage* m_pImage{ nullptr };
+	// The shared memory holding the image's pixels (when MIT-SHM is available)
+	XShmSegmentInfo m_sharedMemory{};
+	// Whether the image is in shared memory, or has to be sent over the socket with XPutImage
+	bool m_bSharedMemory{ false };
+	// The display buffer's own pixels, given back to it before PlayGraphics frees them (at a scale of one it is pointed at
+	// the image's pixels, otherwise this is null)
+	Pixel* m_pOwnPixels{ nullptr };
+#endif
+#ifdef PLAY_PLATFORM_WAYLAND
+	// Waits until the compositor has finished with one of the buffers and returns its index
+	int AcquireBuffer();
+
+	// Wayland event handlers (the data passed to each one is the PlayWindow)
+	static void HandleGlobal( void* pData, wl_registry* pRegistry, uint32_t name, const char* pInterface, uint32_t version );
+	static void HandleGlobalRemove( void* pData, wl_registry* pRegistry, uint32_t name );
+	static void HandlePing( void* pData, xdg_wm_base* pWmBase, uint32_t serial );
+	static void HandleSurfaceConfigure( void* pData, xdg_surface* pXdgSurface, uint32_t serial );
+	static void HandleToplevelConfigure( void* pData, xdg_toplevel* pToplevel, int32_t width, int32_t height, wl_array* pStates );
+	static void HandleToplevelClose( void* pData, xdg_toplevel* pToplevel );
+	static void HandleBufferRelease( void* pData, wl_buffer* pBuffer );
+	static void HandleFrameDone( void* pData, wl_callback* pCallback, uint32_t time );
+	static void HandleSeatCapabilities( void* pData, wl_seat* pSeat, uint32_t capabilities );
+	static void HandlePointerEnter( void* pData, wl_pointer* pPointer, uint32_t serial, wl_surface* pSurface, wl_fixed_t x, wl_fixed_t y );
+	static void HandlePointerLeave( void* pData, wl_pointer* pPointer, uint32_t serial, wl_surface* pSurface );
+	static void HandlePointerMotion( void* pData, wl_pointer* pPointer, uint32_t time, wl_fixed_t x, wl_fixed_t y );
+	static void HandlePointerButton( void* pData, wl_pointer* pPointer, uint32_t serial, uint32_t time, uint32_t button, uint32_t state );
+	static void HandlePointerAxis( void* pData, wl_pointer* pPointer, uint32_t time, uint32_t axis, wl_fixed_t value );
+	static void HandleKeymap( void* pData, wl_keyboard* pKeyboard, uint32_t format, int32_t fd, uint32_t size );
+	static void HandleKeyboardEnter( void* pData, wl_keyboard* pKeyboard, uint32_t serial, wl_surface* pSurface, wl_array* pKeys );
+	static void HandleKeyboardLeave( void* pData, wl_keyboard* pKeyboard, uint32_t serial, wl_surface* pSurface );
+	static void HandleKey( void* pData, wl_keyboard* pKeyboard, uint32_t serial, uint32_t time, uint32_t key, uint32_t state );
+	static void HandleModifiers( void* pData, wl_keyboard* pKeyboard, uint32_t serial, uint32_t depressed, uint32_t latched, uint32_t locked, uint32_t group );
+
+	// The number of buffers taking turns to be drawn, waiting to be shown and being shown
+	static constexpr int WAYLAND_BUFFER_COUNT = 3;
+
+	// The connection to the compositor and the global objects it provides
+	wl_display* m_pDisplay{ nullptr };
+	wl_registry* m_pRegistry{ nullptr };
+	wl_compositor* m_pCompositor{ nullptr };
+	wl_shm* m_pShm{ nullptr };
+	xdg_wm_base* m_pWmBase{ nullptr };
+	wl_seat* m_pSeat{ nullptr };
+	wl_pointer* m_pPointer{ nullptr };
+	wl_keyboard* m_pKeyboard{ nullptr };
+	// The window's surface and its xdg-shell roles
+	wl_surface* m_pSurface{ nullptr };
+	xdg_surface* m_pXdgSurface{ nullptr };
+	xdg_toplevel* m_pToplevel{ nullptr };
+	// The callback for when the last frame presented has been shown
+	wl_callback* m_pFrameCallback{ nullptr };
+	// The buffers, which all share one pool of memory
+	wl_buffer* m_pBuffers[WAYLAND_BUFFER_COUNT]{};
+	Pixel* m_pBufferPixels[WAYLAND_BUFFER_COUNT]{};
+	// Whether the compositor is still using each buffer
+	bool m_bufferBusy[WAYLAND_BUFFER_COUNT]{};
+	// The pool of shared memory and its size in bytes
+	uint8_t* m_pPoolMemory{ nullptr };
+	size_t m_poolSize{ 0 };
+	// The number of bytes from the start of one row of a buffer to the next
+	int m_bufferStride{ 0 };
+	// The buffer which the display buffer has been pointed at, when drawing straight into the buffers (otherwise -1)
+	int m_drawBuffer{ -1 };
+	// The display buffer's own pixels, given back to it before PlayGraphics frees them
+	Pixel* m_pOwnPixels{ nullptr };
+	// Whether the window has been configured, closed, or is waiting for its last frame to be shown
+	bool m_bConfigured{ false };
+	bool m_bClosed{ false };
+	bool m_bFramePending{ false };
+#endif
 };
 
 #endif
@@ -573,7 +959,20 @@ public:
 	PlayBlitter( PixelData* pRenderTarget = nullptr );
 	// Set the render target for all subsequent drawing operations
 	// Returns a pointer to any previous render target
-	PixelData* SetRenderTarget( PixelData* pRenderTarget ) { PixelData* old = m_pRenderTarget; m_pRenderTarget = pRenderTarget; return old; }
+	PixelData* SetRenderTarget( PixelData* pRenderTarget ) { PixelData* old = m_pRenderTarget; m_pRenderTarget = pRenderTarget; UpdateClipRect(); return old; }
+	// Gets the render target which is currently being drawn to
+	PixelData* GetRenderTarget() const { return m_pRenderTarget; }
+
+	// Clipping functions
+	//********************************************************************************************************************************
+
+	// Restricts all subsequent drawing to the overlap between the given rectangle and the current clipping rectangle
+	// > The clipping rectangles are kept on a stack which applies to whichever render target is set
+	void PushClipRect( PixelRect rect );
+	// Restores the clipping rectangle which was in use before the last call to PushClipRect
+	void PopClipRect();
+	// Gets the area of the render target which drawing is currently restricted to
+	PixelRect GetClipRect() const { return m_clipRect; }
 
 	// Primitive drawing functions
 	//********************************************************************************************************************************
@@ -581,22 +980,121 @@ public:
 	// Sets the colour of an individual pixel on the render target
 	void DrawPixel( int posX, int posY, Pixel pix );
 	// Draws a line of pixels into the render target
-	void DrawLine( int startX, int startY, int endX, int endY, Pixel pix );
+	// > The line is clipped before drawing so only the visible pixels are visited
+	// > The start pixel can be left out so that joined lines don't draw the shared pixel twice
+	void DrawLine( int startX, int startY, int endX, int endY, Pixel pix, bool drawStart = true );
+	// Draws a batch of individual pixels, either all in one colour or each with its own colour
+	// > The points are sorted into rows before drawing so the render target is written in order
+	void DrawPoints( const std::vector<Point2f>& points, const std::vector<Pixel>& colours );
+	// Draws a horizontal line of pixels from startX to endX (inclusive)
+	void DrawSpan( int startX, int endX, int posY, Pixel pix );
+	// Draws the pixels in a row which are set in a bitmask (bit 0 of the first word is the pixel at startX)
+	// > Used for 1-bit images like the debug font, where only some of the pixels in each row are set
+	void DrawMaskedSpan( int startX, int posY, const uint64_t* pMask, int width, Pixel pix );
+	// Draws a filled rectangle as horizontal spans (the right and bottom edges are not included)
+	void FillRect( int left, int top, int right, int bottom, Pixel pix );
+	// Draws a circle into the render target, either as an outline or filled with horizontal spans
+	void DrawCircle( int centreX, int centreY, int radius, Pixel pix, bool fill = false );
 	// Draws pixel data to the render target using a direct copy
 	// > Setting alphaMultiply < 1 forces a less optimal rendering approach (~50% slower) 
+	// > PIXEL_FORMAT_INDEXED8 pixel data is expanded through its palette a row at a time
 	void BlitPixels( const PixelData& srcImage, int srcOffset, int blitX, int blitY, int blitWidth, int blitHeight, float alphaMultiply ) const;
 	// Draws rotated and scaled pixel data to the render target (much slower than BlitPixels)
 	// > Setting alphaMultiply isn't a signfiicant additional slow down on RotateScalePixels
 	void RotateScalePixels( const PixelData& srcPixelData, int srcOffset, int blitX, int blitY, int blitWidth, int blitHeight, int originX, int originY, float angle, float scale, float alphaMultiply = 1.0f ) const;
+	// Draws scaled (but not rotated) pixel data to the render target, sampling the nearest source pixel
+	// > Keeps BlitPixels' pre-multiplied blend and transparent skips, so it is much faster than RotateScalePixels
+	void ScalePixels( const PixelData& srcPixelData, int srcOffset, int blitX, int blitY, int blitWidth, int blitHeight, int originX, int originY, float scale, float alphaMultiply = 1.0f ) const;
+	// Blends straight (not pre-multiplied) alpha pixel data onto the render target, multiplying each pixel by a tint colour
+	void BlitTinted( const PixelData& srcPixelData, int blitX, int blitY, Pixel tint );
 	// Clears the render target using the given pixel colour
 	void ClearRenderTarget( Pixel colour );
-	// Copies a background image of the correct size to the render target
-	void BlitBackground( PixelData& backgroundImage );
+	// Copies a background image to the render target, scrolled by the given number of pixels
+	// > Backgrounds which are a different size to the render target repeat in both directions
+	// > Backgrounds with transparent pixels are pre-multiplied (like sprites) and blended instead of copied
+	// > A scale other than 1 samples the nearest background pixel (used for drawing at a reduced resolution)
+	void BlitBackground( const PixelData& backgroundImage, int scrollX = 0, int scrollY = 0, float scale = 1.0f );
+
+	// Sets the camera offset which is subtracted from the position of everything drawn (except backgrounds)
+	// > The clipping rectangle stays in render target co-ordinates
+	void SetCameraOffset( int offsetX, int offsetY ) { m_cameraX = offsetX; m_cameraY = offsetY; }
+	// Gets the horizontal camera offset which is subtracted from the position of everything drawn
+	int GetCameraOffsetX() const { return m_cameraX; }
+	// Gets the vertical camera offset which is subtracted from the position of everything drawn
+	int GetCameraOffsetY() const { return m_cameraY; }
+
+	// 16-bit pixel functions
+	//********************************************************************************************************************************
+
+	// Packs a colour into a 16-bit PIXEL_FORMAT_RGB565 pixel using ordered dithering
+	// > A bias from a 4x4 pattern is added before the low bits are dropped, so the colour averages out over each 4x4 block
+	static uint16_t PackPixel565( uint32_t colour, int x, int y );
+	// Expands a 16-bit PIXEL_FORMAT_RGB565 pixel to an opaque 32-bit pixel
+	static uint32_t UnpackPixel565( uint16_t pix );
+#ifdef PLAY_USE_SSE2
+	// Packs eight pixels' 8-bit channels (held in 16-bit lanes) exactly like PackPixel565, starting from pixel (x, y)
+	static __m128i PackPixels565( __m128i red, __m128i green, __m128i blue, int x, int y );
+	// Expands eight 16-bit pixels into 8-bit channels (held in 16-bit lanes) exactly like UnpackPixel565
+	static void UnpackPixels565( __m128i pixels, __m128i& red, __m128i& green, __m128i& blue );
+#endif
 
 private:
 
+	// Works out the current clipping rectangle from the top of the clip stack and the render target bounds
+	void UpdateClipRect();
+	// Sets a run of pixels which is already known to be inside the render target, blending if the colour is translucent
+	static void FillPixels( Pixel* pDest, int count, Pixel pix );
+	// Blends a single pixel in fixed point: (src * srcAlpha) + (dest * (1 - srcAlpha))
+	static uint32_t BlendPixel( uint32_t dest, Pixel pix );
+	// Whether the render target stores 16-bit PIXEL_FORMAT_RGB565 pixels
+	bool Is565() const { return m_pRenderTarget->format == PIXEL_FORMAT_RGB565; }
+	// Blends a colour into a single pixel of a 16-bit render target (which is already known to be inside it)
+	void BlendPixel565( int x, int y, Pixel pix ) const;
+	// Blends a pre-multiplied pixel (in the sprite format) into a 16-bit pixel, applying a global alpha multiply
+	static uint16_t BlendPreMultiplied565( uint16_t dest, uint32_t src, float alphaMultiply, int x, int y );
+	// Draws a horizontal run of pixels on a 16-bit render target (already clipped)
+	void FillPixels565( int startX, int endX, int posY, Pixel pix );
+#ifdef PLAY_USE_SSE2
+	// Blends eight pre-multiplied pixels (in the sprite format) into a 16-bit row exactly like BlendPreMultiplied565 with no
+	// alpha multiply, leaving the destination of any transparent pixels alone
+	static void BlendPreMultiplied565( uint16_t* pDest, const uint32_t* pSrc, int x, int y );
+#endif
+
+	// The bias added to each channel before PackPixel565 drops its low bits, for each row of a 4x4 Bayer matrix
+	// > Each is a threshold from 0 to 15 in sixteenths of the packed step, plus half a sixteenth so the rounding is centred.
+	//   The rows repeat, so eight pixels' biases can be read from any starting column
+	static constexpr uint16_t DITHER_BIAS_565[4][12] = {
+		{ 8, 136, 40, 168, 8, 136, 40, 168, 8, 136, 40, 168 },
+		{ 200, 72, 232, 104, 200, 72, 232, 104, 200, 72, 232, 104 },
+		{ 56, 184, 24, 152, 56, 184, 24, 152, 56, 184, 24, 152 },
+		{ 248, 120, 216, 88, 248, 120, 216, 88, 248, 120, 216, 88 } };
+
 	PixelData* m_pRenderTarget{ nullptr };
 
+	// The camera offset subtracted from drawing positions
+	int m_cameraX{ 0 }, m_cameraY{ 0 };
+
+	// The stack of clipping rectangles added with PushClipRect
+	std::vector<PixelRect> m_vClipStack;
+	// The area of the render target which can be drawn to (always within the render target bounds)
+	PixelRect m_clipRect;
+
+	// Working buffers for sorting points into rows in DrawPoints (kept to avoid allocating every call)
+	std::vector<int> m_vPointRowStarts;
+	std::vector<int> m_vPointOffsets;
+	std::vector<int> m_vPointOrder;
+	// Working buffer for the half width of each row of a filled circle in DrawCircle
+	std::vector<int> m_vCircleHalfWidths;
+	// Working buffers for scaled backgrounds: the background column for each render target column, and one sampled row
+	std::vector<int> m_vBackgroundColumns;
+	std::vector<Pixel> m_vBackgroundRow;
+	// Working buffer for one row of an indexed image expanded through its palette (mutable so the const blits can use it)
+	mutable std::vector<Pixel> m_vIndexedRow;
+	// Working buffers for ScalePixels: the source column for each render target column, and the first render target column
+	// sampling each source column (so runs of transparent source pixels can be skipped)
+	mutable std::vector<int> m_vScaleColumns;
+	mutable std::vector<int> m_vScaleSkips;
+
 };
 
 #endif
@@ -609,6 +1107,64 @@ private:
 // Notes:		Uses PNG format. The end of the filename indicates the number of frames e.g. "bat_4.png" or "tiles_10x10.png"
 //********************************************************************************************************************************
 
+// Settings which control how dynamic resolution scaling responds to the frame time
+struct DynamicResolutionSettings
+{
+	// The frame time to stay within (measured from TimingBarBegin until the frame is presented, so leave time for presenting)
+	float targetMillisecs{ 15.0f };
+	// The smallest and largest resolution scales (as a fraction of the display size in each direction)
+	float minScale{ 0.5f };
+	float maxScale{ 1.0f };
+	// How much the scale changes by each time it changes
+	float scaleStep{ 0.125f };
+	// The scale only goes back up when the average frame time is below this fraction of the target (so it doesn't keep flipping)
+	float raiseThreshold{ 0.75f };
+	// The number of frames averaged before each change, which is also how long the scale stays the same after changing
+	int frameCount{ 8 };
+};
+
+// The memory used by a sprite, and the cost of decoding it when it is compressed
+struct SpriteMemoryInfo
+{
+	// The straight alpha canvas, which is kept for brushes, region updates and colouring (zero once it has been released)
+	int canvasBytes{ 0 };
+	// The 1-bit collision mask (and the font character widths once the canvas has been released)
+	int maskBytes{ 0 };
+	// The pre-multiplied drawing data (32-bit pixels, palette indices or compressed runs)
+	int drawBytes{ 0 };
+	// The size the drawing data would be as 32-bit pixels
+	int uncompressedBytes{ 0 };
+	// Whether the drawing data is stored as palette indices or compressed runs
+	bool indexed{ false }, compressed{ false };
+	// The number of frames drawn from an identical frame's pixels (in this sprite or another) rather than their own
+	int sharedFrames{ 0 };
+	// The drawing data saved by sharing those frames
+	int sharedBytes{ 0 };
+	// The number of frames decoded or tinted (on first use, or after dropping out of the decoded frame cache)
+	int frameDecodes{ 0 };
+	// The total time spent decoding and tinting frames (in milliseconds)
+	float decodeMillisecs{ 0.0f };
+};
+
+// Settings for the passes applied to each frame after it has been drawn and before it is presented
+struct PostProcessSettings
+{
+	// The radius (in pixels) of the blur applied to the whole frame (zero for no blur)
+	int blurRadius{ 0 };
+	// The number of box blurs applied one after another (three look almost the same as a Gaussian blur)
+	int blurPasses{ 1 };
+	// Whether the bright parts of the frame glow (the parts of each channel over the threshold are blurred at half resolution and added back)
+	bool bloom{ false };
+	// The brightness (0 to 255) which a channel has to be over to glow
+	int bloomThreshold{ 192 };
+	// The radius (in half resolution pixels) of the glow
+	int bloomRadius{ 4 };
+	// How strongly the glow is added back (from 0 to 4, where 1 adds it once)
+	float bloomStrength{ 1.0f };
+	// Whether the colour grade set with SetColourGrade is applied (after the blur and bloom)
+	bool colourGrade{ false };
+};
+
 // Manages 2D graphics operations on a PixelData buffer 
 // > Singleton class accessed using PlayGraphics::Instance()
 class PlayGraphics
@@ -634,7 +1190,13 @@ public:
 	// Draws a rectangle into the display buffer
 	void DrawRect( Point2f topLeft, Point2f bottomRight, Pixel pix, bool fill = false );
 	// Draws a circle into the display buffer
-	void DrawCircle( Point2f centrePos, int radius, Pixel pix );
+	void DrawCircle( Point2f centrePos, int radius, Pixel pix, bool fill = false );
+	// Draws a batch of pixels into the display buffer (e.g. starfields and particles)
+	// > Takes either a single colour for every point or one colour per point
+	void DrawPoints( const std::vector<Point2f>& points, const std::vector<Pixel>& colours );
+	// Draws connected lines through a list of points into the display buffer (e.g. trails and graphs)
+	// > Each pixel where lines join is only drawn once, so translucent polylines don't have darker joints
+	void DrawPolyline( const std::vector<Point2f>& points, Pixel pix, bool closed = false );
 	// Draws raw pixel data to the display buffer
 	// > Pre-multiplies the alpha on the image data if this hasn't been done before
 	void DrawPixelData( PixelData* pixelData, Point2f pos, float alpha = 1.0f );
@@ -647,7 +1209,41 @@ public:
 	int DrawDebugCharacter( Point2f pos, char c, Pixel pix );
 	// Draws text using the in-built debug font
 	// > Returns the x position at the end of the text
-	int DrawDebugString( Point2f pos, const std::string& s, Pixel pix, bool centred = true );
+	// > An outline colour which isn't fully transparent draws a one pixel outline around the text in the same pass
+	int DrawDebugString( Point2f pos, const std::string& s, Pixel pix, bool centred = true, Pixel outlinePix = 0x00000000 );
+
+	// Debug overlay functions
+	//********************************************************************************************************************************
+
+	// Categories of debug overlay drawing, which can be combined and shown or hidden together
+	enum DebugCategory
+	{
+		DEBUG_BOUNDS = 0x01, // Sprite drawing areas
+		DEBUG_COLLISION = 0x02, // Collision radii
+		DEBUG_ORIGINS = 0x04, // Sprite origins
+		DEBUG_LABELS = 0x08, // Text labels
+		DEBUG_USER = 0x10, // Anything added by the game
+		DEBUG_ALL = 0xFF,
+	};
+
+	// Adds a line to the debug overlay (drawn by DrawDebugOverlay)
+	void AddDebugLine( Point2f startPos, Point2f endPos, Pixel pix, int category = DEBUG_USER );
+	// Adds a rectangle outline to the debug overlay (drawn by DrawDebugOverlay)
+	void AddDebugRect( Point2f topLeft, Point2f bottomRight, Pixel pix, int category = DEBUG_USER );
+	// Adds a circle outline to the debug overlay (drawn by DrawDebugOverlay)
+	void AddDebugCircle( Point2f centrePos, int radius, Pixel pix, int category = DEBUG_USER );
+	// Adds a centred debug font label to the debug overlay (drawn by DrawDebugOverlay)
+	// > The text is copied into a shared buffer, so labels don't need to be kept until the overlay is drawn
+	void AddDebugLabel( Point2f pos, const std::string& text, Pixel pix, int category = DEBUG_LABELS );
+	// Draws everything added to the debug overlay since it was last drawn or cleared, then clears it
+	// > Each type of shape is drawn together, with labels on top, and anything outside the clipping rectangle is skipped
+	void DrawDebugOverlay();
+	// Removes everything added to the debug overlay without drawing it
+	void ClearDebugOverlay();
+	// Sets which categories of debug overlay drawing are shown (anything added in other categories is ignored)
+	void SetDebugCategories( int categories ) { m_debugCategories = categories; }
+	// Gets which categories of debug overlay drawing are shown
+	int GetDebugCategories() const { return m_debugCategories; }
 
 	// Sprite Loading functions
 	//********************************************************************************************************************************
@@ -661,6 +1257,20 @@ public:
 	// Updates a sprite sheet dynamically from memory (custom asset pipelines)
 	// > Left to caller to release old PixelData
 	int UpdateSprite( const std::string& name, PixelData& pixelData, int hCount = 1, int vCount = 1 );
+	// Copies the contents of a render target into a single-frame sprite which can be drawn like any other
+	// > Re-uses the existing sprite buffers if a sprite with this name and size has already been captured
+	int CaptureToSprite( PixelData* pRenderTarget, const std::string& name );
+	// Updates a rectangular area of a sprite's canvas from memory (dynamic textures)
+	// > Only the changed area is re-encoded, so the cost is proportional to the size of the rectangle
+	// > The source pixels are tightly packed rows of rect.width pixels
+	void UpdateSpriteRegion( int spriteId, PixelRect rect, const Pixel* pSrcPixels );
+	// Copies the original pixels of a sprite frame into pixel data without any blending
+	// > The copy is clipped to the destination
+	void CopySpriteFrame( int spriteId, int frameIndex, PixelData& dest, int destX, int destY ) const;
+	// Copies the pre-multiplied pixels a sprite frame is drawn with (including its colour) into pre-multiplied pixel data
+	// > Transparent pixels are copied with a skip value of zero, so the skip values need working out again afterwards
+	// > The copy is clipped to the destination
+	void CopySpriteFrameDrawData( int spriteId, int frameIndex, PixelData& dest, int destX, int destY ) const;
 	
 	// Loads a background image which is assumed to be the same size as the display buffer
 	// > Returns the index of the loaded background
@@ -671,6 +1281,7 @@ public:
 
 	// Gets the sprite id of the first matching sprite whose filename contains the given text
 	// > Returns -1 if not found
+	// > Successful lookups are remembered, so repeating a lookup each frame doesn't search the sprites again
 	int GetSpriteId( const char* spriteName ) const;
 	// Gets the root filename of a specific sprite
 	const std::string& GetSpriteName( int spriteId );
@@ -691,6 +1302,23 @@ public:
 	// Gets the number of sprites which have been loaded and created by PlayGraphics
 	int GetTotalLoadedSprites() const { return m_nTotalSprites; }
 
+	// Sprite memory functions
+	//********************************************************************************************************************************
+
+	// Stores a sprite's drawing data as compressed runs of pixels, or back as it was
+	// > Frames are decoded into a small shared cache when they are drawn, so this suits big animated sprites which only
+	//   have a few frames on screen at once, and costs time for sprites with lots of frames drawn every frame
+	void CompressSprite( int spriteId, bool compress = true );
+	// Frees the straight alpha canvas of every sprite (and of sprites added later) once its drawing data has been made
+	// > Collisions then use the 1-bit mask, font widths a table and ColourSprite a tint applied as frames are drawn
+	// > Brushes and sprite region updates rebuild the canvas from the drawing data the first time they need it, and then keep
+	//   it (as do captured sprites), since their pixels will be written again
+	void SetSpriteMemorySaving( bool enable );
+	// Gets the memory used by a sprite and how much decoding it has needed
+	SpriteMemoryInfo GetSpriteMemoryInfo( int spriteId ) const;
+	// Writes the memory used and decoding cost of every sprite to the debug output
+	void ReportSpriteMemory() const;
+
 	// Sprite Drawing functions
 	//********************************************************************************************************************************
 
@@ -701,11 +1329,20 @@ public:
 	// Draw the sprite rotated with transparency (slowest draw)
 	void DrawRotated( int spriteId, Point2f pos, int frameIndex, float angle, float scale = 1.0f, float alphaMultiply = 1.0f ) const;
 	// Draws a previously loaded background image
-	void DrawBackground( int backgroundIndex = 0 );
+	// > The background scrolls with the camera multiplied by the scroll factor (zero for a fixed background), so layers
+	// > drawn back to front with increasing scroll factors give a parallax effect
+	void DrawBackground( int backgroundIndex = 0, Vector2f scrollFactor = { 0.0f, 0.0f } );
 	// Multiplies the sprite image buffer by the colour values
 	// > Applies to all subseqent drawing calls for this sprite, but can be reset by calling agin with rgb set to white
 	void ColourSprite( int spriteId, int r, int g, int b );
 
+	// Draws a line by sweeping frame 0 of a pen sprite along it (as if it had been drawn at every pixel on the line)
+	// > Each pixel is only blended once per stroke and the colour is applied while drawing, so the sprite itself isn't changed
+	void DrawBrushLine( int spriteId, Point2f startPos, Point2f endPos, Pixel colour = PIX_WHITE );
+	// Draws a circle by sweeping frame 0 of a pen sprite around it (as if it had been drawn at every pixel on the circle)
+	// > Each pixel is only blended once per stroke and the colour is applied while drawing, so the sprite itself isn't changed
+	void DrawBrushCircle( int spriteId, Point2f centrePos, int radius, Pixel colour = PIX_WHITE );
+
 	// Draws a string using a sprite-based font exported from PlayFontTool
 	int DrawString( int fontId, Point2f pos, std::string text ) const;
 	// Draws a centred string using a sprite-based font exported from PlayFontTool
@@ -716,6 +1353,22 @@ public:
 	int DrawCharRotated( int fontId, Point2f pos, float angle, float scale, char c ) const;
 	// Gets the width of an individual text character from a sprite-based font
 	int GetFontCharWidth( int fontId, char c ) const;
+	// Gets the width of a string using a sprite-based font
+	int GetStringWidth( int fontId, const std::string& text ) const;
+	// Whether a string's layout is in the text layout cache (the least recently used strings are forgotten first)
+	bool IsTextLayoutCached( int fontId, const std::string& text ) const;
+
+	// Deferred drawing functions
+	//********************************************************************************************************************************
+
+	// Starts recording sprite and background draws so they can be drawn together by EndDeferredDraw
+	// > Any other drawing operation draws the recorded list first, so everything still appears in the order it was drawn
+	// > With occlusion culling, draws and background tiles which would be completely hidden by opaque sprites are skipped
+	void BeginDeferredDraw( bool occlusionCulling = true );
+	// Draws everything recorded since BeginDeferredDraw and stops recording
+	void EndDeferredDraw();
+	// Gets the number of pixels which occlusion culling has avoided drawing since BeginDeferredDraw
+	int GetOccludedPixelCount() const { return m_occludedPixels; }
 
 	// A pixel-based sprite collision test based on drawing
 	bool SpriteCollide( int s1Id, Point2f s1Pos, int s1FrameIndex, float s1Angle, int s1PixelColl[4], int s2Id, Point2f s2pos, int s2FrameIndex, float s2Angle, int s2PixelColl[4] ) const;
@@ -729,8 +1382,23 @@ public:
 		//int canvasWidth{ -1 }, canvasHeight{ -1 }; // The width and height of the entire sprite canvas
 		int hCount{ -1 }, vCount{ -1 }, totalCount{ -1 };  // The number of sprite images in the canvas horizontally and vertically
 		int originX{ 0 }, originY{ 0 }; // The origin and centre of rotation for the sprite (whole pixels only)
-		PixelData canvasBuffer; // The sprite image data
-		PixelData preMultAlpha; // The sprite data pre-multiplied with its own alpha
+		PixelData canvasBuffer; // The sprite image data (the pixels are freed when sprite memory saving is on)
+		PixelData preMultAlpha; // The sprite data pre-multiplied with its own alpha (palette indices for most sprites with 256 colours or fewer)
+		std::vector<Pixel> vPalette; // The colours of an indexed sprite before they are pre-multiplied into preMultAlpha's palette
+		std::vector<uint32_t> vCompressed; // The pre-multiplied frames as runs of pixels when compressed (preMultAlpha is then empty)
+		std::vector<size_t> vFrameStarts; // Where each frame starts in vCompressed
+		mutable int frameDecodes{ 0 }; // The number of frames decoded from vCompressed
+		mutable long long decodeTicks{ 0 }; // The performance counter ticks spent decoding frames
+		Pixel colour{ 0x00FFFFFF }; // The colour multiply last applied by ColourSprite
+		std::vector<PixelRect> vOpaqueRects; // The largest fully-opaque rectangle in each frame (relative to the frame's top left)
+		std::vector<uint32_t> vCollisionMask; // One bit for each canvas pixel which isn't fully transparent
+		int maskStride{ 0 }; // The number of words in each row of vCollisionMask
+		std::vector<uint8_t> vGlyphWidths; // Font character widths, which are hidden in the first canvas pixels, once the canvas is freed
+		std::vector<int> vFrameOwners; // The sprite whose drawing data holds each frame when identical frames are shared (empty for a whole sheet)
+		std::vector<int> vFrameOffsets; // The offset of each frame within its owner's drawing data when identical frames are shared
+		std::vector<uint64_t> vFrameHashes; // A hash of each frame's pre-multiplied pixels for finding identical frames (empty once they change)
+		bool keepCanvas{ false }; // Whether memory saving leaves the canvas alone, because the pixels are written again (by captures and updates)
+		mutable PixelData tintedFrames; // The frames tinted with the colour multiply, laid out like an unshared sheet (made when a sprite without a canvas is first drawn coloured)
 		Sprite() = default;
 	};
 
@@ -738,6 +1406,7 @@ public:
 	//********************************************************************************************************************************
 
 	// Gets a pointer to the drawing buffer's pixel data
+	// > When the resolution is scaled the frame is drawn into a smaller buffer and only copied here by EndFrame
 	PixelData* GetDrawingBuffer( void ) { return &m_playBuffer; }
 	// Resets the timing bar data and sets the current timing bar segment to a specific colour
 	void TimingBarBegin( Pixel pix );
@@ -749,9 +1418,109 @@ public:
 	// Gets the duration (in milliseconds) of a specific timing segment
 	float GetTimingSegmentDuration( int id ) const;
 	// Clears the display buffer using the given pixel colour
-	void ClearBuffer( Pixel colour ) { m_blitter.ClearRenderTarget( colour ); }
+	void ClearBuffer( Pixel colour ) { FlushDeferredDraws(); m_blitter.ClearRenderTarget( colour ); }
 	// Sets the render target for drawing operations
-	PixelData* SetRenderTarget( PixelData* renderTarget ) { return m_blitter.SetRenderTarget( renderTarget ); }
+	PixelData* SetRenderTarget( PixelData* renderTarget );
+	// Restricts subsequent drawing operations to a rectangle within the render target (e.g. split-screen or scrolling panes)
+	void PushClipRect( PixelRect rect );
+	// Restores the clipping rectangle which was in use before the last call to PushClipRect
+	void PopClipRect();
+	// Gets the area of the render target which drawing is currently restricted to
+	// > Always in display co-ordinates, even when the resolution is scaled
+	PixelRect GetClipRect() const;
+	// Sets the position which appears at the top left of the render target, so everything drawn afterwards scrolls with it
+	// > Set it back to zero to draw things which shouldn't scroll (e.g. scores)
+	void SetCameraPosition( Point2f pos );
+	// Gets the position which appears at the top left of the render target
+	Point2f GetCameraPosition() const { return m_cameraPos; }
+
+	// Dynamic resolution functions
+	//********************************************************************************************************************************
+
+	// Turns dynamic resolution scaling on or off
+	// > While it is on, frames are drawn at a lower resolution when they take longer than the target time and upscaled to the display
+	// > Drawing positions stay in display co-ordinates, but debug text and brush stamps keep their size in pixels
+	// > The frame time is measured from TimingBarBegin, so that needs calling at the start of every frame (unless the frame
+	//   time is passed to EndFrame)
+	void SetDynamicResolution( bool enable, const DynamicResolutionSettings& settings = DynamicResolutionSettings() );
+	// Gets whether dynamic resolution scaling is turned on
+	bool GetDynamicResolution() const { return m_bDynamicResolution; }
+	// Gets the fraction of the display resolution which frames are currently drawn at
+	float GetResolutionScale() const { return m_resolutionScale; }
+	// Sets the pixel format which frames are drawn in before they reach the display buffer
+	// > PIXEL_FORMAT_RGB565 halves the memory written and read while drawing, at the cost of some colour accuracy (which is
+	//   hidden with ordered dithering). The frame is only expanded to 32 bits by EndFrame, just before it is presented, and
+	//   at a window scale of one (on X11, Wayland and Windows) it is expanded straight into the memory the window presents.
+	// > Only change it between frames, as whatever has been drawn so far in the current frame is lost
+	void SetDisplayFormat( PixelFormat format );
+	// Gets the pixel format which frames are drawn in
+	PixelFormat GetDisplayFormat() const { return m_displayFormat; }
+
+	// Quality governor functions
+	//********************************************************************************************************************************
+
+	// Turns the quality governor on or off, which lowers the quality level when frames take longer than the target time
+	// and raises it again when there is time to spare
+	// > The frame time is measured from TimingBarBegin, so that needs calling at the start of every frame (unless the frame
+	//   time is passed to EndFrame)
+	void SetQualityGovernor( bool enable, float targetMillisecs = 15.0f );
+	// Gets the frame time (in milliseconds) which the quality governor aims for
+	float GetTargetFrameTime() const { return m_targetFrameTime; }
+	// Gets the average time (in milliseconds) taken by recent frames
+	float GetAverageFrameTime() const { return m_averageFrameTime; }
+	// Gets how many milliseconds recent frames have had to spare (negative when they are over the target)
+	float GetFrameHeadroom() const { return m_targetFrameTime - m_averageFrameTime; }
+	// Gets the suggested quality level from 0 (lowest) to 1 (highest)
+	float GetQualityLevel() const { return m_qualityLevel; }
+	// Registers a named quality setting (e.g. a particle spawn rate) which follows the quality level between two values
+	// > Registering the same name again replaces its values
+	void AddQualityKnob( const std::string& name, float lowQualityValue, float highQualityValue );
+	// Gets the current value of a quality setting for the current quality level
+	float GetQualityKnob( const std::string& name ) const;
+
+	// Post-process functions
+	//********************************************************************************************************************************
+
+	// Turns the post-process passes on or off
+	// > The passes are applied to the display buffer by EndFrame, with the rows of each pass split between worker threads
+	// > Each pass shows in the timing bar as its own segment (blur in cyan, bloom in yellow and colour grade in magenta)
+	void SetPostProcess( bool enable, const PostProcessSettings& settings = PostProcessSettings() );
+	// Gets whether the post-process passes are turned on
+	bool GetPostProcess() const { return m_bPostProcess; }
+	// Gets the settings for the post-process passes
+	const PostProcessSettings& GetPostProcessSettings() const { return m_postProcess; }
+	// Sets the 3D lookup table used for the colour grade from an image of its slices side by side
+	// > A table with N entries per channel is an N*N by N image: blue picks the slice, red the column within it and green the row
+	// > An unchanged table (e.g. 256x16) can be graded in a paint package along with a screenshot to make a new one
+	void SetColourGrade( const PixelData& table );
+	// Loads the colour grade lookup table from a PNG file (laid out as described for SetColourGrade)
+	void LoadColourGrade( const char* fileAndPath );
+	// Sets the number of worker threads the post-process and lighting passes are split between (as well as the calling thread)
+	// > By default there is one fewer than the number of hardware threads, and zero does all the work on the calling thread
+	void SetWorkerThreads( int count );
+	// Gets the number of worker threads which are running
+	int GetWorkerThreads() const { return static_cast<int>( m_vWorkers.size() ); }
+
+	// Lighting functions
+	//********************************************************************************************************************************
+
+	// Sets the colour of the light which reaches everything (white leaves unlit areas unchanged and black leaves them dark)
+	void SetAmbientLight( Pixel colour );
+	// Adds a point light for the current frame (e.g. a thruster glow or an explosion) in the same co-ordinates as sprites
+	// > The light fades smoothly to nothing at its radius, and an intensity over 1 brightens what it lights beyond its own colours
+	void AddLight( Point2f pos, float radius, Pixel colour, float intensity = 1.0f );
+	// Lights everything drawn so far in the render target (within the clipping rectangle) with the ambient light and the lights
+	// added since the last time it was called
+	// > The lights are added together at a quarter of the render target's resolution in each direction and smoothly scaled up, so
+	//   the cost depends on the size of the lights rather than on what has been drawn. It shows in the timing bar in orange.
+	// > Anything drawn afterwards (e.g. scores) isn't lit
+	void DrawLighting();
+
+	// Finishes the frame: upscales it into the display buffer (when it was drawn at a lower resolution), then updates the
+	// resolution scale and quality level from the frame time
+	// > Call once a frame just before presenting the display buffer (Play::PresentDrawingBuffer does this)
+	// > The frame time (in milliseconds) is measured from TimingBarBegin when it isn't given (e.g. from the game's own clock)
+	void EndFrame( float frameMillisecs = -1.0f );
 
 
 
@@ -774,19 +1543,214 @@ private:
 
 	// Multiplies the sprite image by its own alpha transparency values to save repeating this calculation on every draw
 	// > A colour multiplication can also be applied at this stage, which affects all subseqent drawing operations on the sprite
-	void PreMultiplyAlpha( Pixel* source, Pixel* dest, int width, int height, int maxSkipWidth, float alphaMultiply, Pixel colourMultiply );
+	void PreMultiplyAlpha( const PixelData& source, PixelData& dest, int maxSkipWidth, float alphaMultiply, Pixel colourMultiply );
+	// Calculates the pre-multiplied value of a single pixel (without the transparent pixel skip value)
+	static uint32_t PreMultiplyPixel( Pixel src, float alphaMultiply, Pixel colourMultiply );
+	// Applies a colour multiply to pixels pre-multiplied without one, giving what PreMultiplyPixel would have with it
+	static void TintPixels( const uint32_t* pSource, uint32_t* pDest, int count, Pixel colourMultiply );
+	// Works out the straight alpha value of a pixel pre-multiplied without a colour multiply (as closely as the rounding allows)
+	static Pixel UnPreMultiplyPixel( uint32_t pix );
+	// Creates a sprite's pre-multiplied drawing data from its canvas, as palette indices if it has 256 colours or fewer (and that is smaller)
+	void CreateDrawData( Sprite& s );
+	// Replaces an indexed sprite's drawing data with full 32-bit pixels (so that colours outside the palette can be added)
+	void ExpandDrawData( Sprite& s );
+	// Pre-multiplies an indexed sprite's palette with its own alpha and the sprite's colour multiply
+	static void PreMultiplyPalette( Sprite& s );
+	// Frees a sprite's drawing data in whichever form it is in
+	void ReleaseDrawData( Sprite& s );
+	// Encodes a sprite's pre-multiplied frames as runs of transparent and visible pixels
+	void CompressDrawData( Sprite& s );
+	// Gets the drawing data for a sprite frame and the offset of the frame within it (decoding compressed frames into the cache)
+	const PixelData& GetFrameDrawData( const Sprite& s, int frameIndex, int& frameOffset ) const;
+	// Gets the uncompressed drawing data which holds a sprite frame and the frame's offset within it (which may be another sprite's)
+	const PixelData& GetFrameStorage( const Sprite& s, int frameIndex, int& frameOffset ) const;
+	// Gets a pre-multiplied pixel from a frame in 32-bit or indexed drawing data (with every fully transparent pixel the same)
+	static uint32_t GetStoredPixel( const PixelData& data, int frameOffset, int x, int y );
+	// Hashes words with FNV-1a, carrying on from an earlier hash so that a frame can be hashed a row at a time
+	static uint64_t HashWords( const uint32_t* pWords, size_t count, uint64_t hash = kHashSeed );
+	// Makes frames which are identical to one already loaded (in this sprite or another) share its pixels
+	void DeduplicateFrames( Sprite& s );
+	// Removes a sprite's frames from the frame hashes so nothing else will share them
+	void ForgetFrameHashes( Sprite& s );
+	// Must be called before a sprite's drawing data is changed in place, so that it and every sprite sharing its frames have their own
+	void UnshareFrames( Sprite& s );
+	// Re-makes the drawing data of every other sprite which draws frames stored in a sprite
+	void RebuildBorrowers( int spriteId );
+	// Re-makes a sprite's drawing data from its canvas as a whole sheet, without sharing any frames
+	void RebuildDrawData( Sprite& s );
+	// Writes the frames shared while loading sprites, and the memory saved, to the debug output
+	void ReportSharedFrames() const;
+	// Decodes a frame of a compressed sprite into a buffer the size of the frame
+	void DecodeFrame( const Sprite& s, int frameIndex, const PixelData& dest ) const;
+	// Stops using any decoded frames of a sprite (the slots keep their pixels to be re-used) and frees its tinted frames
+	void ForgetDecodedFrames( int spriteId ) const;
+	// Whether a sprite's colour multiply is applied as its frames are drawn (because its canvas has been freed)
+	static bool IsTintedWhenDrawn( const Sprite& s );
+	// Frees a sprite's canvas, first keeping the font widths hidden in it and making sure the drawing data is uncoloured
+	void ReleaseCanvas( Sprite& s );
+	// Rebuilds a sprite's freed canvas from its drawing data
+	void RestoreCanvas( Sprite& s );
+	// Writes the straight alpha pixels of a sprite frame into a buffer the size of the frame, using the drawing data
+	void UnpackFrame( const Sprite& s, int frameIndex, const PixelData& dest ) const;
+	// Allocates (cleared) pixels for a buffer owned by PlayGraphics with every row starting on a 64-byte cache line boundary
+	static void AllocateAlignedPixels( PixelData& pixelData, int width, int height, PixelFormat format = PIXEL_FORMAT_ARGB );
+	// Gets the number of pixels AllocateAlignedPixels pads each row out to
+	static int AlignedStride( int width, PixelFormat format );
+	// Frees pixels which were allocated using AllocateAlignedPixels
+	static void FreeAlignedPixels( PixelData& pixelData );
+	// Works out the largest fully-opaque rectangle in a single sprite frame for occlusion culling
+	void CalculateOpaqueRect( Sprite& s, int frameIndex );
+	// Works out the largest fully-opaque rectangle in every frame of a sprite
+	void CalculateOpaqueRects( Sprite& s );
+	// Sets the collision mask bits for an area of a sprite's canvas (creating the mask if the canvas size has changed)
+	static void CalculateCollisionMask( Sprite& s, PixelRect rect );
+	// Whether a canvas pixel is set in a sprite's collision mask (pixels outside the canvas never are)
+	static bool IsMaskSet( const Sprite& s, int x, int y );
+
+	// A sprite or background draw recorded between BeginDeferredDraw and EndDeferredDraw
+	struct DeferredDraw
+	{
+		int id{ -1 }; // The sprite id, or the background index
+		Point2f pos{ 0.0f, 0.0f };
+		int frameIndex{ 0 };
+		float angle{ 0.0f }, scale{ 1.0f }, alphaMultiply{ 1.0f };
+		bool rotated{ false }, background{ false };
+		Vector2f scrollFactor{ 0.0f, 0.0f }; // The scroll factor for backgrounds
+		PixelRect bounds; // The area of the render target which the draw could change
+	};
+
+	// Draws the recorded deferred draws (culling any hidden ones) and empties the list
+	void FlushDeferredDraws();
+	// Draws frame 0 of a sprite at each position (like Draw), keeping the most opaque pixel where the stamps overlap,
+	// then blends the combined stroke onto the render target once
+	void DrawBrushStroke( int spriteId, const std::vector<Point2f>& vStamps, Pixel colour );
+
+	// Converts a position in display co-ordinates to render target co-ordinates (which differ when the resolution is scaled)
+	Point2f ToRenderTarget( Point2f pos ) const { return { pos.x * m_drawScale, pos.y * m_drawScale }; }
+	// Converts a rectangle in display co-ordinates to render target co-ordinates
+	PixelRect ToRenderTarget( PixelRect rect ) const;
+	// Changes the resolution scale, resizing the reduced resolution buffer and switching to it if drawing to the display
+	void SetResolutionScale( float scale );
+	// Works out the drawing scale for the current render target, scaling the clipping rectangles and camera offset to match
+	void UpdateViewTransform();
+	// Copies a buffer the frame was drawn into to the display buffer, repeating the nearest pixel and expanding 16-bit pixels
+	void UpscaleToDisplay( const PixelData& source );
+	// Gets the buffer which drawing to the display actually goes to (depending on the resolution scale and display format)
+	PixelData* GetDisplayTarget();
+	// Whether a render target is one of the buffers used for drawing to the display
+	bool IsDisplayTarget( const PixelData* pRenderTarget ) const { return pRenderTarget == &m_playBuffer || pRenderTarget == &m_scaledBuffer || pRenderTarget == &m_display565; }
+	// Gets a background in the format of the current render target, dithering a 16-bit copy of it the first time it is needed
+	const PixelData& GetBackgroundForTarget( int backgroundId );
+
+	// The character positions of a string in a sprite-based font, kept so that unchanged strings aren't laid out every frame
+	struct TextLayout
+	{
+		int fontId{ -1 };
+		std::string text;
+		std::vector<int> vOffsets; // The x offset of each character from the start of the string
+		int width{ 0 }; // The total width of the string
+		int uses{ 0 }; // How many times the layout has been used since it was created
+		unsigned int lastUse{ 0 }; // The value of m_textLayoutClock when the layout was last used
+		Pixel colour{ 0x00FFFFFF }; // The font colour when the run was rendered
+		PixelData run; // The whole string pre-rendered in the pre-multiplied format (only once the layout has been re-used)
+		bool translucentOverlaps{ false }; // Whether translucent pixels of one character cover another, so the run can't be used
+	};
+
+	// Finds the cached layout for a string, laying it out first if it isn't in the cache
+	TextLayout& GetTextLayout( int fontId, const std::string& text ) const;
+	// Renders a string's characters into a single pre-multiplied run which can be drawn with one blit
+	void RenderTextRun( TextLayout& layout ) const;
+	// Removes all the cached layouts for a font (when its sprite data changes), or all of them for a font id of -1
+	void ClearTextLayouts( int fontId = -1 ) const;
+
+	// The draws recorded since BeginDeferredDraw (mutable so that the const sprite drawing functions can record)
+	mutable std::vector<DeferredDraw> m_vDeferredDraws;
+	// Working buffers for FlushDeferredDraws (kept to avoid allocating every flush): the draws being flushed (swapped with
+	// m_vDeferredDraws), the hidden tiles, the tiles hidden when each background was reached, and which draws are culled
+	std::vector<DeferredDraw> m_vFlushedDraws;
+	std::vector<uint8_t> m_vHiddenTiles;
+	std::vector<std::vector<uint8_t>> m_vBackgroundHiddenTiles;
+	std::vector<uint8_t> m_vCulled;
+	// Whether sprite and background draws are currently being recorded
+	bool m_bDeferredDraw{ false };
+	// Whether hidden draws are skipped when the deferred draws are drawn
+	bool m_bOcclusionCulling{ true };
+	// The number of pixels occlusion culling has avoided drawing since BeginDeferredDraw
+	int m_occludedPixels{ 0 };
+
+	// Working buffer for the points passed to DrawPoints when the resolution is scaled
+	std::vector<Point2f> m_vScaledPoints;
+
+	// Working buffers for brush strokes (kept to avoid allocating every stroke)
+	std::vector<Point2f> m_vBrushStamps;
+	std::vector<Pixel> m_vBrushPixels;
+	std::vector<int> m_vBrushRowStarts, m_vBrushRowEnds;
+
+	// A frame of a compressed sprite decoded ready for drawing
+	struct DecodedFrame
+	{
+		int spriteId{ -1 };
+		int frameIndex{ -1 };
+		unsigned int lastUse{ 0 }; // The value of m_decodedFrameClock when the frame was last drawn
+		PixelData pixels;
+	};
+
+	// The number of decoded frames kept for compressed sprites (shared between all of them)
+	static constexpr int kDecodedFrameSlots = 16;
+	// The decoded frames, with the least recently drawn one replaced when a new one is needed
+	mutable std::vector<DecodedFrame> m_vDecodedFrames;
+	// Counts frame draws so the least recently drawn frame can be found
+	mutable unsigned int m_decodedFrameClock{ 0 };
+	// Whether sprite canvases are freed once their drawing data has been made
+	bool m_bSpriteMemorySaving{ false };
+	// Working buffer for copying frames of sprites without a canvas
+	mutable std::vector<Pixel> m_vFramePixels;
+	// The sprite id and frame index of every frame storing its own pixels, keyed by the frame's hash
+	std::multimap<uint64_t, std::pair<int, int>> m_frameHashes;
+	// The starting value of a frame hash (the FNV-1a offset basis)
+	static constexpr uint64_t kHashSeed = 14695981039346656037ull;
+
+	// Cached string layouts keyed by the font id and then the text
+	mutable std::map<int, std::map<std::string, TextLayout>> m_textLayouts;
+	// Counts layout uses so the least recently used layout can be found
+	mutable unsigned int m_textLayoutClock{ 0 };
+	// Sprite ids which have already been found by GetSpriteId, keyed by the name asked for
+	mutable std::map<std::string, int> m_spriteIds;
 
 	// Count of the total number of sprites loaded
 	int m_nTotalSprites{ 0 };
 	// Whether the singleton has been initialised yet
 	bool m_bInitialised{ false };
-
-	// Allocates a buffer for the debug font and copies the font pixel data to it
+	// The camera position (the blitter uses it rounded to whole pixels, but parallax backgrounds scroll by a fraction of it)
+	Point2f m_cameraPos{ 0.0f, 0.0f };
+	// The clipping rectangles pushed with PushClipRect in display co-ordinates (so they can be scaled when the resolution changes)
+	std::vector<PixelRect> m_vClipRects;
+
+	// Whether dynamic resolution scaling is turned on
+	bool m_bDynamicResolution{ false };
+	// The settings for dynamic resolution scaling
+	DynamicResolutionSettings m_dynamicResolution;
+	// The fraction of the display resolution which frames are drawn at
+	float m_resolutionScale{ 1.0f };
+	// The scale from display co-ordinates to the current render target (the resolution scale when drawing to the smaller buffer)
+	float m_drawScale{ 1.0f };
+	// The buffer frames are drawn into at a reduced resolution (allocated at the display size, but used with a smaller width and height)
+	PixelData m_scaledBuffer;
+	// The column in the buffer the frame is drawn into which each display column is copied from
+	std::vector<int> m_vUpscaleColumns;
+	// The pixel format frames are drawn in
+	PixelFormat m_displayFormat{ PIXEL_FORMAT_ARGB };
+	// The 16-bit buffer frames are drawn into when the display format is PIXEL_FORMAT_RGB565 (sized like m_scaledBuffer)
+	PixelData m_display565;
+	// The times of recent frames (in milliseconds) which the next scale is chosen from
+	std::vector<float> m_vFrameTimes;
+
+	// Expands the debug font data into a bitmask for each row of each character
 	void DecompressDubugFont( void );
+	// Gets the index of a debug font character (translating a few characters which aren't in the font), or -1 if there isn't one
+	static int GetDebugCharacterIndex( char c );
 	// Returns the pixel width of a string using the debug font
 	int GetDebugStringWidth( const std::string& s );
-	// Draws the offset points from the origin in all octants
-	void DrawCircleOctants( int posX, int posY, int offX, int offY, Pixel pix );
 	// Ends the current timing segment and calculates the duration
 	LARGE_INTEGER EndTimingSegment();
 
@@ -802,23 +1766,277 @@ private:
 	std::vector<TimingSegment> m_vTimings;
 	std::vector<TimingSegment> m_vPrevTimings;
 
+	// Chooses the resolution scale for the next frame from the frame time
+	void UpdateDynamicResolution( float frameTime );
+	// Moves the quality level towards what the average frame time allows
+	void UpdateQualityGovernor();
+
+	// A named quality setting and its values at the lowest and highest quality levels
+	struct QualityKnob
+	{
+		float lowQualityValue{ 0.0f };
+		float highQualityValue{ 1.0f };
+	};
+
+	// Whether the quality governor is turned on
+	bool m_bQualityGovernor{ false };
+	// The frame time (in milliseconds) the quality governor aims for
+	float m_targetFrameTime{ 15.0f };
+	// A moving average of the frame time (in milliseconds)
+	float m_averageFrameTime{ 0.0f };
+	// The suggested quality level from 0 (lowest) to 1 (highest)
+	float m_qualityLevel{ 1.0f };
+	// The registered quality settings
+	std::map<std::string, QualityKnob> m_qualityKnobs;
+
+	// A point light, in render target co-ordinates
+	struct Light
+	{
+		Point2f pos{ 0.0f, 0.0f };
+		float radius{ 0.0f };
+		Pixel colour;
+		float intensity{ 1.0f };
+	};
+
+	// The steps of the post-process passes, each of which works on bands of rows independently
+	enum PostProcessStep
+	{
+		POST_BLUR_ROWS = 0,
+		POST_BLUR_COLUMNS,
+		POST_BLOOM_THRESHOLD,
+		POST_BLOOM_ADD,
+		POST_COLOUR_GRADE,
+		POST_LIGHTING,
+	};
+
+	// A post-process step and the images it reads and writes
+	struct PostProcessJob
+	{
+		PostProcessStep step{ POST_BLUR_ROWS };
+		const PixelData* pSource{ nullptr };
+		PixelData* pDest{ nullptr };
+		int radius{ 0 };
+	};
+
+	// Working buffers for one band of rows (kept to avoid allocating every band of every pass)
+	struct BandScratch
+	{
+		// The four channel sums for each column being blurred
+		std::vector<int> vSums;
+		// A row of the glow which is half way between two of its rows
+		std::vector<uint32_t> vBetweenRows;
+		// The light map blended to the height of the row being lit
+		std::vector<uint16_t> vRowLight;
+	};
+
+	// Applies the post-process passes to the display buffer
+	void ApplyPostProcess();
+	// Box blurs an image a number of times, using a working buffer of the same size
+	void BlurImage( PixelData& image, PixelData& temp, int radius, int passes );
+	// Runs a post-process step on a band of rows of its destination, using that band's working buffers
+	void RunPostProcessJob( const PostProcessJob& job, int band, int startY, int endY ) const;
+	// Box blurs rows of an image horizontally into another image (the edge pixels are repeated beyond the edges)
+	static void BlurRows( const PixelData& source, PixelData& dest, int radius, int startY, int endY );
+	// Box blurs rows of an image vertically into another image (the edge pixels are repeated beyond the edges)
+	static void BlurColumns( const PixelData& source, PixelData& dest, int radius, int startY, int endY, std::vector<int>& vSums );
+	// Halves the size of an image, keeping only the parts of each colour channel over the threshold
+	static void BloomThresholdRows( const PixelData& source, PixelData& dest, int threshold, int startY, int endY );
+	// Doubles the size of a glow image and adds it to an image (strength is in 64ths)
+	static void BloomAddRows( const PixelData& bloom, PixelData& dest, int strength, int startY, int endY, std::vector<uint32_t>& vBetweenRows );
+	// Maps rows of an image through the colour grade lookup table
+	void GradeRows( PixelData& image, int startY, int endY ) const;
+	// Adds a point light to the light map
+	void AddLightToMap( const Light& light );
+	// Multiplies rows of an image (within the area being lit) by the light map, scaled up to the image's size
+	void LightRows( PixelData& image, int startY, int endY, std::vector<uint16_t>& vRowLight ) const;
+	// Starts a new timing bar segment for a post-process or lighting pass (when the timing bar is being used)
+	void BeginPostProcessTiming( Pixel pix );
+
+	// Whether the post-process passes are turned on
+	bool m_bPostProcess{ false };
+	// The settings for the post-process passes
+	PostProcessSettings m_postProcess;
+	// A working buffer for blurring the display buffer (the same size)
+	PixelData m_postBuffer;
+	// The half resolution glow and a working buffer for blurring it
+	PixelData m_bloomBuffer, m_bloomTemp;
+	// The working buffers for each band of rows (only the thread working on a band uses its buffers)
+	mutable std::vector<BandScratch> m_vBandScratch;
+	// The colour grade lookup table, indexed by ( ( blue * size ) + green ) * size + red
+	std::vector<uint32_t> m_vColourGrade;
+	// The number of entries per channel in the colour grade lookup table
+	int m_colourGradeSize{ 0 };
+	// The lower lookup table entry for each channel value, and how far it is towards the next one (in 256ths)
+	uint8_t m_gradeIndex[256]{};
+	uint16_t m_gradeFraction[256]{};
+
+	// The light map has one pixel for each 4x4 block of render target pixels
+	static constexpr int LIGHT_MAP_SHIFT = 2;
+	// The brightest a light map channel can be (four times full brightness, in 256ths)
+	static constexpr int LIGHT_MAP_MAX = 1023;
+
+	// The ambient light
+	Pixel m_ambientLight{ PIX_WHITE };
+	// The point lights added since the last DrawLighting
+	std::vector<Light> m_vLights;
+	// The light reaching each light map pixel as four 16-bit channels (in the same order as a pixel's) in 256ths of full brightness
+	std::vector<uint16_t> m_vLightMap;
+	// The size of the light map
+	int m_lightMapWidth{ 0 }, m_lightMapHeight{ 0 };
+	// The light map column each render target column is scaled up from, and how far it is towards the next one (in 8ths)
+	std::vector<int> m_vLightColumns;
+	std::vector<int> m_vLightColumnWeights;
+	// The area of the render target being lit (the clipping rectangle)
+	PixelRect m_lightRect{ 0, 0, 0, 0 };
+
+	// Worker thread functions
+	//********************************************************************************************************************************
+
+	// Starts the worker threads (one fewer than the number of hardware threads, as the calling thread works too)
+	void StartWorkers();
+	// Stops the worker threads and waits for them to finish
+	void StopWorkers();
+	// The loop each worker thread runs, which waits for bands of rows to work on
+	void WorkerLoop();
+	// Works on bands of rows from the current job until there are none left
+	void RunWorkerBands();
+	// Runs a post-process step in bands of rows on the worker threads (and this one), returning once every band is finished
+	void ForEachRowBand( const PostProcessJob& job, int height );
+
+	// The worker threads
+	std::vector<std::thread> m_vWorkers;
+	// Protects the job number and the quit flag, and is used with the condition variables
+	std::mutex m_workerMutex;
+	// Signalled when there is a new job, and when the last band of a job finishes
+	std::condition_variable m_workerWake, m_workerDone;
+	// The post-process step which the bands of rows are being worked on for
+	PostProcessJob m_workerJob;
+	// The number of rows in the current job
+	int m_workerRows{ 0 };
+	// Increases with each job, so the workers can tell when there is a new one
+	int m_workerJobNumber{ 0 };
+	// The number of bands in the current job (top 16 bits) and the next band to be claimed (bottom 16 bits)
+	// > Keeping both in one value means a thread claiming a band always compares it with the number of bands in the same job
+	std::atomic<int> m_workerClaims{ 0 };
+	// The number of bands in the current job which haven't finished yet
+	std::atomic<int> m_workerBandsLeft{ 0 };
+	// Tells the worker threads to finish
+	bool m_bWorkersQuit{ false };
+	// The number of worker threads to start (-1 for one fewer than the number of hardware threads)
+	int m_workerCount{ -1 };
+
 	// The PlayBlitter used for drawing
 	PlayBlitter m_blitter;
 
 	// Buffer pointers
 	PixelData m_playBuffer;
-	uint8_t* m_pDebugFontBuffer{ nullptr };
+
+	// The debug font as a bitmask for each row of each character (bit 0 is the leftmost pixel)
+	uint8_t m_debugFontMasks[48][12]{};
+	// Whether the debug font has been expanded into m_debugFontMasks yet
+	bool m_bDebugFontReady{ false };
+	// Working buffers for a debug string's row bitmasks (kept to avoid allocating every string)
+	std::vector<uint64_t> m_vDebugTextMasks, m_vDebugOutlineMask;
+
+	// A line or circle added to the debug overlay
+	struct DebugShape
+	{
+		int x1, y1, x2, y2; // The line end points, or the circle's centre and radius in x2
+		Pixel pix;
+		bool drawStart{ true }; // Whether a line draws its first pixel (rectangle edges leave it out so corners are only drawn once)
+	};
+
+	// A label added to the debug overlay, whose text is part of m_debugLabelText
+	struct DebugLabel
+	{
+		Point2f pos;
+		Pixel pix;
+		size_t textStart, textLength;
+	};
+
+	// The debug overlay shapes and labels since the overlay was last drawn (kept between frames to avoid allocations)
+	std::vector<DebugShape> m_vDebugLines, m_vDebugCircles;
+	std::vector<DebugLabel> m_vDebugLabels;
+	std::string m_debugLabelText, m_debugLabel;
+	// The categories of debug overlay drawing which are shown
+	int m_debugCategories{ DEBUG_ALL };
 
 	// A vector of all the loaded sprites
 	std::vector< Sprite > vSpriteData;
 	// A vector of all the loaded backgrounds
 	std::vector< PixelData > vBackgroundData;
+	// Dithered 16-bit copies of the opaque backgrounds (made the first time each is drawn to a 16-bit render target)
+	std::vector< PixelData > vBackground565;
 
 	// A pointer to the static instance
 	static PlayGraphics* s_pInstance;
 
 };
 
+#endif
+#ifndef PLAY_PLAYTILEMAP_H
+#define PLAY_PLAYTILEMAP_H
+//********************************************************************************************************************************
+// File:		PlayTileMap.h
+// Description:	Declaration for a grid of tiles drawn using the frames of a sprite sheet
+// Platform:	Independent
+// Notes:		The tiles are the frames of a sprite sheet such as "tiles_10x10.png", numbered left to right and top to bottom
+//********************************************************************************************************************************
+
+// A grid of tiles which is split into square chunks of tiles
+// > Each chunk is drawn into its own buffer when it changes, so drawing the map only needs one blit per visible chunk
+class TileMap
+{
+public:
+	// Creates a map of empty tiles which uses the frames of the given sprite as its tiles
+	TileMap( int tileSpriteId, int width, int height, int chunkSize = 16 );
+
+	// Sets the tile at a grid position (-1 for an empty tile)
+	// > Only the chunk containing the tile is redrawn, and not until the next time it's visible
+	void SetTile( int x, int y, int tileIndex );
+	// Gets the tile at a grid position (-1 for an empty tile or a position outside the map)
+	int GetTile( int x, int y ) const;
+	// Sets every tile in the map to the same tile
+	void Fill( int tileIndex );
+	// Redraws every chunk the next time it's visible (e.g. after the tile sprite has been updated)
+	void InvalidateAll();
+	// Draws the chunks of the map which are visible through the clipping rectangle
+	// > The camera position is the position in the map which appears at the top left of the render target
+	// > It is added to the PlayGraphics camera position, so it can be left at zero when the map scrolls with everything else
+	void Draw( Point2f cameraPos = { 0.0f, 0.0f } );
+
+	// Gets the width of the map in tiles
+	int GetWidth() const { return m_width; }
+	// Gets the height of the map in tiles
+	int GetHeight() const { return m_height; }
+	// Gets the sprite id used for the tiles
+	int GetTileSpriteId() const { return m_tileSpriteId; }
+
+private:
+	// A square group of tiles with its own pre-drawn buffer
+	struct Chunk
+	{
+		std::vector<Pixel> vPixels; // The chunk's tiles drawn together
+		PixelData pixelData; // Describes vPixels
+		int tileCount{ 0 }; // The number of tiles which aren't empty (empty chunks aren't drawn at all)
+		bool dirty{ true }; // Whether the tiles have changed since the chunk was drawn
+	};
+
+	// Draws the tiles of a chunk into its buffer
+	void DrawChunk( int chunkX, int chunkY );
+
+	int m_tileSpriteId{ -1 };
+	int m_width{ 0 }, m_height{ 0 }; // The size of the map in tiles
+	int m_chunkSize{ 16 }; // The width and height of a chunk in tiles
+	int m_chunksWide{ 0 }, m_chunksHigh{ 0 };
+	std::vector<int> m_vTiles;
+	std::vector<Chunk> m_vChunks;
+
+	// Copying would leave the chunks pointing at the other map's pixels
+	TileMap& operator=( const TileMap& ) = delete;
+	TileMap( const TileMap& ) = delete;
+};
+
 #endif
 #ifndef PLAY_PLAYAUDIO_H
 #define PLAY_PLAYAUDIO_H
@@ -1059,7 +2277,43 @@ namespace Play
 	// Loads a PNG file as the background image for the window
 	int LoadBackground( const char* pngFilename );
 	// Draws the background image previously loaded with Play::LoadBackground() into the drawing buffer
-	void DrawBackground( int background = 0 );
+	// > The background scrolls with the camera multiplied by the scroll factor (e.g. 0.5f for a distant parallax layer)
+	void DrawBackground( int background = 0, Vector2D scrollFactor = { 0.0f, 0.0f } );
+	// Sets the position which appears at the top left of the drawing buffer, so everything drawn afterwards scrolls with it
+	void SetCameraPosition( Point2D pos );
+	// Gets the position which appears at the top left of the drawing buffer
+	Point2D GetCameraPosition();
+	// Turns dynamic resolution on or off, which draws frames at a lower resolution when they take longer than the target time
+	// > The frame time is measured from Play::BeginTimingBar, so that needs calling at the start of every frame
+	void SetDynamicResolution( bool enable, float targetMillisecs = 15.0f, float minScale = 0.5f );
+	// Gets the fraction of the display resolution which frames are currently drawn at
+	float GetResolutionScale();
+	// Draws frames in 16-bit colour (with dithering) to halve the memory bandwidth used while drawing
+	// > Frames are only expanded to 32-bit colour when they are presented
+	void SetSixteenBitDisplay( bool enable );
+	// Turns on the quality governor, which lowers the quality level when frames take longer than the target time
+	// > The frame time is measured from Play::BeginTimingBar, so that needs calling at the start of every frame
+	void SetFrameBudget( float targetMillisecs );
+	// Gets how many milliseconds recent frames have had to spare (negative when they are over budget)
+	float GetFrameHeadroom();
+	// Gets the suggested quality level from 0 (lowest) to 1 (highest)
+	float GetQualityLevel();
+	// Registers a named quality setting (e.g. a particle spawn rate) which follows the quality level between two values
+	void AddQualityKnob( const char* name, float lowQualityValue, float highQualityValue );
+	// Gets the current value of a quality setting
+	float GetQualityKnob( const char* name );
+	// Blurs every frame before it is presented (a radius of zero turns the blur off)
+	void SetScreenBlur( int radius );
+	// Makes the bright parts of every frame glow: the parts of each colour channel over the threshold (0 to 255) are blurred and added back
+	void SetBloom( bool enable, int threshold = 192, float strength = 1.0f );
+	// Colour grades every frame with a 3D lookup table loaded from a PNG (see PlayGraphics::SetColourGrade), or turns it off with nullptr
+	void SetColourGrade( const char* pngFilename );
+	// Sets the colour of the light which reaches everything drawn before Play::DrawLighting (white leaves it unchanged)
+	void SetAmbientLight( Colour col );
+	// Adds a point light (e.g. a thruster glow or an explosion) which lights everything drawn before the next Play::DrawLighting
+	void AddLight( Point2D pos, float radius, Colour col, float intensity = 1.0f );
+	// Lights everything drawn so far with the ambient light and the point lights (draw things which shouldn't be lit afterwards)
+	void DrawLighting();
 	// Draws text to the screen using the built-in debug font
 	void DrawDebugText( Point2D pos, const char* text, Colour col = cWhite, bool centred = true );
 
@@ -1080,6 +2334,13 @@ namespace Play
 	// Blends the sprite with the given colour (works best on white sprites)
 	// > Note that colouring affects subsequent DrawSprite calls using the same sprite!!
 	void ColourSprite( const char* spriteName, Colour col );
+	// Stores the sprite compressed to save memory, decoding frames as they are drawn (best for big sheets with idle frames)
+	void CompressSprite( const char* spriteName, bool compress = true );
+	// Frees the original image of every sprite once it has been prepared for drawing, which roughly halves sprite memory
+	// > Affects sprites loaded later too, and all the sprite functions still work as before
+	void SetSpriteMemorySaving( bool enable );
+	// Writes the memory used and decoding cost of every sprite to the debug output
+	void ReportSpriteMemory();
 
 	// Centres the origin of the first sprite found matching the given name
 	void CentreSpriteOrigin( const char* spriteName );
@@ -1116,15 +2377,15 @@ namespace Play
 	void DrawSpriteRotated( int spriteID, Point2D pos, int frame, float angle, float scale, float opacity = 1.0f );
 	// Draws a single-pixel wide line between two points in the given colour
 	void DrawLine( Point2D start, Point2D end, Colour col );
-	// Draws a single-pixel wide circle in the given colour
-	void DrawCircle( Point2D pos, int radius, Colour col );
+	// Draws a single-pixel wide circle in the given colour (or a filled circle)
+	void DrawCircle( Point2D pos, int radius, Colour col, bool fill = false );
 	// Draws a rectangle in the given colour
 	void DrawRect( Point2D topLeft, Point2D bottomRight, Colour col, bool fill = false );
 	// Draws a line between two points using a sprite
-	// > Note that colouring affects subsequent DrawSprite calls using the same sprite!!
+	// > The colour only applies to the line, so it doesn't affect other drawing with the same sprite
 	void DrawSpriteLine( Point2D startPos, Point2D endPos, const char* penSprite, Colour c = cWhite );
 	// Draws a circle using a sprite
-	// > Note that colouring affects subsequent DrawSprite calls using the same sprite!!
+	// > The colour only applies to the circle, so it doesn't affect other drawing with the same sprite
 	void DrawSpriteCircle( int x, int y, int radius, const char* penSprite, Colour c = cWhite );
 	// Draws text using a sprite-based font exported from PlayFontTool
 	void DrawFontText( const char* fontId, std::string text, Point2D pos, Align justify = LEFT );
@@ -1459,13 +2720,15 @@ void PrintAllocations( const char* tagText )
 //********************************************************************************************************************************
 // File:		PlayWindow.cpp
 // Description:	Platform specific code to provide a window to draw into
-// Platform:	Windows
-// Notes:		Uses a 32-bit ARGB display buffer
+// Platform:	Windows, Headless, X11, Wayland
+// Notes:		Uses a 32-bit ARGB display buffer. The headless platform has no window and presents into memory instead.
 //********************************************************************************************************************************
 
+#ifdef PLAY_PLATFORM_WINDOWS
 // Instruct Visual Studio to add these to the list of libraries to link
 #pragma comment(lib, "gdiplus.lib")
 #pragma comment(lib, "dwmapi.lib")
+#endif
 
 PlayWindow* PlayWindow::s_pInstance = nullptr;
 
@@ -1474,6 +2737,7 @@ extern void MainGameEntry( int argc, char* argv[] );
 extern bool MainGameUpdate( float ); // Called every frame
 extern int MainGameExit( void ); // Called on quit
 
+#ifdef PLAY_PLATFORM_WINDOWS
 ULONG_PTR g_pGDIToken = 0;
 
 int WINAPI WinMain( _In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _In_ LPSTR lpCmdLine, _In_ int nShowCmd )
@@ -1489,98 +2753,423 @@ int WINAPI WinMain( _In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
 
 	return PlayWindow::Instance().HandleWindows( hInstance, hPrevInstance, lpCmdLine, nShowCmd, L"PlayBuffer" );
 }
-
-//********************************************************************************************************************************
-// Constructor / Destructor (Private)
-//********************************************************************************************************************************
-
-PlayWindow::PlayWindow( PixelData* pDisplayBuffer, int nScale )
+#else
+int main( int argc, char* argv[] )
 {
-	PLAY_ASSERT( pDisplayBuffer );
-	PLAY_ASSERT( nScale > 0 );
-	m_pPlayBuffer = pDisplayBuffer;
-	m_scale = nScale;
+	MainGameEntry( argc, argv );
+
+	return PlayWindow::Instance().HandleFrames( argc, argv );
 }
+#endif
 
-PlayWindow::~PlayWindow( void )
+#ifdef PLAY_PLATFORM_X11
+// Set by CatchX11Error when an X request fails while it is the error handler
+static bool s_bX11Error = false;
+
+// An X error handler which records that an error happened instead of exiting
+static int CatchX11Error( Display* pDisplay, XErrorEvent* pError )
 {
-	s_pInstance = nullptr;
+	UNREFERENCED_PARAMETER( pDisplay );
+	UNREFERENCED_PARAMETER( pError );
+	s_bX11Error = true;
+	return 0;
 }
+#endif
 
-//********************************************************************************************************************************
-// Instance functions
-//********************************************************************************************************************************
+#ifdef PLAY_PLATFORM_WAYLAND
+// The xdg-shell protocol's interfaces, as wayland-scanner would generate them (version 1, which has everything we need)
+// > Requests we never make have no argument types: the types are only used to check the objects in events
+static const wl_interface* s_xdgNoTypes[] = { nullptr, nullptr, nullptr, nullptr };
+static const wl_interface* s_xdgSeatTypes[] = { &wl_seat_interface, nullptr, nullptr, nullptr };
+static const wl_interface* s_xdgOutputTypes[] = { &wl_output_interface };
+
+static const wl_message s_xdgToplevelRequests[] = {
+	{ "destroy", "", s_xdgNoTypes }, { "set_parent", "?o", s_xdgNoTypes }, { "set_title", "s", s_xdgNoTypes }, { "set_app_id", "s", s_xdgNoTypes },
+	{ "show_window_menu", "ouii", s_xdgSeatTypes }, { "move", "ou", s_xdgSeatTypes }, { "resize", "ouu", s_xdgSeatTypes },
+	{ "set_max_size", "ii", s_xdgNoTypes }, { "set_min_size", "ii", s_xdgNoTypes }, { "set_maximized", "", s_xdgNoTypes }, { "unset_maximized", "", s_xdgNoTypes },
+	{ "set_fullscreen", "?o", s_xdgOutputTypes }, { "unset_fullscreen", "", s_xdgNoTypes }, { "set_minimized", "", s_xdgNoTypes } };
+static const wl_message s_xdgToplevelEvents[] = { { "configure", "iia", s_xdgNoTypes }, { "close", "", s_xdgNoTypes } };
+static const wl_interface s_xdgToplevelInterface = { "xdg_toplevel", 1, 14, s_xdgToplevelRequests, 2, s_xdgToplevelEvents };
+
+static const wl_interface* s_xdgSurfaceTypes[] = { &s_xdgToplevelInterface };
+static const wl_message s_xdgSurfaceRequests[] = {
+	{ "destroy", "", s_xdgNoTypes }, { "get_toplevel", "n", s_xdgSurfaceTypes }, { "get_popup", "n?oo", s_xdgNoTypes },
+	{ "set_window_geometry", "iiii", s_xdgNoTypes }, { "ack_configure", "u", s_xdgNoTypes } };
+static const wl_message s_xdgSurfaceEvents[] = { { "configure", "u", s_xdgNoTypes } };
+static const wl_interface s_xdgSurfaceInterface = { "xdg_surface", 1, 5, s_xdgSurfaceRequests, 1, s_xdgSurfaceEvents };
+
+static const wl_interface* s_xdgWmBaseTypes[] = { &s_xdgSurfaceInterface, &wl_surface_interface };
+static const wl_message s_xdgWmBaseRequests[] = {
+	{ "destroy", "", s_xdgNoTypes }, { "create_positioner", "n", s_xdgNoTypes }, { "get_xdg_surface", "no", s_xdgWmBaseTypes }, { "pong", "u", s_xdgNoTypes } };
+static const wl_message s_xdgWmBaseEvents[] = { { "ping", "u", s_xdgNoTypes } };
+static const wl_interface s_xdgWmBaseInterface = { "xdg_wm_base", 1, 4, s_xdgWmBaseRequests, 1, s_xdgWmBaseEvents };
+
+// The request numbers (opcodes) of the xdg-shell requests we make
+enum XdgOpcode
+{
+	XDG_DESTROY = 0, // Every xdg-shell interface's first request
+	XDG_WM_BASE_GET_XDG_SURFACE = 2,
+	XDG_WM_BASE_PONG = 3,
+	XDG_SURFACE_GET_TOPLEVEL = 1,
+	XDG_SURFACE_ACK_CONFIGURE = 4,
+	XDG_TOPLEVEL_SET_TITLE = 2,
+	XDG_TOPLEVEL_SET_MAX_SIZE = 7,
+	XDG_TOPLEVEL_SET_MIN_SIZE = 8,
+};
 
-PlayWindow& PlayWindow::Instance()
+// The xdg-shell event handlers, laid out like the listeners wayland-scanner generates
+struct XdgWmBaseListener
 {
-	if( !s_pInstance )
-		PLAY_ASSERT_MSG( false, "Trying to use PlayBuffer without initialising it!" );
+	void ( *ping )( void* pData, xdg_wm_base* pWmBase, uint32_t serial );
+};
 
-	return *s_pInstance;
-}
+struct XdgSurfaceListener
+{
+	void ( *configure )( void* pData, xdg_surface* pXdgSurface, uint32_t serial );
+};
 
-PlayWindow& PlayWindow::Instance( PixelData* pDisplayBuffer, int nScale )
+struct XdgToplevelListener
 {
-	PLAY_ASSERT_MSG( !s_pInstance, "Trying to create multiple instances of singleton class!" );
-	s_pInstance = new PlayWindow( pDisplayBuffer, nScale );
-	return *s_pInstance;
+	void ( *configure )( void* pData, xdg_toplevel* pToplevel, int32_t width, int32_t height, wl_array* pStates );
+	void ( *close )( void* pData, xdg_toplevel* pToplevel );
+};
+
+// Sets the handlers for an xdg-shell object's events
+static void XdgAddListener( void* pObject, const void* pListener, void* pData )
+{
+	wl_proxy_add_listener( static_cast<wl_proxy*>( pObject ), reinterpret_cast<void ( ** )( void )>( const_cast<void*>( pListener ) ), pData );
 }
 
-void PlayWindow::Destroy()
+// Destroys an xdg-shell object
+static void XdgDestroy( void* pObject )
 {
-	PLAY_ASSERT_MSG( s_pInstance, "Trying to use destroy PlayBuffer which hasn't been instanced!" );
-	delete s_pInstance;
-	s_pInstance = nullptr;
+	wl_proxy_marshal( static_cast<wl_proxy*>( pObject ), XDG_DESTROY );
+	wl_proxy_destroy( static_cast<wl_proxy*>( pObject ) );
 }
+#endif
 
 //********************************************************************************************************************************
-// Windows functions
+// Constructor / Destructor (Private)
 //********************************************************************************************************************************
 
-int PlayWindow::HandleWindows( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow, LPCWSTR windowName )
+PlayWindow::PlayWindow( PixelData* pDisplayBuffer, int nScale )
 {
-	UNREFERENCED_PARAMETER( hPrevInstance );
-	UNREFERENCED_PARAMETER( lpCmdLine );
+	PLAY_ASSERT( pDisplayBuffer );
+	PLAY_ASSERT( nScale > 0 );
+	m_pPlayBuffer = pDisplayBuffer;
+	m_scale = nScale;
 
-	WNDCLASSEXW wcex;
+#ifdef PLAY_PLATFORM_HEADLESS
+	// Frames are presented at the display buffer's size: there is no point scaling up pixels nobody will see
+	m_presentBuffer.width = pDisplayBuffer->width;
+	m_presentBuffer.height = pDisplayBuffer->height;
+	m_presentBuffer.pPixels = new Pixel[m_presentBuffer.width * m_presentBuffer.height];
+#endif
 
-	wcex.cbSize = sizeof( WNDCLASSEX );
+#ifdef PLAY_PLATFORM_X11
+	m_pDisplay = XOpenDisplay( nullptr );
+	PLAY_ASSERT_MSG( m_pDisplay, "Unable to connect to the X server: check the DISPLAY environment variable" );
+	if( !m_pDisplay )
+		exit( PLAY_ERROR ); // There is nowhere to present to
 
-	wcex.style = CS_HREDRAW | CS_VREDRAW;
-	wcex.lpfnWndProc = PlayWindow::WndProc;
-	wcex.cbClsExtra = 0;
-	wcex.cbWndExtra = 0;
-	wcex.hInstance = hInstance;
-	wcex.hIcon = LoadIcon( hInstance, IDI_APPLICATION );
-	wcex.hCursor = LoadCursor( nullptr, IDC_ARROW );
-	wcex.hbrBackground = (HBRUSH)( COLOR_WINDOW + 1 );
-	wcex.lpszMenuName = nullptr;
-	wcex.lpszClassName = windowName;
-	wcex.hIconSm = LoadIcon( wcex.hInstance, IDI_APPLICATION );
+	int screen = DefaultScreen( m_pDisplay );
+	int depth = DefaultDepth( m_pDisplay, screen );
+	Visual* pVisual = DefaultVisual( m_pDisplay, screen );
+	int w = pDisplayBuffer->width * nScale;
+	int h = pDisplayBuffer->height * nScale;
 
-	RegisterClassExW( &wcex );
+	// At a scale of one the image is as wide as the display buffer's rows (including any padding), so it can be drawn into
+	bool bDirect = ( nScale == 1 );
+	int imageWidth = bDirect ? pDisplayBuffer->Stride() : w;
 
-	int	w = m_pPlayBuffer->width * m_scale;
-	int h = m_pPlayBuffer->height * m_scale;
+	// The display buffer's pixels are copied as they are, so the window needs the same 0x00RRGGBB layout
+	PLAY_ASSERT_MSG( depth >= 24 && pVisual->red_mask == 0xFF0000 && pVisual->green_mask == 0x00FF00 && pVisual->blue_mask == 0x0000FF, "The X server's default visual isn't 24-bit RGB" );
 
-	UINT dwStyle = WS_OVERLAPPED | WS_CAPTION | WS_SYSMENU;
-	RECT rect = { 0, 0, w, h }; 
-	AdjustWindowRect( &rect, dwStyle, FALSE );
-	HWND hWnd = CreateWindowW( windowName, windowName, dwStyle, CW_USEDEFAULT, CW_USEDEFAULT, rect.right - rect.left, rect.bottom - rect.top, nullptr, nullptr, hInstance, nullptr );
+	m_window = XCreateSimpleWindow( m_pDisplay, RootWindow( m_pDisplay, screen ), 0, 0, w, h, 0, BlackPixel( m_pDisplay, screen ), BlackPixel( m_pDisplay, screen ) );
+	XStoreName( m_pDisplay, m_window, "PlayBuffer" );
+	XSelectInput( m_pDisplay, m_window, KeyPressMask | KeyReleaseMask | ButtonPressMask | ButtonReleaseMask | PointerMotionMask | LeaveWindowMask );
 
-	if( !hWnd )
-		return FALSE;
+	// Ask for the close button to send a message rather than disconnecting us
+	m_deleteMessage = XInternAtom( m_pDisplay, "WM_DELETE_WINDOW", False );
+	XSetWMProtocols( m_pDisplay, m_window, &m_deleteMessage, 1 );
 
-	m_hWindow = hWnd;
+	// The window can't be resized, just like on Windows
+	XSizeHints* pSizeHints = XAllocSizeHints();
+	pSizeHints->flags = PMinSize | PMaxSize;
+	pSizeHints->min_width = pSizeHints->max_width = w;
+	pSizeHints->min_height = pSizeHints->max_height = h;
+	XSetWMNormalHints( m_pDisplay, m_window, pSizeHints );
+	XFree( pSizeHints );
 
-	ShowWindow( hWnd, nCmdShow );
-	UpdateWindow( hWnd );
+	// Held keys only send one press and one release rather than repeating both
+	XkbSetDetectableAutoRepeat( m_pDisplay, True, nullptr );
 
-	HACCEL hAccelTable = LoadAccelerators( hInstance, windowName );
+	m_gc = XCreateGC( m_pDisplay, m_window, 0, nullptr );
 
-	LARGE_INTEGER frequency;        
-	double elapsedTime = 0.0;
-	static LARGE_INTEGER lastDrawTime;
+	// Put the image in shared memory when the server supports it (it won't when the display is on another machine)
+	if( XShmQueryExtension( m_pDisplay ) )
+	{
+		m_pImage = XShmCreateImage( m_pDisplay, pVisual, depth, ZPixmap, nullptr, &m_sharedMemory, imageWidth, h );
+
+		if( m_pImage )
+		{
+			m_sharedMemory.shmid = shmget( IPC_PRIVATE, static_cast<size_t>( m_pImage->bytes_per_line ) * h, IPC_CREAT | 0600 );
+			m_sharedMemory.shmaddr = m_pImage->data = static_cast<char*>( shmat( m_sharedMemory.shmid, nullptr, 0 ) );
+			m_sharedMemory.readOnly = False;
+
+			// Attaching fails with an X error rather than a return value, so catch it instead of letting it exit
+			s_bX11Error = false;
+			XErrorHandler oldHandler = XSetErrorHandler( CatchX11Error );
+			m_bSharedMemory = m_sharedMemory.shmid >= 0 && m_sharedMemory.shmaddr != reinterpret_cast<char*>( -1 ) && XShmAttach( m_pDisplay, &m_sharedMemory );
+			XSync( m_pDisplay, False );
+			XSetErrorHandler( oldHandler );
+			m_bSharedMemory = m_bSharedMemory && !s_bX11Error;
+
+			// Marked for removal now so the memory is freed even if we don't exit cleanly (it lasts until both sides detach)
+			if( m_sharedMemory.shmid >= 0 )
+				shmctl( m_sharedMemory.shmid, IPC_RMID, nullptr );
+
+			if( !m_bSharedMemory )
+			{
+				if( m_sharedMemory.shmaddr != reinterpret_cast<char*>( -1 ) )
+					shmdt( m_sharedMemory.shmaddr );
+				m_pImage->data = nullptr;
+				XDestroyImage( m_pImage );
+				m_pImage = nullptr;
+			}
+		}
+	}
+
+	if( !m_pImage )
+	{
+		m_pImage = XCreateImage( m_pDisplay, pVisual, depth, ZPixmap, 0, nullptr, imageWidth, h, 32, 0 );
+		m_pImage->data = static_cast<char*>( malloc( static_cast<size_t>( m_pImage->bytes_per_line ) * h ) );
+	}
+
+	PLAY_ASSERT_MSG( m_pImage->bits_per_pixel == 32, "The X server's default visual doesn't use 32-bit pixels" );
+
+	// The server has finished with the image by the time each present returns, so one image is enough to draw into
+	if( bDirect && m_pImage->bytes_per_line == static_cast<int>( sizeof( Pixel ) ) * imageWidth )
+	{
+		m_pOwnPixels = pDisplayBuffer->pPixels;
+		memcpy( m_pImage->data, m_pOwnPixels, static_cast<size_t>( m_pImage->bytes_per_line ) * h );
+		pDisplayBuffer->pPixels = reinterpret_cast<Pixel*>( m_pImage->data );
+	}
+
+	XMapWindow( m_pDisplay, m_window );
+	XFlush( m_pDisplay );
+#endif
+
+#ifdef PLAY_PLATFORM_WAYLAND
+	m_pDisplay = wl_display_connect( nullptr );
+	PLAY_ASSERT_MSG( m_pDisplay, "Unable to connect to the Wayland compositor: check the WAYLAND_DISPLAY environment variable" );
+	if( !m_pDisplay )
+		exit( PLAY_ERROR ); // There is nowhere to present to
+
+	// Find the compositor's global objects
+	static const wl_registry_listener registryListener = { HandleGlobal, HandleGlobalRemove };
+	m_pRegistry = wl_display_get_registry( m_pDisplay );
+	wl_registry_add_listener( m_pRegistry, &registryListener, this );
+	wl_display_roundtrip( m_pDisplay );
+	PLAY_ASSERT_MSG( m_pCompositor && m_pShm && m_pWmBase, "The Wayland compositor doesn't support wl_shm and xdg-shell" );
+
+	int w = pDisplayBuffer->width * nScale;
+	int h = pDisplayBuffer->height * nScale;
+
+	// Give the surface the role of a top level window, which can't be resized (just like on Windows)
+	static const XdgSurfaceListener xdgSurfaceListener = { HandleSurfaceConfigure };
+	static const XdgToplevelListener toplevelListener = { HandleToplevelConfigure, HandleToplevelClose };
+	m_pSurface = wl_compositor_create_surface( m_pCompositor );
+	m_pXdgSurface = reinterpret_cast<xdg_surface*>( wl_proxy_marshal_constructor( reinterpret_cast<wl_proxy*>( m_pWmBase ), XDG_WM_BASE_GET_XDG_SURFACE, &s_xdgSurfaceInterface, nullptr, m_pSurface ) );
+	XdgAddListener( m_pXdgSurface, &xdgSurfaceListener, this );
+	m_pToplevel = reinterpret_cast<xdg_toplevel*>( wl_proxy_marshal_constructor( reinterpret_cast<wl_proxy*>( m_pXdgSurface ), XDG_SURFACE_GET_TOPLEVEL, &s_xdgToplevelInterface, nullptr ) );
+	XdgAddListener( m_pToplevel, &toplevelListener, this );
+	wl_proxy_marshal( reinterpret_cast<wl_proxy*>( m_pToplevel ), XDG_TOPLEVEL_SET_TITLE, "PlayBuffer" );
+	wl_proxy_marshal( reinterpret_cast<wl_proxy*>( m_pToplevel ), XDG_TOPLEVEL_SET_MIN_SIZE, w, h );
+	wl_proxy_marshal( reinterpret_cast<wl_proxy*>( m_pToplevel ), XDG_TOPLEVEL_SET_MAX_SIZE, w, h );
+
+	// A buffer can't be attached until the compositor has configured the surface
+	wl_surface_commit( m_pSurface );
+	while( !m_bConfigured )
+	{
+		if( wl_display_dispatch( m_pDisplay ) < 0 )
+			break;
+	}
+
+	// At a scale of one the buffers are laid out like the display buffer, so it can be drawn into them directly
+	bool bDirect = ( nScale == 1 );
+	m_bufferStride = static_cast<int>( sizeof( Pixel ) ) * ( bDirect ? pDisplayBuffer->Stride() : w );
+	size_t bufferSize = static_cast<size_t>( m_bufferStride ) * h;
+	m_poolSize = bufferSize * WAYLAND_BUFFER_COUNT;
+
+	// Every buffer is taken from one block of shared memory which the compositor maps too
+	int fd = memfd_create( "PlayBuffer", MFD_CLOEXEC );
+	bool bCreated = fd >= 0 && ftruncate( fd, static_cast<off_t>( m_poolSize ) ) == 0;
+	PLAY_ASSERT_MSG( bCreated, "Unable to create shared memory for the Wayland buffers" );
+	m_pPoolMemory = static_cast<uint8_t*>( mmap( nullptr, m_poolSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 ) );
+	PLAY_ASSERT_MSG( m_pPoolMemory != MAP_FAILED, "Unable to map shared memory for the Wayland buffers" );
+
+	static const wl_buffer_listener bufferListener = { HandleBufferRelease };
+	wl_shm_pool* pPool = wl_shm_create_pool( m_pShm, fd, static_cast<int32_t>( m_poolSize ) );
+
+	for( int i = 0; i < WAYLAND_BUFFER_COUNT; i++ )
+	{
+		// XRGB rather than ARGB, so the compositor ignores the display buffer's alpha
+		m_pBuffers[i] = wl_shm_pool_create_buffer( pPool, static_cast<int32_t>( bufferSize * i ), w, h, m_bufferStride, WL_SHM_FORMAT_XRGB8888 );
+		m_pBufferPixels[i] = reinterpret_cast<Pixel*>( m_pPoolMemory + bufferSize * i );
+		wl_buffer_add_listener( m_pBuffers[i], &bufferListener, this );
+	}
+
+	// The buffers keep the memory alive without the pool or the file
+	wl_shm_pool_destroy( pPool );
+	close( fd );
+
+	if( bDirect )
+	{
+		m_pOwnPixels = pDisplayBuffer->pPixels;
+		m_drawBuffer = AcquireBuffer();
+		memcpy( m_pBufferPixels[m_drawBuffer], m_pOwnPixels, bufferSize );
+		pDisplayBuffer->pPixels = m_pBufferPixels[m_drawBuffer];
+	}
+#endif
+}
+
+PlayWindow::~PlayWindow( void )
+{
+#ifdef PLAY_PLATFORM_HEADLESS
+	delete[] m_presentBuffer.pPixels;
+#endif
+
+#ifdef PLAY_PLATFORM_X11
+	// PlayGraphics frees the display buffer's pixels, so give it its own back (holding the frame being drawn)
+	if( m_pOwnPixels )
+	{
+		memcpy( m_pOwnPixels, m_pPlayBuffer->pPixels, static_cast<size_t>( m_pImage->bytes_per_line ) * m_pImage->height );
+		m_pPlayBuffer->pPixels = m_pOwnPixels;
+	}
+
+	if( m_bSharedMemory )
+	{
+		XShmDetach( m_pDisplay, &m_sharedMemory );
+		XSync( m_pDisplay, False );
+		shmdt( m_sharedMemory.shmaddr );
+		m_pImage->data = nullptr; // Stops XDestroyImage freeing the shared memory
+	}
+	XDestroyImage( m_pImage );
+	XFreeGC( m_pDisplay, m_gc );
+	XDestroyWindow( m_pDisplay, m_window );
+	XCloseDisplay( m_pDisplay );
+#endif
+
+#ifdef PLAY_PLATFORM_WAYLAND
+	// PlayGraphics frees the display buffer's pixels, so give it its own back (holding the frame being drawn)
+	if( m_drawBuffer >= 0 )
+	{
+		memcpy( m_pOwnPixels, m_pPlayBuffer->pPixels, static_cast<size_t>( m_bufferStride ) * m_pPlayBuffer->height );
+		m_pPlayBuffer->pPixels = m_pOwnPixels;
+	}
+
+	if( m_pFrameCallback )
+		wl_callback_destroy( m_pFrameCallback );
+	for( int i = 0; i < WAYLAND_BUFFER_COUNT; i++ )
+		wl_buffer_destroy( m_pBuffers[i] );
+	munmap( m_pPoolMemory, m_poolSize );
+
+	if( m_pPointer )
+		wl_pointer_destroy( m_pPointer );
+	if( m_pKeyboard )
+		wl_keyboard_destroy( m_pKeyboard );
+	if( m_pSeat )
+		wl_seat_destroy( m_pSeat );
+
+	XdgDestroy( m_pToplevel );
+	XdgDestroy( m_pXdgSurface );
+	wl_surface_destroy( m_pSurface );
+	XdgDestroy( m_pWmBase );
+	wl_shm_destroy( m_pShm );
+	wl_compositor_destroy( m_pCompositor );
+	wl_registry_destroy( m_pRegistry );
+	wl_display_disconnect( m_pDisplay );
+#endif
+
+	s_pInstance = nullptr;
+}
+
+//********************************************************************************************************************************
+// Instance functions
+//********************************************************************************************************************************
+
+PlayWindow& PlayWindow::Instance()
+{
+	if( !s_pInstance )
+		PLAY_ASSERT_MSG( false, "Trying to use PlayBuffer without initialising it!" );
+
+	return *s_pInstance;
+}
+
+PlayWindow& PlayWindow::Instance( PixelData* pDisplayBuffer, int nScale )
+{
+	PLAY_ASSERT_MSG( !s_pInstance, "Trying to create multiple instances of singleton class!" );
+	s_pInstance = new PlayWindow( pDisplayBuffer, nScale );
+	return *s_pInstance;
+}
+
+void PlayWindow::Destroy()
+{
+	PLAY_ASSERT_MSG( s_pInstance, "Trying to use destroy PlayBuffer which hasn't been instanced!" );
+	delete s_pInstance;
+	s_pInstance = nullptr;
+}
+
+#ifdef PLAY_PLATFORM_WINDOWS
+//********************************************************************************************************************************
+// Windows functions
+//********************************************************************************************************************************
+
+int PlayWindow::HandleWindows( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow, LPCWSTR windowName )
+{
+	UNREFERENCED_PARAMETER( hPrevInstance );
+	UNREFERENCED_PARAMETER( lpCmdLine );
+
+	WNDCLASSEXW wcex;
+
+	wcex.cbSize = sizeof( WNDCLASSEX );
+
+	wcex.style = CS_HREDRAW | CS_VREDRAW;
+	wcex.lpfnWndProc = PlayWindow::WndProc;
+	wcex.cbClsExtra = 0;
+	wcex.cbWndExtra = 0;
+	wcex.hInstance = hInstance;
+	wcex.hIcon = LoadIcon( hInstance, IDI_APPLICATION );
+	wcex.hCursor = LoadCursor( nullptr, IDC_ARROW );
+	wcex.hbrBackground = (HBRUSH)( COLOR_WINDOW + 1 );
+	wcex.lpszMenuName = nullptr;
+	wcex.lpszClassName = windowName;
+	wcex.hIconSm = LoadIcon( wcex.hInstance, IDI_APPLICATION );
+
+	RegisterClassExW( &wcex );
+
+	int	w = m_pPlayBuffer->width * m_scale;
+	int h = m_pPlayBuffer->height * m_scale;
+
+	UINT dwStyle = WS_OVERLAPPED | WS_CAPTION | WS_SYSMENU;
+	RECT rect = { 0, 0, w, h }; 
+	AdjustWindowRect( &rect, dwStyle, FALSE );
+	HWND hWnd = CreateWindowW( windowName, windowName, dwStyle, CW_USEDEFAULT, CW_USEDEFAULT, rect.right - rect.left, rect.bottom - rect.top, nullptr, nullptr, hInstance, nullptr );
+
+	if( !hWnd )
+		return FALSE;
+
+	m_hWindow = hWnd;
+
+	ShowWindow( hWnd, nCmdShow );
+	UpdateWindow( hWnd );
+
+	HACCEL hAccelTable = LoadAccelerators( hInstance, windowName );
+
+	LARGE_INTEGER frequency;        
+	double elapsedTime = 0.0;
+	static LARGE_INTEGER lastDrawTime;
 	LARGE_INTEGER now;
 
 	MSG msg{};
@@ -1687,7 +3276,7 @@ double PlayWindow::Present( void )
 	BITMAPINFOHEADER bitmap_info_header
 	{
 			sizeof( BITMAPINFOHEADER ),								// size of its own data,
-			m_pPlayBuffer->width, m_pPlayBuffer->height,		// width and height
+			m_pPlayBuffer->Stride(), m_pPlayBuffer->height,		// width (including any row padding) and height
 			1, 32, BI_RGB,				// planes must always be set to 1 (docs), 32-bit pixel data, uncompressed 
 			0, 0, 0, 0, 0				// rest can be set to 0 as this is uncompressed and has no palette
 	};
@@ -1792,6 +3381,11 @@ int PlayWindow::LoadPNGImage( std::string& fileAndPath, PixelData& destImage )
 	return 1;
 }
 
+std::string PlayWindow::FindFile( const std::string& fileAndPath )
+{
+	return fileAndPath;
+}
+
 //********************************************************************************************************************************
 // Miscellaneous functions
 //********************************************************************************************************************************
@@ -1833,1349 +3427,6969 @@ void TracePrintf( const char* file, int line, const char* fmt, ... )
 	DebugOutput( buffer );
 	va_end( args );
 }
-
+#else
 //********************************************************************************************************************************
-// File:		PlayBlitter.cpp
-// Description:	A software pixel renderer for drawing 2D primitives into a PixelData buffer
-// Platform:	Independent
+// Game loop functions
 //********************************************************************************************************************************
 
-
-PlayBlitter::PlayBlitter( PixelData* pRenderTarget )
+int PlayWindow::HandleFrames( int argc, char* argv[] )
 {
-	m_pRenderTarget = pRenderTarget;
-}
+	// Options on the command line override the settings made by the game in MainGameEntry
+	for( int a = 1; a + 1 < argc; a++ )
+	{
+		std::string option( argv[a] );
 
+		if( option == "-frames" )
+			m_gameLoop.frameLimit = atoi( argv[++a] );
+		else if( option == "-dt" )
+			m_gameLoop.fixedDeltaTime = static_cast<float>( atof( argv[++a] ) );
+		else if( option == "-fps" )
+			m_gameLoop.framesPerSecond = atoi( argv[++a] );
+	}
 
-void PlayBlitter::DrawPixel( int posX, int posY, Pixel srcPix )
-{
-	if( srcPix.a == 0x00 || posX < 0 || posX >= m_pRenderTarget->width || posY < 0 || posY >= m_pRenderTarget->height )
-		return;
+	LARGE_INTEGER frequency;
+	LARGE_INTEGER startTime;
+	LARGE_INTEGER lastDrawTime;
+	LARGE_INTEGER now;
+	double elapsedTime = 0.0;
+	int frameCount = 0;
+	bool quit = false;
 
-	Pixel* destPix = &m_pRenderTarget->pPixels[( posY * m_pRenderTarget->width ) + posX];
+	// Set up counters for timing the frame
+	QueryPerformanceFrequency( &frequency );
+	QueryPerformanceCounter( &startTime );
+	lastDrawTime = startTime;
 
-	if( srcPix.a == 0xFF ) // Completely opaque pixel - no need to blend
-	{
-		*destPix = srcPix.bits;
-	}
-	else
+	while( !quit && ( m_gameLoop.frameLimit <= 0 || frameCount < m_gameLoop.frameLimit ) )
 	{
-		Pixel blendPix = *destPix;
-		float srcAlpha = srcPix.a / 255.0f;
-		float oneMinusSrcAlpha = 1.0f - srcAlpha;
+#if defined( PLAY_PLATFORM_X11 ) || defined( PLAY_PLATFORM_WAYLAND )
+		// Handle the window's events
+		if( !HandleEvents() )
+			break;
+#endif
+
+		// Only wait when the frame rate is capped: there is no compositor to wait for
+		do
+		{
+			QueryPerformanceCounter( &now );
+			elapsedTime = ( now.QuadPart - lastDrawTime.QuadPart ) * 1000.0 / frequency.QuadPart;
 
-		blendPix.a = 0xFF;
-		blendPix.r = static_cast<uint8_t>( ( srcAlpha * srcPix.r ) + ( oneMinusSrcAlpha * blendPix.r ) );
-		blendPix.g = static_cast<uint8_t>( ( srcAlpha * srcPix.g ) + ( oneMinusSrcAlpha * blendPix.g ) );
-		blendPix.b = static_cast<uint8_t>( ( srcAlpha * srcPix.b ) + ( oneMinusSrcAlpha * blendPix.b ) );
+			if( m_gameLoop.framesPerSecond > 0 && elapsedTime < 1000.0 / m_gameLoop.framesPerSecond )
+				std::this_thread::yield();
 
-		*destPix = blendPix.bits;
+		} while( m_gameLoop.framesPerSecond > 0 && elapsedTime < 1000.0 / m_gameLoop.framesPerSecond );
+
+		// A fixed time step makes every run simulate exactly the same frames however fast they are processed
+		float deltaTime = m_gameLoop.fixedDeltaTime > 0.0f ? m_gameLoop.fixedDeltaTime : static_cast<float>( elapsedTime ) / 1000.0f;
+
+		// Call the main game update function
+		quit = MainGameUpdate( deltaTime );
+		lastDrawTime = now;
+		frameCount++;
 	}
 
-	return;
+	// Report the throughput before MainGameExit destroys the PlayWindow
+	QueryPerformanceCounter( &now );
+	double totalTime = ( now.QuadPart - startTime.QuadPart ) / static_cast<double>( frequency.QuadPart );
+	char buffer[256];
+	sprintf_s( buffer, "PlayBuffer: %d frames (%d presented) in %.3f seconds = %.1f frames per second\n", frameCount, m_presentCount, totalTime, totalTime > 0.0 ? frameCount / totalTime : 0.0 );
+	DebugOutput( buffer );
+
+	// Call the main game cleanup function
+	return MainGameExit();
 }
 
-void PlayBlitter::DrawLine( int startX, int startY, int endX, int endY, Pixel pix )
+double PlayWindow::Present( void )
 {
-	//Implementation of Bresenham's Line Drawing Algorithm
-	int dx = abs( endX - startX );
-	int sx = 1;
-	if( endX < startX ) { sx = -1; }
+	LARGE_INTEGER frequency;
+	LARGE_INTEGER before;
+	LARGE_INTEGER after;
+	QueryPerformanceCounter( &before );
+	QueryPerformanceFrequency( &frequency );
 
-	int dy = -abs( endY - startY );
-	int sy = 1;
-	if( endY < startY ) { sy = -1; }
+#ifdef PLAY_PLATFORM_HEADLESS
+	// Copy the display buffer into memory in place of the window
+	for( int y = 0; y < m_presentBuffer.height; y++ )
+		memcpy( m_presentBuffer.Row( y ), m_pPlayBuffer->Row( y ), sizeof( Pixel ) * m_presentBuffer.width );
+#elif defined( PLAY_PLATFORM_X11 )
+	// Unless the frame was drawn straight into the image, scale it in, repeating each row after it has been scaled up once
+	for( int y = 0; y < m_pPlayBuffer->height && !m_pOwnPixels; y++ )
+	{
+		char* pImageRow = m_pImage->data + static_cast<size_t>( m_pImage->bytes_per_line ) * y * m_scale;
+		ReplicatePixels( m_pPlayBuffer->Row( y ), reinterpret_cast<Pixel*>( pImageRow ), m_pPlayBuffer->width, m_scale );
 
-	int err = dx + dy;
+		for( int i = 1; i < m_scale; i++ )
+			memcpy( pImageRow + static_cast<size_t>( m_pImage->bytes_per_line ) * i, pImageRow, sizeof( Pixel ) * m_pImage->width );
+	}
 
-	if( err == 0 ) return;
+	// The X server reads a shared memory image directly rather than it being sent through the socket
+	int width = m_pPlayBuffer->width * m_scale;
+	if( m_bSharedMemory )
+		XShmPutImage( m_pDisplay, m_window, m_gc, m_pImage, 0, 0, 0, 0, width, m_pImage->height, False );
+	else
+		XPutImage( m_pDisplay, m_window, m_gc, m_pImage, 0, 0, 0, 0, width, m_pImage->height );
 
-	int x = startX;
-	int y = startY;
+	// Wait for the server to finish with the image before the next present overwrites it
+	XSync( m_pDisplay, False );
+#else
+	int buffer = m_drawBuffer;
 
-	while( true )
+	// Unless the frame was drawn straight into a buffer, scale it into one the compositor has finished with
+	if( buffer < 0 )
 	{
-		DrawPixel( x, y, pix );
+		buffer = AcquireBuffer();
+		uint8_t* pBufferRow = reinterpret_cast<uint8_t*>( m_pBufferPixels[buffer] );
 
-		if( x == endX && y == endY )
-			break;
-
-		int e2 = 2 * err;
-		if( e2 >= dy )
-		{
-			err += dy;
-			x += sx;
-		}
-		if( e2 <= dx )
+		for( int y = 0; y < m_pPlayBuffer->height; y++ )
 		{
-			err += dx;
-			y += sy;
+			uint8_t* pRow = pBufferRow + static_cast<size_t>( m_bufferStride ) * y * m_scale;
+			ReplicatePixels( m_pPlayBuffer->Row( y ), reinterpret_cast<Pixel*>( pRow ), m_pPlayBuffer->width, m_scale );
+
+			for( int i = 1; i < m_scale; i++ )
+				memcpy( pRow + static_cast<size_t>( m_bufferStride ) * i, pRow, sizeof( Pixel ) * m_pPlayBuffer->width * m_scale );
 		}
 	}
+
+	// Ask to be told when this frame has been shown, which paces the game loop
+	static const wl_callback_listener frameListener = { HandleFrameDone };
+	if( m_pFrameCallback )
+		wl_callback_destroy( m_pFrameCallback );
+	m_pFrameCallback = wl_surface_frame( m_pSurface );
+	wl_callback_add_listener( m_pFrameCallback, &frameListener, this );
+	m_bFramePending = true;
+
+	wl_surface_attach( m_pSurface, m_pBuffers[buffer], 0, 0 );
+	wl_surface_damage( m_pSurface, 0, 0, m_pPlayBuffer->width * m_scale, m_pPlayBuffer->height * m_scale );
+	wl_surface_commit( m_pSurface );
+	m_bufferBusy[buffer] = true;
+	wl_display_flush( m_pDisplay );
+
+	// Draw the next frame straight into a buffer the compositor has finished with
+	if( m_drawBuffer >= 0 )
+	{
+		m_drawBuffer = AcquireBuffer();
+		m_pPlayBuffer->pPixels = m_pBufferPixels[m_drawBuffer];
+	}
+#endif
+
+	m_presentCount++;
+
+	QueryPerformanceCounter( &after );
+
+	double elapsedTime = ( after.QuadPart - before.QuadPart ) * 1000.0 / frequency.QuadPart;
+
+	return elapsedTime;
 }
 
+#if defined( PLAY_PLATFORM_X11 ) || defined( PLAY_PLATFORM_WAYLAND )
 //********************************************************************************************************************************
-// Function:	BlitPixels - draws image data with and without a global alpha multiply
-// Parameters:	spriteId = the id of the sprite to draw
-//				xpos, ypos = the position you want to draw the sprite
-//				frameIndex = which frame of the animation to draw (wrapped)
-// Notes:		Alpha multiply approach is relatively unoptimized
+// Window functions
 //********************************************************************************************************************************
-void PlayBlitter::BlitPixels( const PixelData& srcPixelData, int srcOffset, int blitX, int blitY, int blitWidth, int blitHeight, float alphaMultiply ) const
+
+short GetAsyncKeyState( int vKey )
 {
-	PLAY_ASSERT_MSG( m_pRenderTarget, "Render target not set for PlayBlitter" );
+	return PlayWindow::Instance().IsKeyDown( vKey ) ? static_cast<short>( 0x8000 ) : 0;
+}
 
-	// Nothing within the display buffer to draw
-	if( blitX > m_pRenderTarget->width || blitX + blitWidth < 0 || blitY > m_pRenderTarget->height || blitY + blitHeight < 0 )
+//********************************************************************************************************************************
+// Function:	ReplicatePixels - scales up a row of pixels by repeating each one
+// Parameters:	pSource = the row to scale, pDest = receives width * scale pixels, scale = how many times to repeat each pixel
+// Notes:		With SSE2 a scale of two interleaves four pixels with themselves. Larger scales store four copies of a pixel
+//				at a time, letting the last store run on into the next pixel's copies (which then overwrite it), so only the
+//				final pixel of the row needs to be written one copy at a time.
+//********************************************************************************************************************************
+void PlayWindow::ReplicatePixels( const Pixel* pSource, Pixel* pDest, int width, int scale )
+{
+	if( scale == 1 )
+	{
+		memcpy( pDest, pSource, sizeof( Pixel ) * width );
 		return;
+	}
 
-	// Work out if we need to clip to the display buffer (and by how much)
-	int xClipStart = -blitX;
-	if( xClipStart < 0 ) { xClipStart = 0; }
-
-	int xClipEnd = ( blitX + blitWidth ) - m_pRenderTarget->width;
-	if( xClipEnd < 0 ) { xClipEnd = 0; }
-
-	int yClipStart = -blitY;
-	if( yClipStart < 0 ) { yClipStart = 0; }
-
-	int yClipEnd = ( blitY + blitHeight ) - m_pRenderTarget->height;
-	if( yClipEnd < 0 ) { yClipEnd = 0; }
+	int x = 0;
 
-	// Set up the source and destination pointers based on clipping
-	int destOffset = ( m_pRenderTarget->width * ( blitY + yClipStart ) ) + ( blitX + xClipStart );
-	uint32_t* destPixels = &m_pRenderTarget->pPixels->bits + destOffset;
+#ifdef PLAY_USE_SSE2
+	if( scale == 2 )
+	{
+		for( ; x + 4 <= width; x += 4 )
+		{
+			__m128i pixels = _mm_loadu_si128( reinterpret_cast<const __m128i*>( pSource + x ) );
+			_mm_storeu_si128( reinterpret_cast<__m128i*>( pDest + x * 2 ), _mm_unpacklo_epi32( pixels, pixels ) );
+			_mm_storeu_si128( reinterpret_cast<__m128i*>( pDest + x * 2 + 4 ), _mm_unpackhi_epi32( pixels, pixels ) );
+		}
+	}
+	else
+	{
+		for( ; x < width - 1; x++ )
+		{
+			__m128i pixel = _mm_set1_epi32( static_cast<int>( pSource[x].bits ) );
+			Pixel* pOut = pDest + x * scale;
 
-	int srcClipOffset = ( srcPixelData.width * yClipStart ) + xClipStart;
-	uint32_t* srcPixels = &srcPixelData.pPixels->bits + srcOffset + srcClipOffset;
+			for( int i = 0; i < scale; i += 4 )
+				_mm_storeu_si128( reinterpret_cast<__m128i*>( pOut + i ), pixel );
+		}
+	}
+#endif
 
-	// Work out in advance how much we need to add to src and dest to reach the next row 
-	int destInc = m_pRenderTarget->width - blitWidth + xClipEnd + xClipStart;
-	int srcInc = srcPixelData.width - blitWidth + xClipEnd + xClipStart;
+	for( ; x < width; x++ )
+	{
+		for( int i = 0; i < scale; i++ )
+			pDest[x * scale + i] = pSource[x];
+	}
+}
+#endif
 
-	//Work out final pixel in destination.
-	int destColOffset = ( m_pRenderTarget->width * ( blitHeight - yClipEnd - yClipStart - 1 ) ) + ( blitWidth - xClipEnd - xClipStart );
-	uint32_t* destColEnd = destPixels + destColOffset;
+#ifdef PLAY_PLATFORM_X11
+//********************************************************************************************************************************
+// X11 functions
+//********************************************************************************************************************************
 
-	//How many pixels per row in sprite.
-	int endRow = blitWidth - xClipEnd - xClipStart;
+// Converts an X key symbol to the matching Windows virtual key code (or zero when there isn't one)
+static int VirtualKeyFromKeySym( KeySym keySym )
+{
+	if( keySym >= XK_a && keySym <= XK_z )
+		return 'A' + static_cast<int>( keySym - XK_a );
+	if( keySym >= XK_A && keySym <= XK_Z )
+		return 'A' + static_cast<int>( keySym - XK_A );
+	if( keySym >= XK_0 && keySym <= XK_9 )
+		return '0' + static_cast<int>( keySym - XK_0 );
+	if( keySym >= XK_F1 && keySym <= XK_F12 )
+		return VK_F1 + static_cast<int>( keySym - XK_F1 );
+
+	switch( keySym )
+	{
+		case XK_BackSpace: return VK_BACK;
+		case XK_Tab: return VK_TAB;
+		case XK_Return: return VK_RETURN;
+		case XK_Shift_L: case XK_Shift_R: return VK_SHIFT;
+		case XK_Control_L: case XK_Control_R: return VK_CONTROL;
+		case XK_Escape: return VK_ESCAPE;
+		case XK_space: return VK_SPACE;
+		case XK_Prior: return VK_PRIOR;
+		case XK_Next: return VK_NEXT;
+		case XK_End: return VK_END;
+		case XK_Home: return VK_HOME;
+		case XK_Left: return VK_LEFT;
+		case XK_Up: return VK_UP;
+		case XK_Right: return VK_RIGHT;
+		case XK_Down: return VK_DOWN;
+		case XK_Insert: return VK_INSERT;
+		case XK_Delete: return VK_DELETE;
+		default: return 0;
+	}
+}
 
-	if( alphaMultiply < 1.0f )
+bool PlayWindow::HandleEvents()
+{
+	while( XPending( m_pDisplay ) )
 	{
-		// *******************************************************************************************************************************************************
-		// A basic (unoptimized) approach which separates the channels and performs a 'typical' alpha blending operation: (src * srcAlpha)+(dest * (1-srcAlpha))
-		// Has the advantage that a global alpha multiplication can be easily added over the top, so we use this method when a global multiply is required
-		// *******************************************************************************************************************************************************
+		XEvent event;
+		XNextEvent( m_pDisplay, &event );
 
-		// Slightly more optimised iterations without the additions in the loop
-		while( destPixels < destColEnd )
+		switch( event.type )
 		{
-			uint32_t* destRowEnd = destPixels + endRow;
+			case KeyPress:
+			case KeyRelease:
+			{
+				// The unshifted symbol, so that letters match their upper case virtual key codes either way
+				int vKey = VirtualKeyFromKeySym( XLookupKeysym( &event.xkey, 0 ) );
+				if( vKey )
+					m_keyDown[vKey] = event.type == KeyPress;
+				break;
+			}
+			case ButtonPress:
+			case ButtonRelease:
+				if( m_pMouseData && event.xbutton.button == Button1 )
+					m_pMouseData->left = event.type == ButtonPress;
+				if( m_pMouseData && event.xbutton.button == Button3 )
+					m_pMouseData->right = event.type == ButtonPress;
+				break;
+			case MotionNotify:
+				if( m_pMouseData )
+				{
+					m_pMouseData->pos.x = static_cast<float>( event.xmotion.x / m_scale );
+					m_pMouseData->pos.y = static_cast<float>( event.xmotion.y / m_scale );
+				}
+				break;
+			case LeaveNotify:
+				if( m_pMouseData )
+				{
+					m_pMouseData->pos.x = -1;
+					m_pMouseData->pos.y = -1;
+				}
+				break;
+			case ClientMessage:
+				if( static_cast<Atom>( event.xclient.data.l[0] ) == m_deleteMessage )
+					return false;
+				break;
+			default:
+				break;
+		}
+	}
 
-			while( destPixels < destRowEnd )
+	return true;
+}
+#endif
+
+#ifdef PLAY_PLATFORM_WAYLAND
+//********************************************************************************************************************************
+// Wayland functions
+//********************************************************************************************************************************
+
+// Converts a Linux key code to the matching Windows virtual key code (or zero when there isn't one)
+static int VirtualKeyFromKeyCode( uint32_t key )
+{
+	// The letters' key codes follow the rows of the keyboard rather than the alphabet
+	if( key >= KEY_Q && key <= KEY_P )
+		return "QWERTYUIOP"[key - KEY_Q];
+	if( key >= KEY_A && key <= KEY_L )
+		return "ASDFGHJKL"[key - KEY_A];
+	if( key >= KEY_Z && key <= KEY_M )
+		return "ZXCVBNM"[key - KEY_Z];
+	if( key >= KEY_1 && key <= KEY_9 )
+		return '1' + static_cast<int>( key - KEY_1 );
+	if( key >= KEY_F1 && key <= KEY_F10 )
+		return VK_F1 + static_cast<int>( key - KEY_F1 );
+
+	switch( key )
+	{
+		case KEY_0: return '0';
+		case KEY_F11: return VK_F11;
+		case KEY_F12: return VK_F12;
+		case KEY_BACKSPACE: return VK_BACK;
+		case KEY_TAB: return VK_TAB;
+		case KEY_ENTER: return VK_RETURN;
+		case KEY_LEFTSHIFT: case KEY_RIGHTSHIFT: return VK_SHIFT;
+		case KEY_LEFTCTRL: case KEY_RIGHTCTRL: return VK_CONTROL;
+		case KEY_ESC: return VK_ESCAPE;
+		case KEY_SPACE: return VK_SPACE;
+		case KEY_PAGEUP: return VK_PRIOR;
+		case KEY_PAGEDOWN: return VK_NEXT;
+		case KEY_END: return VK_END;
+		case KEY_HOME: return VK_HOME;
+		case KEY_LEFT: return VK_LEFT;
+		case KEY_UP: return VK_UP;
+		case KEY_RIGHT: return VK_RIGHT;
+		case KEY_DOWN: return VK_DOWN;
+		case KEY_INSERT: return VK_INSERT;
+		case KEY_DELETE: return VK_DELETE;
+		default: return 0;
+	}
+}
+
+bool PlayWindow::HandleEvents()
+{
+	// Read whatever events have already arrived without waiting for more
+	while( wl_display_prepare_read( m_pDisplay ) != 0 )
+		wl_display_dispatch_pending( m_pDisplay );
+	wl_display_flush( m_pDisplay );
+
+	pollfd displayFd = { wl_display_get_fd( m_pDisplay ), POLLIN, 0 };
+	if( poll( &displayFd, 1, 0 ) > 0 )
+		wl_display_read_events( m_pDisplay );
+	else
+		wl_display_cancel_read( m_pDisplay );
+
+	if( wl_display_dispatch_pending( m_pDisplay ) < 0 )
+		return false;
+
+	// Wait until the compositor has shown the last frame, which keeps the game loop in step with the display
+	while( m_bFramePending && !m_bClosed )
+	{
+		if( wl_display_dispatch( m_pDisplay ) < 0 )
+			return false;
+	}
+
+	return !m_bClosed;
+}
+
+int PlayWindow::AcquireBuffer()
+{
+	for( ;; )
+	{
+		for( int i = 0; i < WAYLAND_BUFFER_COUNT; i++ )
+		{
+			if( !m_bufferBusy[i] )
+				return i;
+		}
+
+		// Every buffer is waiting to be shown or being shown, so wait for the compositor to release one
+		if( wl_display_dispatch( m_pDisplay ) < 0 )
+		{
+			m_bClosed = true; // The connection has gone, so the next HandleEvents will end the game loop
+			return 0;
+		}
+	}
+}
+
+void PlayWindow::HandleGlobal( void* pData, wl_registry* pRegistry, uint32_t name, const char* pInterface, uint32_t version )
+{
+	UNREFERENCED_PARAMETER( version );
+	PlayWindow* pWindow = static_cast<PlayWindow*>( pData );
+
+	if( strcmp( pInterface, wl_compositor_interface.name ) == 0 )
+	{
+		pWindow->m_pCompositor = static_cast<wl_compositor*>( wl_registry_bind( pRegistry, name, &wl_compositor_interface, 1 ) );
+	}
+	else if( strcmp( pInterface, wl_shm_interface.name ) == 0 )
+	{
+		pWindow->m_pShm = static_cast<wl_shm*>( wl_registry_bind( pRegistry, name, &wl_shm_interface, 1 ) );
+	}
+	else if( strcmp( pInterface, s_xdgWmBaseInterface.name ) == 0 )
+	{
+		static const XdgWmBaseListener wmBaseListener = { HandlePing };
+		pWindow->m_pWmBase = static_cast<xdg_wm_base*>( wl_registry_bind( pRegistry, name, &s_xdgWmBaseInterface, 1 ) );
+		XdgAddListener( pWindow->m_pWmBase, &wmBaseListener, pWindow );
+	}
+	else if( strcmp( pInterface, wl_seat_interface.name ) == 0 && !pWindow->m_pSeat )
+	{
+		static const wl_seat_listener seatListener = { HandleSeatCapabilities, nullptr };
+		pWindow->m_pSeat = static_cast<wl_seat*>( wl_registry_bind( pRegistry, name, &wl_seat_interface, 1 ) );
+		wl_seat_add_listener( pWindow->m_pSeat, &seatListener, pWindow );
+	}
+}
+
+void PlayWindow::HandleGlobalRemove( void* pData, wl_registry* pRegistry, uint32_t name )
+{
+	UNREFERENCED_PARAMETER( pData );
+	UNREFERENCED_PARAMETER( pRegistry );
+	UNREFERENCED_PARAMETER( name );
+}
+
+void PlayWindow::HandlePing( void* pData, xdg_wm_base* pWmBase, uint32_t serial )
+{
+	UNREFERENCED_PARAMETER( pData );
+	// The compositor checks that the game is still responding
+	wl_proxy_marshal( reinterpret_cast<wl_proxy*>( pWmBase ), XDG_WM_BASE_PONG, serial );
+}
+
+void PlayWindow::HandleSurfaceConfigure( void* pData, xdg_surface* pXdgSurface, uint32_t serial )
+{
+	wl_proxy_marshal( reinterpret_cast<wl_proxy*>( pXdgSurface ), XDG_SURFACE_ACK_CONFIGURE, serial );
+	static_cast<PlayWindow*>( pData )->m_bConfigured = true;
+}
+
+void PlayWindow::HandleToplevelConfigure( void* pData, xdg_toplevel* pToplevel, int32_t width, int32_t height, wl_array* pStates )
+{
+	// The window keeps its size whatever the compositor suggests
+	UNREFERENCED_PARAMETER( pData );
+	UNREFERENCED_PARAMETER( pToplevel );
+	UNREFERENCED_PARAMETER( width );
+	UNREFERENCED_PARAMETER( height );
+	UNREFERENCED_PARAMETER( pStates );
+}
+
+void PlayWindow::HandleToplevelClose( void* pData, xdg_toplevel* pToplevel )
+{
+	UNREFERENCED_PARAMETER( pToplevel );
+	static_cast<PlayWindow*>( pData )->m_bClosed = true;
+}
+
+void PlayWindow::HandleBufferRelease( void* pData, wl_buffer* pBuffer )
+{
+	PlayWindow* pWindow = static_cast<PlayWindow*>( pData );
+
+	for( int i = 0; i < WAYLAND_BUFFER_COUNT; i++ )
+	{
+		if( pWindow->m_pBuffers[i] == pBuffer )
+			pWindow->m_bufferBusy[i] = false;
+	}
+}
+
+void PlayWindow::HandleFrameDone( void* pData, wl_callback* pCallback, uint32_t time )
+{
+	UNREFERENCED_PARAMETER( time );
+	PlayWindow* pWindow = static_cast<PlayWindow*>( pData );
+
+	wl_callback_destroy( pCallback );
+	pWindow->m_pFrameCallback = nullptr;
+	pWindow->m_bFramePending = false;
+}
+
+void PlayWindow::HandleSeatCapabilities( void* pData, wl_seat* pSeat, uint32_t capabilities )
+{
+	// The events added after version 1 of each interface are never sent, so they have no handlers
+	static const wl_pointer_listener pointerListener = { HandlePointerEnter, HandlePointerLeave, HandlePointerMotion, HandlePointerButton, HandlePointerAxis, nullptr, nullptr };
+	static const wl_keyboard_listener keyboardListener = { HandleKeymap, HandleKeyboardEnter, HandleKeyboardLeave, HandleKey, HandleModifiers, nullptr };
+	PlayWindow* pWindow = static_cast<PlayWindow*>( pData );
+
+	if( ( capabilities & WL_SEAT_CAPABILITY_POINTER ) && !pWindow->m_pPointer )
+	{
+		pWindow->m_pPointer = wl_seat_get_pointer( pSeat );
+		wl_pointer_add_listener( pWindow->m_pPointer, &pointerListener, pWindow );
+	}
+
+	if( ( capabilities & WL_SEAT_CAPABILITY_KEYBOARD ) && !pWindow->m_pKeyboard )
+	{
+		pWindow->m_pKeyboard = wl_seat_get_keyboard( pSeat );
+		wl_keyboard_add_listener( pWindow->m_pKeyboard, &keyboardListener, pWindow );
+	}
+}
+
+void PlayWindow::HandlePointerEnter( void* pData, wl_pointer* pPointer, uint32_t serial, wl_surface* pSurface, wl_fixed_t x, wl_fixed_t y )
+{
+	UNREFERENCED_PARAMETER( pSurface );
+	HandlePointerMotion( pData, pPointer, serial, x, y );
+}
+
+void PlayWindow::HandlePointerLeave( void* pData, wl_pointer* pPointer, uint32_t serial, wl_surface* pSurface )
+{
+	UNREFERENCED_PARAMETER( pPointer );
+	UNREFERENCED_PARAMETER( serial );
+	UNREFERENCED_PARAMETER( pSurface );
+	PlayWindow* pWindow = static_cast<PlayWindow*>( pData );
+
+	if( pWindow->m_pMouseData )
+	{
+		pWindow->m_pMouseData->pos.x = -1;
+		pWindow->m_pMouseData->pos.y = -1;
+	}
+}
+
+void PlayWindow::HandlePointerMotion( void* pData, wl_pointer* pPointer, uint32_t time, wl_fixed_t x, wl_fixed_t y )
+{
+	UNREFERENCED_PARAMETER( pPointer );
+	UNREFERENCED_PARAMETER( time );
+	PlayWindow* pWindow = static_cast<PlayWindow*>( pData );
+
+	if( pWindow->m_pMouseData )
+	{
+		pWindow->m_pMouseData->pos.x = static_cast<float>( static_cast<int>( wl_fixed_to_double( x ) ) / pWindow->m_scale );
+		pWindow->m_pMouseData->pos.y = static_cast<float>( static_cast<int>( wl_fixed_to_double( y ) ) / pWindow->m_scale );
+	}
+}
+
+void PlayWindow::HandlePointerButton( void* pData, wl_pointer* pPointer, uint32_t serial, uint32_t time, uint32_t button, uint32_t state )
+{
+	UNREFERENCED_PARAMETER( pPointer );
+	UNREFERENCED_PARAMETER( serial );
+	UNREFERENCED_PARAMETER( time );
+	PlayWindow* pWindow = static_cast<PlayWindow*>( pData );
+
+	if( pWindow->m_pMouseData && button == BTN_LEFT )
+		pWindow->m_pMouseData->left = state == WL_POINTER_BUTTON_STATE_PRESSED;
+	if( pWindow->m_pMouseData && button == BTN_RIGHT )
+		pWindow->m_pMouseData->right = state == WL_POINTER_BUTTON_STATE_PRESSED;
+}
+
+void PlayWindow::HandlePointerAxis( void* pData, wl_pointer* pPointer, uint32_t time, uint32_t axis, wl_fixed_t value )
+{
+	UNREFERENCED_PARAMETER( pData );
+	UNREFERENCED_PARAMETER( pPointer );
+	UNREFERENCED_PARAMETER( time );
+	UNREFERENCED_PARAMETER( axis );
+	UNREFERENCED_PARAMETER( value );
+}
+
+void PlayWindow::HandleKeymap( void* pData, wl_keyboard* pKeyboard, uint32_t format, int32_t fd, uint32_t size )
+{
+	// Key codes are mapped directly, so the compositor's keymap isn't needed
+	UNREFERENCED_PARAMETER( pData );
+	UNREFERENCED_PARAMETER( pKeyboard );
+	UNREFERENCED_PARAMETER( format );
+	UNREFERENCED_PARAMETER( size );
+	close( fd );
+}
+
+void PlayWindow::HandleKeyboardEnter( void* pData, wl_keyboard* pKeyboard, uint32_t serial, wl_surface* pSurface, wl_array* pKeys )
+{
+	UNREFERENCED_PARAMETER( pData );
+	UNREFERENCED_PARAMETER( pKeyboard );
+	UNREFERENCED_PARAMETER( serial );
+	UNREFERENCED_PARAMETER( pSurface );
+	UNREFERENCED_PARAMETER( pKeys );
+}
+
+void PlayWindow::HandleKeyboardLeave( void* pData, wl_keyboard* pKeyboard, uint32_t serial, wl_surface* pSurface )
+{
+	UNREFERENCED_PARAMETER( pKeyboard );
+	UNREFERENCED_PARAMETER( serial );
+	UNREFERENCED_PARAMETER( pSurface );
+	// The key releases will go to another window, so don't leave any keys held down
+	PlayWindow* pWindow = static_cast<PlayWindow*>( pData );
+	memset( pWindow->m_keyDown, 0, sizeof( pWindow->m_keyDown ) );
+}
+
+void PlayWindow::HandleKey( void* pData, wl_keyboard* pKeyboard, uint32_t serial, uint32_t time, uint32_t key, uint32_t state )
+{
+	UNREFERENCED_PARAMETER( pKeyboard );
+	UNREFERENCED_PARAMETER( serial );
+	UNREFERENCED_PARAMETER( time );
+	PlayWindow* pWindow = static_cast<PlayWindow*>( pData );
+
+	int vKey = VirtualKeyFromKeyCode( key );
+	if( vKey )
+		pWindow->m_keyDown[vKey] = state == WL_KEYBOARD_KEY_STATE_PRESSED;
+}
+
+void PlayWindow::HandleModifiers( void* pData, wl_keyboard* pKeyboard, uint32_t serial, uint32_t depressed, uint32_t latched, uint32_t locked, uint32_t group )
+{
+	UNREFERENCED_PARAMETER( pData );
+	UNREFERENCED_PARAMETER( pKeyboard );
+	UNREFERENCED_PARAMETER( serial );
+	UNREFERENCED_PARAMETER( depressed );
+	UNREFERENCED_PARAMETER( latched );
+	UNREFERENCED_PARAMETER( locked );
+	UNREFERENCED_PARAMETER( group );
+}
+#endif
+
+//********************************************************************************************************************************
+// Loading functions
+//********************************************************************************************************************************
+
+// The state of the bit stream read by the PNG decoder's inflate
+struct InflateStream
+{
+	const uint8_t* pSource{ nullptr };
+	size_t sourceSize{ 0 };
+	size_t position{ 0 };
+	uint32_t bitBuffer{ 0 };
+	int bitCount{ 0 };
+	bool error{ false };
+};
+
+// A canonical Huffman code: the number of codes of each length and the symbols in code order
+struct InflateHuffman
+{
+	uint16_t counts[16]{};
+	uint16_t symbols[288]{};
+};
+
+// Reads a number of bits from the stream (least significant bit first)
+static int InflateBits( InflateStream& stream, int need )
+{
+	uint32_t value = stream.bitBuffer;
+
+	while( stream.bitCount < need )
+	{
+		if( stream.position >= stream.sourceSize )
+		{
+			stream.error = true;
+			return 0;
+		}
+		value |= static_cast<uint32_t>( stream.pSource[stream.position++] ) << stream.bitCount;
+		stream.bitCount += 8;
+	}
+
+	stream.bitBuffer = value >> need;
+	stream.bitCount -= need;
+	return static_cast<int>( value & ( ( 1u << need ) - 1 ) );
+}
+
+// Builds a Huffman code from the code length of each symbol
+static void InflateBuild( InflateHuffman& huffman, const uint8_t* lengths, int symbolCount )
+{
+	uint16_t offsets[16]{};
+
+	for( int len = 0; len < 16; len++ )
+		huffman.counts[len] = 0;
+	for( int symbol = 0; symbol < symbolCount; symbol++ )
+		huffman.counts[lengths[symbol]]++;
+
+	for( int len = 1; len < 15; len++ )
+		offsets[len + 1] = offsets[len] + huffman.counts[len];
+
+	for( int symbol = 0; symbol < symbolCount; symbol++ )
+	{
+		if( lengths[symbol] != 0 )
+			huffman.symbols[offsets[lengths[symbol]]++] = static_cast<uint16_t>( symbol );
+	}
+}
+
+// Reads one symbol using a Huffman code, a bit at a time (returns -1 for an invalid code)
+static int InflateDecode( InflateStream& stream, const InflateHuffman& huffman )
+{
+	int code = 0; // The code bits read so far
+	int first = 0; // The first code of the current length
+	int index = 0; // The index of the first code of the current length in the symbols
+
+	for( int len = 1; len < 16; len++ )
+	{
+		code |= InflateBits( stream, 1 );
+		int count = huffman.counts[len];
+
+		if( code - count < first )
+			return huffman.symbols[index + ( code - first )];
+
+		index += count;
+		first = ( first + count ) << 1;
+		code <<= 1;
+	}
+
+	stream.error = true;
+	return -1;
+}
+
+//********************************************************************************************************************************
+// Function:	Inflate - decompresses a zlib stream (as stored in the IDAT chunks of a PNG)
+// Parameters:	source = the zlib stream, dest = the decompressed bytes are appended to this
+// Notes:		A straightforward decoder for the three DEFLATE block types (RFC 1951) which reads the Huffman codes a bit at a
+//				time. It is only used to load images on platforms without GDI+, so it favours being short over being fast.
+//********************************************************************************************************************************
+static bool Inflate( const std::vector<uint8_t>& source, std::vector<uint8_t>& dest )
+{
+	static const uint16_t lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	static const uint8_t lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	static const uint16_t distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	static const uint8_t distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+	static const uint8_t codeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+	// The two byte zlib header must describe a DEFLATE stream without a preset dictionary
+	if( source.size() < 2 || ( source[0] & 0x0F ) != 8 || ( ( source[0] << 8 ) | source[1] ) % 31 != 0 || ( source[1] & 0x20 ) )
+		return false;
+
+	InflateStream stream;
+	stream.pSource = source.data();
+	stream.sourceSize = source.size();
+	stream.position = 2;
+
+	InflateHuffman lengthCode;
+	InflateHuffman distanceCode;
+	uint8_t lengths[320];
+	int lastBlock = 0;
+
+	do
+	{
+		lastBlock = InflateBits( stream, 1 );
+		int blockType = InflateBits( stream, 2 );
+
+		if( blockType == 0 )
+		{
+			// Stored blocks start on a byte boundary with the length and its complement
+			stream.bitBuffer = 0;
+			stream.bitCount = 0;
+			if( stream.position + 4 > stream.sourceSize )
+				return false;
+
+			const uint8_t* pHeader = stream.pSource + stream.position;
+			size_t len = pHeader[0] | ( pHeader[1] << 8 );
+			if( ( len ^ 0xFFFF ) != static_cast<size_t>( pHeader[2] | ( pHeader[3] << 8 ) ) || stream.position + 4 + len > stream.sourceSize )
+				return false;
+
+			dest.insert( dest.end(), pHeader + 4, pHeader + 4 + len );
+			stream.position += 4 + len;
+			continue;
+		}
+
+		if( blockType == 1 )
+		{
+			// Fixed Huffman codes
+			for( int symbol = 0; symbol < 288; symbol++ )
+				lengths[symbol] = symbol < 144 ? 8 : symbol < 256 ? 9 : symbol < 280 ? 7 : 8;
+			InflateBuild( lengthCode, lengths, 288 );
+
+			for( int symbol = 0; symbol < 30; symbol++ )
+				lengths[symbol] = 5;
+			InflateBuild( distanceCode, lengths, 30 );
+		}
+		else if( blockType == 2 )
+		{
+			// Dynamic Huffman codes, whose code lengths are themselves Huffman coded
+			int lengthCount = InflateBits( stream, 5 ) + 257;
+			int distanceCount = InflateBits( stream, 5 ) + 1;
+			int codeLengthCount = InflateBits( stream, 4 ) + 4;
+			if( lengthCount > 286 || distanceCount > 30 )
+				return false;
+
+			for( int i = 0; i < 19; i++ )
+				lengths[codeLengthOrder[i]] = i < codeLengthCount ? static_cast<uint8_t>( InflateBits( stream, 3 ) ) : 0;
+			InflateBuild( lengthCode, lengths, 19 );
+
+			int index = 0;
+			while( index < lengthCount + distanceCount && !stream.error )
 			{
-				uint32_t src = *srcPixels++;
-				uint32_t dest = *destPixels;
+				int symbol = InflateDecode( stream, lengthCode );
 
-				// If this isn't a fully transparent pixel 
-				if( src < 0xFF000000 )
+				if( symbol < 0 )
+					return false;
+
+				if( symbol < 16 )
 				{
-					int srcAlpha = static_cast<int>( ( 0xFF - ( src >> 24 ) ) * alphaMultiply );
-					int constAlpha = static_cast<int>( 255 * alphaMultiply );
+					lengths[index++] = static_cast<uint8_t>( symbol );
+					continue;
+				}
+
+				// Repeat the previous length, or a run of zero lengths
+				uint8_t repeatLength = 0;
+				int repeat = 0;
+
+				if( symbol == 16 )
+				{
+					if( index == 0 )
+						return false;
+					repeatLength = lengths[index - 1];
+					repeat = 3 + InflateBits( stream, 2 );
+				}
+				else if( symbol == 17 )
+				{
+					repeat = 3 + InflateBits( stream, 3 );
+				}
+				else
+				{
+					repeat = 11 + InflateBits( stream, 7 );
+				}
+
+				if( index + repeat > lengthCount + distanceCount )
+					return false;
+
+				while( repeat-- )
+					lengths[index++] = repeatLength;
+			}
+
+			InflateBuild( lengthCode, lengths, lengthCount );
+			InflateBuild( distanceCode, lengths + lengthCount, distanceCount );
+		}
+		else
+		{
+			return false;
+		}
+
+		// Decode literals and back references until the end of block symbol
+		while( !stream.error )
+		{
+			int symbol = InflateDecode( stream, lengthCode );
+
+			if( symbol < 0 || symbol > 285 )
+				return false;
+
+			if( symbol < 256 )
+			{
+				dest.push_back( static_cast<uint8_t>( symbol ) );
+				continue;
+			}
+
+			if( symbol == 256 )
+				break;
+
+			symbol -= 257;
+			size_t len = lengthBase[symbol] + InflateBits( stream, lengthExtra[symbol] );
+			int distanceSymbol = InflateDecode( stream, distanceCode );
+
+			if( distanceSymbol < 0 || distanceSymbol > 29 )
+				return false;
+
+			size_t distance = distanceBase[distanceSymbol] + InflateBits( stream, distanceExtra[distanceSymbol] );
+
+			if( distance > dest.size() )
+				return false;
+
+			// Copied a byte at a time because the source and destination can overlap
+			size_t from = dest.size() - distance;
+			for( size_t i = 0; i < len; i++ )
+			{
+				uint8_t value = dest[from + i];
+				dest.push_back( value );
+			}
+		}
+
+	} while( !lastBlock && !stream.error );
+
+	return !stream.error;
+}
+
+// Reads a big-endian 32-bit value from a PNG file
+static uint32_t PNGReadUint32( const uint8_t* pBytes )
+{
+	return ( static_cast<uint32_t>( pBytes[0] ) << 24 ) | ( pBytes[1] << 16 ) | ( pBytes[2] << 8 ) | pBytes[3];
+}
+
+// Whether a PNG bit depth is allowed with a colour type (palettes are limited to 8 bits and full colour types have 8 or 16)
+static bool PNGValidFormat( int colourType, int bitDepth )
+{
+	switch( colourType )
+	{
+		case 0: return bitDepth == 1 || bitDepth == 2 || bitDepth == 4 || bitDepth == 8 || bitDepth == 16;
+		case 3: return bitDepth == 1 || bitDepth == 2 || bitDepth == 4 || bitDepth == 8;
+		case 2: case 4: case 6: return bitDepth == 8 || bitDepth == 16;
+		default: return false;
+	}
+}
+
+// Reads a sample from a row of unfiltered PNG data, at any bit depth
+static int PNGSample( const uint8_t* pRow, int index, int bitDepth )
+{
+	if( bitDepth == 8 )
+		return pRow[index];
+
+	if( bitDepth == 16 )
+		return ( pRow[index * 2] << 8 ) | pRow[index * 2 + 1];
+
+	// Samples smaller than a byte are packed from the most significant bit
+	int bit = index * bitDepth;
+	return ( pRow[bit >> 3] >> ( 8 - bitDepth - ( bit & 7 ) ) ) & ( ( 1 << bitDepth ) - 1 );
+}
+
+//********************************************************************************************************************************
+// Function:	DecodePNG - reads a PNG file into straight alpha ARGB pixels, as GDI+ would on Windows
+// Parameters:	fileAndPath = the PNG file, destImage = receives the size and (when bPixels is set) new[]'d pixels
+// Notes:		Handles every colour type and bit depth (including palettes and tRNS transparency) but not interlaced images.
+//				Malformed files are rejected, as are images of more than PNG_MAX_PIXELS pixels.
+//********************************************************************************************************************************
+static bool DecodePNG( const std::string& fileAndPath, PixelData& destImage, bool bPixels )
+{
+	static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+	// The largest image that will be decoded (a 16384 x 16384 image is a gigabyte of pixels)
+	static const uint64_t PNG_MAX_PIXELS = 16384 * 16384;
+
+	std::ifstream file( fileAndPath, std::ios::binary );
+	std::vector<uint8_t> data( ( std::istreambuf_iterator<char>( file ) ), std::istreambuf_iterator<char>() );
+
+	if( data.size() < 33 || memcmp( data.data(), signature, 8 ) != 0 || memcmp( data.data() + 12, "IHDR", 4 ) != 0 )
+		return false;
+
+	uint32_t fileWidth = PNGReadUint32( data.data() + 16 );
+	uint32_t fileHeight = PNGReadUint32( data.data() + 20 );
+	int bitDepth = data[24];
+	int colourType = data[25];
+	int interlace = data[28];
+
+	// Colour types: 0 = grey, 2 = RGB, 3 = palette, 4 = grey and alpha, 6 = RGBA
+	int channels = colourType == 2 ? 3 : colourType == 4 ? 2 : colourType == 6 ? 4 : 1;
+
+	if( fileWidth == 0 || fileHeight == 0 || static_cast<uint64_t>( fileWidth ) * fileHeight > PNG_MAX_PIXELS || !PNGValidFormat( colourType, bitDepth ) )
+		return false;
+
+	int width = static_cast<int>( fileWidth );
+	int height = static_cast<int>( fileHeight );
+
+	destImage.width = width;
+	destImage.height = height;
+
+	if( !bPixels )
+		return true;
+
+	PLAY_ASSERT_MSG( interlace == 0, std::string( "Interlaced PNG files are not supported: " + fileAndPath ).c_str() );
+	if( interlace != 0 )
+		return false;
+
+	// Gather the compressed image data and the palette and transparency chunks
+	std::vector<uint8_t> compressed;
+	uint32_t palette[256];
+	int paletteSize = 0;
+	int transparentKey[3] = { -1, -1, -1 };
+
+	for( int i = 0; i < 256; i++ )
+		palette[i] = 0xFF000000;
+
+	size_t chunk = 8;
+	while( chunk + 12 <= data.size() )
+	{
+		size_t len = PNGReadUint32( data.data() + chunk );
+		const uint8_t* pType = data.data() + chunk + 4;
+		const uint8_t* pData = data.data() + chunk + 8;
+
+		if( chunk + 12 + len > data.size() )
+			return false;
+
+		if( memcmp( pType, "IDAT", 4 ) == 0 )
+		{
+			compressed.insert( compressed.end(), pData, pData + len );
+		}
+		else if( memcmp( pType, "PLTE", 4 ) == 0 )
+		{
+			paletteSize = std::min( static_cast<int>( len / 3 ), 256 );
+			for( int i = 0; i < paletteSize; i++ )
+				palette[i] = 0xFF000000 | ( pData[i * 3] << 16 ) | ( pData[i * 3 + 1] << 8 ) | pData[i * 3 + 2];
+		}
+		else if( memcmp( pType, "tRNS", 4 ) == 0 )
+		{
+			if( colourType == 3 )
+			{
+				for( size_t i = 0; i < len && i < 256; i++ )
+					palette[i] = ( palette[i] & 0x00FFFFFF ) | ( static_cast<uint32_t>( pData[i] ) << 24 );
+			}
+			else
+			{
+				for( size_t i = 0; i < 3 && i * 2 + 1 < len; i++ )
+					transparentKey[i] = ( pData[i * 2] << 8 ) | pData[i * 2 + 1];
+			}
+		}
+		else if( memcmp( pType, "IEND", 4 ) == 0 )
+		{
+			break;
+		}
+
+		chunk += 12 + len;
+	}
+
+	// A palette image needs a palette
+	if( colourType == 3 && paletteSize == 0 )
+		return false;
+
+	size_t rowBytes = ( static_cast<size_t>( width ) * channels * bitDepth + 7 ) / 8;
+	int pixelBytes = std::max( 1, channels * bitDepth / 8 ); // The distance back to the same byte of the previous pixel
+
+	// Deflate expands data by at most 1032 times, so a header can't make this reserve more than the data could fill
+	std::vector<uint8_t> filtered;
+	filtered.reserve( std::min( ( rowBytes + 1 ) * height, compressed.size() * 1032 ) );
+	if( !Inflate( compressed, filtered ) || filtered.size() < ( rowBytes + 1 ) * height )
+		return false;
+
+	// Undo the filter on each row, which predicts every byte from the bytes to its left, above, and above left
+	std::vector<uint8_t> previous( rowBytes, 0 );
+	destImage.pPixels = new Pixel[static_cast<size_t>( width ) * height];
+	int maxValue = ( 1 << bitDepth ) - 1;
+	bool bValid = true;
+
+	for( int y = 0; y < height && bValid; y++ )
+	{
+		uint8_t* pRow = filtered.data() + y * ( rowBytes + 1 );
+		int filter = *pRow++;
+
+		// Filter types above four don't exist
+		if( filter > 4 )
+		{
+			bValid = false;
+			break;
+		}
+
+		for( size_t i = 0; i < rowBytes; i++ )
+		{
+			int left = i >= static_cast<size_t>( pixelBytes ) ? pRow[i - pixelBytes] : 0;
+			int up = previous[i];
+			int upLeft = i >= static_cast<size_t>( pixelBytes ) ? previous[i - pixelBytes] : 0;
+
+			switch( filter )
+			{
+				case 1:
+					pRow[i] = static_cast<uint8_t>( pRow[i] + left );
+					break;
+				case 2:
+					pRow[i] = static_cast<uint8_t>( pRow[i] + up );
+					break;
+				case 3:
+					pRow[i] = static_cast<uint8_t>( pRow[i] + ( ( left + up ) >> 1 ) );
+					break;
+				case 4:
+				{
+					// Paeth picks whichever neighbour is closest to left + up - upLeft
+					int estimate = left + up - upLeft;
+					int distanceLeft = abs( estimate - left );
+					int distanceUp = abs( estimate - up );
+					int distanceUpLeft = abs( estimate - upLeft );
+					int predictor = ( distanceLeft <= distanceUp && distanceLeft <= distanceUpLeft ) ? left : ( distanceUp <= distanceUpLeft ) ? up : upLeft;
+					pRow[i] = static_cast<uint8_t>( pRow[i] + predictor );
+					break;
+				}
+				default:
+					break;
+			}
+		}
+
+		memcpy( previous.data(), pRow, rowBytes );
+
+		// Convert the samples to 8-bit straight alpha ARGB
+		Pixel* pDest = destImage.pPixels + static_cast<size_t>( y ) * width;
+
+		for( int x = 0; x < width; x++ )
+		{
+			if( colourType == 3 )
+			{
+				int index = PNGSample( pRow, x, bitDepth );
+
+				// Indices past the end of the palette are an error
+				if( index >= paletteSize )
+				{
+					bValid = false;
+					break;
+				}
+
+				pDest[x].bits = palette[index];
+				continue;
+			}
+
+			int sample[4];
+			for( int c = 0; c < channels; c++ )
+				sample[c] = PNGSample( pRow, x * channels + c, bitDepth );
+
+			if( colourType == 0 || colourType == 4 )
+			{
+				int grey = sample[0] * 255 / maxValue;
+				int alpha = colourType == 4 ? sample[1] * 255 / maxValue : ( sample[0] == transparentKey[0] ? 0 : 255 );
+				pDest[x] = Pixel( alpha, grey, grey, grey );
+			}
+			else
+			{
+				int alpha = colourType == 6 ? sample[3] * 255 / maxValue : ( sample[0] == transparentKey[0] && sample[1] == transparentKey[1] && sample[2] == transparentKey[2] ? 0 : 255 );
+				pDest[x] = Pixel( alpha, sample[0] * 255 / maxValue, sample[1] * 255 / maxValue, sample[2] * 255 / maxValue );
+			}
+		}
+	}
+
+	if( !bValid )
+	{
+		delete[] destImage.pPixels;
+		destImage.pPixels = nullptr;
+	}
+
+	return bValid;
+}
+
+int PlayWindow::ReadPNGImage( std::string& fileAndPath, int& width, int& height )
+{
+	PixelData image;
+
+	if( !DecodePNG( FindFile( fileAndPath ), image, false ) )
+		return PLAY_ERROR;
+
+	width = image.width;
+	height = image.height;
+
+	return 1;
+}
+
+int PlayWindow::LoadPNGImage( std::string& fileAndPath, PixelData& destImage )
+{
+	if( !DecodePNG( FindFile( fileAndPath ), destImage, true ) )
+	{
+		PLAY_ASSERT_MSG( false, std::string( "Unable to load PNG file: " + fileAndPath ).c_str() );
+		return PLAY_ERROR;
+	}
+
+	return 1;
+}
+
+std::string PlayWindow::FindFile( const std::string& fileAndPath )
+{
+	std::string path( fileAndPath );
+	std::replace( path.begin(), path.end(), '\\', '/' );
+
+	if( std::filesystem::exists( path ) )
+		return path;
+
+	// Windows file names ignore case, so look for each part of the path in its directory with the case ignored
+	std::filesystem::path found;
+
+	for( const std::filesystem::path& part : std::filesystem::path( path ) )
+	{
+		std::filesystem::path next = found / part;
+
+		if( !part.empty() && !std::filesystem::exists( next ) )
+		{
+			std::filesystem::path directory = found.empty() ? std::filesystem::path( "." ) : found;
+			std::string name = part.string();
+			for( char& c : name ) c = static_cast<char>( toupper( c ) );
+
+			if( !std::filesystem::is_directory( directory ) )
+				return path;
+
+			bool bMatched = false;
+			for( const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator( directory ) )
+			{
+				std::string entryName = entry.path().filename().string();
+				for( char& c : entryName ) c = static_cast<char>( toupper( c ) );
+
+				if( entryName == name )
+				{
+					next = found / entry.path().filename();
+					bMatched = true;
+					break;
+				}
+			}
+
+			if( !bMatched )
+				return path;
+		}
+
+		found = next;
+	}
+
+	return found.string();
+}
+
+//********************************************************************************************************************************
+// Miscellaneous functions
+//********************************************************************************************************************************
+
+void AssertFailMessage( const char* message, const char* file, long line )
+{
+	// There is nobody to show a message box to, so the failure goes to the debug output
+	std::filesystem::path p = file;
+	std::string s = "Assertion Failure: " + p.filename().string() + " : LINE " + std::to_string( line );
+	s += "\n" + std::string( message ) + "\n";
+	DebugOutput( s );
+}
+
+void DebugOutput( const char* s )
+{
+	fputs( s, stderr );
+}
+
+void DebugOutput( std::string s )
+{
+	fputs( s.c_str(), stderr );
+}
+
+void TracePrintf( const char* file, int line, const char* fmt, ... )
+{
+	constexpr size_t kMaxBufferSize = 512u;
+	char buffer[kMaxBufferSize];
+
+	va_list args;
+	va_start( args, fmt );
+	int len = snprintf( buffer, kMaxBufferSize, "%s(%d): ", file, line );
+	vsnprintf( buffer + len, kMaxBufferSize - len, fmt, args );
+	DebugOutput( buffer );
+	va_end( args );
+}
+#endif // PLAY_PLATFORM_WINDOWS
+
+//********************************************************************************************************************************
+// File:		PlayBlitter.cpp
+// Description:	A software pixel renderer for drawing 2D primitives into a PixelData buffer
+// Platform:	Independent
+//********************************************************************************************************************************
+
+
+PlayBlitter::PlayBlitter( PixelData* pRenderTarget )
+{
+	m_pRenderTarget = pRenderTarget;
+	UpdateClipRect();
+}
+
+//********************************************************************************************************************************
+// Clipping functions
+//********************************************************************************************************************************
+
+void PlayBlitter::PushClipRect( PixelRect rect )
+{
+	// Each new clipping rectangle is restricted to the one below it on the stack
+	if( !m_vClipStack.empty() )
+	{
+		const PixelRect& prev = m_vClipStack.back();
+		int right = std::min( rect.x + rect.width, prev.x + prev.width );
+		int bottom = std::min( rect.y + rect.height, prev.y + prev.height );
+		rect.x = std::max( rect.x, prev.x );
+		rect.y = std::max( rect.y, prev.y );
+		rect.width = std::max( right - rect.x, 0 );
+		rect.height = std::max( bottom - rect.y, 0 );
+	}
+
+	m_vClipStack.push_back( rect );
+	UpdateClipRect();
+}
+
+void PlayBlitter::PopClipRect()
+{
+	PLAY_ASSERT_MSG( !m_vClipStack.empty(), "PopClipRect called without a matching PushClipRect" );
+	if( !m_vClipStack.empty() )
+		m_vClipStack.pop_back();
+	UpdateClipRect();
+}
+
+void PlayBlitter::UpdateClipRect()
+{
+	if( !m_pRenderTarget )
+	{
+		m_clipRect = PixelRect();
+		return;
+	}
+
+	m_clipRect = { 0, 0, m_pRenderTarget->width, m_pRenderTarget->height };
+
+	if( !m_vClipStack.empty() )
+	{
+		const PixelRect& top = m_vClipStack.back();
+		int right = std::min( top.x + top.width, m_clipRect.width );
+		int bottom = std::min( top.y + top.height, m_clipRect.height );
+		m_clipRect.x = std::max( top.x, 0 );
+		m_clipRect.y = std::max( top.y, 0 );
+		m_clipRect.width = std::max( right - m_clipRect.x, 0 );
+		m_clipRect.height = std::max( bottom - m_clipRect.y, 0 );
+	}
+}
+
+//********************************************************************************************************************************
+// Primitive drawing functions
+//********************************************************************************************************************************
+
+void PlayBlitter::DrawPixel( int posX, int posY, Pixel srcPix )
+{
+	posX -= m_cameraX;
+	posY -= m_cameraY;
+
+	if( srcPix.a == 0x00 || posX < m_clipRect.x || posX >= m_clipRect.x + m_clipRect.width || posY < m_clipRect.y || posY >= m_clipRect.y + m_clipRect.height )
+		return;
+
+	if( Is565() )
+	{
+		BlendPixel565( posX, posY, srcPix );
+		return;
+	}
+
+	Pixel* destPix = m_pRenderTarget->Row( posY ) + posX;
+
+	if( srcPix.a == 0xFF ) // Completely opaque pixel - no need to blend
+		*destPix = srcPix.bits;
+	else
+		*destPix = BlendPixel( destPix->bits, srcPix );
+}
+
+uint32_t PlayBlitter::BlendPixel( uint32_t dest, Pixel pix )
+{
+	int srcAlpha = pix.a;
+	int invSrcAlpha = 0xFF - srcAlpha;
+
+	// Fast divide by 255 which is exact for the full range of products: x/255 = ( x + 1 + ( x >> 8 ) ) >> 8
+	int destRed = ( pix.r * srcAlpha ) + ( ( ( dest >> 16 ) & 0xFF ) * invSrcAlpha );
+	int destGreen = ( pix.g * srcAlpha ) + ( ( ( dest >> 8 ) & 0xFF ) * invSrcAlpha );
+	int destBlue = ( pix.b * srcAlpha ) + ( ( dest & 0xFF ) * invSrcAlpha );
+
+	destRed = ( destRed + 1 + ( destRed >> 8 ) ) >> 8;
+	destGreen = ( destGreen + 1 + ( destGreen >> 8 ) ) >> 8;
+	destBlue = ( destBlue + 1 + ( destBlue >> 8 ) ) >> 8;
+
+	return 0xFF000000 | ( destRed << 16 ) | ( destGreen << 8 ) | destBlue;
+}
+
+void PlayBlitter::FillPixels( Pixel* pDest, int count, Pixel pix )
+{
+	uint32_t* pDestPixels = &pDest->bits;
+	uint32_t* pDestEnd = pDestPixels + count;
+
+	if( pix.a == 0xFF ) // Completely opaque - a straight fill
+	{
+#ifdef PLAY_USE_SSE2
+		__m128i fill = _mm_set1_epi32( static_cast<int>( pix.bits ) );
+		for( ; pDestPixels + 4 <= pDestEnd; pDestPixels += 4 )
+			_mm_storeu_si128( reinterpret_cast<__m128i*>( pDestPixels ), fill );
+#endif
+		while( pDestPixels < pDestEnd )
+			*pDestPixels++ = pix.bits;
+		return;
+	}
+
+#ifdef PLAY_USE_SSE2
+	// The same fixed point blend as BlendPixel, four pixels at a time using 16-bit channels
+	__m128i zero = _mm_setzero_si128();
+	__m128i one = _mm_set1_epi16( 1 );
+	__m128i invSrcAlpha = _mm_set1_epi16( static_cast<short>( 0xFF - pix.a ) );
+	__m128i opaque = _mm_set1_epi32( static_cast<int>( 0xFF000000 ) );
+	__m128i srcTerm = _mm_mullo_epi16( _mm_unpacklo_epi8( _mm_set1_epi32( static_cast<int>( pix.bits & 0x00FFFFFF ) ), zero ), _mm_set1_epi16( pix.a ) );
+
+	for( ; pDestPixels + 4 <= pDestEnd; pDestPixels += 4 )
+	{
+		__m128i dest = _mm_loadu_si128( reinterpret_cast<__m128i*>( pDestPixels ) );
+
+		__m128i lo = _mm_add_epi16( srcTerm, _mm_mullo_epi16( _mm_unpacklo_epi8( dest, zero ), invSrcAlpha ) );
+		__m128i hi = _mm_add_epi16( srcTerm, _mm_mullo_epi16( _mm_unpackhi_epi8( dest, zero ), invSrcAlpha ) );
+		lo = _mm_srli_epi16( _mm_add_epi16( _mm_add_epi16( lo, one ), _mm_srli_epi16( lo, 8 ) ), 8 );
+		hi = _mm_srli_epi16( _mm_add_epi16( _mm_add_epi16( hi, one ), _mm_srli_epi16( hi, 8 ) ), 8 );
+
+		_mm_storeu_si128( reinterpret_cast<__m128i*>( pDestPixels ), _mm_or_si128( _mm_packus_epi16( lo, hi ), opaque ) );
+	}
+#endif
+	for( ; pDestPixels < pDestEnd; pDestPixels++ )
+		*pDestPixels = BlendPixel( *pDestPixels, pix );
+}
+
+//********************************************************************************************************************************
+// 16-bit pixel functions
+//********************************************************************************************************************************
+
+uint16_t PlayBlitter::PackPixel565( uint32_t colour, int x, int y )
+{
+	int bias = DITHER_BIAS_565[y & 3][x & 3];
+
+	// Each channel is multiplied up to its new range and divided by 255 with ( v + ( v >> 8 ) ) >> 8, and the bias decides
+	// whether the fraction rounds up. White stays white without any clamping, because the largest bias is below one step
+	int red = ( ( colour >> 16 ) & 0xFF ) * 31;
+	int green = ( ( colour >> 8 ) & 0xFF ) * 63;
+	int blue = ( colour & 0xFF ) * 31;
+
+	red = ( red + ( red >> 8 ) + bias ) >> 8;
+	green = ( green + ( green >> 8 ) + bias ) >> 8;
+	blue = ( blue + ( blue >> 8 ) + bias ) >> 8;
+
+	return static_cast<uint16_t>( ( red << 11 ) | ( green << 5 ) | blue );
+}
+
+uint32_t PlayBlitter::UnpackPixel565( uint16_t pix )
+{
+	// The top bits are repeated into the new low bits so that black and white stay exactly black and white
+	uint32_t red = ( pix >> 11 ) & 0x1F;
+	uint32_t green = ( pix >> 5 ) & 0x3F;
+	uint32_t blue = pix & 0x1F;
+
+	red = ( red << 3 ) | ( red >> 2 );
+	green = ( green << 2 ) | ( green >> 4 );
+	blue = ( blue << 3 ) | ( blue >> 2 );
+
+	return 0xFF000000 | ( red << 16 ) | ( green << 8 ) | blue;
+}
+
+#ifdef PLAY_USE_SSE2
+__m128i PlayBlitter::PackPixels565( __m128i red, __m128i green, __m128i blue, int x, int y )
+{
+	// Every product fits in 16 bits, as do the biases added to them
+	__m128i bias = _mm_loadu_si128( reinterpret_cast<const __m128i*>( &DITHER_BIAS_565[y & 3][x & 3] ) );
+	red = _mm_mullo_epi16( red, _mm_set1_epi16( 31 ) );
+	green = _mm_mullo_epi16( green, _mm_set1_epi16( 63 ) );
+	blue = _mm_mullo_epi16( blue, _mm_set1_epi16( 31 ) );
+
+	red = _mm_srli_epi16( _mm_add_epi16( _mm_add_epi16( red, _mm_srli_epi16( red, 8 ) ), bias ), 8 );
+	green = _mm_srli_epi16( _mm_add_epi16( _mm_add_epi16( green, _mm_srli_epi16( green, 8 ) ), bias ), 8 );
+	blue = _mm_srli_epi16( _mm_add_epi16( _mm_add_epi16( blue, _mm_srli_epi16( blue, 8 ) ), bias ), 8 );
+
+	return _mm_or_si128( _mm_or_si128( _mm_slli_epi16( red, 11 ), _mm_slli_epi16( green, 5 ) ), blue );
+}
+
+void PlayBlitter::UnpackPixels565( __m128i pixels, __m128i& red, __m128i& green, __m128i& blue )
+{
+	red = _mm_srli_epi16( pixels, 11 );
+	green = _mm_and_si128( _mm_srli_epi16( pixels, 5 ), _mm_set1_epi16( 0x3F ) );
+	blue = _mm_and_si128( pixels, _mm_set1_epi16( 0x1F ) );
+
+	red = _mm_or_si128( _mm_slli_epi16( red, 3 ), _mm_srli_epi16( red, 2 ) );
+	green = _mm_or_si128( _mm_slli_epi16( green, 2 ), _mm_srli_epi16( green, 4 ) );
+	blue = _mm_or_si128( _mm_slli_epi16( blue, 3 ), _mm_srli_epi16( blue, 2 ) );
+}
+#endif
+
+void PlayBlitter::BlendPixel565( int x, int y, Pixel pix ) const
+{
+	uint16_t* pDest = m_pRenderTarget->Row565( y ) + x;
+	*pDest = PackPixel565( ( pix.a == 0xFF ) ? pix.bits : BlendPixel( UnpackPixel565( *pDest ), pix ), x, y );
+}
+
+uint16_t PlayBlitter::BlendPreMultiplied565( uint16_t dest, uint32_t src, float alphaMultiply, int x, int y )
+{
+	int constAlpha = static_cast<int>( 255 * std::min( alphaMultiply, 1.0f ) );
+
+	// Opaque sprite pixels don't need the destination at all
+	if( ( src >> 24 ) == 0 && constAlpha == 0xFF )
+		return PackPixel565( src, x, y );
+
+	uint32_t destPix = UnpackPixel565( dest );
+	int red, green, blue;
+
+	if( constAlpha == 0xFF )
+	{
+		// The source is already multiplied by its own alpha, so only the destination is scaled (by one minus that alpha)
+		int invSrcAlpha = static_cast<int>( src >> 24 );
+		red = invSrcAlpha * ( ( destPix >> 16 ) & 0xFF );
+		green = invSrcAlpha * ( ( destPix >> 8 ) & 0xFF );
+		blue = invSrcAlpha * ( destPix & 0xFF );
+
+		red = ( ( src >> 16 ) & 0xFF ) + ( ( red + 1 + ( red >> 8 ) ) >> 8 );
+		green = ( ( src >> 8 ) & 0xFF ) + ( ( green + 1 + ( green >> 8 ) ) >> 8 );
+		blue = ( src & 0xFF ) + ( ( blue + 1 + ( blue >> 8 ) ) >> 8 );
+	}
+	else
+	{
+		// The same blend as the 32-bit alpha multiply path: the source is scaled by the alpha multiply as well
+		int srcAlpha = ( 0xFF - static_cast<int>( src >> 24 ) ) * constAlpha;
+		srcAlpha = ( srcAlpha + 1 + ( srcAlpha >> 8 ) ) >> 8;
+		int invSrcAlpha = 0xFF - srcAlpha;
+
+		red = ( constAlpha * ( ( src >> 16 ) & 0xFF ) ) + ( invSrcAlpha * ( ( destPix >> 16 ) & 0xFF ) );
+		green = ( constAlpha * ( ( src >> 8 ) & 0xFF ) ) + ( invSrcAlpha * ( ( destPix >> 8 ) & 0xFF ) );
+		blue = ( constAlpha * ( src & 0xFF ) ) + ( invSrcAlpha * ( destPix & 0xFF ) );
+
+		red = ( red + 1 + ( red >> 8 ) ) >> 8;
+		green = ( green + 1 + ( green >> 8 ) ) >> 8;
+		blue = ( blue + 1 + ( blue >> 8 ) ) >> 8;
+	}
+
+	return PackPixel565( ( std::min( red, 0xFF ) << 16 ) | ( std::min( green, 0xFF ) << 8 ) | std::min( blue, 0xFF ), x, y );
+}
+
+#ifdef PLAY_USE_SSE2
+void PlayBlitter::BlendPreMultiplied565( uint16_t* pDest, const uint32_t* pSrc, int x, int y )
+{
+	__m128i mask = _mm_set1_epi32( 0xFF );
+	__m128i one = _mm_set1_epi16( 1 );
+	__m128i lo = _mm_loadu_si128( reinterpret_cast<const __m128i*>( pSrc ) );
+	__m128i hi = _mm_loadu_si128( reinterpret_cast<const __m128i*>( pSrc + 4 ) );
+
+	// The source channels are all below 256, so packing them down into 16-bit lanes doesn't saturate
+	__m128i srcRed = _mm_packs_epi32( _mm_and_si128( _mm_srli_epi32( lo, 16 ), mask ), _mm_and_si128( _mm_srli_epi32( hi, 16 ), mask ) );
+	__m128i srcGreen = _mm_packs_epi32( _mm_and_si128( _mm_srli_epi32( lo, 8 ), mask ), _mm_and_si128( _mm_srli_epi32( hi, 8 ), mask ) );
+	__m128i srcBlue = _mm_packs_epi32( _mm_and_si128( lo, mask ), _mm_and_si128( hi, mask ) );
+	__m128i invSrcAlpha = _mm_packs_epi32( _mm_srli_epi32( lo, 24 ), _mm_srli_epi32( hi, 24 ) );
+
+	__m128i dest = _mm_loadu_si128( reinterpret_cast<const __m128i*>( pDest ) );
+	__m128i red, green, blue;
+	UnpackPixels565( dest, red, green, blue );
+
+	red = _mm_mullo_epi16( red, invSrcAlpha );
+	green = _mm_mullo_epi16( green, invSrcAlpha );
+	blue = _mm_mullo_epi16( blue, invSrcAlpha );
+
+	__m128i maxChannel = _mm_set1_epi16( 0xFF );
+	red = _mm_min_epi16( _mm_add_epi16( srcRed, _mm_srli_epi16( _mm_add_epi16( _mm_add_epi16( red, one ), _mm_srli_epi16( red, 8 ) ), 8 ) ), maxChannel );
+	green = _mm_min_epi16( _mm_add_epi16( srcGreen, _mm_srli_epi16( _mm_add_epi16( _mm_add_epi16( green, one ), _mm_srli_epi16( green, 8 ) ), 8 ) ), maxChannel );
+	blue = _mm_min_epi16( _mm_add_epi16( srcBlue, _mm_srli_epi16( _mm_add_epi16( _mm_add_epi16( blue, one ), _mm_srli_epi16( blue, 8 ) ), 8 ) ), maxChannel );
+
+	// Transparent pixels have an inverse alpha of 0xFF (and a run length in place of their colour)
+	__m128i transparent = _mm_cmpeq_epi16( invSrcAlpha, maxChannel );
+	__m128i blended = PackPixels565( red, green, blue, x, y );
+	_mm_storeu_si128( reinterpret_cast<__m128i*>( pDest ), _mm_or_si128( _mm_and_si128( transparent, dest ), _mm_andnot_si128( transparent, blended ) ) );
+}
+#endif
+
+void PlayBlitter::FillPixels565( int startX, int endX, int posY, Pixel pix )
+{
+	uint16_t* pDestRow = m_pRenderTarget->Row565( posY );
+	int x = startX;
+
+	if( pix.a != 0xFF )
+	{
+#ifdef PLAY_USE_SSE2
+		// The same blend as BlendPixel565, eight pixels at a time
+		__m128i one = _mm_set1_epi16( 1 );
+		__m128i invSrcAlpha = _mm_set1_epi16( static_cast<short>( 0xFF - pix.a ) );
+		__m128i srcRed = _mm_set1_epi16( static_cast<short>( pix.r * pix.a ) );
+		__m128i srcGreen = _mm_set1_epi16( static_cast<short>( pix.g * pix.a ) );
+		__m128i srcBlue = _mm_set1_epi16( static_cast<short>( pix.b * pix.a ) );
+
+		for( ; x + 7 <= endX; x += 8 )
+		{
+			__m128i red, green, blue;
+			UnpackPixels565( _mm_loadu_si128( reinterpret_cast<const __m128i*>( pDestRow + x ) ), red, green, blue );
+
+			red = _mm_add_epi16( srcRed, _mm_mullo_epi16( red, invSrcAlpha ) );
+			green = _mm_add_epi16( srcGreen, _mm_mullo_epi16( green, invSrcAlpha ) );
+			blue = _mm_add_epi16( srcBlue, _mm_mullo_epi16( blue, invSrcAlpha ) );
+			red = _mm_srli_epi16( _mm_add_epi16( _mm_add_epi16( red, one ), _mm_srli_epi16( red, 8 ) ), 8 );
+			green = _mm_srli_epi16( _mm_add_epi16( _mm_add_epi16( green, one ), _mm_srli_epi16( green, 8 ) ), 8 );
+			blue = _mm_srli_epi16( _mm_add_epi16( _mm_add_epi16( blue, one ), _mm_srli_epi16( blue, 8 ) ), 8 );
+
+			_mm_storeu_si128( reinterpret_cast<__m128i*>( pDestRow + x ), PackPixels565( red, green, blue, x, posY ) );
+		}
+#endif
+		for( ; x <= endX; x++ )
+			BlendPixel565( x, posY, pix );
+		return;
+	}
+
+	// An opaque colour only has four different dithered values along a row, so eight pixels hold the pattern twice
+	uint16_t pattern[8];
+	for( int i = 0; i < 8; i++ )
+		pattern[i] = PackPixel565( pix.bits, startX + i, posY );
+
+#ifdef PLAY_USE_SSE2
+	__m128i fill = _mm_loadu_si128( reinterpret_cast<const __m128i*>( pattern ) );
+	for( ; x + 7 <= endX; x += 8 )
+		_mm_storeu_si128( reinterpret_cast<__m128i*>( pDestRow + x ), fill );
+#endif
+	for( ; x <= endX; x++ )
+		pDestRow[x] = pattern[( x - startX ) & 7];
+}
+
+//********************************************************************************************************************************
+// Function:	DrawLine - draws a line using Bresenham's line drawing algorithm
+// Notes:		The line is clipped in advance (in the style of Liang-Barsky) by working out the range of steps along the major
+//				axis which fall inside the clipping rectangle. The minor axis position after k steps along the major axis is
+//				floor( ( 2*minor*k + major ) / ( 2*major ) ), which is exactly where Bresenham would put it, so clipping
+//				never changes which pixels are drawn and the loop doesn't need any bounds checks.
+//********************************************************************************************************************************
+void PlayBlitter::DrawLine( int startX, int startY, int endX, int endY, Pixel pix, bool drawStart )
+{
+	if( pix.a == 0x00 || ( startX == endX && startY == endY ) )
+		return;
+
+	startX -= m_cameraX;
+	startY -= m_cameraY;
+	endX -= m_cameraX;
+	endY -= m_cameraY;
+
+	int dx = abs( endX - startX );
+	int sx = ( endX < startX ) ? -1 : 1;
+	int dy = abs( endY - startY );
+	int sy = ( endY < startY ) ? -1 : 1;
+
+	// Work in terms of the major (longest) and minor axes so both cases share the same code
+	bool xMajor = dx >= dy;
+	long long major = xMajor ? dx : dy;
+	long long minor = xMajor ? dy : dx;
+	int majorStart = xMajor ? startX : startY;
+	int minorStart = xMajor ? startY : startX;
+	int majorStep = xMajor ? sx : sy;
+	int minorStep = xMajor ? sy : sx;
+	int majorClipMin = xMajor ? m_clipRect.x : m_clipRect.y;
+	int majorClipMax = majorClipMin + ( xMajor ? m_clipRect.width : m_clipRect.height ) - 1;
+	int minorClipMin = xMajor ? m_clipRect.y : m_clipRect.x;
+	int minorClipMax = minorClipMin + ( xMajor ? m_clipRect.height : m_clipRect.width ) - 1;
+
+	if( majorClipMax < majorClipMin || minorClipMax < minorClipMin )
+		return;
+
+	// The range of major axis steps which are inside the clipping rectangle on the major axis
+	long long kMin = drawStart ? 0 : 1;
+	long long kMax = major;
+	long long toMin = static_cast<long long>( majorClipMin - majorStart ) * majorStep;
+	long long toMax = static_cast<long long>( majorClipMax - majorStart ) * majorStep;
+	kMin = std::max( kMin, std::min( toMin, toMax ) );
+	kMax = std::min( kMax, std::max( toMin, toMax ) );
+
+	// Narrow the range to the steps which are inside on the minor axis (the number of minor steps only ever increases)
+	long long toMinorMin = static_cast<long long>( minorClipMin - minorStart ) * minorStep;
+	long long toMinorMax = static_cast<long long>( minorClipMax - minorStart ) * minorStep;
+	long long mLow = std::max( 0LL, std::min( toMinorMin, toMinorMax ) );
+	long long mHigh = std::min( minor, std::max( toMinorMin, toMinorMax ) );
+
+	if( mLow > mHigh )
+		return;
+
+	if( minor > 0 )
+	{
+		// First step with at least mLow minor steps, and last step with no more than mHigh
+		if( mLow > 0 )
+			kMin = std::max( kMin, ( ( 2 * major * mLow ) - major + ( 2 * minor ) - 1 ) / ( 2 * minor ) );
+		if( mHigh < minor )
+			kMax = std::min( kMax, ( ( 2 * major * ( mHigh + 1 ) ) - major + ( 2 * minor ) - 1 ) / ( 2 * minor ) - 1 );
+	}
+
+	if( kMin > kMax )
+		return;
+
+	// Set up the minor axis position and remainder for the first visible step
+	long long numerator = ( 2 * minor * kMin ) + major;
+	long long m = numerator / ( 2 * major );
+	long long remainder = numerator - ( m * 2 * major );
+
+	int x = xMajor ? majorStart + ( majorStep * static_cast<int>( kMin ) ) : minorStart + ( minorStep * static_cast<int>( m ) );
+	int y = xMajor ? minorStart + ( minorStep * static_cast<int>( m ) ) : majorStart + ( majorStep * static_cast<int>( kMin ) );
+
+	if( Is565() )
+	{
+		// 16-bit pixels are dithered by position, so the loop steps the co-ordinates instead of a pointer
+		for( long long k = kMin; k <= kMax; k++ )
+		{
+			BlendPixel565( x, y, pix );
+
+			( xMajor ? x : y ) += majorStep;
+			remainder += 2 * minor;
+			if( remainder >= 2 * major )
+			{
+				remainder -= 2 * major;
+				( xMajor ? y : x ) += minorStep;
+			}
+		}
+		return;
+	}
+
+	int stride = m_pRenderTarget->Stride();
+	int majorInc = xMajor ? majorStep : majorStep * stride;
+	int minorInc = xMajor ? minorStep * stride : minorStep;
+	Pixel* pDest = m_pRenderTarget->Row( y ) + x;
+
+	for( long long k = kMin; k <= kMax; k++ )
+	{
+		if( pix.a == 0xFF )
+			*pDest = pix.bits;
+		else
+			*pDest = BlendPixel( pDest->bits, pix );
+
+		pDest += majorInc;
+		remainder += 2 * minor;
+		if( remainder >= 2 * major )
+		{
+			remainder -= 2 * major;
+			pDest += minorInc;
+		}
+	}
+}
+
+//********************************************************************************************************************************
+// Function:	DrawPoints - draws a batch of individual pixels
+// Parameters:	points = the positions of the pixels, colours = a colour for each point (or a single colour for all of them)
+// Notes:		The visible points are counting sorted into rows (keeping their original order within each row) so that
+//				the render target is written from top to bottom instead of jumping around the buffer
+//********************************************************************************************************************************
+void PlayBlitter::DrawPoints( const std::vector<Point2f>& points, const std::vector<Pixel>& colours )
+{
+	PLAY_ASSERT_MSG( colours.size() == 1 || colours.size() == points.size(), "DrawPoints needs either one colour or one colour per point" );
+	if( colours.empty() || ( colours.size() != 1 && colours.size() != points.size() ) )
+		return;
+
+	int stride = m_pRenderTarget->Stride();
+	int clipRight = m_clipRect.x + m_clipRect.width;
+	int clipBottom = m_clipRect.y + m_clipRect.height;
+
+	// Clip every point once and count how many land on each row
+	m_vPointRowStarts.assign( static_cast<size_t>( m_clipRect.height ) + 1, 0 );
+	m_vPointOffsets.resize( points.size() );
+
+	for( size_t i = 0; i < points.size(); i++ )
+	{
+		// Rounded down after adding a half so points just above or to the left of the target (e.g. -0.7) stay off it
+		int x = static_cast<int>( std::floor( points[i].x + 0.5f ) ) - m_cameraX;
+		int y = static_cast<int>( std::floor( points[i].y + 0.5f ) ) - m_cameraY;
+
+		if( x < m_clipRect.x || x >= clipRight || y < m_clipRect.y || y >= clipBottom )
+		{
+			m_vPointOffsets[i] = -1;
+			continue;
+		}
+
+		m_vPointOffsets[i] = ( y * stride ) + x;
+		m_vPointRowStarts[static_cast<size_t>( y - m_clipRect.y ) + 1]++;
+	}
+
+	// Turn the counts into the position of each row in the sorted order
+	for( size_t row = 1; row < m_vPointRowStarts.size(); row++ )
+		m_vPointRowStarts[row] += m_vPointRowStarts[row - 1];
+
+	m_vPointOrder.resize( m_vPointRowStarts.back() );
+
+	for( size_t i = 0; i < points.size(); i++ )
+	{
+		if( m_vPointOffsets[i] >= 0 )
+			m_vPointOrder[m_vPointRowStarts[( m_vPointOffsets[i] / stride ) - m_clipRect.y]++] = static_cast<int>( i );
+	}
+
+	uint32_t* pDstBase = &m_pRenderTarget->pPixels->bits;
+	bool oneColour = colours.size() == 1;
+
+	if( Is565() )
+	{
+		for( int i : m_vPointOrder )
+		{
+			Pixel pix = colours[oneColour ? 0 : i];
+			if( pix.a != 0x00 )
+				BlendPixel565( m_vPointOffsets[i] % stride, m_vPointOffsets[i] / stride, pix );
+		}
+		return;
+	}
+
+	for( int i : m_vPointOrder )
+	{
+		Pixel pix = colours[oneColour ? 0 : i];
+		uint32_t* pDest = pDstBase + m_vPointOffsets[i];
+
+		if( pix.a == 0xFF )
+			*pDest = pix.bits;
+		else if( pix.a != 0x00 )
+			*pDest = BlendPixel( *pDest, pix );
+	}
+}
+
+void PlayBlitter::DrawSpan( int startX, int endX, int posY, Pixel pix )
+{
+	startX -= m_cameraX;
+	endX -= m_cameraX;
+	posY -= m_cameraY;
+
+	if( pix.a == 0x00 || posY < m_clipRect.y || posY >= m_clipRect.y + m_clipRect.height )
+		return;
+
+	startX = std::max( startX, m_clipRect.x );
+	endX = std::min( endX, m_clipRect.x + m_clipRect.width - 1 );
+
+	if( startX > endX )
+		return;
+
+	if( Is565() )
+		FillPixels565( startX, endX, posY, pix );
+	else
+		FillPixels( m_pRenderTarget->Row( posY ) + startX, endX - startX + 1, pix );
+}
+
+void PlayBlitter::DrawMaskedSpan( int startX, int posY, const uint64_t* pMask, int width, Pixel pix )
+{
+	startX -= m_cameraX;
+	posY -= m_cameraY;
+
+	if( pix.a == 0x00 || posY < m_clipRect.y || posY >= m_clipRect.y + m_clipRect.height )
+		return;
+
+	int first = std::max( 0, m_clipRect.x - startX );
+	int last = std::min( width, m_clipRect.x + m_clipRect.width - startX );
+	int words = ( width + 63 ) / 64;
+
+	if( Is565() )
+	{
+		for( int i = first; i < last; i++ )
+		{
+			if( pMask[i >> 6] & ( 1ull << ( i & 63 ) ) )
+				BlendPixel565( startX + i, posY, pix );
+		}
+		return;
+	}
+
+	Pixel* pDestRow = m_pRenderTarget->Row( posY );
+
+#ifdef PLAY_USE_SSE2
+	__m128i fill = _mm_set1_epi32( static_cast<int>( pix.bits ) );
+#endif
+
+	for( int i = first; i < last; )
+	{
+		// The next 64 bits of the mask from pixel i (which may straddle two words)
+		int shift = i & 63;
+		uint64_t bits = pMask[i >> 6] >> shift;
+		if( shift > 0 && ( i >> 6 ) + 1 < words )
+			bits |= pMask[( i >> 6 ) + 1] << ( 64 - shift );
+
+		if( bits == 0 )
+		{
+			i += 64;
+			continue;
+		}
+
+		int count = std::min( 4, last - i );
+		uint32_t lanes = static_cast<uint32_t>( bits ) & ( ( 1u << count ) - 1 );
+		uint32_t* pDest = &pDestRow[startX + i].bits;
+
+#ifdef PLAY_USE_SSE2
+		// Opaque pixels are written four at a time, selecting between the colour and the existing pixels with the mask
+		if( count == 4 && pix.a == 0xFF )
+		{
+			__m128i select = _mm_set_epi32( -static_cast<int>( ( lanes >> 3 ) & 1 ), -static_cast<int>( ( lanes >> 2 ) & 1 ), -static_cast<int>( ( lanes >> 1 ) & 1 ), -static_cast<int>( lanes & 1 ) );
+			__m128i dest = _mm_loadu_si128( reinterpret_cast<__m128i*>( pDest ) );
+			_mm_storeu_si128( reinterpret_cast<__m128i*>( pDest ), _mm_or_si128( _mm_and_si128( select, fill ), _mm_andnot_si128( select, dest ) ) );
+			i += 4;
+			continue;
+		}
+#endif
+		for( int lane = 0; lane < count; lane++ )
+		{
+			if( lanes & ( 1u << lane ) )
+				pDest[lane] = ( pix.a == 0xFF ) ? pix.bits : BlendPixel( pDest[lane], pix );
+		}
+		i += count;
+	}
+}
+
+void PlayBlitter::FillRect( int left, int top, int right, int bottom, Pixel pix )
+{
+	// DrawSpan applies the camera offset, so the rows are clipped against the clipping rectangle moved by the camera
+	top = std::max( top, m_clipRect.y + m_cameraY );
+	bottom = std::min( bottom, m_clipRect.y + m_clipRect.height + m_cameraY );
+
+	for( int y = top; y < bottom; y++ )
+		DrawSpan( left, right - 1, y, pix );
+}
+
+//********************************************************************************************************************************
+// Function:	DrawCircle - draws a circle using the midpoint circle algorithm
+// Notes:		The algorithm steps around one octant and the other seven are reflections of it. When filling, the half width
+//				of every row is worked out first so each row is drawn as a single span and no pixel is blended twice. The
+//				outline skips reflections which land on a pixel already drawn for the same reason.
+//********************************************************************************************************************************
+void PlayBlitter::DrawCircle( int centreX, int centreY, int radius, Pixel pix, bool fill )
+{
+	if( pix.a == 0x00 || radius < 0 )
+		return;
+
+	if( radius == 0 )
+	{
+		DrawPixel( centreX, centreY, pix );
+		return;
+	}
+
+	// Nothing to draw if the circle is outside the clipping rectangle (DrawPixel and DrawSpan apply the camera offset)
+	int screenX = centreX - m_cameraX;
+	int screenY = centreY - m_cameraY;
+	if( screenX + radius < m_clipRect.x || screenX - radius >= m_clipRect.x + m_clipRect.width ||
+		screenY + radius < m_clipRect.y || screenY - radius >= m_clipRect.y + m_clipRect.height )
+		return;
+
+	if( fill )
+		m_vCircleHalfWidths.assign( radius + 1, 0 );
+
+	int dx = 0;
+	int dy = radius;
+	int d = 3 - 2 * radius;
+
+	// Octants meet on the axes (dx == 0) and the diagonals (dx == dy), where only four of the eight reflections are different
+	while( dx <= dy )
+	{
+		if( fill )
+		{
+			m_vCircleHalfWidths[dy] = std::max( m_vCircleHalfWidths[dy], dx );
+			m_vCircleHalfWidths[dx] = std::max( m_vCircleHalfWidths[dx], dy );
+		}
+		else if( dx == 0 )
+		{
+			DrawPixel( centreX, centreY + dy, pix );
+			DrawPixel( centreX, centreY - dy, pix );
+			DrawPixel( centreX + dy, centreY, pix );
+			DrawPixel( centreX - dy, centreY, pix );
+		}
+		else
+		{
+			DrawPixel( centreX + dx, centreY + dy, pix );
+			DrawPixel( centreX - dx, centreY + dy, pix );
+			DrawPixel( centreX + dx, centreY - dy, pix );
+			DrawPixel( centreX - dx, centreY - dy, pix );
+
+			if( dx != dy )
+			{
+				DrawPixel( centreX - dy, centreY + dx, pix );
+				DrawPixel( centreX + dy, centreY - dx, pix );
+				DrawPixel( centreX - dy, centreY - dx, pix );
+				DrawPixel( centreX + dy, centreY + dx, pix );
+			}
+		}
+
+		dx++;
+		if( d > 0 )
+		{
+			dy--;
+			d = d + 4 * ( dx - dy ) + 10;
+		}
+		else
+		{
+			d = d + 4 * dx + 6;
+		}
+	}
+
+	for( int row = 0; fill && row <= radius; row++ )
+	{
+		int halfWidth = m_vCircleHalfWidths[row];
+		DrawSpan( centreX - halfWidth, centreX + halfWidth, centreY + row, pix );
+		if( row > 0 )
+			DrawSpan( centreX - halfWidth, centreX + halfWidth, centreY - row, pix );
+	}
+}
+
+//********************************************************************************************************************************
+// Function:	BlitPixels - draws image data with and without a global alpha multiply
+// Parameters:	spriteId = the id of the sprite to draw
+//				xpos, ypos = the position you want to draw the sprite
+//				frameIndex = which frame of the animation to draw (wrapped)
+// Notes:		Alpha multiply approach is relatively unoptimized
+//********************************************************************************************************************************
+void PlayBlitter::BlitPixels( const PixelData& srcPixelData, int srcOffset, int blitX, int blitY, int blitWidth, int blitHeight, float alphaMultiply ) const
+{
+	PLAY_ASSERT_MSG( m_pRenderTarget, "Render target not set for PlayBlitter" );
+
+	blitX -= m_cameraX;
+	blitY -= m_cameraY;
+
+	int clipRight = m_clipRect.x + m_clipRect.width;
+	int clipBottom = m_clipRect.y + m_clipRect.height;
+
+	// Nothing within the clipping rectangle to draw
+	if( blitX >= clipRight || blitX + blitWidth <= m_clipRect.x || blitY >= clipBottom || blitY + blitHeight <= m_clipRect.y )
+		return;
+
+	// Work out if we need to clip to the clipping rectangle (and by how much)
+	int xClipStart = m_clipRect.x - blitX;
+	if( xClipStart < 0 ) { xClipStart = 0; }
+
+	int xClipEnd = ( blitX + blitWidth ) - clipRight;
+	if( xClipEnd < 0 ) { xClipEnd = 0; }
+
+	int yClipStart = m_clipRect.y - blitY;
+	if( yClipStart < 0 ) { yClipStart = 0; }
+
+	int yClipEnd = ( blitY + blitHeight ) - clipBottom;
+	if( yClipEnd < 0 ) { yClipEnd = 0; }
+
+	// Rows may be padded or be part of a larger image, so stepping between them uses the stride rather than the width
+	int destStride = m_pRenderTarget->Stride();
+	int srcStride = srcPixelData.Stride();
+
+	if( srcPixelData.format == PIXEL_FORMAT_INDEXED8 )
+	{
+		// Each visible row is looked up in the (pre-multiplied) palette from right to left, so the transparent skip values
+		// can be worked out as it goes, and then drawn like any other row
+		int width = blitWidth - xClipEnd - xClipStart;
+		m_vIndexedRow.resize( width );
+
+		PixelData row;
+		row.width = width;
+		row.height = 1;
+		row.pPixels = m_vIndexedRow.data();
+		row.preMultiplied = true;
+
+		uint32_t* pRow = &m_vIndexedRow.data()->bits;
+		const uint32_t* pPalette = srcPixelData.pPalette;
+
+		for( int y = yClipStart; y < blitHeight - yClipEnd; y++ )
+		{
+			const uint8_t* pIndices = srcPixelData.Row8( 0 ) + srcOffset + ( srcStride * y ) + xClipStart;
+
+			uint32_t next = 0;
+			for( int x = width - 1; x >= 0; x-- )
+			{
+				uint32_t pix = pPalette[pIndices[x]];
+				if( pix >= 0xFF000000 && next >= 0xFF000000 )
+					pix = next + 1;
+				pRow[x] = next = pix;
+			}
+
+			// BlitPixels applies the camera offset again, so it is added back on here
+			BlitPixels( row, 0, blitX + xClipStart + m_cameraX, blitY + y + m_cameraY, width, 1, alphaMultiply );
+		}
+		return;
+	}
+
+	if( Is565() )
+	{
+		// 16-bit render targets unpack, blend and dither each pixel, skipping runs of transparent pixels in the same way
+		int endX = blitX + blitWidth - xClipEnd;
+		int endY = blitY + blitHeight - yClipEnd;
+
+		for( int y = blitY + yClipStart; y < endY; y++ )
+		{
+			const uint32_t* pSrc = &srcPixelData.pPixels->bits + srcOffset + ( srcStride * ( y - blitY ) ) + xClipStart;
+			uint16_t* pDestRow = m_pRenderTarget->Row565( y );
+
+			for( int x = blitX + xClipStart; x < endX; x++ )
+			{
+#ifdef PLAY_USE_SSE2
+				// Without an alpha multiply, eight pixels are blended at a time unless they start a transparent run
+				if( alphaMultiply >= 1.0f && *pSrc < 0xFF000000 && x + 8 <= endX )
+				{
+					BlendPreMultiplied565( pDestRow + x, pSrc, x, y );
+					pSrc += 8;
+					x += 7;
+					continue;
+				}
+#endif
+				uint32_t src = *pSrc++;
+
+				if( src < 0xFF000000 )
+				{
+					pDestRow[x] = BlendPreMultiplied565( pDestRow[x], src, alphaMultiply, x, y );
+				}
+				else
+				{
+					int skip = std::min( static_cast<int>( src & 0x00FFFFFF ), endX - x - 1 );
+					pSrc += skip;
+					x += skip;
+				}
+			}
+		}
+		return;
+	}
+
+	// Set up the source and destination pointers based on clipping
+	int destOffset = ( destStride * ( blitY + yClipStart ) ) + ( blitX + xClipStart );
+	uint32_t* destPixels = &m_pRenderTarget->pPixels->bits + destOffset;
+
+	int srcClipOffset = ( srcStride * yClipStart ) + xClipStart;
+	uint32_t* srcPixels = &srcPixelData.pPixels->bits + srcOffset + srcClipOffset;
+
+	// Work out in advance how much we need to add to src and dest to reach the next row 
+	int destInc = destStride - blitWidth + xClipEnd + xClipStart;
+	int srcInc = srcStride - blitWidth + xClipEnd + xClipStart;
+
+	//Work out final pixel in destination.
+	int destColOffset = ( destStride * ( blitHeight - yClipEnd - yClipStart - 1 ) ) + ( blitWidth - xClipEnd - xClipStart );
+	uint32_t* destColEnd = destPixels + destColOffset;
+
+	//How many pixels per row in sprite.
+	int endRow = blitWidth - xClipEnd - xClipStart;
+
+	if( alphaMultiply < 1.0f )
+	{
+		// *******************************************************************************************************************************************************
+		// A basic (unoptimized) approach which separates the channels and performs a 'typical' alpha blending operation: (src * srcAlpha)+(dest * (1-srcAlpha))
+		// Has the advantage that a global alpha multiplication can be easily added over the top, so we use this method when a global multiply is required
+		// *******************************************************************************************************************************************************
+
+		// Slightly more optimised iterations without the additions in the loop
+		while( destPixels < destColEnd )
+		{
+			uint32_t* destRowEnd = destPixels + endRow;
+
+			while( destPixels < destRowEnd )
+			{
+				uint32_t src = *srcPixels++;
+				uint32_t dest = *destPixels;
+
+				// If this isn't a fully transparent pixel 
+				if( src < 0xFF000000 )
+				{
+					int srcAlpha = static_cast<int>( ( 0xFF - ( src >> 24 ) ) * alphaMultiply );
+					int constAlpha = static_cast<int>( 255 * alphaMultiply );
+
+					// Source pixels are already multiplied by srcAlpha so we just apply the constant alpha multiplier
+					int destRed = constAlpha * ( ( src >> 16 ) & 0xFF );
+					int destGreen = constAlpha * ( ( src >> 8 ) & 0xFF );
+					int destBlue = constAlpha * ( src & 0xFF );
+
+					int invSrcAlpha = 0xFF - srcAlpha;
+
+					// Apply a standard Alpha blend [ src*srcAlpha + dest*(1-SrcAlpha) ]
+					destRed += invSrcAlpha * ( ( dest >> 16 ) & 0xFF );
+					destGreen += invSrcAlpha * ( ( dest >> 8 ) & 0xFF );
+					destBlue += invSrcAlpha * ( dest & 0xFF );
+
+					// Bring back to the range 0-255
+					destRed >>= 8;
+					destGreen >>= 8;
+					destBlue >>= 8;
+
+					// Put ARGB components back together again
+					*destPixels++ = 0xFF000000 | ( destRed << 16 ) | ( destGreen << 8 ) | destBlue;
+				}
+				else
+				{
+					// If this is a fully transparent pixel then the low bits store how many there are in a row
+					// This means we can skip to the next pixel which isn't fully transparent
+					uint32_t skip = static_cast<uint32_t>( destRowEnd - destPixels ) - 1;
+					src = src & 0x00FFFFFF;
+					if( skip > src ) skip = src;
+
+					srcPixels += skip;
+					++destPixels += skip;
+				}
+			}
+			// Increase buffers by pre-calculated amounts
+			destPixels += destInc;
+			srcPixels += srcInc;
+		}
+
+	}
+	else
+	{
+		// *******************************************************************************************************************************************************
+		// An optimized approach which uses pre-multiplied alpha, parallel channel multiplication and pixel skipping to achieve the same 'typical' alpha 
+		// blending operation (src * srcAlpha)+(dest * (1-srcAlpha)). Not easy to apply a global alpha multiplication over the top, but used everywhere else.
+		// *******************************************************************************************************************************************************
+
+		// Slightly more optimised iterations without the additions in the loop
+		while( destPixels < destColEnd )
+		{
+			uint32_t* destRowEnd = destPixels + endRow;
+
+			while( destPixels < destRowEnd )
+			{
+				uint32_t src = *srcPixels++;
+				uint32_t dest = *destPixels;
+
+				// If this isn't a fully transparent pixel 
+				if( src < 0xFF000000 )
+				{
+					// This performes the dest*(1-srcAlpha) calculation for all channels in parallel with minor accuracy loss in dest colour.
+					// It does this by shifting all the destination channels down by 4 bits in order to "make room" for the later multiplication.
+					// After shifting down, it masks out the bits which have shifted into the adjacent channel data.
+					// This causes the RGB data to be rounded down to their nearest 16 producing a reduction in colour accuracy.
+					// This is then multiplied by the inverse alpha (inversed in PreMultiplyAlpha), also divided by 16 (hence >> 8+8+8+4).
+					// The multiplication brings our RGB values back up to their original bit ranges (albeit rounded to the nearest 16).
+					// As the colour accuracy only affects the destination pixels behind semi-transparent source pixels and so isn't very obvious.
+					dest = ( ( ( dest >> 4 ) & 0x000F0F0F ) * ( src >> 28 ) );
+					// Add the (pre-multiplied Alpha) source to the destination and force alpha to opaque
+					*destPixels++ = ( src + dest ) | 0xFF000000;
+				}
+				else
+				{
+					// If this is a fully transparent pixel then the low bits store how many there are in a row
+					// This means we can skip to the next pixel which isn't fully transparent
+					uint32_t skip = static_cast<uint32_t>( destRowEnd - destPixels ) - 1;
+					src = src & 0x00FFFFFF;
+					if( skip > src ) skip = src;
+
+					srcPixels += skip;
+					++destPixels += skip;
+				}
+			}
+			// Increase buffers by pre-calculated amounts
+			destPixels += destInc;
+			srcPixels += srcInc;
+		}
+
+	}
+
+	return;
+}
+
+//********************************************************************************************************************************
+// Function:	ScalePixels - draws scaled image data with and without a global alpha multiply
+// Parameters:	blitX, blitY = where the origin of the image is drawn
+//				blitWidth, blitHeight = the size of the image before it is scaled
+//				originX, originY = the origin of the image relative to its top left corner
+// Notes:		Each render target pixel samples the image pixel nearest its centre. The source column for every render target
+//				column is worked out once (like the scaled backgrounds), so the rows are drawn with table lookups and runs of
+//				transparent pixels are skipped through the table of the first render target column for each source column.
+//********************************************************************************************************************************
+void PlayBlitter::ScalePixels( const PixelData& srcPixelData, int srcOffset, int blitX, int blitY, int blitWidth, int blitHeight, int originX, int originY, float scale, float alphaMultiply ) const
+{
+	PLAY_ASSERT_MSG( m_pRenderTarget, "Render target not set for PlayBlitter" );
+
+	// The scaled image's top left corner and size in the render target
+	int left = blitX - m_cameraX - static_cast<int>( std::floor( ( originX * scale ) + 0.5f ) );
+	int top = blitY - m_cameraY - static_cast<int>( std::floor( ( originY * scale ) + 0.5f ) );
+	int width = static_cast<int>( ( blitWidth * scale ) + 0.5f );
+	int height = static_cast<int>( ( blitHeight * scale ) + 0.5f );
+
+	int startX = std::max( left, m_clipRect.x );
+	int endX = std::min( left + width, m_clipRect.x + m_clipRect.width );
+	int startY = std::max( top, m_clipRect.y );
+	int endY = std::min( top + height, m_clipRect.y + m_clipRect.height );
+
+	// Nothing within the clipping rectangle to draw
+	if( startX >= endX || startY >= endY )
+		return;
+
+	// The image is stepped through in 16.16 fixed point, starting half a step in so each sample is at a pixel centre
+	int step = static_cast<int>( 65536.0f / scale );
+	int columns = endX - startX;
+	m_vScaleColumns.resize( columns );
+	for( int x = 0; x < columns; x++ )
+		m_vScaleColumns[x] = std::min( ( ( ( startX - left + x ) * step ) + ( step >> 1 ) ) >> 16, blitWidth - 1 );
+
+	// Only the source columns between the first and last sampled are used, so the columns are made relative to the first
+	int srcStart = m_vScaleColumns[0];
+	int srcCount = m_vScaleColumns[columns - 1] + 1 - srcStart;
+	m_vScaleSkips.resize( srcCount + 1 );
+	for( int x = 0, column = 0; column <= srcCount; column++ )
+	{
+		while( x < columns && m_vScaleColumns[x] - srcStart < column )
+			x++;
+		m_vScaleSkips[column] = x;
+	}
+	for( int& column : m_vScaleColumns )
+		column -= srcStart;
+
+	const int* pColumns = m_vScaleColumns.data();
+	const int* pSkips = m_vScaleSkips.data();
+	bool is565 = Is565();
+	int srcStride = srcPixelData.Stride();
+	int lastSourceY = -1;
+	const uint32_t* pSrc = nullptr;
+
+	for( int y = startY; y < endY; y++ )
+	{
+		int sourceY = std::min( ( ( ( y - top ) * step ) + ( step >> 1 ) ) >> 16, blitHeight - 1 );
+
+		if( srcPixelData.format != PIXEL_FORMAT_INDEXED8 )
+		{
+			pSrc = &srcPixelData.pPixels->bits + srcOffset + ( srcStride * sourceY ) + srcStart;
+		}
+		else if( sourceY != lastSourceY )
+		{
+			// Indexed rows are looked up in the palette from right to left, working out the transparent skips like BlitPixels
+			m_vIndexedRow.resize( srcCount );
+			uint32_t* pRow = &m_vIndexedRow.data()->bits;
+			const uint8_t* pIndices = srcPixelData.Row8( 0 ) + srcOffset + ( srcStride * sourceY ) + srcStart;
+
+			uint32_t next = 0;
+			for( int x = srcCount - 1; x >= 0; x-- )
+			{
+				uint32_t pix = srcPixelData.pPalette[pIndices[x]];
+				if( pix >= 0xFF000000 && next >= 0xFF000000 )
+					pix = next + 1;
+				pRow[x] = next = pix;
+			}
+			pSrc = pRow;
+		}
+		lastSourceY = sourceY;
+
+		uint32_t* pDest = is565 ? nullptr : &m_pRenderTarget->Row( y )[startX].bits;
+		uint16_t* pDest565 = is565 ? m_pRenderTarget->Row565( y ) + startX : nullptr;
+
+		if( !is565 && alphaMultiply >= 1.0f )
+		{
+			// The pre-multiplied blend from BlitPixels, with all the destination channels multiplied in parallel
+			for( int x = 0; x < columns; )
+			{
+				int column = pColumns[x];
+				uint32_t src = pSrc[column];
+
+				if( src < 0xFF000000 )
+				{
+					pDest[x] = ( src + ( ( ( pDest[x] >> 4 ) & 0x000F0F0F ) * ( src >> 28 ) ) ) | 0xFF000000;
+					x++;
+				}
+				else
+				{
+					// Skip to the first render target column past the run of transparent source pixels
+					x = pSkips[std::min( column + static_cast<int>( src & 0x00FFFFFF ) + 1, srcCount )];
+				}
+			}
+			continue;
+		}
+
+		for( int x = 0; x < columns; )
+		{
+			int column = pColumns[x];
+			uint32_t src = pSrc[column];
+
+			if( src >= 0xFF000000 )
+			{
+				x = pSkips[std::min( column + static_cast<int>( src & 0x00FFFFFF ) + 1, srcCount )];
+				continue;
+			}
+
+			if( is565 )
+			{
+				pDest565[x] = BlendPreMultiplied565( pDest565[x], src, alphaMultiply, startX + x, y );
+			}
+			else
+			{
+				// The same channel separated blend as BlitPixels uses for a global alpha multiply
+				uint32_t dest = pDest[x];
+				int srcAlpha = static_cast<int>( ( 0xFF - ( src >> 24 ) ) * alphaMultiply );
+				int constAlpha = static_cast<int>( 255 * alphaMultiply );
+				int invSrcAlpha = 0xFF - srcAlpha;
+
+				int destRed = ( ( constAlpha * ( ( src >> 16 ) & 0xFF ) ) + ( invSrcAlpha * ( ( dest >> 16 ) & 0xFF ) ) ) >> 8;
+				int destGreen = ( ( constAlpha * ( ( src >> 8 ) & 0xFF ) ) + ( invSrcAlpha * ( ( dest >> 8 ) & 0xFF ) ) ) >> 8;
+				int destBlue = ( ( constAlpha * ( src & 0xFF ) ) + ( invSrcAlpha * ( dest & 0xFF ) ) ) >> 8;
+
+				pDest[x] = 0xFF000000 | ( destRed << 16 ) | ( destGreen << 8 ) | destBlue;
+			}
+			x++;
+		}
+	}
+}
+
+//********************************************************************************************************************************
+// Function:	RotateScaleSprite - draws a rotated and scaled sprite with global alpha multiply
+// Parameters:	s = the sprite to draw
+//				xpos, ypos = the position of the center of rotation.
+//				frameIndex = which frame of the animation to draw (wrapped)
+//				angle = rotation angle
+//				scale = parameter to magnify the sprite.
+//				rotOffX, rotOffY = offset of centre of rotation to the top left of the sprite
+//				alpha = the fraction defining the amount of sprite and background that is draw. 255 = all sprite, 0 = all background.
+// Notes:		Pre-calculates roughly where the sprite will be in the display buffer and only processes those pixels. 
+//				Approx 15 times slower than not rotating.
+//********************************************************************************************************************************
+void PlayBlitter::RotateScalePixels( const PixelData& srcPixelData, int srcOffset, int blitX, int blitY, int blitWidth, int blitHeight, int originX, int originY, float angle, float scale, float alphaMultiply ) const
+{
+	PLAY_ASSERT_MSG( m_pRenderTarget, "Render target not set for PlayBlitter" );
+
+	blitX -= m_cameraX;
+	blitY -= m_cameraY;
+
+	//pointers to start of source and destination buffers (indexed sources are looked up in their palette)
+	const uint8_t* pIndexBase = ( srcPixelData.format == PIXEL_FORMAT_INDEXED8 ) ? srcPixelData.Row8( 0 ) + srcOffset : nullptr;
+	const uint32_t* pSrcBase = pIndexBase ? nullptr : &srcPixelData.pPixels->bits + srcOffset;
+	uint32_t* pDstBase = &m_pRenderTarget->pPixels->bits;
+
+	//the centre of rotation in the sprite frame relative to the top corner
+	float fRotCentreU = static_cast<float>( originX );
+	float fRotCentreV = static_cast<float>( originY );
+
+	//u/v are co-ordinates in the rotated sprite frame. x/y are screen buffer co-ordinates.
+	//change in u/v for a unit change in x/y.
+	float dUdX = static_cast<float>( cos( -angle ) ) * ( 1.0f / scale );
+	float dVdX = static_cast<float>( sin( -angle ) ) * ( 1.0f / scale );
+	float dUdY = -dVdX;
+	float dVdY = dUdX;
+
+	//Position in the sprite rotated frame with origin at the center of rotation of the sprite corners.
+	float leftU = -fRotCentreU * scale;
+	float rightU = ( blitWidth + -fRotCentreU ) * scale;
+	float topV = ( -fRotCentreV ) * scale;
+	float bottomV = ( blitHeight - fRotCentreV ) * scale;
+
+	//Scale added in to cancel out the scale in dUdX.
+	float boundingBoxCorners[4][2]
+	{
+		{ ( dUdX * leftU + dVdX * topV ) * scale,			( dUdY * leftU + dVdY * topV ) * scale		},	// Top left
+		{ ( dUdX * leftU + dVdX * bottomV ) * scale,		( dUdY * leftU + dVdY * bottomV ) * scale		},	// Bottom left
+		{ ( dUdX * rightU + dVdX * bottomV ) * scale,		( dUdY * rightU + dVdY * bottomV ) * scale	},	// Bottom right
+		{ ( dUdX * rightU + dVdX * topV ) * scale,			( dUdY * rightU + dVdY * topV ) * scale,		},	// Top right
+	};
+
+	float minX = std::numeric_limits<float>::infinity();
+	float minY = std::numeric_limits<float>::infinity();
+	float maxX = -std::numeric_limits<float>::infinity();
+	float maxY = -std::numeric_limits<float>::infinity();
+
+	//calculate the extremes of the rotated corners.
+	for( int i = 0; i < 4; i++ )
+	{
+		minX = std::min( minX, boundingBoxCorners[i][0] );
+		maxX = std::max( maxX, boundingBoxCorners[i][0] );
+		minY = std::min( minY, boundingBoxCorners[i][1] );
+		maxY = std::max( maxY, boundingBoxCorners[i][1] );
+	}
+
+	//clip the starting and finishing positions.
+	// > minX/minY are stepped on by whole pixels so clipping doesn't change where the sprite is sampled
+	int startY = blitY + static_cast<int>( minY );
+	if( startY < m_clipRect.y ) { minY += static_cast<float>( m_clipRect.y - startY ); startY = m_clipRect.y; }
+
+	int endY = blitY + static_cast<int>( maxY );
+	if( endY > m_clipRect.y + m_clipRect.height ) { endY = m_clipRect.y + m_clipRect.height; }
+
+	int startX = blitX + static_cast<int>( minX );
+	if( startX < m_clipRect.x ) { minX += static_cast<float>( m_clipRect.x - startX ); startX = m_clipRect.x; }
+
+	int endX = blitX + static_cast<int>( maxX );
+	if( endX > m_clipRect.x + m_clipRect.width ) { endX = m_clipRect.x + m_clipRect.width; }
+
+	// Nothing within the clipping rectangle to draw
+	if( startX >= endX || startY >= endY )
+		return;
+
+	//rotate the basis so we get the edge of the bounding box in the sprite frame.
+	float startingU = dUdX * minX + dUdY * minY + fRotCentreU;
+	float startingV = dVdY * minY + dVdX * minX + fRotCentreV;
+
+	float rowU = startingU;
+	float rowV = startingV;
+
+	// The destination is tracked as an index so the same loop can write to either render target format
+	uint16_t* pDst565Base = m_pRenderTarget->Row565( 0 );
+	bool is565 = Is565();
+	size_t destIndex = ( static_cast<size_t>( m_pRenderTarget->Stride() ) * startY ) + startX;
+	int nextRow = m_pRenderTarget->Stride() - ( endX - startX );
+	int srcStride = srcPixelData.Stride();
+
+	//Start of double for loop. 
+	for( int y = startY; y < endY; y++ )
+	{
+		float u = rowU;
+		float v = rowV;
+
+		for( int x = startX; x < endX; x++ )
+		{
+			//Check to see if u and v correspond to a valid pixel in sprite.
+			if( u > 0 && v > 0 && u < blitWidth && v < blitHeight )
+			{
+				size_t srcIndex = static_cast<size_t>( u ) + ( static_cast<size_t>( v ) * srcStride );
+				uint32_t src = pIndexBase ? srcPixelData.pPalette[pIndexBase[srcIndex]] : pSrcBase[srcIndex];
+
+				if( src < 0xFF000000 && is565 )
+				{
+					pDst565Base[destIndex] = BlendPreMultiplied565( pDst565Base[destIndex], src, alphaMultiply, x, y );
+				}
+				else if( src < 0xFF000000 )
+				{
+					int srcAlpha = static_cast<int>( ( 0xFF - ( src >> 24 ) ) * alphaMultiply );
+					int constAlpha = static_cast<int>( 255 * alphaMultiply );
+
+					// Source pixels are already multiplied by srcAlpha so we just apply the constant alpha multiplier
+					int destRed = constAlpha * ( ( src >> 16 ) & 0xFF );
+					int destGreen = constAlpha * ( ( src >> 8 ) & 0xFF );
+					int destBlue = constAlpha * ( src & 0xFF );
+
+					uint32_t dest = pDstBase[destIndex];
+					int invSrcAlpha = 0xFF - srcAlpha;
+
+					// Apply a standard Alpha blend [ src*srcAlpha + dest*(1-SrcAlpha) ]
+					destRed += invSrcAlpha * ( ( dest >> 16 ) & 0xFF );
+					destGreen += invSrcAlpha * ( ( dest >> 8 ) & 0xFF );
+					destBlue += invSrcAlpha * ( dest & 0xFF );
+
+					// Bring back to the range 0-255
+					destRed >>= 8;
+					destGreen >>= 8;
+					destBlue >>= 8;
+
+					// Put ARGB components back together again
+					pDstBase[destIndex] = 0xFF000000 | ( destRed << 16 ) | ( destGreen << 8 ) | destBlue;
+				}
+			}
+
+			destIndex++;
+
+			// Change the position in the sprite frame for changing X in the display
+			u += dUdX;
+			v += dVdX;
+		}
+
+		// Work out the change in the sprite frame for changing Y in the display
+		rowU += dUdY;
+		rowV += dVdY;
+		// Next row
+		destIndex += nextRow;
+	}
+
+}
+
+
+void PlayBlitter::BlitTinted( const PixelData& srcPixelData, int blitX, int blitY, Pixel tint )
+{
+	PLAY_ASSERT_MSG( m_pRenderTarget, "Render target not set for PlayBlitter" );
+
+	blitX -= m_cameraX;
+	blitY -= m_cameraY;
+
+	int left = std::max( blitX, m_clipRect.x );
+	int top = std::max( blitY, m_clipRect.y );
+	int right = std::min( blitX + srcPixelData.width, m_clipRect.x + m_clipRect.width );
+	int bottom = std::min( blitY + srcPixelData.height, m_clipRect.y + m_clipRect.height );
+
+	for( int y = top; y < bottom; y++ )
+	{
+		const Pixel* pSrc = srcPixelData.Row( y - blitY ) + ( left - blitX );
+		Pixel* pDestRow = Is565() ? nullptr : m_pRenderTarget->Row( y );
+
+		for( int x = left; x < right; x++, pSrc++ )
+		{
+			if( pSrc->a == 0x00 )
+				continue;
+
+			// Apply the tint using the same exact divide by 255 as BlendPixel
+			int red = pSrc->r * tint.r;
+			int green = pSrc->g * tint.g;
+			int blue = pSrc->b * tint.b;
+			Pixel pix( pSrc->a, ( red + 1 + ( red >> 8 ) ) >> 8, ( green + 1 + ( green >> 8 ) ) >> 8, ( blue + 1 + ( blue >> 8 ) ) >> 8 );
+
+			if( !pDestRow )
+				BlendPixel565( x, y, pix );
+			else
+				pDestRow[x] = ( pix.a == 0xFF ) ? pix.bits : BlendPixel( pDestRow[x].bits, pix );
+		}
+	}
+}
+
+void PlayBlitter::ClearRenderTarget( Pixel colour )
+{
+	if( Is565() )
+	{
+		// 16-bit render targets have no alpha, so the clear colour is always opaque (and dithered)
+		for( int y = m_clipRect.y; y < m_clipRect.y + m_clipRect.height && m_clipRect.width > 0; y++ )
+			FillPixels565( m_clipRect.x, m_clipRect.x + m_clipRect.width - 1, y, Pixel( colour.bits | 0xFF000000 ) );
+	}
+	else if( m_clipRect.width == m_pRenderTarget->width && m_clipRect.height == m_pRenderTarget->height && m_pRenderTarget->Stride() == m_pRenderTarget->width )
+	{
+		Pixel* pBuffEnd = m_pRenderTarget->pPixels + ( m_pRenderTarget->width * m_pRenderTarget->height );
+		for( Pixel* pBuff = m_pRenderTarget->pPixels; pBuff < pBuffEnd; *pBuff++ = colour.bits );
+	}
+	else
+	{
+		// Only clear the rows and columns inside the clipping rectangle
+		for( int y = m_clipRect.y; y < m_clipRect.y + m_clipRect.height; y++ )
+		{
+			Pixel* pBuff = m_pRenderTarget->Row( y ) + m_clipRect.x;
+			Pixel* pRowEnd = pBuff + m_clipRect.width;
+			for( ; pBuff < pRowEnd; *pBuff++ = colour.bits );
+		}
+	}
+	m_pRenderTarget->preMultiplied = false;
+}
+
+//********************************************************************************************************************************
+// Function:	BlitBackground - copies (or blends) a background into the clipping rectangle
+// Parameters:	backgroundImage = the background, scrollX, scrollY = the position in the background at the render target's top left
+//				scale = the size of a background pixel on the render target
+// Notes:		The background is used where it is (as a strided view) with no intermediate copies. Positions outside the
+//				background wrap around, so each row is copied in as many pieces as it takes to cross the clipping rectangle.
+//				Scaled backgrounds are sampled a row at a time using a table of the background column for each render target
+//				column, and the sampled rows are copied or blended in the same way.
+//				Opaque backgrounds can be in either pixel format. Rows are copied as they are when the formats match, and
+//				32-bit rows are dithered as they are copied to a 16-bit render target.
+//********************************************************************************************************************************
+void PlayBlitter::BlitBackground( const PixelData& backgroundImage, int scrollX, int scrollY, float scale )
+{
+	PLAY_ASSERT_MSG( m_pRenderTarget, "Render target not set for PlayBlitter" );
+	PLAY_ASSERT_MSG( backgroundImage.format == PIXEL_FORMAT_ARGB || ( Is565() && !backgroundImage.preMultiplied ), "16-bit backgrounds can only be drawn to a 16-bit render target" );
+
+	int width = backgroundImage.width;
+	int height = backgroundImage.height;
+	bool sameFormat = backgroundImage.format == m_pRenderTarget->format;
+
+	if( scale != 1.0f )
+	{
+		// The step through the background for each render target pixel in 16.16 fixed point
+		int step = static_cast<int>( 65536.0f / scale );
+
+		m_vBackgroundColumns.resize( m_clipRect.width );
+		for( int x = 0; x < m_clipRect.width; x++ )
+			m_vBackgroundColumns[x] = ( ( ( ( ( m_clipRect.x + x ) * step ) >> 16 ) + scrollX ) % width + width ) % width;
+
+		m_vBackgroundRow.resize( m_clipRect.width );
+		PixelData row;
+		row.width = m_clipRect.width;
+		row.height = 1;
+		row.pPixels = m_vBackgroundRow.data();
+		row.preMultiplied = backgroundImage.preMultiplied;
+
+		for( int y = m_clipRect.y; y < m_clipRect.y + m_clipRect.height; y++ )
+		{
+			int sourceY = ( ( ( ( y * step ) >> 16 ) + scrollY ) % height + height ) % height;
+
+			if( Is565() && !backgroundImage.preMultiplied )
+			{
+				uint16_t* pDest565 = m_pRenderTarget->Row565( y ) + m_clipRect.x;
+
+				for( int x = 0; x < m_clipRect.width; x++ )
+				{
+					if( sameFormat )
+						pDest565[x] = backgroundImage.Row565( sourceY )[m_vBackgroundColumns[x]];
+					else
+						pDest565[x] = PackPixel565( backgroundImage.Row( sourceY )[m_vBackgroundColumns[x]].bits, m_clipRect.x + x, y );
+				}
+				continue;
+			}
+
+			const Pixel* pSourceRow = backgroundImage.Row( sourceY );
+			Pixel* pDest = backgroundImage.preMultiplied ? row.pPixels : m_pRenderTarget->Row( y ) + m_clipRect.x;
+
+			for( int x = 0; x < m_clipRect.width; x++ )
+				pDest[x] = pSourceRow[m_vBackgroundColumns[x]];
+
+			// BlitPixels applies the camera offset, which backgrounds scroll by separately, so it is added back on here
+			if( backgroundImage.preMultiplied )
+				BlitPixels( row, 0, m_clipRect.x + m_cameraX, y + m_cameraY, row.width, 1, 1.0f );
+		}
+		return;
+	}
+
+	// Work out where the top left of the clipping rectangle is in the (repeating) background
+	int startX = ( ( m_clipRect.x + scrollX ) % width + width ) % width;
+	int startY = ( ( m_clipRect.y + scrollY ) % height + height ) % height;
+
+	if( backgroundImage.preMultiplied )
+	{
+		// Blend each repeat of the background which overlaps the clipping rectangle
+		// > BlitPixels applies the camera offset, which backgrounds scroll by separately, so it is added back on here
+		for( int y = m_clipRect.y - startY; y < m_clipRect.y + m_clipRect.height; y += height )
+		{
+			for( int x = m_clipRect.x - startX; x < m_clipRect.x + m_clipRect.width; x += width )
+				BlitPixels( backgroundImage, 0, x + m_cameraX, y + m_cameraY, width, height, 1.0f );
+		}
+		return;
+	}
+
+	bool fullWidth = m_clipRect.x == 0 && m_clipRect.width == m_pRenderTarget->width;
+	bool tightlyPacked = m_pRenderTarget->Stride() == m_pRenderTarget->width && backgroundImage.Stride() == width;
+	int bytesPerPixel = m_pRenderTarget->BytesPerPixel();
+
+	if( sameFormat && fullWidth && tightlyPacked && startX == 0 && width == m_clipRect.width && startY + m_clipRect.height <= height )
+	{
+		// The whole clipping rectangle is one block of memory in both images
+		// Takes about 1ms for 720p screen on i7-8550U (and half that for 16-bit pixels)
+		memcpy( m_pRenderTarget->RowBytes( m_clipRect.y ), backgroundImage.RowBytes( startY ), static_cast<size_t>( bytesPerPixel ) * width * m_clipRect.height );
+		return;
+	}
+
+	int sourceY = startY;
+	for( int y = m_clipRect.y; y < m_clipRect.y + m_clipRect.height; y++ )
+	{
+		int destX = m_clipRect.x;
+		int sourceX = startX;
+
+		for( int remaining = m_clipRect.width; remaining > 0; )
+		{
+			int count = std::min( remaining, width - sourceX );
+
+			if( sameFormat )
+			{
+				memcpy( m_pRenderTarget->RowBytes( y ) + ( static_cast<size_t>( destX ) * bytesPerPixel ), backgroundImage.RowBytes( sourceY ) + ( static_cast<size_t>( sourceX ) * bytesPerPixel ), static_cast<size_t>( bytesPerPixel ) * count );
+			}
+			else
+			{
+				const Pixel* pSource = backgroundImage.Row( sourceY ) + sourceX;
+				uint16_t* pDest565 = m_pRenderTarget->Row565( y ) + destX;
+				for( int i = 0; i < count; i++ )
+					pDest565[i] = PackPixel565( pSource[i].bits, destX + i, y );
+			}
+
+			destX += count;
+			remaining -= count;
+			sourceX = 0;
+		}
+
+		if( ++sourceY == height )
+			sourceY = 0;
+	}
+}
+
+
+//********************************************************************************************************************************
+// File:		PlayGraphics.cpp
+// Description:	Manages 2D graphics operations on a PixelData buffer 
+// Platform:	Independent
+// Notes:		Uses PNG format. The end of the filename indicates the number of frames e.g. "bat_4.png" or "tiles_10x10.png"
+//********************************************************************************************************************************
+
+
+PlayGraphics* PlayGraphics::s_pInstance = nullptr;
+
+//********************************************************************************************************************************
+// Constructor / Destructor (Private)
+//********************************************************************************************************************************
+
+PlayGraphics::PlayGraphics( int bufferWidth, int bufferHeight, const char* path )
+{
+	// A working buffer for our display. Each pixel is stored as an unsigned 32-bit integer: alpha<<24 | red<<16 | green<<8 | blue
+	AllocateAlignedPixels( m_playBuffer, bufferWidth, bufferHeight );
+	m_playBuffer.preMultiplied = false;
+
+	// Make the display buffer the render target for the blitter
+	m_blitter.SetRenderTarget( &m_playBuffer );
+
+	// Iterate through the directory
+	std::string directory = PlayWindow::FindFile( path );
+	PLAY_ASSERT_MSG( std::filesystem::exists( directory ), "PlayBuffer: Drectory provided does not exist." );
+
+	for( const auto& p : std::filesystem::directory_iterator( directory ) )
+	{
+		// Switch everything to uppercase to avoid need to check case each time
+		std::string filename = p.path().string();
+		for( char& c : filename ) c = static_cast<char>( toupper( c ) );
+
+		// Only attempt to load PNG files
+		if( filename.find( ".PNG" ) != std::string::npos )
+		{
+			std::ifstream png_infile;
+			png_infile.open( PlayWindow::FindFile( filename ), std::ios::binary ); // Don't do this as part of the constructor or we lose 16 bytes!
+
+			// If the PNG was opened okay
+			if( png_infile )
+			{
+				int spriteId = LoadSpriteSheet( p.path().parent_path().string() + "\\", p.path().stem().string() );
+
+				// Now we check for .inf file for each sprite and load origins
+				int originX = 0, originY = 0;
+
+				std::string info_filename = PlayWindow::FindFile( filename.replace( filename.find( ".PNG" ), 4, ".INF" ) );
+
+				if( std::filesystem::exists( info_filename ) )
+				{
+					std::ifstream info_infile;
+					info_infile.open( info_filename, std::ios::in );
+
+					PLAY_ASSERT_MSG( info_infile.is_open(), std::string( "Unable to load existing .inf file: " + info_filename ).c_str() );
+					if( info_infile.is_open() )
+					{
+						std::string type;
+						info_infile >> type;
+						info_infile >> originX;
+						info_infile >> originY;
+					}
+
+					info_infile.close();
+				}
+
+				if( spriteId != -1 )
+					SetSpriteOrigin( spriteId, { originX, originY } );
+			}
+
+			png_infile.close();
+		}
+	}
+
+	ReportSharedFrames();
+}
+
+PlayGraphics::~PlayGraphics()
+{
+	for( Sprite& s : vSpriteData )
+	{
+		if( s.canvasBuffer.pPixels )
+			delete[] s.canvasBuffer.pPixels;
+
+		if( s.preMultAlpha.pPixels )
+			FreeAlignedPixels( s.preMultAlpha );
+
+		if( s.tintedFrames.pPixels )
+			FreeAlignedPixels( s.tintedFrames );
+	}
+
+	for( PixelData& pBgBuffer : vBackgroundData )
+		FreeAlignedPixels( pBgBuffer );
+
+	for( PixelData& pBgBuffer : vBackground565 )
+	{
+		if( pBgBuffer.pPixels )
+			FreeAlignedPixels( pBgBuffer );
+	}
+
+	ClearTextLayouts();
+
+	for( DecodedFrame& frame : m_vDecodedFrames )
+	{
+		if( frame.pixels.pPixels )
+			FreeAlignedPixels( frame.pixels );
+	}
+
+	if( m_scaledBuffer.pPixels )
+		FreeAlignedPixels( m_scaledBuffer );
+
+	if( m_display565.pPixels )
+		FreeAlignedPixels( m_display565 );
+
+	StopWorkers();
+
+	if( m_postBuffer.pPixels )
+		FreeAlignedPixels( m_postBuffer );
+
+	if( m_bloomBuffer.pPixels )
+	{
+		FreeAlignedPixels( m_bloomBuffer );
+		FreeAlignedPixels( m_bloomTemp );
+	}
+
+	FreeAlignedPixels( m_playBuffer );
+}
+
+//********************************************************************************************************************************
+// Instance functions
+//********************************************************************************************************************************
+
+PlayGraphics& PlayGraphics::Instance()
+{
+	PLAY_ASSERT_MSG( s_pInstance, "Trying to use PlayGraphics without initialising it!" );
+	return *s_pInstance;
+}
+
+PlayGraphics& PlayGraphics::Instance( int bufferWidth, int bufferHeight, const char* path )
+{
+	PLAY_ASSERT_MSG( !s_pInstance, "Trying to create multiple instances of singleton class!" );
+	s_pInstance = new PlayGraphics( bufferWidth, bufferHeight, path );
+	return *s_pInstance;
+}
+
+void PlayGraphics::Destroy()
+{
+	PLAY_ASSERT_MSG( s_pInstance, "Trying to use destroy PlayGraphics when it hasn't been instanced!" );
+	delete s_pInstance;
+	s_pInstance = nullptr;
+}
+
+//********************************************************************************************************************************
+// Loading functions
+//********************************************************************************************************************************
+
+int PlayGraphics::LoadSpriteSheet( const std::string& path, const std::string& filename )
+{
+	PixelData canvasBuffer;
+	std::string spriteName = filename;
+	int hCount = 1;
+	int vCount = 1;
+
+	// Switch everything to uppercase to avoid need to check case each time
+	for( char& c : spriteName ) c = static_cast<char>( toupper( c ) );
+
+	// Look for the final number in the filename to pull out the number of frames across the width
+	size_t frameWidthEnd = spriteName.find_last_of( "0123456789" );
+	size_t frameWidthStart = spriteName.find_last_not_of( "0123456789" );
+
+	if( frameWidthEnd == spriteName.length() - 1 )
+	{
+		// Grab the number of frames
+		std::string widthString = spriteName.substr( frameWidthStart + 1, frameWidthEnd - frameWidthStart );
+
+		// Make sure the number is valid 
+		size_t num = widthString.find_first_of( "0123456789" );
+		PLAY_ASSERT_MSG( num == 0, std::string( "Incorrectly named sprite: " + filename ).c_str() );
+
+		hCount = stoi( widthString );
+
+		if( spriteName[frameWidthStart] == 'X' )
+		{
+			//Two dimensional sprite sheet so the width was actually the height: copy it over and work out the real width
+			vCount = hCount;
+
+			// Cut off the last number we just found plus an "x", then check for another number indicating a frame height (optional)
+			std::string truncated = spriteName.substr( 0, frameWidthStart );
+			frameWidthEnd = truncated.find_last_of( "0123456789" );
+			frameWidthStart = truncated.find_last_not_of( "0123456789" );
+
+			if( frameWidthEnd == truncated.length() - 1 && frameWidthStart != std::string::npos )
+			{
+				// Grab the number of images in the height
+				widthString = truncated.substr( frameWidthStart + 1, frameWidthEnd - frameWidthStart );
+
+				// Make sure the number is valid
+				num = widthString.find_first_of( "0123456789" );
+				PLAY_ASSERT_MSG( num == 0, std::string( "Incorrectly named sprite: " + filename ).c_str() );
+
+				hCount = stoi( widthString );
+			}
+			else
+			{
+				PLAY_ASSERT_MSG( false, std::string( "Incorrectly named sprite: " + filename ).c_str() );
+			}
+		}
+		else
+		{
+			vCount = 1;
+		}
+	}
+
+	std::string fileAndPath( path + spriteName + ".PNG" );
+	// Allocates memory as we don't know the size
+	if( PlayWindow::LoadPNGImage( fileAndPath, canvasBuffer ) != 1 )
+		return -1; // LoadPNGImage has already reported the problem, and no sprite is added
+	
+	return AddSprite( filename, canvasBuffer, hCount, vCount );
+}
+
+int PlayGraphics::AddSprite( const std::string& name, PixelData& pixelData, int hCount, int vCount )
+{
+	// Switch everything to uppercase to avoid need to check case each time
+	std::string spriteName = name;
+	for( char& c : spriteName ) c = static_cast<char>( toupper( c ) );
+
+	Sprite s;
+	s.id = m_nTotalSprites++;
+	s.name = spriteName;
+	s.originX = s.originY = 0;
+	s.hCount = hCount;
+	s.vCount = vCount;
+	s.canvasBuffer = pixelData; // copy including pointer to pixel data
+
+	s.totalCount = s.hCount * s.vCount;
+	s.width = s.canvasBuffer.width / s.hCount;
+	s.height = s.canvasBuffer.height / s.vCount;
+
+	// Create a separate buffer with the pre-multiplyied alpha
+	CreateDrawData( s );
+	CalculateOpaqueRects( s );
+	CalculateCollisionMask( s, { 0, 0, s.canvasBuffer.width, s.canvasBuffer.height } );
+
+	// Add the sprite to our vector
+	vSpriteData.push_back( s );
+
+	// Frames identical to ones already loaded (in this sprite or another) share their pixels
+	DeduplicateFrames( vSpriteData.back() );
+
+	if( m_bSpriteMemorySaving )
+		ReleaseCanvas( vSpriteData.back() );
+
+	return s.id;
+}
+
+int PlayGraphics::UpdateSprite( const std::string& name, PixelData& pixelData, int hCount, int vCount )
+{
+	// Switch everything to uppercase to avoid need to check case each time
+	std::string spriteName = name;
+	for( char& c : spriteName ) c = static_cast<char>( toupper( c ) );
+
+	// Recorded draws need to use the old sprite data
+	FlushDeferredDraws();
+
+	for( Sprite& s : vSpriteData )
+	{
+		if( s.name.find( spriteName ) != std::string::npos )
+		{
+			// delete the old premultiplied buffer
+			ReleaseDrawData( s );
+
+			s.hCount = hCount;
+			s.vCount = vCount;
+			s.canvasBuffer = pixelData; // copy including pointer to pixel data
+
+			s.totalCount = s.hCount * s.vCount;
+			s.width = s.canvasBuffer.width / s.hCount;
+			s.height = s.canvasBuffer.height / s.vCount;
+
+			// Create a new buffer with the pre-multiplyied alpha
+			s.colour = 0x00FFFFFF;
+			CreateDrawData( s );
+			CalculateOpaqueRects( s );
+			CalculateCollisionMask( s, { 0, 0, s.canvasBuffer.width, s.canvasBuffer.height } );
+			DeduplicateFrames( s );
+			ClearTextLayouts( s.id );
+
+			if( m_bSpriteMemorySaving )
+				ReleaseCanvas( s );
+
+			return s.id;
+		}
+	}
+
+	return -1;
+}
+
+int PlayGraphics::CaptureToSprite( PixelData* pRenderTarget, const std::string& name )
+{
+	PLAY_ASSERT_MSG( pRenderTarget && pRenderTarget->pPixels, "Trying to capture an invalid render target" );
+	PLAY_ASSERT_MSG( !pRenderTarget->preMultiplied, "Trying to capture a render target which has already been pre-multiplied" );
+	PLAY_ASSERT_MSG( pRenderTarget->format == PIXEL_FORMAT_ARGB, "Trying to capture a 16-bit render target" );
+
+	// Recorded draws may be to the render target being captured
+	FlushDeferredDraws();
+
+	// Switch everything to uppercase to avoid need to check case each time
+	std::string spriteName = name;
+	for( char& c : spriteName ) c = static_cast<char>( toupper( c ) );
+
+	int width = pRenderTarget->width;
+	int height = pRenderTarget->height;
+
+	for( Sprite& s : vSpriteData )
+	{
+		// Captured sprites are matched exactly so that "PANEL" doesn't overwrite "PANEL_BG"
+		if( s.name == spriteName )
+		{
+			// The pixels are about to change, so nothing can keep sharing them
+			UnshareFrames( s );
+
+			if( s.canvasBuffer.width != width || s.canvasBuffer.height != height )
+			{
+				// The size has changed so the existing buffers can't be re-used
+				delete[] s.canvasBuffer.pPixels;
+				ReleaseDrawData( s );
+
+				s.canvasBuffer.pPixels = new Pixel[static_cast<size_t>( width ) * height];
+				s.canvasBuffer.width = width;
+				s.canvasBuffer.height = height;
+				s.canvasBuffer.stride = 0;
+
+				AllocateAlignedPixels( s.preMultAlpha, width, height );
+			}
+			else
+			{
+				// A sprite which memory saving freed the canvas of (before it was captured over) only needs the canvas back
+				if( !s.canvasBuffer.pPixels )
+				{
+					s.canvasBuffer.pPixels = new Pixel[static_cast<size_t>( width ) * height];
+					s.canvasBuffer.stride = 0;
+					s.vGlyphWidths.clear();
+					s.vGlyphWidths.shrink_to_fit();
+				}
+
+				// Captures change every time, so they are re-encoded as full 32-bit pixels rather than looking for a palette
+				if( s.preMultAlpha.format == PIXEL_FORMAT_INDEXED8 || !s.vCompressed.empty() )
+				{
+					ReleaseDrawData( s );
+					AllocateAlignedPixels( s.preMultAlpha, width, height );
+				}
+			}
+
+			s.hCount = s.vCount = s.totalCount = 1;
+			s.width = width;
+			s.height = height;
+
+			// Encode straight into the existing buffers without any temporary allocations
+			for( int y = 0; y < height; y++ )
+				memcpy( s.canvasBuffer.Row( y ), pRenderTarget->Row( y ), sizeof( Pixel ) * width );
+			PreMultiplyAlpha( s.canvasBuffer, s.preMultAlpha, width, 1.0f, 0x00FFFFFF );
+			s.canvasBuffer.preMultiplied = true;
+			s.colour = 0x00FFFFFF;
+			s.keepCanvas = true;
+			ForgetDecodedFrames( s.id );
+			CalculateOpaqueRects( s );
+			CalculateCollisionMask( s, { 0, 0, width, height } );
+			ClearTextLayouts( s.id );
+
+			return s.id;
+		}
+	}
+
+	// First capture with this name, so the sprite takes ownership of a copy of the render target
+	PixelData canvasBuffer;
+	canvasBuffer.width = width;
+	canvasBuffer.height = height;
+	canvasBuffer.pPixels = new Pixel[static_cast<size_t>( width ) * height];
+	for( int y = 0; y < height; y++ )
+		memcpy( canvasBuffer.Row( y ), pRenderTarget->Row( y ), sizeof( Pixel ) * width );
+
+	// Every capture writes the pixels again, so memory saving leaves the canvas for the next one to re-use
+	bool memorySaving = m_bSpriteMemorySaving;
+	m_bSpriteMemorySaving = false;
+	int spriteId = AddSprite( name, canvasBuffer );
+	m_bSpriteMemorySaving = memorySaving;
+	vSpriteData[spriteId].keepCanvas = true;
+	return spriteId;
+}
+
+void PlayGraphics::UpdateSpriteRegion( int spriteId, PixelRect rect, const Pixel* pSrcPixels )
+{
+	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to update invalid sprite id" );
+	PLAY_ASSERT_MSG( pSrcPixels, "Trying to update a sprite region without any pixel data" );
+
+	Sprite& s = vSpriteData[spriteId];
+	PixelData& canvas = s.canvasBuffer;
+	PixelData& dest = s.preMultAlpha;
+
+	PLAY_ASSERT_MSG( rect.x >= 0 && rect.y >= 0 && rect.x + rect.width <= canvas.width && rect.y + rect.height <= canvas.height, "Sprite region is outside the sprite canvas" );
+	if( rect.width <= 0 || rect.height <= 0 || rect.x < 0 || rect.y < 0 || rect.x + rect.width > canvas.width || rect.y + rect.height > canvas.height )
+		return;
+
+	// Recorded draws need to use the old sprite data
+	FlushDeferredDraws();
+
+	// Sprites which are updated keep their canvas from then on
+	if( !canvas.pPixels )
+		RestoreCanvas( s );
+	s.keepCanvas = true;
+
+	// The pixels are about to change, so nothing can keep sharing them
+	UnshareFrames( s );
+
+	// The new pixels may not be in the palette, and compressed runs can't be updated in place
+	if( dest.format == PIXEL_FORMAT_INDEXED8 || !s.vCompressed.empty() )
+		ExpandDrawData( s );
+
+	for( int y = rect.y; y < rect.y + rect.height; y++ )
+	{
+		Pixel* pCanvasRow = canvas.Row( y );
+		uint32_t* pDestRow = &dest.Row( y )->bits;
+
+		memcpy( pCanvasRow + rect.x, pSrcPixels, sizeof( Pixel ) * rect.width );
+		pSrcPixels += rect.width;
+
+		// Work from right to left so each transparent pixel's skip value can be worked out from its neighbour
+		// > Skips never cross the edge of a frame, so a pixel at the end of a frame column never has a skip value
+		for( int x = rect.x + rect.width - 1; x >= rect.x; x-- )
+		{
+			uint32_t pix = PreMultiplyPixel( pCanvasRow[x], 1.0f, s.colour );
+
+			if( pix >> 24 == 0xFF ) // Completely transparent pixel
+			{
+				bool endOfFrame = ( x + 1 ) % s.width == 0;
+				pix = 0xFF000000;
+				if( !endOfFrame && pDestRow[x + 1] >> 24 == 0xFF )
+					pix += ( pDestRow[x + 1] & 0x00FFFFFF ) + 1;
+			}
+
+			pDestRow[x] = pix;
+		}
+
+		// Transparent pixels to the left of the region may skip into it, so their skip values need fixing up
+		// > This stops as soon as a pixel's skip value is unchanged as everything to its left will be unchanged too
+		for( int x = rect.x - 1; x >= 0 && ( x + 1 ) % s.width != 0 && pDestRow[x] >> 24 == 0xFF; x-- )
+		{
+			uint32_t pix = 0xFF000000;
+			if( pDestRow[x + 1] >> 24 == 0xFF )
+				pix += ( pDestRow[x + 1] & 0x00FFFFFF ) + 1;
+
+			if( pDestRow[x] == pix )
+				break;
+
+			pDestRow[x] = pix;
+		}
+	}
+
+	// Only the frames which overlap the region can have changed shape
+	for( int frameY = rect.y / s.height; frameY <= ( rect.y + rect.height - 1 ) / s.height && frameY < s.vCount; frameY++ )
+	{
+		for( int frameX = rect.x / s.width; frameX <= ( rect.x + rect.width - 1 ) / s.width && frameX < s.hCount; frameX++ )
+			CalculateOpaqueRect( s, frameX + ( frameY * s.hCount ) );
+	}
+	CalculateCollisionMask( s, rect );
+	ClearTextLayouts( spriteId );
+}
+
+void PlayGraphics::CopySpriteFrame( int spriteId, int frameIndex, PixelData& dest, int destX, int destY ) const
+{
+	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to copy invalid sprite id" );
+
+	const Sprite& spr = vSpriteData[spriteId];
+	frameIndex = frameIndex % spr.totalCount;
+
+	int frameX = ( frameIndex % spr.hCount ) * spr.width;
+	int frameY = ( frameIndex / spr.hCount ) * spr.height;
+
+	int left = std::max( 0, -destX );
+	int top = std::max( 0, -destY );
+	int right = std::min( spr.width, dest.width - destX );
+	int bottom = std::min( spr.height, dest.height - destY );
+
+	// Sprites without a canvas have the frame unpacked from their drawing data first
+	PixelData source;
+	if( spr.canvasBuffer.pPixels )
+	{
+		source = spr.canvasBuffer.View( { frameX, frameY, spr.width, spr.height } );
+	}
+	else
+	{
+		m_vFramePixels.resize( static_cast<size_t>( spr.width ) * spr.height );
+		source.width = spr.width;
+		source.height = spr.height;
+		source.pPixels = m_vFramePixels.data();
+		UnpackFrame( spr, frameIndex, source );
+	}
+
+	for( int y = top; y < bottom; y++ )
+		memcpy( dest.Row( destY + y ) + destX + left, source.Row( y ) + left, sizeof( Pixel ) * ( right - left ) );
+}
+
+void PlayGraphics::CopySpriteFrameDrawData( int spriteId, int frameIndex, PixelData& dest, int destX, int destY ) const
+{
+	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to copy invalid sprite id" );
+
+	const Sprite& spr = vSpriteData[spriteId];
+	frameIndex = frameIndex % spr.totalCount;
+
+	int left = std::max( 0, -destX );
+	int top = std::max( 0, -destY );
+	int right = std::min( spr.width, dest.width - destX );
+	int bottom = std::min( spr.height, dest.height - destY );
+
+	// The same data Draw uses, so compressed, indexed and tinted frames all come out as they are drawn
+	int frameOffset = 0;
+	const PixelData& source = GetFrameDrawData( spr, frameIndex, frameOffset );
+
+	for( int y = top; y < bottom; y++ )
+	{
+		Pixel* pDest = dest.Row( destY + y ) + destX;
+		for( int x = left; x < right; x++ )
+			pDest[x].bits = GetStoredPixel( source, frameOffset, x, y );
+	}
+}
+
+int PlayGraphics::LoadBackground( const char* fileAndPath )
+{
+	PixelData backgroundImage;
+	PixelData background;
+
+	std::string pngFile( fileAndPath );
+	PLAY_ASSERT_MSG( std::filesystem::exists( PlayWindow::FindFile( pngFile ) ), "The background png does not exist at the given location." );
+	PlayWindow::LoadPNGImage( pngFile, backgroundImage ); // Allocates memory in function as we don't know the size
+
+	// Backgrounds are kept whole (so larger ones can scroll) and copied into rows aligned like the display buffer
+	AllocateAlignedPixels( background, backgroundImage.width, backgroundImage.height );
+
+	bool transparent = false;
+	for( int h = 0; h < backgroundImage.height; h++ )
+	{
+		memcpy( background.Row( h ), backgroundImage.Row( h ), sizeof( Pixel ) * backgroundImage.width );
+
+		for( int w = 0; w < backgroundImage.width && !transparent; w++ )
+			transparent = backgroundImage.Row( h )[w].a != 0xFF;
+	}
+
+	// Free up the loading buffer
+	delete[] backgroundImage.pPixels;
+
+	// Backgrounds with transparency (e.g. parallax layers) are blended like sprites
+	if( transparent )
+	{
+		PreMultiplyAlpha( background, background, background.width, 1.0f, 0x00FFFFFF );
+		background.preMultiplied = true;
+	}
+
+	vBackgroundData.push_back( background );
+
+	return static_cast<int>( vBackgroundData.size() ) - 1;
+}
+
+
+//********************************************************************************************************************************
+// Sprite Getters and Setters
+//********************************************************************************************************************************
+int PlayGraphics::GetSpriteId( const char* name ) const
+{
+	// New sprites are always added after existing ones, so a remembered match is still the first match
+	auto found = m_spriteIds.find( name );
+	if( found != m_spriteIds.end() )
+		return found->second;
+
+	std::string tofind( name );
+	for( char& c : tofind ) c = static_cast<char>( toupper( c ) );
+
+	for( const Sprite& s : vSpriteData )
+	{
+		if( s.name.find( tofind ) != std::string::npos )
+		{
+			m_spriteIds[name] = s.id;
+			return s.id;
+		}
+	}
+	PLAY_ASSERT_MSG( false, "The sprite name is invalid!" );
+	return -1;
+}
+
+const std::string& PlayGraphics::GetSpriteName( int spriteId )
+{
+	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to get name of invalid sprite id" );
+	return vSpriteData[spriteId].name;
+}
+
+Vector2f PlayGraphics::GetSpriteSize( int spriteId ) const
+{
+	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to get width of invalid sprite id" );
+	return { vSpriteData[spriteId].width, vSpriteData[spriteId].height };
+}
+
+int PlayGraphics::GetSpriteFrames( int spriteId ) const
+{
+	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to get frames of invalid sprite id" );
+	return vSpriteData[spriteId].totalCount;
+}
+
+Vector2f PlayGraphics::GetSpriteOrigin( int spriteId ) const
+{
+	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to get origin with invalid sprite id" );
+	return { vSpriteData[spriteId].originX, vSpriteData[spriteId].originY };
+}
+
+void PlayGraphics::SetSpriteOrigin( int spriteId, Vector2f newOrigin, bool relative )
+{
+	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to set origin with invalid sprite id" );
+	if( relative )
+	{
+		vSpriteData[spriteId].originX += static_cast<int>( newOrigin.x );
+		vSpriteData[spriteId].originY += static_cast<int>( newOrigin.y );
+	}
+	else
+	{
+		vSpriteData[spriteId].originX = static_cast<int>( newOrigin.x );
+		vSpriteData[spriteId].originY = static_cast<int>( newOrigin.y );
+	}
+}
+
+void PlayGraphics::CentreSpriteOrigin( int spriteId )
+{
+	SetSpriteOrigin( spriteId, GetSpriteSize( spriteId ) / 2 );
+}
+
+void PlayGraphics::CentreAllSpriteOrigins( void )
+{
+	for( Sprite& s : vSpriteData )
+		CentreSpriteOrigin( s.id );
+}
+
+void PlayGraphics::SetSpriteOrigins( const char* rootName, Vector2f newOrigin, bool relative )
+{
+	std::string tofind( rootName );
+	for( char& c : tofind ) c = static_cast<char>( toupper( c ) );
+
+	for( Sprite& s : vSpriteData )
+	{
+		if( s.name.find( tofind ) != std::string::npos )
+		{
+			if( relative )
+			{
+				s.originX += static_cast<int>( newOrigin.x );
+				s.originY += static_cast<int>( newOrigin.y );
+			}
+			else
+			{
+				s.originX = static_cast<int>( newOrigin.x );
+				s.originY = static_cast<int>( newOrigin.y );
+			}
+		}
+	}
+}
+
+//********************************************************************************************************************************
+// Drawing functions
+//********************************************************************************************************************************
+
+void PlayGraphics::DrawTransparent( int spriteId, Point2f pos, int frameIndex, float alphaMultiply ) const
+{
+	// Sprites drawn at a reduced resolution need scaling (which DrawRotated does without rotating them)
+	if( m_drawScale != 1.0f )
+	{
+		DrawRotated( spriteId, pos, frameIndex, 0.0f, 1.0f, alphaMultiply );
+		return;
+	}
+
+	// Rounded down after adding a half (like the shapes) so sprites partly off the top left of the target stay in place
+	const Sprite& spr = vSpriteData[spriteId];
+	int destx = static_cast<int>( std::floor( pos.x + 0.5f ) ) - spr.originX;
+	int desty = static_cast<int>( std::floor( pos.y + 0.5f ) ) - spr.originY;
+	frameIndex = frameIndex % spr.totalCount;
+
+	if( m_bDeferredDraw )
+	{
+		DeferredDraw d;
+		d.id = spriteId;
+		d.pos = pos;
+		d.frameIndex = frameIndex;
+		d.alphaMultiply = alphaMultiply;
+		d.bounds = { destx - m_blitter.GetCameraOffsetX(), desty - m_blitter.GetCameraOffsetY(), spr.width, spr.height };
+		m_vDeferredDraws.push_back( d );
+		return;
+	}
+
+	int frameOffset = 0;
+	const PixelData& frameData = GetFrameDrawData( spr, frameIndex, frameOffset );
+
+	m_blitter.BlitPixels( frameData, frameOffset, destx, desty, spr.width, spr.height, alphaMultiply );
+};
+
+void PlayGraphics::DrawRotated( int spriteId, Point2f pos, int frameIndex, float angle, float scale, float alphaMultiply ) const
+{
+	const Sprite& spr = vSpriteData[spriteId];
+	Point2f targetPos = ToRenderTarget( pos );
+	int destx = static_cast<int>( std::floor( targetPos.x + 0.5f ) );
+	int desty = static_cast<int>( std::floor( targetPos.y + 0.5f ) );
+	float targetScale = scale * m_drawScale;
+	frameIndex = frameIndex % spr.totalCount;
+
+	if( m_bDeferredDraw )
+	{
+		// Any rotation fits within a circle around the origin which reaches the furthest corner
+		float cornerX = static_cast<float>( std::max( spr.originX, spr.width - spr.originX ) );
+		float cornerY = static_cast<float>( std::max( spr.originY, spr.height - spr.originY ) );
+		int radius = static_cast<int>( sqrt( cornerX * cornerX + cornerY * cornerY ) * targetScale ) + 2;
+
+		DeferredDraw d;
+		d.id = spriteId;
+		d.pos = pos;
+		d.frameIndex = frameIndex;
+		d.angle = angle;
+		d.scale = scale;
+		d.alphaMultiply = alphaMultiply;
+		d.rotated = true;
+		d.bounds = { destx - radius - m_blitter.GetCameraOffsetX(), desty - radius - m_blitter.GetCameraOffsetY(), radius * 2, radius * 2 };
+		m_vDeferredDraws.push_back( d );
+		return;
+	}
+
+	int frameOffset = 0;
+	const PixelData& frameData = GetFrameDrawData( spr, frameIndex, frameOffset );
+
+	// Unrotated sprites only need scaling, which is much faster
+	if( angle == 0.0f )
+		m_blitter.ScalePixels( frameData, frameOffset, destx, desty, spr.width, spr.height, spr.originX, spr.originY, targetScale, alphaMultiply );
+	else
+		m_blitter.RotateScalePixels( frameData, frameOffset, destx, desty, spr.width, spr.height, spr.originX, spr.originY, angle, targetScale, alphaMultiply );
+}
+
+
+void PlayGraphics::DrawBackground( int backgroundId, Vector2f scrollFactor )
+{
+	PLAY_ASSERT_MSG( m_playBuffer.pPixels, "Trying to draw background without initialising display!" );
+	PLAY_ASSERT_MSG( vBackgroundData.size() > static_cast<size_t>(backgroundId), "Background image out of range!" );
+
+	if( m_bDeferredDraw )
+	{
+		DeferredDraw d;
+		d.id = backgroundId;
+		d.background = true;
+		d.scrollFactor = scrollFactor;
+		d.bounds = m_blitter.GetClipRect(); // Backgrounds repeat, so they always cover the clipping rectangle
+		m_vDeferredDraws.push_back( d );
+		return;
+	}
+
+	int scrollX = static_cast<int>( floor( ( m_cameraPos.x * scrollFactor.x ) + 0.5f ) );
+	int scrollY = static_cast<int>( floor( ( m_cameraPos.y * scrollFactor.y ) + 0.5f ) );
+	m_blitter.BlitBackground( GetBackgroundForTarget( backgroundId ), scrollX, scrollY, m_drawScale );
+}
+
+const PixelData& PlayGraphics::GetBackgroundForTarget( int backgroundId )
+{
+	const PixelData& background = vBackgroundData[backgroundId];
+
+	// Transparent backgrounds are blended like sprites, so they stay in the sprite format
+	if( m_blitter.GetRenderTarget()->format != PIXEL_FORMAT_RGB565 || background.preMultiplied )
+		return background;
+
+	if( vBackground565.size() < vBackgroundData.size() )
+		vBackground565.resize( vBackgroundData.size() );
+
+	PixelData& background565 = vBackground565[backgroundId];
+	if( !background565.pPixels )
+	{
+		AllocateAlignedPixels( background565, background.width, background.height, PIXEL_FORMAT_RGB565 );
+		for( int y = 0; y < background.height; y++ )
+		{
+			for( int x = 0; x < background.width; x++ )
+				background565.Row565( y )[x] = PlayBlitter::PackPixel565( background.Row( y )[x].bits, x, y );
+		}
+	}
+
+	return background565;
+}
+
+void PlayGraphics::SetCameraPosition( Point2f pos )
+{
+	// Recorded draws need to use the camera position they were drawn with
+	FlushDeferredDraws();
+
+	m_cameraPos = pos;
+	UpdateViewTransform();
+}
+
+PixelData* PlayGraphics::SetRenderTarget( PixelData* renderTarget )
+{
+	FlushDeferredDraws();
+
+	// The display is drawn to through the smaller (or 16-bit) buffer while the resolution is scaled (or the display format is 16-bit)
+	if( renderTarget == &m_playBuffer )
+		renderTarget = GetDisplayTarget();
+
+	PixelData* old = m_blitter.SetRenderTarget( renderTarget );
+	UpdateViewTransform();
+	return old;
+}
+
+void PlayGraphics::PushClipRect( PixelRect rect )
+{
+	FlushDeferredDraws();
+	m_vClipRects.push_back( rect );
+	m_blitter.PushClipRect( ToRenderTarget( rect ) );
+}
+
+void PlayGraphics::PopClipRect()
+{
+	FlushDeferredDraws();
+	if( !m_vClipRects.empty() )
+		m_vClipRects.pop_back();
+	m_blitter.PopClipRect();
+}
+
+PixelRect PlayGraphics::GetClipRect() const
+{
+	PixelRect clip = m_blitter.GetClipRect();
+	if( m_drawScale == 1.0f )
+		return clip;
+
+	// Rounded outwards so the rectangle covers every display pixel which could be drawn to
+	int left = static_cast<int>( floor( clip.x / m_drawScale ) );
+	int top = static_cast<int>( floor( clip.y / m_drawScale ) );
+	int right = static_cast<int>( ceil( ( clip.x + clip.width ) / m_drawScale ) );
+	int bottom = static_cast<int>( ceil( ( clip.y + clip.height ) / m_drawScale ) );
+	return { left, top, right - left, bottom - top };
+}
+
+PixelRect PlayGraphics::ToRenderTarget( PixelRect rect ) const
+{
+	if( m_drawScale == 1.0f )
+		return rect;
+
+	int left = static_cast<int>( floor( ( rect.x * m_drawScale ) + 0.5f ) );
+	int top = static_cast<int>( floor( ( rect.y * m_drawScale ) + 0.5f ) );
+	int right = static_cast<int>( floor( ( ( rect.x + rect.width ) * m_drawScale ) + 0.5f ) );
+	int bottom = static_cast<int>( floor( ( ( rect.y + rect.height ) * m_drawScale ) + 0.5f ) );
+	return { left, top, right - left, bottom - top };
+}
+
+void PlayGraphics::UpdateViewTransform()
+{
+	PixelData* pRenderTarget = m_blitter.GetRenderTarget();
+	float drawScale = ( pRenderTarget == &m_scaledBuffer || pRenderTarget == &m_display565 ) ? m_resolutionScale : 1.0f;
+
+	if( drawScale != m_drawScale )
+	{
+		m_drawScale = drawScale;
+
+		// The blitter's clipping rectangles are rebuilt from the display co-ordinate ones at the new scale
+		for( size_t i = 0; i < m_vClipRects.size(); i++ )
+			m_blitter.PopClipRect();
+		for( const PixelRect& rect : m_vClipRects )
+			m_blitter.PushClipRect( ToRenderTarget( rect ) );
+	}
+
+	Point2f cameraOffset = ToRenderTarget( m_cameraPos );
+	m_blitter.SetCameraOffset( static_cast<int>( floor( cameraOffset.x + 0.5f ) ), static_cast<int>( floor( cameraOffset.y + 0.5f ) ) );
+}
+
+void PlayGraphics::ColourSprite( int spriteId, int r, int g, int b )
+{
+	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to colour invalid sprite id" );
+
+	// Recorded draws of this sprite need to use the old colour
+	FlushDeferredDraws();
+
+	// Sprites sharing frames with this one need to keep their own colour
+	Sprite& s = vSpriteData[spriteId];
+	UnshareFrames( s );
+
+	uint32_t col = ( ( r & 0xFF ) << 16 ) | ( ( g & 0xFF ) << 8 ) | ( b & 0xFF );
+	s.colour = col;
+
+	// Indexed sprites only need their palette changing
+	if( s.preMultAlpha.format == PIXEL_FORMAT_INDEXED8 )
+	{
+		PreMultiplyPalette( s );
+		return;
+	}
+
+	// Sprites without a canvas keep their drawing data uncoloured and are tinted as their frames are drawn
+	if( !s.canvasBuffer.pPixels )
+	{
+		ForgetDecodedFrames( spriteId );
+		return;
+	}
+
+	// Compressed sprites are re-encoded from the canvas in the new colour
+	if( !s.vCompressed.empty() )
+	{
+		CompressDrawData( s );
+		return;
+	}
+
+	PreMultiplyAlpha( s.canvasBuffer, s.preMultAlpha, s.width, 1.0f, col );
+	s.canvasBuffer.preMultiplied = true;
+}
+
+//********************************************************************************************************************************
+// Brush stroke functions
+//********************************************************************************************************************************
+
+void PlayGraphics::DrawBrushLine( int spriteId, Point2f startPos, Point2f endPos, Pixel colour )
+{
+	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to draw a brush line with an invalid sprite id" );
+
+	startPos = ToRenderTarget( startPos );
+	endPos = ToRenderTarget( endPos );
+
+	// Rounded down so lines which start or end off the top left of the target keep their shape
+	int x1 = static_cast<int>( std::floor( startPos.x ) );
+	int y1 = static_cast<int>( std::floor( startPos.y ) );
+	int x2 = static_cast<int>( std::floor( endPos.x ) );
+	int y2 = static_cast<int>( std::floor( endPos.y ) );
+
+	//Implementation of Bresenham's Line Drawing Algorithm
+	int dx = abs( x2 - x1 );
+	int sx = ( x2 < x1 ) ? -1 : 1;
+	int dy = -abs( y2 - y1 );
+	int sy = ( y2 < y1 ) ? -1 : 1;
+	int err = dx + dy;
+
+	if( dx == 0 && dy == 0 )
+		return;
+
+	m_vBrushStamps.clear();
+
+	while( true )
+	{
+		m_vBrushStamps.push_back( { x1, y1 } );
+
+		if( x1 == x2 && y1 == y2 )
+			break;
+
+		int e2 = 2 * err;
+		if( e2 >= dy )
+		{
+			err += dy;
+			x1 += sx;
+		}
+		if( e2 <= dx )
+		{
+			err += dx;
+			y1 += sy;
+		}
+	}
+
+	DrawBrushStroke( spriteId, m_vBrushStamps, colour );
+}
+
+void PlayGraphics::DrawBrushCircle( int spriteId, Point2f centrePos, int radius, Pixel colour )
+{
+	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to draw a brush circle with an invalid sprite id" );
+
+	centrePos = ToRenderTarget( centrePos );
+	if( m_drawScale != 1.0f )
+		radius = static_cast<int>( ( radius * m_drawScale ) + 0.5f );
+
+	int x = static_cast<int>( std::floor( centrePos.x ) );
+	int y = static_cast<int>( std::floor( centrePos.y ) );
+	int ox = 0, oy = radius;
+	int d = 3 - 2 * radius;
+
+	m_vBrushStamps.clear();
+
+	while( true )
+	{
+		// The same point in all 8 octants
+		m_vBrushStamps.push_back( { x + ox, y + oy } );
+		m_vBrushStamps.push_back( { x - ox, y + oy } );
+		m_vBrushStamps.push_back( { x + ox, y - oy } );
+		m_vBrushStamps.push_back( { x - ox, y - oy } );
+		m_vBrushStamps.push_back( { x + oy, y + ox } );
+		m_vBrushStamps.push_back( { x - oy, y + ox } );
+		m_vBrushStamps.push_back( { x + oy, y - ox } );
+		m_vBrushStamps.push_back( { x - oy, y - ox } );
+
+		if( oy < ox )
+			break;
+
+		ox++;
+		if( d > 0 )
+		{
+			oy--;
+			d = d + 4 * ( ox - oy ) + 10;
+		}
+		else
+		{
+			d = d + 4 * ox + 6;
+		}
+	}
+
+	DrawBrushStroke( spriteId, m_vBrushStamps, colour );
+}
+
+//********************************************************************************************************************************
+// Function:	DrawBrushStroke - draws a pen sprite at lots of overlapping positions as a single stroke
+// Parameters:	spriteId = the pen sprite, vStamps = the positions to draw it at, colour = the tint for the stroke
+// Notes:		The stamps are combined into a working buffer covering the stroke (clipped to the clipping rectangle) by
+//				keeping the most opaque sprite pixel at each position. Only the touched part of each row is then tinted and
+//				blended onto the render target, so each pixel is blended once however many stamps overlap it.
+//********************************************************************************************************************************
+void PlayGraphics::DrawBrushStroke( int spriteId, const std::vector<Point2f>& vStamps, Pixel colour )
+{
+	FlushDeferredDraws();
+
+	// Brushes need the straight alpha pixels, so sprites used as brushes keep their canvas from then on
+	Sprite& s = vSpriteData[spriteId];
+	if( !s.canvasBuffer.pPixels )
+		RestoreCanvas( s );
+	const PixelData& canvas = s.canvasBuffer;
+
+	// The stroke is worked out in camera space (BlitTinted subtracts the camera offset)
+	PixelRect clip = m_blitter.GetClipRect();
+	clip.x += m_blitter.GetCameraOffsetX();
+	clip.y += m_blitter.GetCameraOffsetY();
+
+	if( vStamps.empty() || colour.a == 0x00 )
+		return;
+
+	// Find the area covered by the stroke (using the same positioning as Draw)
+	int left = static_cast<int>( std::floor( vStamps[0].x + 0.5f ) ) - s.originX;
+	int top = static_cast<int>( std::floor( vStamps[0].y + 0.5f ) ) - s.originY;
+	int right = left + s.width;
+	int bottom = top + s.height;
+	for( const Point2f& p : vStamps )
+	{
+		int destx = static_cast<int>( std::floor( p.x + 0.5f ) ) - s.originX;
+		int desty = static_cast<int>( std::floor( p.y + 0.5f ) ) - s.originY;
+		left = std::min( left, destx );
+		top = std::min( top, desty );
+		right = std::max( right, destx + s.width );
+		bottom = std::max( bottom, desty + s.height );
+	}
+
+	left = std::max( left, clip.x );
+	top = std::max( top, clip.y );
+	right = std::min( right, clip.x + clip.width );
+	bottom = std::min( bottom, clip.y + clip.height );
+
+	if( left >= right || top >= bottom )
+		return;
+
+	PixelData stroke;
+	stroke.width = right - left;
+	stroke.height = bottom - top;
+	m_vBrushPixels.assign( static_cast<size_t>( stroke.width ) * stroke.height, Pixel( 0x00000000 ) );
+	stroke.pPixels = m_vBrushPixels.data();
+
+	// The range of pixels touched on each row of the stroke
+	m_vBrushRowStarts.assign( stroke.height, stroke.width );
+	m_vBrushRowEnds.assign( stroke.height, 0 );
+
+	for( const Point2f& p : vStamps )
+	{
+		int destx = static_cast<int>( std::floor( p.x + 0.5f ) ) - s.originX;
+		int desty = static_cast<int>( std::floor( p.y + 0.5f ) ) - s.originY;
+
+		int stampLeft = std::max( destx, left );
+		int stampTop = std::max( desty, top );
+		int stampRight = std::min( destx + s.width, right );
+		int stampBottom = std::min( desty + s.height, bottom );
+
+		for( int y = stampTop; y < stampBottom; y++ )
+		{
+			const Pixel* pSrc = canvas.Row( y - desty ) + ( stampLeft - destx );
+			Pixel* pDest = stroke.Row( y - top ) + ( stampLeft - left );
+
+			// Later stamps win ties, as they would if each stamp was drawn in turn
+			for( int x = stampLeft; x < stampRight; x++, pSrc++, pDest++ )
+			{
+				if( pSrc->a != 0x00 && pSrc->a >= pDest->a )
+					*pDest = *pSrc;
+			}
+
+			m_vBrushRowStarts[y - top] = std::min( m_vBrushRowStarts[y - top], stampLeft - left );
+			m_vBrushRowEnds[y - top] = std::max( m_vBrushRowEnds[y - top], stampRight - left );
+		}
+	}
+
+	// Blend each row once, applying the tint as it is drawn
+	for( int row = 0; row < stroke.height; row++ )
+	{
+		int start = m_vBrushRowStarts[row];
+		int end = m_vBrushRowEnds[row];
+
+		if( start < end )
+			m_blitter.BlitTinted( stroke.View( { start, row, end - start, 1 } ), left + start, top + row, colour );
+	}
+}
+
+//********************************************************************************************************************************
+// Deferred drawing functions
+//********************************************************************************************************************************
+
+void PlayGraphics::BeginDeferredDraw( bool occlusionCulling )
+{
+	FlushDeferredDraws();
+	m_bDeferredDraw = true;
+	m_bOcclusionCulling = occlusionCulling;
+	m_occludedPixels = 0;
+}
+
+void PlayGraphics::EndDeferredDraw()
+{
+	FlushDeferredDraws();
+	m_bDeferredDraw = false;
+}
+
+//********************************************************************************************************************************
+// Function:	FlushDeferredDraws - draws the recorded draws in order, skipping any which would be completely hidden
+// Notes:		The clipping rectangle is split into tiles and the draws are visited front to back (most recent first). A draw
+//				which only touches tiles that are already hidden is skipped, and the tiles inside the opaque rectangle of an
+//				unrotated sprite drawn without transparency are hidden from everything behind it. Backgrounds are opaque, so
+//				they hide everything behind them and are only copied into the tiles which are still visible.
+//********************************************************************************************************************************
+void PlayGraphics::FlushDeferredDraws()
+{
+	if( m_vDeferredDraws.empty() )
+		return;
+
+	// Take the recorded list so that the draws below happen immediately (the two lists swap back and forth, keeping
+	// their memory)
+	std::vector<DeferredDraw>& vDraws = m_vFlushedDraws;
+	vDraws.swap( m_vDeferredDraws );
+	bool deferred = m_bDeferredDraw;
+	m_bDeferredDraw = false;
+
+	constexpr int TILE_SIZE = 32;
+	PixelRect clip = m_blitter.GetClipRect();
+	int tilesX = ( clip.width + TILE_SIZE - 1 ) / TILE_SIZE;
+	int tilesY = ( clip.height + TILE_SIZE - 1 ) / TILE_SIZE;
+
+	// Whether each tile is hidden by the opaque sprites in front of the draw being considered
+	std::vector<uint8_t>& vHiddenTiles = m_vHiddenTiles;
+	vHiddenTiles.assign( static_cast<size_t>( tilesX ) * tilesY, 0 );
+	// The tiles which were hidden when each background was reached (empty for sprites)
+	std::vector<std::vector<uint8_t>>& vBackgroundHiddenTiles = m_vBackgroundHiddenTiles;
+	if( vBackgroundHiddenTiles.size() < vDraws.size() )
+		vBackgroundHiddenTiles.resize( vDraws.size() );
+	for( size_t i = 0; i < vDraws.size(); i++ )
+		vBackgroundHiddenTiles[i].clear();
+	std::vector<uint8_t>& vCulled = m_vCulled;
+	vCulled.assign( vDraws.size(), 0 );
+
+	for( int i = static_cast<int>( vDraws.size() ) - 1; i >= 0 && m_bOcclusionCulling; i-- )
+	{
+		const DeferredDraw& d = vDraws[i];
+
+		// The area of the draw within the clipping rectangle
+		int left = std::max( d.bounds.x, clip.x );
+		int top = std::max( d.bounds.y, clip.y );
+		int right = std::min( d.bounds.x + d.bounds.width, clip.x + clip.width );
+		int bottom = std::min( d.bounds.y + d.bounds.height, clip.y + clip.height );
+
+		if( left >= right || top >= bottom )
+		{
+			vCulled[i] = 1; // Nothing inside the clipping rectangle
+			continue;
+		}
+
+		int tileLeft = ( left - clip.x ) / TILE_SIZE;
+		int tileTop = ( top - clip.y ) / TILE_SIZE;
+		int tileRight = ( right - 1 - clip.x ) / TILE_SIZE;
+		int tileBottom = ( bottom - 1 - clip.y ) / TILE_SIZE;
+
+		// Opaque backgrounds hide everything drawn before them (transparent ones are treated like sprites)
+		if( d.background && !vBackgroundData[d.id].preMultiplied )
+		{
+			vBackgroundHiddenTiles[i] = vHiddenTiles;
+
+			for( int ty = tileTop; ty <= tileBottom; ty++ )
+			{
+				for( int tx = tileLeft; tx <= tileRight; tx++ )
+				{
+					uint8_t& hidden = vHiddenTiles[( static_cast<size_t>( ty ) * tilesX ) + tx];
+					if( hidden )
+					{
+						int tileWidth = std::min( TILE_SIZE, clip.width - ( tx * TILE_SIZE ) );
+						int tileHeight = std::min( TILE_SIZE, clip.height - ( ty * TILE_SIZE ) );
+						m_occludedPixels += tileWidth * tileHeight;
+					}
+					hidden = 1;
+				}
+			}
+			continue;
+		}
+
+		bool hidden = true;
+		for( int ty = tileTop; ty <= tileBottom && hidden; ty++ )
+		{
+			for( int tx = tileLeft; tx <= tileRight && hidden; tx++ )
+				hidden = vHiddenTiles[( static_cast<size_t>( ty ) * tilesX ) + tx] != 0;
+		}
+
+		if( hidden )
+		{
+			vCulled[i] = 1;
+			m_occludedPixels += ( right - left ) * ( bottom - top );
+			continue;
+		}
+
+		// Only unrotated sprites drawn without transparency completely replace the pixels behind them
+		if( !d.background && !d.rotated && d.alphaMultiply >= 1.0f )
+		{
+			const PixelRect& opaque = vSpriteData[d.id].vOpaqueRects[d.frameIndex];
+			int opaqueLeft = d.bounds.x + opaque.x;
+			int opaqueTop = d.bounds.y + opaque.y;
+			int opaqueRight = opaqueLeft + opaque.width;
+			int opaqueBottom = opaqueTop + opaque.height;
+
+			for( int ty = tileTop; ty <= tileBottom; ty++ )
+			{
+				int tileY = clip.y + ( ty * TILE_SIZE );
+				if( tileY < opaqueTop || std::min( tileY + TILE_SIZE, clip.y + clip.height ) > opaqueBottom )
+					continue;
+
+				for( int tx = tileLeft; tx <= tileRight; tx++ )
+				{
+					int tileX = clip.x + ( tx * TILE_SIZE );
+					if( tileX >= opaqueLeft && std::min( tileX + TILE_SIZE, clip.x + clip.width ) <= opaqueRight )
+						vHiddenTiles[( static_cast<size_t>( ty ) * tilesX ) + tx] = 1;
+				}
+			}
+		}
+	}
+
+	// Draw everything which is still visible in the order it was recorded
+	for( size_t i = 0; i < vDraws.size(); i++ )
+	{
+		const DeferredDraw& d = vDraws[i];
+		const std::vector<uint8_t>& vTiles = vBackgroundHiddenTiles[i];
+
+		if( vCulled[i] )
+			continue;
+
+		if( d.rotated )
+		{
+			DrawRotated( d.id, d.pos, d.frameIndex, d.angle, d.scale, d.alphaMultiply );
+		}
+		else if( !d.background )
+		{
+			DrawTransparent( d.id, d.pos, d.frameIndex, d.alphaMultiply );
+		}
+		else if( std::find( vTiles.begin(), vTiles.end(), 1 ) == vTiles.end() )
+		{
+			DrawBackground( d.id, d.scrollFactor );
+		}
+		else
+		{
+			// Copy the background into each run of visible tiles along each row of tiles
+			for( int ty = 0; ty < tilesY; ty++ )
+			{
+				for( int tx = 0; tx < tilesX; tx++ )
+				{
+					if( vTiles[( static_cast<size_t>( ty ) * tilesX ) + tx] )
+						continue;
+
+					int runStart = tx;
+					while( tx + 1 < tilesX && !vTiles[( static_cast<size_t>( ty ) * tilesX ) + tx + 1] )
+						tx++;
+
+					m_blitter.PushClipRect( { clip.x + ( runStart * TILE_SIZE ), clip.y + ( ty * TILE_SIZE ), ( tx + 1 - runStart ) * TILE_SIZE, TILE_SIZE } );
+					DrawBackground( d.id, d.scrollFactor );
+					m_blitter.PopClipRect();
+				}
+			}
+		}
+	}
+
+	vDraws.clear();
+	m_bDeferredDraw = deferred;
+}
+
+int PlayGraphics::DrawString( int fontId, Point2f pos, std::string text ) const
+{
+	PLAY_ASSERT_MSG( fontId >= 0 && fontId < m_nTotalSprites, "Trying to use invalid sprite id for font" );
+
+	TextLayout& layout = GetTextLayout( fontId, text );
+	const Sprite& spr = vSpriteData[fontId];
+
+	// Strings which are drawn again (e.g. instructions and labels) are pre-rendered so they only need one blit
+	// > Recorded draws and scaled draws are drawn a character at a time
+	// > Compressed fonts are always drawn a character at a time, as their characters are decoded as they are drawn
+	if( layout.uses > 1 && !m_bDeferredDraw && m_drawScale == 1.0f && !text.empty() && spr.vCompressed.empty() && !IsTintedWhenDrawn( spr ) )
+	{
+		if( !layout.run.pPixels || layout.colour.bits != spr.colour.bits )
+			RenderTextRun( layout );
+
+		if( !layout.translucentOverlaps )
+		{
+			int destx = static_cast<int>( std::floor( pos.x + 0.5f ) ) - spr.originX;
+			int desty = static_cast<int>( std::floor( pos.y + 0.5f ) ) - spr.originY;
+			m_blitter.BlitPixels( layout.run, 0, destx, desty, layout.run.width, layout.run.height, 1.0f );
+			return layout.width;
+		}
+	}
+
+	for( size_t i = 0; i < text.size(); i++ )
+		Draw( fontId, { pos.x + layout.vOffsets[i], pos.y }, text[i] - 32 );
+
+	return layout.width;
+}
+
+int PlayGraphics::DrawStringCentred( int fontId, Point2f pos, std::string text ) const
+{
+	int totalWidth = GetStringWidth( fontId, text );
+
+	pos.x -= totalWidth / 2;
+
+	DrawString( fontId, pos, text );
+	return totalWidth;
+}
+
+int PlayGraphics::GetStringWidth( int fontId, const std::string& text ) const
+{
+	PLAY_ASSERT_MSG( fontId >= 0 && fontId < m_nTotalSprites, "Trying to use invalid sprite id for font" );
+	return GetTextLayout( fontId, text ).width;
+}
+
+PlayGraphics::TextLayout& PlayGraphics::GetTextLayout( int fontId, const std::string& text ) const
+{
+	// Bounds the cache when lots of different strings are drawn (e.g. changing scores)
+	constexpr size_t MAX_TEXT_LAYOUTS = 256;
+
+	std::map<std::string, TextLayout>& fontLayouts = m_textLayouts[fontId];
+	auto found = fontLayouts.find( text );
+
+	if( found == fontLayouts.end() )
+	{
+		size_t count = 0;
+		for( const auto& font : m_textLayouts )
+			count += font.second.size();
+
+		// The least recently used layout makes way for the new one, so strings drawn every frame stay cached
+		if( count >= MAX_TEXT_LAYOUTS )
+		{
+			std::map<std::string, TextLayout>* pOldestFont = nullptr;
+			std::map<std::string, TextLayout>::iterator oldest;
+			for( auto& font : m_textLayouts )
+			{
+				for( auto it = font.second.begin(); it != font.second.end(); it++ )
+				{
+					if( !pOldestFont || it->second.lastUse < oldest->second.lastUse )
+					{
+						pOldestFont = &font.second;
+						oldest = it;
+					}
+				}
+			}
+
+			FreeAlignedPixels( oldest->second.run );
+			pOldestFont->erase( oldest );
+		}
+
+		found = fontLayouts.emplace( text, TextLayout() ).first;
+		TextLayout& layout = found->second;
+		layout.fontId = fontId;
+		layout.text = text;
+		layout.vOffsets.resize( text.size() );
+
+		for( size_t i = 0; i < text.size(); i++ )
+		{
+			layout.vOffsets[i] = layout.width;
+			layout.width += GetFontCharWidth( fontId, text[i] );
+		}
+	}
+
+	TextLayout& layout = found->second;
+	layout.uses++;
+	layout.lastUse = ++m_textLayoutClock;
+	return layout;
+}
+
+bool PlayGraphics::IsTextLayoutCached( int fontId, const std::string& text ) const
+{
+	auto font = m_textLayouts.find( fontId );
+	return font != m_textLayouts.end() && font->second.find( text ) != font->second.end();
+}
+
+//********************************************************************************************************************************
+// Function:	RenderTextRun - draws every character of a string into a single buffer in the sprite pre-multiplied format
+// Parameters:	layout = the layout of the string to render
+// Notes:		Pixels which are only covered by one character, or where a later character is opaque, are copied exactly so
+//				drawing the run matches drawing the characters one at a time. Translucent pixels over another character can't
+//				be combined in advance (the blend onto the render target only keeps the top 4 bits of what is behind), so
+//				strings with any are marked to be drawn a character at a time. The transparent skip values are worked out
+//				afterwards as the characters overlap.
+//********************************************************************************************************************************
+void PlayGraphics::RenderTextRun( TextLayout& layout ) const
+{
+	const Sprite& spr = vSpriteData[layout.fontId];
+	int width = layout.vOffsets.back() + spr.width;
+
+	FreeAlignedPixels( layout.run );
+	AllocateAlignedPixels( layout.run, width, spr.height );
+	layout.colour = spr.colour;
+	layout.translucentOverlaps = false;
+
+	for( int y = 0; y < spr.height; y++ )
+	{
+		uint32_t* pDestRow = &layout.run.Row( y )->bits;
+		std::fill( pDestRow, pDestRow + width, 0xFF000000 );
+
+		for( size_t i = 0; i < layout.text.size(); i++ )
+		{
+			int frameIndex = ( layout.text[i] - 32 ) % spr.totalCount;
+
+			// Fonts with few colours are usually indexed (and blank characters usually share the same frame)
+			int frameOffset;
+			const PixelData& source = GetFrameStorage( spr, frameIndex, frameOffset );
+			const uint32_t* pSrc = ( source.format == PIXEL_FORMAT_INDEXED8 ) ? nullptr : &source.Row( y )->bits + frameOffset;
+			const uint8_t* pSrcIndices = pSrc ? nullptr : source.Row8( y ) + frameOffset;
+			uint32_t* pDest = pDestRow + layout.vOffsets[i];
+
+			for( int x = 0; x < spr.width; x++, pDest++ )
+			{
+				uint32_t src = pSrc ? pSrc[x] : source.pPalette[pSrcIndices[x]];
+				uint32_t dest = *pDest;
+
+				if( src >= 0xFF000000 ) // Transparent (the low bits are a skip value)
+					continue;
+
+				// Nothing behind, or an opaque pixel which hides what is behind it
+				if( dest >= 0xFF000000 || src < 0x01000000 )
+				{
+					*pDest = src;
+					continue;
+				}
+
+				layout.translucentOverlaps = true;
+			}
+		}
+
+		// Work from right to left so each transparent pixel's skip value can be worked out from its neighbour
+		for( int x = width - 2; x >= 0; x-- )
+		{
+			if( pDestRow[x] >= 0xFF000000 && pDestRow[x + 1] >= 0xFF000000 )
+				pDestRow[x] = 0xFF000000 + ( pDestRow[x + 1] & 0x00FFFFFF ) + 1;
+		}
+	}
+}
+
+void PlayGraphics::ClearTextLayouts( int fontId ) const
+{
+	for( auto font = m_textLayouts.begin(); font != m_textLayouts.end(); )
+	{
+		if( fontId == -1 || font->first == fontId )
+		{
+			for( auto& layout : font->second )
+				FreeAlignedPixels( layout.second.run );
+			font = m_textLayouts.erase( font );
+		}
+		else
+		{
+			font++;
+		}
+	}
+}
+
+int PlayGraphics::DrawChar( int fontId, Point2f pos, char c ) const
+{
+	PLAY_ASSERT_MSG( fontId >= 0 && fontId < m_nTotalSprites, "Trying to use invalid sprite id for font" );
+	Draw( fontId, { pos.x, pos.y }, c - 32 );
+	return GetFontCharWidth( fontId, c );
+}
+
+int PlayGraphics::DrawCharRotated( int fontId, Point2f pos, float angle, float scale, char c ) const
+{
+	PLAY_ASSERT_MSG( fontId >= 0 && fontId < m_nTotalSprites, "Trying to use invalid sprite id for font" );
+	DrawRotated( fontId, { pos.x, pos.y }, c - 32, angle, scale );
+	return GetFontCharWidth( fontId, c );
+}
+
+int PlayGraphics::GetFontCharWidth( int fontId, char c ) const
+{
+	PLAY_ASSERT_MSG( fontId >= 0 && fontId < m_nTotalSprites, "Trying to use invalid sprite id for font" );
+	const Sprite& s = vSpriteData[fontId];
+	if( !s.canvasBuffer.pPixels )
+	{
+		int glyph = c - 32;
+		return ( glyph >= 0 && glyph < static_cast<int>( s.vGlyphWidths.size() ) ) ? s.vGlyphWidths[glyph] : 0;
+	}
+	return (s.canvasBuffer.pPixels + ( c - 32 ))->b; // character width hidden in pixel data
+}
+
+
+
+
+//********************************************************************************************************************************
+// Function:	SpriteCollide: function that checks by pixel if two sprites collide
+// Parameters:	s1Xpos, s1Ypos, s2Xpos, s2Ypos = the origin of rotation for both sprites.
+//				s1Id, s2Id = the ids of both sprites
+//				s1angle, s2angle = the angle of rotation for both sprites, clockwise. 0 = unrotated.
+//				s1Pixelcoll, s2Pixelcoll = the top left and bottom right co-ordinates defining the collision rectangle of both sprites
+//				
+// Returns: true if a single pixel or more overlap between the two sprites and false if not.
+// Notes:	rounding errors may cause it not to be pixel perfect.	
+//********************************************************************************************************************************
+bool PlayGraphics::SpriteCollide( int id_1, Point2f pos_1, int frame_1, float angle_1, int s1PixelColl[4], int id_2, Point2f pos_2, int frame_2, float angle_2, int s2PixelColl[4] ) const
+{
+	//transform all co-ordinates of sprite2 into the frame of sprite 1.
+
+	//To do this we'll set up three co-ordinate systems.
+	//X,Y are screen, u,v are sprite 1 and a,b are sprite 2.
+	//The input is position of centre of rotation in screen and position of centre of rotation in sprite1 and sprite2.
+
+	//We define the origin of the sprite1 as the beginning of its buffer.
+	//First I calculate the offset vector for sprite one in the screen.
+	//in sprite offsetu = rotOffX, offsetv = rotOffY.
+	//When I refer to origin of the sprite I mean the 0,0 pixel.
+
+
+	//Next define corners of sprite
+	const Sprite& s1 = vSpriteData[id_1];
+	const Sprite& s2 = vSpriteData[id_2];
+
+	//Convert collision box locations from relative to sprite origin to relative to sprite top left. Hence TL.
+	int s1PixelCollTL[4]{ 0 };
+	int s2PixelCollTL[4]{ 0 };
+
+	for( int i{ 0 }; i < 2; i++ )
+	{
+		s1PixelCollTL[2 * i] = s1PixelColl[2 * i] + s1.originX;
+		s1PixelCollTL[2 * i + 1] = s1PixelColl[2 * i + 1] + s1.originY;
+		s2PixelCollTL[2 * i] = s2PixelColl[2 * i] + s2.originX;
+		s2PixelCollTL[2 * i + 1] = s2PixelColl[2 * i + 1] + s2.originY;
+	}
+
+	//in screen
+	float cosAngle1 = cos( angle_1 );
+	float sinAngle1 = sin( angle_1 );
+	float offsetSprite1X = cosAngle1 * s1.originX - sinAngle1 * s1.originY;
+	float offsetSprite1Y = cosAngle1 * s1.originY + sinAngle1 * s1.originX;
+
+	//Next I calculate the sprite origin in the screen.
+	float originSprite1X = pos_1.x - offsetSprite1X;
+	float originSprite1Y = pos_1.y - offsetSprite1Y;
+
+	//Repeat for other sprite.
+	float cosAngle2 = cos( angle_2 );
+	float sinAngle2 = sin( angle_2 );
+	float offsetSprite2X = cosAngle2 * s2.originX - sinAngle2 * s2.originY;
+	float offsetSprite2Y = cosAngle2 * s2.originY + sinAngle2 * s2.originX;
+
+	//Next I calculate the sprite origin in the screen.
+	float originSprite2X = pos_2.x - offsetSprite2X;
+	float originSprite2Y = pos_2.y - offsetSprite2Y;
+
+	//calculate the difference between two sprite origins in screen
+	float originDiffX = originSprite2X - originSprite1X;
+	float originDiffY = originSprite2Y - originSprite1Y;
+
+	//calculation of the difference between two sprite origins in frame of sprite 1.
+	float originDiffu = originDiffX * cosAngle1 + originDiffY * sinAngle1;
+	float originDiffv = originDiffY * cosAngle1 - originDiffX * sinAngle1;
+
+	int s2Width = s2.width;
+	int s2Height = s2.height;
+	int s1Width = s1.width;
+
+	float cosAngleDiff = cos( angle_2 - angle_1 );
+	float sinAngleDiff = sin( angle_2 - angle_1 );
+	//top left, top right, bottom right, bottom left.
+	float s2Cu[4]
+	{
+		0,
+		s2Width * cosAngleDiff,
+		s2Width * cosAngleDiff - s2Height * sinAngleDiff,
+		-s2Height * sinAngleDiff
+	};
+
+	float s2Cv[4]
+	{
+		0,
+		s2Width * sinAngleDiff,
+		s2Width * sinAngleDiff + s2Height * cosAngleDiff,
+		s2Height * cosAngleDiff
+	};
+
+
+	float minCu{ std::numeric_limits<float>::infinity() };
+	float minCv{ std::numeric_limits<float>::infinity() };
+	float maxCu{ -std::numeric_limits<float>::infinity() };
+	float maxCv{ -std::numeric_limits<float>::infinity() };
+
+	//calculate the extremes of the rotated sprite2.
+	for( int i = 0; i < 4; i++ )
+	{
+		minCu = std::min( s2Cu[i], minCu );
+		minCv = std::min( s2Cv[i], minCv );
+		maxCu = std::max( s2Cu[i], maxCu );
+		maxCv = std::max( s2Cv[i], maxCv );
+	}
+
+	//calculate the maximum and minimum positions in the sprite1 frame of the sprite2 corners.
+	float maxu = (originDiffu)+( maxCu );
+	float maxv = (originDiffv)+( maxCv );
+	float minu = (originDiffu)+( minCu );
+	float minv = (originDiffv)+( minCv );
+
+	if( minu > s1PixelCollTL[2] || minv > s1PixelCollTL[3] || maxu < s1PixelCollTL[0] || maxv < s1PixelCollTL[1] )
+	{
+		return false;
+	}
+	else
+	{
+		//wrap both frame indexes just in case.
+		frame_1 = frame_1 % s1.totalCount;
+		frame_2 = frame_2 % s2.totalCount;
+
+		//clip so we loop through sprite 1.
+		//Restrict the range we look in for pixel based collisions.
+		minv = ( minv < s1PixelCollTL[1] ) ? static_cast<float>( s1PixelCollTL[1] ) : minv;
+		maxv = ( maxv > s1PixelCollTL[3] ) ? static_cast<float>( s1PixelCollTL[3] ) : maxv;
+		minu = ( minu < s1PixelCollTL[0] ) ? static_cast<float>( s1PixelCollTL[0] ) : minu;
+		maxu = ( maxu > s1PixelCollTL[2] ) ? static_cast<float>( s1PixelCollTL[2] ) : maxu;
+
+		//Set up the starting position in sprite 2 frame. We know the box corners in u, v relative to the sprite 2 origin but we need to get them in a,b.
+		float minCa = ( minu - originDiffu ) * cosAngleDiff + ( minv - originDiffv ) * sinAngleDiff;
+		float minCb = -( minu - originDiffu ) * sinAngleDiff + ( minv - originDiffv ) * cosAngleDiff;
+
+		//rounding at this point
+		int iminu = static_cast<int>( minu );
+		int iminv = static_cast<int>( minv );
+		int imaxu = static_cast<int>( maxu );
+		int imaxv = static_cast<int>( maxv );
+
+		float startinga = minCa;
+		float startingb = minCb;
+
+		float rowstarta = startinga;
+		float rowstartb = startingb;
+
+		//The pixels are looked up in each sprite's collision mask (which is kept even when the canvas is freed).
+		//Find the top left of the correct frame in each canvas.
+		int sprite1FrameX = s1Width * ( frame_1 % s1.hCount );
+		int sprite1FrameY = s1.height * ( frame_1 / s1.hCount );
+		int sprite2FrameX = s2Width * ( frame_2 % s2.hCount );
+		int sprite2FrameY = s2.height * ( frame_2 / s2.hCount );
+
+		//Start of double for loop.
+		//Go through the overlapping region (warning may go out of the buffer of sprite 2.)
+		for( int v{ iminv }; v < imaxv; v++ )
+		{
+			//store a and b to be the start of the row.
+			float a = rowstarta;
+			float b = rowstartb;
+
+			for( int u{ iminu }; u < imaxu; u++ )
+			{
+
+				//Edit this part to add a collision box.
+				//If we are in sprite 2 then extract the look at the pixels.
+				if( a >= s2PixelCollTL[0] && b >= s2PixelCollTL[1] && a < s2PixelCollTL[2] && b < s2PixelCollTL[3] )
+				{
+					//If both pixels at that position are opaque then there is a collision. 
+					if( IsMaskSet( s2, sprite2FrameX + static_cast<int>( a ), sprite2FrameY + static_cast<int>( b ) ) && IsMaskSet( s1, sprite1FrameX + u, sprite1FrameY + v ) )
+					{
+						return true;
+					}
+
+				}
+				//add change in for going along u. go along a row.
+				a += cosAngleDiff;
+				b += -sinAngleDiff;
+
+			}
+
+			//work out start of next row based on start of previous row. 
+			rowstarta += sinAngleDiff;
+			rowstartb += cosAngleDiff;
+		}
+	}
+	return false;
+}
+
+
+
+
+//********************************************************************************************************************************
+// Function:	PreMultiplyAlpha - calculates the (src*srcAlpha) alpha blending calculation in advance as it doesn't change
+// Parameters:	s = the sprite to pre-calculate data for
+// Notes:		Also inverts the alpha ready for the (dest*(1-srcAlpha)) calculation and stores information in the new
+//				buffer which provides the number of fully-transparent pixels in a row (so they can be skipped)
+//********************************************************************************************************************************
+void PlayGraphics::PreMultiplyAlpha( const PixelData& source, PixelData& dest, int maxSkipWidth, float alphaMultiply = 1.0f, Pixel colourMultiply = 0x00FFFFFF )
+{
+	// Iterate through all the pixels in the entire canvas
+	for( int bh = 0; bh < source.height; bh++ )
+	{
+		Pixel* pSourcePixels = source.Row( bh );
+		Pixel* pDestPixels = dest.Row( bh );
+
+		for( int bw = 0; bw < source.width; bw++ )
+		{
+			*pDestPixels = PreMultiplyPixel( *pSourcePixels, alphaMultiply, colourMultiply );
+
+			if( pDestPixels->bits >> 24 == 0xFF ) // Completely transparent pixel
+			{
+				int repeats = 0;
+
+				// We can only skip to the end of the row because the sprite frames are arranged on a continuous canvas
+				int maxSkip = maxSkipWidth - ( bw % maxSkipWidth );
+
+				for( int zw = 1; zw < maxSkip; zw++ )
+				{
+					if( ( pSourcePixels + zw )->bits >> 24 == 0x00 ) // Another transparent pixel
+						repeats++;
+					else
+						break;
+				}
+
+				*pDestPixels = 0xFF000000 | repeats; // Doesn't matter what the colour was so we use it to store the skip value
+			}
+
+			pDestPixels++;
+			pSourcePixels++;
+		}
+	}
+}
+
+uint32_t PlayGraphics::PreMultiplyPixel( Pixel src, float alphaMultiply, Pixel colourMultiply )
+{
+	// Separate the channels and calculate src*srcAlpha
+	int srcAlpha = static_cast<int>( ( src.bits >> 24 ) * alphaMultiply );
+
+	int destRed = ( srcAlpha * ( ( src.bits >> 16 ) & 0xFF ) ) >> 8;
+	int destGreen = ( srcAlpha * ( ( src.bits >> 8 ) & 0xFF ) ) >> 8;
+	int destBlue = ( srcAlpha * ( src.bits & 0xFF ) ) >> 8;
+
+	destRed = ( destRed * ( ( colourMultiply.bits >> 16 ) & 0xFF ) ) >> 8;
+	destGreen = ( destGreen * ( ( colourMultiply.bits >> 8 ) & 0xFF ) ) >> 8;
+	destBlue = ( destBlue * ( colourMultiply.bits & 0xFF ) ) >> 8;
+
+	srcAlpha = 0xFF - srcAlpha; // invert the alpha ready to multiply with the destination pixels
+	return ( srcAlpha << 24 ) | ( destRed << 16 ) | ( destGreen << 8 ) | destBlue;
+}
+
+Pixel PlayGraphics::UnPreMultiplyPixel( uint32_t pix )
+{
+	int srcAlpha = 0xFF - static_cast<int>( pix >> 24 );
+	if( srcAlpha == 0 )
+		return 0x00000000;
+
+	// PreMultiplyPixel multiplies by the alpha and then by the (white) colour multiply, dividing by 256 each time
+	// > Each step is undone by finding the smallest value which rounds down to it, so the result pre-multiplies back exactly
+	int channels[3];
+	for( int i = 0; i < 3; i++ )
+	{
+		int value = static_cast<int>( ( pix >> ( 16 - ( 8 * i ) ) ) & 0xFF );
+		int beforeColour = ( ( value * 256 ) + 254 ) / 255;
+		channels[i] = std::min( ( ( beforeColour * 256 ) + srcAlpha - 1 ) / srcAlpha, 0xFF );
+	}
+	int red = channels[0], green = channels[1], blue = channels[2];
+
+	return ( static_cast<uint32_t>( srcAlpha ) << 24 ) | ( red << 16 ) | ( green << 8 ) | blue;
+}
+
+void PlayGraphics::AllocateAlignedPixels( PixelData& pixelData, int width, int height, PixelFormat format )
+{
+	pixelData.format = format;
+
+	int stride = AlignedStride( width, format );
+	size_t bytes = static_cast<size_t>( pixelData.BytesPerPixel() ) * stride * std::max( height, 1 );
+
+#ifdef _WIN32
+	pixelData.pPixels = static_cast<Pixel*>( _aligned_malloc( bytes, 64 ) );
+#else
+	pixelData.pPixels = static_cast<Pixel*>( std::aligned_alloc( 64, bytes ) );
+#endif
+	PLAY_ASSERT( pixelData.pPixels );
+
+	// Cleared as bytes since the buffer may hold 16-bit pixels rather than Pixels
+	memset( static_cast<void*>( pixelData.pPixels ), 0, bytes );
+	pixelData.width = width;
+	pixelData.height = height;
+	pixelData.stride = stride;
+}
+
+int PlayGraphics::AlignedStride( int width, PixelFormat format )
+{
+	PixelData pixelData;
+	pixelData.format = format;
+
+	// Pad each row out to a whole number of cache lines (16 pixels, or 32 16-bit pixels) so that every row is aligned, not just the first
+	int rowAlign = 64 / pixelData.BytesPerPixel();
+	return ( width + rowAlign - 1 ) & ~( rowAlign - 1 );
+}
+
+void PlayGraphics::FreeAlignedPixels( PixelData& pixelData )
+{
+#ifdef _WIN32
+	_aligned_free( pixelData.pPixels );
+#else
+	std::free( pixelData.pPixels );
+#endif
+	pixelData.pPixels = nullptr;
+
+	delete[] pixelData.pPalette;
+	pixelData.pPalette = nullptr;
+}
+
+//********************************************************************************************************************************
+// Function:	CreateDrawData - creates a sprite's pre-multiplied drawing data from its canvas
+// Parameters:	s = the sprite, whose canvas and colour multiply are already set
+// Notes:		Sprites with 256 colours or fewer (counting every fully-transparent pixel as the same colour) are stored as one
+//				byte per pixel indexing a palette of just the colours used, which is close to a quarter of the memory to keep
+//				and to read when drawing. Sprites with more colours, or which are so small that the palette and the row padding
+//				outweigh the saving, are stored as full 32-bit pixels. Colours are never merged, so the sprite always draws
+//				exactly the same either way.
+//********************************************************************************************************************************
+void PlayGraphics::CreateDrawData( Sprite& s )
+{
+	const PixelData& canvas = s.canvasBuffer;
+	s.canvasBuffer.preMultiplied = true;
+	s.vPalette.clear();
+
+	// Find the colours used, giving up as soon as there are too many
+	std::map<uint32_t, uint8_t> colours;
+	uint32_t lastColour = 0;
+	uint8_t lastIndex = 0;
+	bool indexed = true;
+
+	for( int y = 0; y < canvas.height && indexed; y++ )
+	{
+		const Pixel* pRow = canvas.Row( y );
+		for( int x = 0; x < canvas.width; x++ )
+		{
+			uint32_t colour = ( pRow[x].a == 0x00 ) ? 0x00000000 : pRow[x].bits;
+			if( ( x > 0 || y > 0 ) && colour == lastColour )
+				continue;
+
+			std::map<uint32_t, uint8_t>::const_iterator i = colours.find( colour );
+			if( i == colours.end() )
+			{
+				if( colours.size() == 256 )
+				{
+					indexed = false;
+					break;
+				}
+				i = colours.insert( { colour, static_cast<uint8_t>( colours.size() ) } ).first;
+				s.vPalette.push_back( colour );
+			}
+
+			lastColour = colour;
+			lastIndex = i->second;
+		}
+	}
+
+	// Compare the sizes the two kinds of drawing data would be allocated at
+	if( indexed )
+	{
+		size_t indexedBytes = ( static_cast<size_t>( AlignedStride( canvas.width, PIXEL_FORMAT_INDEXED8 ) ) * canvas.height ) + ( sizeof( uint32_t ) * colours.size() );
+		size_t pixelBytes = sizeof( Pixel ) * AlignedStride( canvas.width, PIXEL_FORMAT_ARGB ) * canvas.height;
+		indexed = indexedBytes < pixelBytes;
+	}
+
+	if( !indexed )
+	{
+		s.vPalette.clear();
+		AllocateAlignedPixels( s.preMultAlpha, canvas.width, canvas.height );
+		PreMultiplyAlpha( canvas, s.preMultAlpha, s.width, 1.0f, s.colour );
+		return;
+	}
+
+	AllocateAlignedPixels( s.preMultAlpha, canvas.width, canvas.height, PIXEL_FORMAT_INDEXED8 );
+	s.preMultAlpha.pPalette = new uint32_t[colours.size()];
+	s.preMultAlpha.preMultiplied = true;
+
+	for( int y = 0; y < canvas.height; y++ )
+	{
+		const Pixel* pRow = canvas.Row( y );
+		uint8_t* pIndices = s.preMultAlpha.Row8( y );
+
+		for( int x = 0; x < canvas.width; x++ )
+		{
+			uint32_t colour = ( pRow[x].a == 0x00 ) ? 0x00000000 : pRow[x].bits;
+			if( colour != lastColour )
+			{
+				lastColour = colour;
+				lastIndex = colours[colour];
+			}
+			pIndices[x] = lastIndex;
+		}
+	}
+
+	PreMultiplyPalette( s );
+}
+
+void PlayGraphics::ExpandDrawData( Sprite& s )
+{
+	ReleaseDrawData( s );
+
+	AllocateAlignedPixels( s.preMultAlpha, s.canvasBuffer.width, s.canvasBuffer.height );
+	PreMultiplyAlpha( s.canvasBuffer, s.preMultAlpha, s.width, 1.0f, s.colour );
+}
+
+void PlayGraphics::PreMultiplyPalette( Sprite& s )
+{
+	uint32_t* pPalette = s.preMultAlpha.pPalette;
+
+	for( size_t i = 0; i < s.vPalette.size(); i++ )
+	{
+		// Fully transparent entries have a skip value of zero (the blitter works out the skip values as it draws)
+		pPalette[i] = PreMultiplyPixel( s.vPalette[i], 1.0f, s.colour );
+		if( pPalette[i] >> 24 == 0xFF )
+			pPalette[i] = 0xFF000000;
+	}
+}
+
+void PlayGraphics::ReleaseDrawData( Sprite& s )
+{
+	// Sprites drawing frames stored in this one get their own copies first (this one stops sharing other sprites' frames
+	// beforehand, so it is never asked to rebuild itself)
+	s.vFrameOwners.clear();
+	s.vFrameOffsets.clear();
+	ForgetFrameHashes( s );
+	RebuildBorrowers( s.id );
+
+	if( s.preMultAlpha.pPixels )
+		FreeAlignedPixels( s.preMultAlpha );
+
+	s.preMultAlpha = PixelData();
+	s.vPalette.clear();
+	s.vCompressed.clear();
+	s.vCompressed.shrink_to_fit();
+	s.vFrameStarts.clear();
+
+	// Decoded frames of the old data can't be used again
+	ForgetDecodedFrames( s.id );
+}
+
+void PlayGraphics::ForgetDecodedFrames( int spriteId ) const
+{
+	const Sprite& s = vSpriteData[spriteId];
+	if( s.tintedFrames.pPixels )
+	{
+		FreeAlignedPixels( s.tintedFrames );
+		s.tintedFrames = PixelData();
+	}
+
+	for( DecodedFrame& frame : m_vDecodedFrames )
+	{
+		if( frame.spriteId == spriteId )
+		{
+			frame.spriteId = -1;
+			frame.lastUse = 0;
+		}
+	}
+}
+
+//********************************************************************************************************************************
+// Function:	CompressDrawData - encodes a sprite's pre-multiplied frames as runs of pixels
+// Parameters:	s = the sprite, whose canvas and colour multiply are already set
+// Notes:		Each row of each frame is a list of runs, and each run is a word holding the number of transparent pixels
+//				(top 16 bits) and the number of visible pixels (bottom 16 bits) followed by the visible pixels themselves.
+//				Transparent pixels take no space at all, and decoding is a fill and a memcpy per run. Frames which encode
+//				exactly the same as an earlier frame just start at the earlier frame's runs.
+//********************************************************************************************************************************
+void PlayGraphics::CompressDrawData( Sprite& s )
+{
+	PLAY_ASSERT_MSG( s.width <= 0xFFFF, "Sprite frames are too wide to compress" );
+
+	ReleaseDrawData( s );
+	s.frameDecodes = 0;
+	s.decodeTicks = 0;
+
+	const PixelData& canvas = s.canvasBuffer;
+	std::multimap<uint64_t, std::pair<size_t, size_t>> frameHashes; // The start and length of each frame's runs
+
+	for( int f = 0; f < s.totalCount; f++ )
+	{
+		int frameX = ( f % s.hCount ) * s.width;
+		int frameY = ( f / s.hCount ) * s.height;
+		size_t frameStart = s.vCompressed.size();
+		s.vFrameStarts.push_back( frameStart );
+
+		for( int y = 0; y < s.height; y++ )
+		{
+			const Pixel* pRow = canvas.Row( frameY + y ) + frameX;
+
+			for( int x = 0; x < s.width; )
+			{
+				int transparent = 0;
+				while( x + transparent < s.width && pRow[x + transparent].a == 0x00 )
+					transparent++;
+
+				int visible = 0;
+				while( x + transparent + visible < s.width && pRow[x + transparent + visible].a != 0x00 )
+					visible++;
+
+				s.vCompressed.push_back( ( static_cast<uint32_t>( transparent ) << 16 ) | static_cast<uint32_t>( visible ) );
+				for( int i = x + transparent; i < x + transparent + visible; i++ )
+					s.vCompressed.push_back( PreMultiplyPixel( pRow[i], 1.0f, s.colour ) );
+
+				x += transparent + visible;
+			}
+		}
+
+		size_t length = s.vCompressed.size() - frameStart;
+		uint64_t hash = HashWords( s.vCompressed.data() + frameStart, length );
+		std::pair<std::multimap<uint64_t, std::pair<size_t, size_t>>::const_iterator, std::multimap<uint64_t, std::pair<size_t, size_t>>::const_iterator> matches = frameHashes.equal_range( hash );
+		for( std::multimap<uint64_t, std::pair<size_t, size_t>>::const_iterator i = matches.first; i != matches.second; ++i )
+		{
+			size_t otherStart = i->second.first;
+			if( i->second.second == length && std::equal( s.vCompressed.begin() + frameStart, s.vCompressed.end(), s.vCompressed.begin() + otherStart ) )
+			{
+				s.vCompressed.resize( frameStart );
+				s.vFrameStarts[f] = otherStart;
+				break;
+			}
+		}
+
+		if( s.vFrameStarts[f] == frameStart )
+			frameHashes.insert( { hash, { frameStart, length } } );
+	}
+
+	s.vCompressed.shrink_to_fit();
+}
+
+//********************************************************************************************************************************
+// Function:	GetFrameDrawData - gets the pre-multiplied drawing data for a sprite frame
+// Parameters:	s = the sprite, frameIndex = the frame (already wrapped), frameOffset = set to the frame's offset in the data
+// Notes:		Uncompressed and untinted frames are drawn straight from the sprite's drawing data. Sprites coloured without a
+//				canvas keep a tinted copy of all their frames, and compressed frames are decoded (and tinted) into a small
+//				shared cache.
+//********************************************************************************************************************************
+const PixelData& PlayGraphics::GetFrameDrawData( const Sprite& s, int frameIndex, int& frameOffset ) const
+{
+	bool tinted = IsTintedWhenDrawn( s );
+
+	if( s.vCompressed.empty() && !tinted )
+		return GetFrameStorage( s, frameIndex, frameOffset );
+
+	if( s.vCompressed.empty() )
+	{
+		PixelData& copy = s.tintedFrames;
+		if( !copy.pPixels )
+		{
+			// Tinting is only applied to 32-bit drawing data
+			AllocateAlignedPixels( copy, s.width * s.hCount, s.height * s.vCount );
+			for( int f = 0; f < s.totalCount; f++ )
+			{
+				int storedOffset;
+				const PixelData& stored = GetFrameStorage( s, f, storedOffset );
+				Pixel* pCopy = copy.Row( ( f / s.hCount ) * s.height ) + ( ( f % s.hCount ) * s.width );
+				for( int y = 0; y < s.height; y++ )
+					TintPixels( &( stored.Row( y ) + storedOffset )->bits, &pCopy[copy.Stride() * y].bits, s.width, s.colour );
+			}
+		}
+
+		frameOffset = ( ( frameIndex % s.hCount ) * s.width ) + ( copy.Stride() * ( frameIndex / s.hCount ) * s.height );
+		return copy;
+	}
+
+	frameOffset = 0;
+	m_decodedFrameClock++;
+
+	if( m_vDecodedFrames.empty() )
+		m_vDecodedFrames.resize( kDecodedFrameSlots );
+
+	// Use the frame if it is already decoded, otherwise replace the least recently drawn one
+	DecodedFrame* pSlot = &m_vDecodedFrames[0];
+	for( DecodedFrame& frame : m_vDecodedFrames )
+	{
+		if( frame.spriteId == s.id && frame.frameIndex == frameIndex )
+		{
+			frame.lastUse = m_decodedFrameClock;
+			return frame.pixels;
+		}
+
+		if( frame.lastUse < pSlot->lastUse )
+			pSlot = &frame;
+	}
+
+	if( pSlot->pixels.width != s.width || pSlot->pixels.height != s.height )
+	{
+		if( pSlot->pixels.pPixels )
+			FreeAlignedPixels( pSlot->pixels );
+		AllocateAlignedPixels( pSlot->pixels, s.width, s.height );
+	}
+
+	LARGE_INTEGER start, end;
+	QueryPerformanceCounter( &start );
+
+	DecodeFrame( s, frameIndex, pSlot->pixels );
+	if( tinted )
+	{
+		for( int y = 0; y < s.height; y++ )
+			TintPixels( &pSlot->pixels.Row( y )->bits, &pSlot->pixels.Row( y )->bits, s.width, s.colour );
+	}
+
+	QueryPerformanceCounter( &end );
+	s.frameDecodes++;
+	s.decodeTicks += end.QuadPart - start.QuadPart;
+
+	pSlot->spriteId = s.id;
+	pSlot->frameIndex = frameIndex;
+	pSlot->lastUse = m_decodedFrameClock;
+	return pSlot->pixels;
+}
+
+void PlayGraphics::TintPixels( const uint32_t* pSource, uint32_t* pDest, int count, Pixel colourMultiply )
+{
+	int red = ( colourMultiply.bits >> 16 ) & 0xFF;
+	int green = ( colourMultiply.bits >> 8 ) & 0xFF;
+	int blue = colourMultiply.bits & 0xFF;
+
+	for( int x = 0; x < count; x++ )
+	{
+		uint32_t pix = pSource[x];
+		if( pix >= 0xFF000000 ) // Fully transparent pixels keep their skip values
+		{
+			pDest[x] = pix;
+			continue;
+		}
+
+		// PreMultiplyPixel's multiply by white took exactly one off every channel which wasn't zero, so that is added back
+		// before multiplying by the colour in the same way (a channel of one also became zero, but would tint to zero anyway)
+		int r = ( pix >> 16 ) & 0xFF;
+		int g = ( pix >> 8 ) & 0xFF;
+		int b = pix & 0xFF;
+		r = ( ( r + ( r != 0 ) ) * red ) >> 8;
+		g = ( ( g + ( g != 0 ) ) * green ) >> 8;
+		b = ( ( b + ( b != 0 ) ) * blue ) >> 8;
+		pDest[x] = ( pix & 0xFF000000 ) | ( r << 16 ) | ( g << 8 ) | b;
+	}
+}
+
+void PlayGraphics::DecodeFrame( const Sprite& s, int frameIndex, const PixelData& dest ) const
+{
+	const uint32_t* pRun = s.vCompressed.data() + s.vFrameStarts[frameIndex];
+	for( int y = 0; y < s.height; y++ )
+	{
+		uint32_t* pDest = &dest.Row( y )->bits;
+
+		for( int x = 0; x < s.width; )
+		{
+			int transparent = static_cast<int>( *pRun >> 16 );
+			int visible = static_cast<int>( *pRun++ & 0xFFFF );
+
+			// Transparent pixels store how many more follow them in the low bits (as PreMultiplyAlpha does)
+			for( int i = 0; i < transparent; i++ )
+				pDest[x + i] = 0xFF000000 | static_cast<uint32_t>( transparent - 1 - i );
+			x += transparent;
+
+			memcpy( pDest + x, pRun, sizeof( uint32_t ) * visible );
+			pRun += visible;
+			x += visible;
+		}
+	}
+}
+
+bool PlayGraphics::IsTintedWhenDrawn( const Sprite& s )
+{
+	// Indexed sprites are always coloured through their palette
+	return !s.canvasBuffer.pPixels && s.preMultAlpha.format != PIXEL_FORMAT_INDEXED8 && ( s.colour.bits & 0x00FFFFFF ) != 0x00FFFFFF;
+}
+
+//********************************************************************************************************************************
+// Function:	ReleaseCanvas - frees a sprite's straight alpha canvas to save memory
+// Parameters:	s = the sprite, whose drawing data, opaque rectangles and collision mask have already been made
+// Notes:		The drawing data is re-made uncoloured (unless it is indexed, where only the palette is coloured) so that
+//				ColourSprite can still change the colour by tinting frames as they are drawn. The canvas can be rebuilt
+//				from the drawing data by RestoreCanvas, which is exact for indexed sprites and very close for the others.
+//********************************************************************************************************************************
+void PlayGraphics::ReleaseCanvas( Sprite& s )
+{
+	PixelData& canvas = s.canvasBuffer;
+	if( !canvas.pPixels || s.keepCanvas )
+		return;
+
+	// The character widths of a font are hidden in the blue channel of its first pixels
+	s.vGlyphWidths.resize( std::min( 96, canvas.width * canvas.height ) );
+	for( size_t i = 0; i < s.vGlyphWidths.size(); i++ )
+		s.vGlyphWidths[i] = canvas.pPixels[i].b;
+
+	if( s.preMultAlpha.format != PIXEL_FORMAT_INDEXED8 && ( s.colour.bits & 0x00FFFFFF ) != 0x00FFFFFF )
+	{
+		Pixel colour = s.colour;
+		s.colour = 0x00FFFFFF;
+		if( s.vCompressed.empty() )
+			PreMultiplyAlpha( canvas, s.preMultAlpha, s.width, 1.0f, s.colour );
+		else
+			CompressDrawData( s );
+		s.colour = colour;
+	}
+
+	delete[] canvas.pPixels;
+	canvas.pPixels = nullptr;
+	canvas.stride = 0;
+	ForgetDecodedFrames( s.id );
+}
+
+void PlayGraphics::RestoreCanvas( Sprite& s )
+{
+	PixelData& canvas = s.canvasBuffer;
+	if( canvas.pPixels )
+		return;
+
+	// Any pixels outside the frames (when the canvas isn't an exact number of frames) are left transparent
+	size_t canvasPixels = static_cast<size_t>( canvas.width ) * canvas.height;
+	canvas.pPixels = new Pixel[canvasPixels];
+	canvas.stride = 0;
+	memset( static_cast<void*>( canvas.pPixels ), 0, sizeof( Pixel ) * canvasPixels );
+
+	for( int f = 0; f < s.totalCount; f++ )
+		UnpackFrame( s, f, canvas.View( { ( f % s.hCount ) * s.width, ( f / s.hCount ) * s.height, s.width, s.height } ) );
+
+	s.vGlyphWidths.clear();
+	s.vGlyphWidths.shrink_to_fit();
+
+	// The drawing data is coloured from the canvas again rather than being tinted as it is drawn
+	if( s.preMultAlpha.format != PIXEL_FORMAT_INDEXED8 && ( s.colour.bits & 0x00FFFFFF ) != 0x00FFFFFF )
+	{
+		if( s.vCompressed.empty() )
+			PreMultiplyAlpha( canvas, s.preMultAlpha, s.width, 1.0f, s.colour );
+		else
+			CompressDrawData( s );
+	}
+
+	ForgetDecodedFrames( s.id );
+}
+
+void PlayGraphics::UnpackFrame( const Sprite& s, int frameIndex, const PixelData& dest ) const
+{
+	// Compressed frames are decoded into the destination and converted where they are
+	if( !s.vCompressed.empty() )
+	{
+		DecodeFrame( s, frameIndex, dest );
+		for( int y = 0; y < s.height; y++ )
+		{
+			Pixel* pDest = dest.Row( y );
+			for( int x = 0; x < s.width; x++ )
+				pDest[x] = UnPreMultiplyPixel( pDest[x].bits );
+		}
+		return;
+	}
+
+	// Shared frames are read from the sprite which stores them
+	int frameOffset;
+	const PixelData& stored = GetFrameStorage( s, frameIndex, frameOffset );
+	const Sprite& owner = s.vFrameOwners.empty() ? s : vSpriteData[s.vFrameOwners[frameIndex]];
+
+	// Indexed sprites still have their original colours in the palette
+	if( stored.format == PIXEL_FORMAT_INDEXED8 )
+	{
+		for( int y = 0; y < s.height; y++ )
+		{
+			const uint8_t* pIndices = stored.Row8( y ) + frameOffset;
+			Pixel* pDest = dest.Row( y );
+			for( int x = 0; x < s.width; x++ )
+				pDest[x] = owner.vPalette[pIndices[x]];
+		}
+		return;
+	}
+
+	for( int y = 0; y < s.height; y++ )
+	{
+		const Pixel* pSrc = stored.Row( y ) + frameOffset;
+		Pixel* pDest = dest.Row( y );
+		for( int x = 0; x < s.width; x++ )
+			pDest[x] = UnPreMultiplyPixel( pSrc[x].bits );
+	}
+}
+
+const PixelData& PlayGraphics::GetFrameStorage( const Sprite& s, int frameIndex, int& frameOffset ) const
+{
+	if( !s.vFrameOwners.empty() )
+	{
+		frameOffset = s.vFrameOffsets[frameIndex];
+		return ( s.vFrameOwners[frameIndex] == s.id ) ? s.preMultAlpha : vSpriteData[s.vFrameOwners[frameIndex]].preMultAlpha;
+	}
+
+	int pixelX = ( frameIndex % s.hCount ) * s.width;
+	int pixelY = ( frameIndex / s.hCount ) * s.height;
+	frameOffset = pixelX + ( s.preMultAlpha.Stride() * pixelY );
+	return s.preMultAlpha;
+}
+
+uint32_t PlayGraphics::GetStoredPixel( const PixelData& data, int frameOffset, int x, int y )
+{
+	uint32_t pix = ( data.format == PIXEL_FORMAT_INDEXED8 ) ? data.pPalette[data.Row8( y )[frameOffset + x]] : data.Row( y )[frameOffset + x].bits;
+
+	// Fully transparent 32-bit pixels hold a skip value, but it only depends on the pixels next to them in the same frame
+	return ( pix >= 0xFF000000 ) ? 0xFF000000 : pix;
+}
+
+uint64_t PlayGraphics::HashWords( const uint32_t* pWords, size_t count, uint64_t hash )
+{
+	// FNV-1a
+	for( size_t i = 0; i < count; i++ )
+	{
+		hash ^= pWords[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+//********************************************************************************************************************************
+// Function:	DeduplicateFrames - makes identical sprite frames share the same pixels
+// Parameters:	s = the sprite, which has just had its drawing data made as a whole sheet
+// Notes:		Each frame is hashed and looked up in the hashes of the frames already loaded (including this sprite's
+//				earlier frames), comparing the pixels as well so a clash in the hashes never matters. Frames are compared
+//				as they are drawn (pre-multiplied, with any palette looked up) so 32-bit and indexed sprites can share.
+//				When any frame matches, the sprite's own drawing data shrinks to a strip of its remaining frames and a
+//				table says where each frame is drawn from.
+//********************************************************************************************************************************
+void PlayGraphics::DeduplicateFrames( Sprite& s )
+{
+	// Compressed sprites share identical frames' runs when they are encoded instead, and coloured ones are never shared
+	if( !s.vCompressed.empty() || !s.preMultAlpha.pPixels || ( s.colour.bits & 0x00FFFFFF ) != 0x00FFFFFF )
+		return;
+
+	std::vector<int> vOwners( s.totalCount, s.id );
+	std::vector<int> vOffsets( s.totalCount, 0 );
+	std::vector<int> vStoredFrames; // The sheet frames kept in this sprite's strip
+	std::vector<uint32_t> vRow( s.width ); // A row of a frame's pixels as they are drawn, for hashing
+	s.vFrameHashes.assign( s.totalCount, 0 );
+
+	for( int f = 0; f < s.totalCount; f++ )
+	{
+		int frameOffset;
+		const PixelData& frame = GetFrameStorage( s, f, frameOffset );
+
+		uint64_t hash = kHashSeed;
+		for( int y = 0; y < s.height; y++ )
+		{
+			for( int x = 0; x < s.width; x++ )
+				vRow[x] = GetStoredPixel( frame, frameOffset, x, y );
+			hash = HashWords( vRow.data(), vRow.size(), hash );
+		}
+		s.vFrameHashes[f] = hash;
+
+		bool shared = false;
+		std::pair<std::multimap<uint64_t, std::pair<int, int>>::const_iterator, std::multimap<uint64_t, std::pair<int, int>>::const_iterator> matches = m_frameHashes.equal_range( hash );
+		for( std::multimap<uint64_t, std::pair<int, int>>::const_iterator i = matches.first; i != matches.second && !shared; ++i )
+		{
+			const Sprite& other = vSpriteData[i->second.first];
+			int otherFrame = i->second.second;
+			if( other.width != s.width || other.height != s.height )
+				continue;
+
+			// This sprite's earlier frames are still in the sheet, so their position in the strip comes from the table being built
+			int otherOffset;
+			const PixelData& otherData = GetFrameStorage( other, otherFrame, otherOffset );
+
+			shared = true;
+			for( int y = 0; y < s.height && shared; y++ )
+			{
+				for( int x = 0; x < s.width && shared; x++ )
+					shared = GetStoredPixel( frame, frameOffset, x, y ) == GetStoredPixel( otherData, otherOffset, x, y );
+			}
+
+			if( shared )
+			{
+				vOwners[f] = ( other.id == s.id ) ? vOwners[otherFrame] : other.vFrameOwners.empty() ? other.id : other.vFrameOwners[otherFrame];
+				vOffsets[f] = ( other.id == s.id ) ? vOffsets[otherFrame] : otherOffset;
+			}
+		}
+
+		if( !shared )
+		{
+			vOffsets[f] = static_cast<int>( vStoredFrames.size() ) * s.width;
+			vStoredFrames.push_back( f );
+			m_frameHashes.insert( { hash, { s.id, f } } );
+		}
+	}
+
+	if( static_cast<int>( vStoredFrames.size() ) == s.totalCount )
+		return;
+
+	// Copy the frames which are still needed into a strip (which keeps the palette of an indexed sprite)
+	PixelData strip;
+	if( !vStoredFrames.empty() )
+	{
+		AllocateAlignedPixels( strip, static_cast<int>( vStoredFrames.size() ) * s.width, s.height, s.preMultAlpha.format );
+		strip.preMultiplied = true;
+
+		int bytesPerPixel = strip.BytesPerPixel();
+		for( size_t i = 0; i < vStoredFrames.size(); i++ )
+		{
+			int sheetOffset;
+			const PixelData& sheet = GetFrameStorage( s, vStoredFrames[i], sheetOffset );
+			for( int y = 0; y < s.height; y++ )
+				memcpy( strip.RowBytes( y ) + ( i * s.width * bytesPerPixel ), sheet.RowBytes( y ) + ( static_cast<size_t>( sheetOffset ) * bytesPerPixel ), static_cast<size_t>( s.width ) * bytesPerPixel );
+		}
+	}
+
+	strip.format = s.preMultAlpha.format;
+	strip.preMultiplied = s.preMultAlpha.preMultiplied;
+	if( strip.pPixels )
+	{
+		strip.pPalette = s.preMultAlpha.pPalette;
+		s.preMultAlpha.pPalette = nullptr;
+	}
+	FreeAlignedPixels( s.preMultAlpha );
+	s.preMultAlpha = strip;
+
+	s.vFrameOwners = vOwners;
+	s.vFrameOffsets = vOffsets;
+}
+
+void PlayGraphics::ForgetFrameHashes( Sprite& s )
+{
+	for( size_t f = 0; f < s.vFrameHashes.size(); f++ )
+	{
+		std::pair<std::multimap<uint64_t, std::pair<int, int>>::iterator, std::multimap<uint64_t, std::pair<int, int>>::iterator> matches = m_frameHashes.equal_range( s.vFrameHashes[f] );
+		for( std::multimap<uint64_t, std::pair<int, int>>::iterator i = matches.first; i != matches.second; )
+		{
+			if( i->second.first == s.id && i->second.second == static_cast<int>( f ) )
+				i = m_frameHashes.erase( i );
+			else
+				++i;
+		}
+	}
+
+	s.vFrameHashes.clear();
+}
+
+void PlayGraphics::UnshareFrames( Sprite& s )
+{
+	// Only sprites with hashed frames can have had them shared
+	if( !s.vFrameOwners.empty() )
+	{
+		RebuildDrawData( s );
+	}
+	else if( !s.vFrameHashes.empty() )
+	{
+		ForgetFrameHashes( s );
+		RebuildBorrowers( s.id );
+	}
+}
+
+void PlayGraphics::RebuildBorrowers( int spriteId )
+{
+	for( Sprite& other : vSpriteData )
+	{
+		if( other.id != spriteId && std::find( other.vFrameOwners.begin(), other.vFrameOwners.end(), spriteId ) != other.vFrameOwners.end() )
+		{
+			// The borrower keeps what it can still share with the other sprites
+			RebuildDrawData( other );
+			DeduplicateFrames( other );
+		}
+	}
+}
+
+void PlayGraphics::RebuildDrawData( Sprite& s )
+{
+	// A freed canvas is rebuilt from the shared frames while they are still there
+	bool released = !s.canvasBuffer.pPixels;
+	if( released )
+		RestoreCanvas( s );
+
+	ReleaseDrawData( s );
+	CreateDrawData( s );
+
+	if( released )
+		ReleaseCanvas( s );
+}
+
+void PlayGraphics::ReportSharedFrames() const
+{
+	char buffer[512];
+	int totalBytes = 0;
+
+	for( const Sprite& s : vSpriteData )
+	{
+		SpriteMemoryInfo info = GetSpriteMemoryInfo( s.id );
+		if( info.sharedFrames == 0 )
+			continue;
+
+		if( totalBytes == 0 )
+		{
+			DebugOutput( "****************************************************\n" );
+			DebugOutput( "SHARED SPRITE FRAMES\n" );
+			DebugOutput( "****************************************************\n" );
+		}
+
+		sprintf_s( buffer, "%s: %d of %d frames shared, saving %d bytes\n", s.name.c_str(), info.sharedFrames, s.totalCount, info.sharedBytes );
+		DebugOutput( buffer );
+		totalBytes += info.sharedBytes;
+	}
+
+	if( totalBytes > 0 )
+	{
+		sprintf_s( buffer, "Total saved = %d bytes\n", totalBytes );
+		DebugOutput( buffer );
+		DebugOutput( "**************************************************\n" );
+	}
+}
+
+//********************************************************************************************************************************
+// Sprite memory functions
+//********************************************************************************************************************************
+
+void PlayGraphics::CompressSprite( int spriteId, bool compress )
+{
+	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to compress invalid sprite id" );
+
+	// Recorded draws of this sprite need to use the old data
+	FlushDeferredDraws();
+
+	// The drawing data is always made from the canvas, so a freed one is rebuilt while it changes
+	Sprite& s = vSpriteData[spriteId];
+	bool released = !s.canvasBuffer.pPixels;
+	if( released )
+		RestoreCanvas( s );
+
+	if( compress )
+	{
+		CompressDrawData( s );
+	}
+	else if( !s.vCompressed.empty() )
+	{
+		ReleaseDrawData( s );
+		CreateDrawData( s );
+		DeduplicateFrames( s );
+	}
 
-					// Source pixels are already multiplied by srcAlpha so we just apply the constant alpha multiplier
-					int destRed = constAlpha * ( ( src >> 16 ) & 0xFF );
-					int destGreen = constAlpha * ( ( src >> 8 ) & 0xFF );
-					int destBlue = constAlpha * ( src & 0xFF );
+	if( released )
+		ReleaseCanvas( s );
+}
 
-					int invSrcAlpha = 0xFF - srcAlpha;
+void PlayGraphics::SetSpriteMemorySaving( bool enable )
+{
+	m_bSpriteMemorySaving = enable;
+	if( !enable )
+		return;
 
-					// Apply a standard Alpha blend [ src*srcAlpha + dest*(1-SrcAlpha) ]
-					destRed += invSrcAlpha * ( ( dest >> 16 ) & 0xFF );
-					destGreen += invSrcAlpha * ( ( dest >> 8 ) & 0xFF );
-					destBlue += invSrcAlpha * ( dest & 0xFF );
+	// Recorded draws may use the drawing data which is re-made uncoloured
+	FlushDeferredDraws();
 
-					// Bring back to the range 0-255
-					destRed >>= 8;
-					destGreen >>= 8;
-					destBlue >>= 8;
+	for( Sprite& s : vSpriteData )
+		ReleaseCanvas( s );
+	ClearTextLayouts();
+}
 
-					// Put ARGB components back together again
-					*destPixels++ = 0xFF000000 | ( destRed << 16 ) | ( destGreen << 8 ) | destBlue;
-				}
-				else
-				{
-					// If this is a fully transparent pixel then the low bits store how many there are in a row
-					// This means we can skip to the next pixel which isn't fully transparent
-					uint32_t skip = static_cast<uint32_t>( destRowEnd - destPixels ) - 1;
-					src = src & 0x00FFFFFF;
-					if( skip > src ) skip = src;
+SpriteMemoryInfo PlayGraphics::GetSpriteMemoryInfo( int spriteId ) const
+{
+	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to get memory for invalid sprite id" );
 
-					srcPixels += skip;
-					++destPixels += skip;
-				}
-			}
-			// Increase buffers by pre-calculated amounts
-			destPixels += destInc;
-			srcPixels += srcInc;
-		}
+	const Sprite& s = vSpriteData[spriteId];
+	SpriteMemoryInfo info;
+	info.canvasBytes = s.canvasBuffer.pPixels ? static_cast<int>( sizeof( Pixel ) * s.canvasBuffer.Stride() * s.canvasBuffer.height ) : 0;
+	info.maskBytes = static_cast<int>( ( sizeof( uint32_t ) * s.vCollisionMask.size() ) + s.vGlyphWidths.size() );
+	info.uncompressedBytes = static_cast<int>( sizeof( Pixel ) * s.canvasBuffer.width * s.canvasBuffer.height );
+	info.indexed = s.preMultAlpha.format == PIXEL_FORMAT_INDEXED8;
+	info.compressed = !s.vCompressed.empty();
 
-	}
-	else
-	{
-		// *******************************************************************************************************************************************************
-		// An optimized approach which uses pre-multiplied alpha, parallel channel multiplication and pixel skipping to achieve the same 'typical' alpha 
-		// blending operation (src * srcAlpha)+(dest * (1-srcAlpha)). Not easy to apply a global alpha multiplication over the top, but used everywhere else.
-		// *******************************************************************************************************************************************************
+	if( info.compressed )
+		info.drawBytes = static_cast<int>( ( sizeof( uint32_t ) * s.vCompressed.size() ) + ( sizeof( size_t ) * s.vFrameStarts.size() ) );
+	else if( s.preMultAlpha.pPixels )
+		info.drawBytes = ( s.preMultAlpha.BytesPerPixel() * s.preMultAlpha.Stride() * s.preMultAlpha.height ) + static_cast<int>( s.preMultAlpha.pPalette ? sizeof( uint32_t ) * s.vPalette.size() : 0 );
+	info.drawBytes += static_cast<int>( ( sizeof( int ) * ( s.vFrameOwners.size() + s.vFrameOffsets.size() ) ) + ( sizeof( uint64_t ) * s.vFrameHashes.size() ) );
+	info.drawBytes += static_cast<int>( sizeof( Pixel ) * s.tintedFrames.Stride() * s.tintedFrames.height );
 
-		// Slightly more optimised iterations without the additions in the loop
-		while( destPixels < destColEnd )
+	// Frames drawn from the pixels of an identical frame (frames are shared with an earlier one, or another sprite's)
+	for( int f = 0; f < s.totalCount; f++ )
+	{
+		if( info.compressed )
 		{
-			uint32_t* destRowEnd = destPixels + endRow;
+			size_t start = s.vFrameStarts[f];
+			if( std::find( s.vFrameStarts.begin(), s.vFrameStarts.begin() + f, start ) == s.vFrameStarts.begin() + f )
+				continue;
 
-			while( destPixels < destRowEnd )
+			const uint32_t* pRun = s.vCompressed.data() + start;
+			for( int y = 0; y < s.height; y++ )
 			{
-				uint32_t src = *srcPixels++;
-				uint32_t dest = *destPixels;
+				for( int x = 0; x < s.width; pRun += 1 + ( *pRun & 0xFFFF ) )
+					x += static_cast<int>( ( *pRun >> 16 ) + ( *pRun & 0xFFFF ) );
+			}
 
-				// If this isn't a fully transparent pixel 
-				if( src < 0xFF000000 )
-				{
-					// This performes the dest*(1-srcAlpha) calculation for all channels in parallel with minor accuracy loss in dest colour.
-					// It does this by shifting all the destination channels down by 4 bits in order to "make room" for the later multiplication.
-					// After shifting down, it masks out the bits which have shifted into the adjacent channel data.
-					// This causes the RGB data to be rounded down to their nearest 16 producing a reduction in colour accuracy.
-					// This is then multiplied by the inverse alpha (inversed in PreMultiplyAlpha), also divided by 16 (hence >> 8+8+8+4).
-					// The multiplication brings our RGB values back up to their original bit ranges (albeit rounded to the nearest 16).
-					// As the colour accuracy only affects the destination pixels behind semi-transparent source pixels and so isn't very obvious.
-					dest = ( ( ( dest >> 4 ) & 0x000F0F0F ) * ( src >> 28 ) );
-					// Add the (pre-multiplied Alpha) source to the destination and force alpha to opaque
-					*destPixels++ = ( src + dest ) | 0xFF000000;
-				}
-				else
-				{
-					// If this is a fully transparent pixel then the low bits store how many there are in a row
-					// This means we can skip to the next pixel which isn't fully transparent
-					uint32_t skip = static_cast<uint32_t>( destRowEnd - destPixels ) - 1;
-					src = src & 0x00FFFFFF;
-					if( skip > src ) skip = src;
+			info.sharedFrames++;
+			info.sharedBytes += static_cast<int>( sizeof( uint32_t ) * ( pRun - ( s.vCompressed.data() + start ) ) );
+		}
+		else if( !s.vFrameOwners.empty() )
+		{
+			bool shared = s.vFrameOwners[f] != s.id;
+			for( int g = 0; g < f && !shared; g++ )
+				shared = s.vFrameOwners[g] == s.id && s.vFrameOffsets[g] == s.vFrameOffsets[f];
 
-					srcPixels += skip;
-					++destPixels += skip;
-				}
+			if( shared )
+			{
+				info.sharedFrames++;
+				info.sharedBytes += s.width * s.height * s.preMultAlpha.BytesPerPixel();
 			}
-			// Increase buffers by pre-calculated amounts
-			destPixels += destInc;
-			srcPixels += srcInc;
 		}
+	}
+
+	LARGE_INTEGER freq;
+	QueryPerformanceFrequency( &freq );
+	info.frameDecodes = s.frameDecodes;
+	info.decodeMillisecs = static_cast<float>( ( s.decodeTicks * 1000.0 ) / freq.QuadPart );
+	return info;
+}
+
+void PlayGraphics::ReportSpriteMemory() const
+{
+	char buffer[512];
+	int totalBytes = 0;
+	int sharedBytes = 0;
+
+	DebugOutput( "****************************************************\n" );
+	DebugOutput( "SPRITE MEMORY\n" );
+	DebugOutput( "****************************************************\n" );
+
+	for( const Sprite& s : vSpriteData )
+	{
+		SpriteMemoryInfo info = GetSpriteMemoryInfo( s.id );
+		const char* format = info.compressed ? "compressed" : ( info.indexed ? "indexed" : "32-bit" );
+
+		sprintf_s( buffer, "%s: canvas %d bytes, mask %d bytes, drawing %d bytes %s (%d%% of 32-bit), %d shared frames saving %d bytes, %d frame decodes taking %.3fms\n",
+			s.name.c_str(), info.canvasBytes, info.maskBytes, info.drawBytes, format, ( 100 * info.drawBytes ) / std::max( info.uncompressedBytes, 1 ), info.sharedFrames, info.sharedBytes, info.frameDecodes, info.decodeMillisecs );
+		DebugOutput( buffer );
 
+		totalBytes += info.canvasBytes + info.maskBytes + info.drawBytes;
+		sharedBytes += info.sharedBytes;
 	}
 
-	return;
+	sprintf_s( buffer, "Total = %d bytes (%d bytes saved by sharing frames)\n", totalBytes, sharedBytes );
+	DebugOutput( buffer );
+	DebugOutput( "**************************************************\n" );
+}
+
+void PlayGraphics::CalculateOpaqueRects( Sprite& s )
+{
+	s.vOpaqueRects.assign( s.totalCount, PixelRect() );
+	for( int f = 0; f < s.totalCount; f++ )
+		CalculateOpaqueRect( s, f );
 }
 
 //********************************************************************************************************************************
-// Function:	RotateScaleSprite - draws a rotated and scaled sprite with global alpha multiply
-// Parameters:	s = the sprite to draw
-//				xpos, ypos = the position of the center of rotation.
-//				frameIndex = which frame of the animation to draw (wrapped)
-//				angle = rotation angle
-//				scale = parameter to magnify the sprite.
-//				rotOffX, rotOffY = offset of centre of rotation to the top left of the sprite
-//				alpha = the fraction defining the amount of sprite and background that is draw. 255 = all sprite, 0 = all background.
-// Notes:		Pre-calculates roughly where the sprite will be in the display buffer and only processes those pixels. 
-//				Approx 15 times slower than not rotating.
+// Function:	CalculateOpaqueRect - finds the largest rectangle of fully-opaque pixels in a sprite frame
+// Parameters:	s = the sprite, frameIndex = the frame to calculate the rectangle for
+// Notes:		Works down the frame keeping a count of the opaque pixels directly above each pixel, so each row is a histogram
+//				whose largest rectangle can be found in a single pass using a stack (O(width*height) overall)
 //********************************************************************************************************************************
-void PlayBlitter::RotateScalePixels( const PixelData& srcPixelData, int srcOffset, int blitX, int blitY, int blitWidth, int blitHeight, int originX, int originY, float angle, float scale, float alphaMultiply ) const
+void PlayGraphics::CalculateOpaqueRect( Sprite& s, int frameIndex )
 {
-	PLAY_ASSERT_MSG( m_pRenderTarget, "Render target not set for PlayBlitter" );
+	int frameX = ( frameIndex % s.hCount ) * s.width;
+	int frameY = ( frameIndex / s.hCount ) * s.height;
 
-	//pointers to start of source and destination buffers
-	uint32_t* pSrcBase = &srcPixelData.pPixels->bits + srcOffset;
-	uint32_t* pDstBase = &m_pRenderTarget->pPixels->bits;
+	// An extra zero-height column at the end empties the stack on every row
+	std::vector<int> heights( static_cast<size_t>( s.width ) + 1, 0 );
+	std::vector<int> stack;
+	PixelRect best;
 
-	//the centre of rotation in the sprite frame relative to the top corner
-	float fRotCentreU = static_cast<float>( originX );
-	float fRotCentreV = static_cast<float>( originY );
+	for( int y = 0; y < s.height; y++ )
+	{
+		// The canvas is used as it is always 32-bit (the drawing data may be indexed)
+		const Pixel* pRow = s.canvasBuffer.Row( frameY + y ) + frameX;
 
-	//u/v are co-ordinates in the rotated sprite frame. x/y are screen buffer co-ordinates.
-	//change in u/v for a unit change in x/y.
-	float dUdX = static_cast<float>( cos( -angle ) ) * ( 1.0f / scale );
-	float dVdX = static_cast<float>( sin( -angle ) ) * ( 1.0f / scale );
-	float dUdY = -dVdX;
-	float dVdY = dUdX;
+		for( int x = 0; x < s.width; x++ )
+			heights[x] = ( pRow[x].a == 0xFF ) ? heights[x] + 1 : 0;
 
-	//Position in the sprite rotated frame with origin at the center of rotation of the sprite corners.
-	float leftU = -fRotCentreU * scale;
-	float rightU = ( blitWidth + -fRotCentreU ) * scale;
-	float topV = ( -fRotCentreV ) * scale;
-	float bottomV = ( blitHeight - fRotCentreV ) * scale;
+		stack.clear();
+		for( int x = 0; x <= s.width; x++ )
+		{
+			while( !stack.empty() && heights[stack.back()] >= heights[x] )
+			{
+				int h = heights[stack.back()];
+				stack.pop_back();
+				int left = stack.empty() ? 0 : stack.back() + 1;
 
-	//Scale added in to cancel out the scale in dUdX.
-	float boundingBoxCorners[4][2]
-	{
-		{ ( dUdX * leftU + dVdX * topV ) * scale,			( dUdY * leftU + dVdY * topV ) * scale		},	// Top left
-		{ ( dUdX * leftU + dVdX * bottomV ) * scale,		( dUdY * leftU + dVdY * bottomV ) * scale		},	// Bottom left
-		{ ( dUdX * rightU + dVdX * bottomV ) * scale,		( dUdY * rightU + dVdY * bottomV ) * scale	},	// Bottom right
-		{ ( dUdX * rightU + dVdX * topV ) * scale,			( dUdY * rightU + dVdY * topV ) * scale,		},	// Top right
-	};
+				if( h * ( x - left ) > best.width * best.height )
+					best = { left, y - h + 1, x - left, h };
+			}
+			stack.push_back( x );
+		}
+	}
 
-	float minX = std::numeric_limits<float>::infinity();
-	float minY = std::numeric_limits<float>::infinity();
-	float maxX = -std::numeric_limits<float>::infinity();
-	float maxY = -std::numeric_limits<float>::infinity();
+	s.vOpaqueRects[frameIndex] = best;
+}
 
-	//calculate the extremes of the rotated corners.
-	for( int i = 0; i < 4; i++ )
+void PlayGraphics::CalculateCollisionMask( Sprite& s, PixelRect rect )
+{
+	const PixelData& canvas = s.canvasBuffer;
+	int maskStride = ( canvas.width + 31 ) / 32;
+
+	if( s.maskStride != maskStride || s.vCollisionMask.size() != static_cast<size_t>( maskStride ) * canvas.height )
 	{
-		minX = std::min( minX, boundingBoxCorners[i][0] );
-		maxX = std::max( maxX, boundingBoxCorners[i][0] );
-		minY = std::min( minY, boundingBoxCorners[i][1] );
-		maxY = std::max( maxY, boundingBoxCorners[i][1] );
+		s.maskStride = maskStride;
+		s.vCollisionMask.assign( static_cast<size_t>( maskStride ) * canvas.height, 0 );
+		rect = { 0, 0, canvas.width, canvas.height };
 	}
 
-	//clip the starting and finishing positions.
-	int startY = blitY + static_cast<int>( minY );
-	if( startY < 0 ) { startY = 0; minY = static_cast<float>( -blitY ); }
+	// The same test the collisions used on the canvas: any pixel which isn't fully transparent
+	for( int y = rect.y; y < rect.y + rect.height; y++ )
+	{
+		const Pixel* pRow = canvas.Row( y );
+		uint32_t* pMask = s.vCollisionMask.data() + ( static_cast<size_t>( maskStride ) * y );
 
-	int endY = blitY + static_cast<int>( maxY );
-	if( endY > m_pRenderTarget->height ) { endY = m_pRenderTarget->height; }
+		for( int x = rect.x; x < rect.x + rect.width; x++ )
+		{
+			if( pRow[x].a != 0x00 )
+				pMask[x >> 5] |= 1u << ( x & 31 );
+			else
+				pMask[x >> 5] &= ~( 1u << ( x & 31 ) );
+		}
+	}
+}
 
-	int startX = blitX + static_cast<int>( minX );
-	if( startX < 0 ) { startX = 0; minX = static_cast<float>( -blitX ); }
+bool PlayGraphics::IsMaskSet( const Sprite& s, int x, int y )
+{
+	if( x < 0 || y < 0 || x >= s.canvasBuffer.width || y >= s.canvasBuffer.height )
+		return false;
 
-	int endX = blitX + static_cast<int>( maxX );
-	if( endX > m_pRenderTarget->width ) { endX = m_pRenderTarget->width; }
+	return ( s.vCollisionMask[( static_cast<size_t>( s.maskStride ) * y ) + ( x >> 5 )] >> ( x & 31 ) ) & 1;
+}
 
-	//rotate the basis so we get the edge of the bounding box in the sprite frame.
-	float startingU = dUdX * minX + dUdY * minY + fRotCentreU;
-	float startingV = dVdY * minY + dVdX * minX + fRotCentreV;
+//********************************************************************************************************************************
+// Basic drawing functions
+//********************************************************************************************************************************
 
-	float rowU = startingU;
-	float rowV = startingV;
 
-	uint32_t* destPixels = pDstBase + ( static_cast<size_t>( m_pRenderTarget->width ) * startY ) + startX;
-	int nextRow = m_pRenderTarget->width - ( endX - startX );
 
-	uint32_t* srcPixels = pSrcBase;
+void PlayGraphics::DrawPixel( Point2f pos, Pixel srcPix )
+{
+	FlushDeferredDraws();
 
-	//Start of double for loop. 
-	for( int y = startY; y < endY; y++ )
+	// Convert floating point co-ordinates to pixels
+	pos = ToRenderTarget( pos );
+	m_blitter.DrawPixel( static_cast<int>( std::floor( pos.x + 0.5f ) ), static_cast<int>( std::floor( pos.y + 0.5f ) ), srcPix );
+}
+
+void PlayGraphics::DrawLine( Point2f startPos, Point2f endPos, Pixel pix )
+{
+	FlushDeferredDraws();
+
+	// Convert floating point co-ordinates to pixels
+	startPos = ToRenderTarget( startPos );
+	endPos = ToRenderTarget( endPos );
+	int x1 = static_cast<int>( std::floor( startPos.x + 0.5f ) );
+	int y1 = static_cast<int>( std::floor( startPos.y + 0.5f ) );
+	int x2 = static_cast<int>( std::floor( endPos.x + 0.5f ) );
+	int y2 = static_cast<int>( std::floor( endPos.y + 0.5f ) );
+
+	m_blitter.DrawLine( x1, y1, x2, y2, pix );
+}
+
+
+
+
+void PlayGraphics::DrawRect( Point2f topLeft, Point2f bottomRight, Pixel pix, bool fill )
+{
+	FlushDeferredDraws();
+
+	// Convert floating point co-ordinates to pixels
+	topLeft = ToRenderTarget( topLeft );
+	bottomRight = ToRenderTarget( bottomRight );
+	int x1 = static_cast<int>( std::floor( topLeft.x + 0.5f ) );
+	int x2 = static_cast<int>( std::floor( bottomRight.x + 0.5f ) );
+	int y1 = static_cast<int>( std::floor( topLeft.y + 0.5f ) );
+	int y2 = static_cast<int>( std::floor( bottomRight.y + 0.5f ) );
+
+	if( fill )
 	{
-		float u = rowU;
-		float v = rowV;
+		m_blitter.FillRect( x1, y1, x2, y2, pix );
+	}
+	else if( x1 == x2 || y1 == y2 )
+	{
+		// A rectangle with no width or height is a single line, which would otherwise be drawn over itself
+		m_blitter.DrawLine( x1, y1, x2, y2, pix );
+	}
+	else
+	{
+		// Each edge leaves out its first pixel (the last pixel of the edge before), so translucent corners only blend once
+		m_blitter.DrawLine( x1, y1, x2, y1, pix, false );
+		m_blitter.DrawLine( x2, y1, x2, y2, pix, false );
+		m_blitter.DrawLine( x2, y2, x1, y2, pix, false );
+		m_blitter.DrawLine( x1, y2, x1, y1, pix, false );
+	}
+}
 
-		for( int x = startX; x < endX; x++ )
-		{
-			//Check to see if u and v correspond to a valid pixel in sprite.
-			if( u > 0 && v > 0 && u < blitWidth && v < blitHeight )
-			{
-				srcPixels = pSrcBase + static_cast<size_t>( u ) + ( static_cast<size_t>( v ) * srcPixelData.width );
-				uint32_t src = *srcPixels;
+void PlayGraphics::DrawPoints( const std::vector<Point2f>& points, const std::vector<Pixel>& colours )
+{
+	FlushDeferredDraws();
 
-				if( src < 0xFF000000 )
-				{
-					int srcAlpha = static_cast<int>( ( 0xFF - ( src >> 24 ) ) * alphaMultiply );
-					int constAlpha = static_cast<int>( 255 * alphaMultiply );
+	if( m_drawScale == 1.0f )
+	{
+		m_blitter.DrawPoints( points, colours );
+		return;
+	}
 
-					// Source pixels are already multiplied by srcAlpha so we just apply the constant alpha multiplier
-					int destRed = constAlpha * ( ( src >> 16 ) & 0xFF );
-					int destGreen = constAlpha * ( ( src >> 8 ) & 0xFF );
-					int destBlue = constAlpha * ( src & 0xFF );
+	m_vScaledPoints.resize( points.size() );
+	for( size_t i = 0; i < points.size(); i++ )
+		m_vScaledPoints[i] = ToRenderTarget( points[i] );
 
-					uint32_t dest = *destPixels;
-					int invSrcAlpha = 0xFF - srcAlpha;
+	m_blitter.DrawPoints( m_vScaledPoints, colours );
+}
 
-					// Apply a standard Alpha blend [ src*srcAlpha + dest*(1-SrcAlpha) ]
-					destRed += invSrcAlpha * ( ( dest >> 16 ) & 0xFF );
-					destGreen += invSrcAlpha * ( ( dest >> 8 ) & 0xFF );
-					destBlue += invSrcAlpha * ( dest & 0xFF );
+void PlayGraphics::DrawPolyline( const std::vector<Point2f>& points, Pixel pix, bool closed )
+{
+	FlushDeferredDraws();
 
-					// Bring back to the range 0-255
-					destRed >>= 8;
-					destGreen >>= 8;
-					destBlue >>= 8;
+	if( points.size() < 2 || pix.a == 0x00 )
+		return;
 
-					// Put ARGB components back together again
-					*destPixels = 0xFF000000 | ( destRed << 16 ) | ( destGreen << 8 ) | destBlue;
-				}
-			}
+	// Convert floating point co-ordinates to pixels
+	Point2f start = ToRenderTarget( points[0] );
+	int startX = static_cast<int>( std::floor( start.x + 0.5f ) );
+	int startY = static_cast<int>( std::floor( start.y + 0.5f ) );
+	int firstX = startX, firstY = startY;
 
-			destPixels++;
+	// Every line after the first starts on the last pixel of the previous line, so only the first line draws its start
+	// > In a closed polyline the closing line ends on the first pixel, so that draws it instead
+	bool drawStart = !closed;
 
-			// Change the position in the sprite frame for changing X in the display
-			u += dUdX;
-			v += dVdX;
-		}
+	for( size_t i = 1; i < points.size(); i++ )
+	{
+		Point2f end = ToRenderTarget( points[i] );
+		int endX = static_cast<int>( std::floor( end.x + 0.5f ) );
+		int endY = static_cast<int>( std::floor( end.y + 0.5f ) );
 
-		// Work out the change in the sprite frame for changing Y in the display
-		rowU += dUdY;
-		rowV += dVdY;
-		// Next row
-		destPixels += nextRow;
+		if( endX == startX && endY == startY )
+			continue;
+
+		m_blitter.DrawLine( startX, startY, endX, endY, pix, drawStart );
+		drawStart = false;
+
+		startX = endX;
+		startY = endY;
 	}
 
+	if( closed )
+	{
+		if( startX != firstX || startY != firstY )
+			m_blitter.DrawLine( startX, startY, firstX, firstY, pix, false );
+		else
+			m_blitter.DrawPixel( firstX, firstY, pix );
+	}
 }
 
-
-void PlayBlitter::ClearRenderTarget( Pixel colour )
+void PlayGraphics::DrawCircle( Point2f pos, int radius, Pixel pix, bool fill )
 {
-	Pixel* pBuffEnd = m_pRenderTarget->pPixels + ( m_pRenderTarget->width * m_pRenderTarget->height );
-	for( Pixel* pBuff = m_pRenderTarget->pPixels; pBuff < pBuffEnd; *pBuff++ = colour.bits );
-	m_pRenderTarget->preMultiplied = false;
+	FlushDeferredDraws();
+
+	// Convert floating point co-ordinates to pixels
+	pos = ToRenderTarget( pos );
+	if( m_drawScale != 1.0f )
+		radius = static_cast<int>( ( radius * m_drawScale ) + 0.5f );
+
+	m_blitter.DrawCircle( static_cast<int>( std::floor( pos.x + 0.5f ) ), static_cast<int>( std::floor( pos.y + 0.5f ) ), radius, pix, fill );
 }
 
-void PlayBlitter::BlitBackground( PixelData& backgroundImage )
+void PlayGraphics::DrawPixelData( PixelData* pixelData, Point2f pos, float alpha )
 {
-	PLAY_ASSERT_MSG( backgroundImage.height == m_pRenderTarget->height && backgroundImage.width == m_pRenderTarget->width, "Background size doesn't match render target!" );
-	// Takes about 1ms for 720p screen on i7-8550U
-	memcpy( m_pRenderTarget->pPixels, backgroundImage.pPixels, sizeof( Pixel ) * m_pRenderTarget->width * m_pRenderTarget->height );
-}
+	FlushDeferredDraws();
 
+	if( !pixelData->preMultiplied )
+	{
+		PreMultiplyAlpha( *pixelData, *pixelData, pixelData->width );
+		pixelData->preMultiplied = true;
+	}
 
-//********************************************************************************************************************************
-// File:		PlayGraphics.cpp
-// Description:	Manages 2D graphics operations on a PixelData buffer 
-// Platform:	Independent
-// Notes:		Uses PNG format. The end of the filename indicates the number of frames e.g. "bat_4.png" or "tiles_10x10.png"
-//********************************************************************************************************************************
+	if( m_drawScale != 1.0f )
+	{
+		pos = ToRenderTarget( pos );
+		m_blitter.ScalePixels( *pixelData, 0, static_cast<int>( pos.x ), static_cast<int>( pos.y ), pixelData->width, pixelData->height, 0, 0, m_drawScale, alpha );
+		return;
+	}
 
+	m_blitter.BlitPixels( *pixelData, 0, static_cast<int>(pos.x), static_cast<int>(pos.y), pixelData->width, pixelData->height, alpha );
+}
 
-PlayGraphics* PlayGraphics::s_pInstance = nullptr;
 
 //********************************************************************************************************************************
-// Constructor / Destructor (Private)
+// Debug font functions
 //********************************************************************************************************************************
 
-PlayGraphics::PlayGraphics( int bufferWidth, int bufferHeight, const char* path )
-{
-	// A working buffer for our display. Each pixel is stored as an unsigned 32-bit integer: alpha<<24 | red<<16 | green<<8 | blue
-	m_playBuffer.width = bufferWidth;
-	m_playBuffer.height = bufferHeight;
-	m_playBuffer.pPixels = new Pixel[static_cast<size_t>( bufferWidth ) * bufferHeight];
-	m_playBuffer.preMultiplied = false;
-	PLAY_ASSERT( m_playBuffer.pPixels );
-
-	memset( m_playBuffer.pPixels, 0, sizeof( uint32_t ) * bufferWidth * bufferHeight );
-
-	// Make the display buffer the render target for the blitter
-	m_blitter.SetRenderTarget( &m_playBuffer );
+// Settings for the embedded debug font
+#define FONT_IMAGE_WIDTH	96
+#define FONT_IMAGE_HEIGHT	36
+#define FONT_CHAR_WIDTH		6
+#define FONT_CHAR_HEIGHT	12
 
-	// Iterate through the directory
-	PLAY_ASSERT_MSG( std::filesystem::exists( path ), "PlayBuffer: Drectory provided does not exist." );
+// A 96x36 font image @ 1bpp containing basic ASCII characters from 0x30 (0) to 0x5F (underscore) at 6x12 pixels each
+static const uint32_t debugFontData[] =
+{
+	0x87304178, 0x0800861F, 0xFFFFFFE1, 0x7BBFBE79, 0xF7FE79EF, 0xFFFFFFFE, 0x7BBFBE79, 0xF7FE79EC, 0xFFFFFFFE, 0x7BBFBE79, 0xF7FE79EC, 0xFFFFFFFE, 0x7BBFBE79, 0xF7FE79EF, 0xFFEE3DFE, 0x6BB86080,
+	0x1078860F, 0xE3DFFEFE, 0x5BB7FEFB, 0xE7BE7BEF, 0xFFBFFF41, 0x7BB7FEFB, 0xE7BE7BEC, 0xFFDFFEDF, 0x7BB7FEFB, 0xE7BE7BEC, 0xFFEE3DDF, 0x7BB7FEFB, 0xE7BE7BEF, 0xFFFFFFFF, 0x7BB7BEF9, 0xE7BE7BEF,
+	0xFFFFFFDF, 0x87B001F8, 0x187E87EF, 0xFFFFFFDF, 0x86106104, 0x00007A30, 0x1E7C5061, 0x79E79E79, 0xF7DF7B7F, 0x5E7DA79E, 0x79E79F79, 0xF7DF7B7F, 0x5E7DA79E, 0x79E79F79, 0xF7DF7B7F, 0x5E7DA79E,
+	0x59E79F79, 0xF7DF7B7F, 0x597DA79E, 0x58005F78, 0x30D0037F, 0x477DA79E, 0x59E79F79, 0xF7DE7B7F, 0x597DA79E, 0x59E79F79, 0xF7DE7B7F, 0x5E7DA79E, 0x41E79F79, 0xF7DE7B7F, 0x5E7DA79E, 0x7DE79F79,
+	0xF7DE7B7F, 0x5E7DA79E, 0x7DE79E79, 0xF7DE7B7F, 0x5E7DA79E, 0x81E06104, 0x07C17A38, 0xDE01A7A1, 0x06106101, 0xE79E79E0, 0x337F3FFF, 0x79E79EED, 0xE79E79EF, 0xB77FBFFF, 0x79E79FED, 0xE79E79EF,
+	0xB7BFBFFF, 0x79E79FED, 0xE79A79EF, 0xB7BFBFFF, 0x79E75FED, 0xE79AB5EF, 0x77DFBFFF, 0x05E0E1ED, 0xE79ACC0E, 0xF7DFBFFF, 0x7DE77EED, 0xE79AB7ED, 0xF7EFBFFF, 0x7DE7BEED, 0xE79A7BEB, 0xF7EFBFFF,
+	0x7DE7BEED, 0xE79A7BE7, 0xF7F7BFFF, 0x7DA7BEED, 0xE79A7BE7, 0xF7F7BCFF, 0x7DD79EED, 0xEB5A7BE7, 0xF7FBBCFF, 0x7C27A1EE, 0x1CE57810, 0x33FB3EC0
+};
 
-	for( const auto& p : std::filesystem::directory_iterator( path ) )
+void PlayGraphics::DecompressDubugFont( void )
+{
+	for( int c = 0; c < 48; c++ )
 	{
-		// Switch everything to uppercase to avoid need to check case each time
-		std::string filename = p.path().string();
-		for( char& c : filename ) c = static_cast<char>( toupper( c ) );
+		int sourceX = ( c % 16 ) * FONT_CHAR_WIDTH;
+		int sourceY = ( c / 16 ) * FONT_CHAR_HEIGHT;
 
-		// Only attempt to load PNG files
-		if( filename.find( ".PNG" ) != std::string::npos )
+		for( int y = 0; y < FONT_CHAR_HEIGHT; y++ )
 		{
-			std::ifstream png_infile;
-			png_infile.open( filename, std::ios::binary ); // Don't do this as part of the constructor or we lose 16 bytes!
+			uint8_t mask = 0;
 
-			// If the PNG was opened okay
-			if( png_infile )
+			for( int x = 0; x < FONT_CHAR_WIDTH; x++ )
 			{
-				int spriteId = LoadSpriteSheet( p.path().parent_path().string() + "\\", p.path().stem().string() );
-
-				// Now we check for .inf file for each sprite and load origins
-				int originX = 0, originY = 0;
-
-				std::string info_filename = filename.replace( filename.find( ".PNG" ), 4, ".INF" );
-
-				if( std::filesystem::exists( info_filename ) )
-				{
-					std::ifstream info_infile;
-					info_infile.open( info_filename, std::ios::in );
-
-					PLAY_ASSERT_MSG( info_infile.is_open(), std::string( "Unable to load existing .inf file: " + info_filename ).c_str() );
-					if( info_infile.is_open() )
-					{
-						std::string type;
-						info_infile >> type;
-						info_infile >> originX;
-						info_infile >> originY;
-					}
-
-					info_infile.close();
-				}
+				int dataIndex = ( ( sourceY + y ) * FONT_IMAGE_WIDTH ) + sourceX + x;
 
-				SetSpriteOrigin( spriteId, { originX, originY } );
+				// The 1bpp data uses a clear bit for a pixel
+				if( ( ( debugFontData[dataIndex / 32] >> ( 31 - ( dataIndex % 32 ) ) ) & 0x01 ) == 0 )
+					mask |= 1 << x;
 			}
 
-			png_infile.close();
+			m_debugFontMasks[c][y] = mask;
 		}
 	}
+
+	m_bDebugFontReady = true;
 }
 
-PlayGraphics::~PlayGraphics()
+int PlayGraphics::GetDebugCharacterIndex( char c )
 {
-	for( Sprite& s : vSpriteData )
+	// Limited character set in the font (0x30-0x5F) so includes translation of useful chars outside that range
+	switch( c )
 	{
-		if( s.canvasBuffer.pPixels )
-			delete[] s.canvasBuffer.pPixels;
-
-		if( s.preMultAlpha.pPixels )
-			delete[] s.preMultAlpha.pPixels;
+		case 0x2C: c = 0x5E; break; // Map full stop to comma (nearly the same!)
+		case 0x2D: c = 0x3B; break; // Map minus to semi-colon (rarely used)
+		case 0x28: c = 0x5B; break; // Map brackets to square brackets
+		case 0x29: c = 0x5D; break; // Map brackets to square brackets
+		case 0x2E: c = 0x5E; break; // Map full stop to carot (never used)
 	}
 
-	for( PixelData& pBgBuffer : vBackgroundData )
-		delete[] pBgBuffer.pPixels;
-
-	if( m_pDebugFontBuffer )
-		delete[] m_pDebugFontBuffer;
+	if( c < 0x30 || c > 0x5F )
+		return -1;
 
-	delete[] m_playBuffer.pPixels;
+	return c - 0x30;
 }
 
-//********************************************************************************************************************************
-// Instance functions
-//********************************************************************************************************************************
-
-PlayGraphics& PlayGraphics::Instance()
+int PlayGraphics::DrawDebugCharacter( Point2f pos, char c, Pixel pix )
 {
-	PLAY_ASSERT_MSG( s_pInstance, "Trying to use PlayGraphics without initialising it!" );
-	return *s_pInstance;
-}
+	FlushDeferredDraws();
 
-PlayGraphics& PlayGraphics::Instance( int bufferWidth, int bufferHeight, const char* path )
-{
-	PLAY_ASSERT_MSG( !s_pInstance, "Trying to create multiple instances of singleton class!" );
-	s_pInstance = new PlayGraphics( bufferWidth, bufferHeight, path );
-	return *s_pInstance;
-}
+	if( !m_bDebugFontReady )
+		DecompressDubugFont();
 
-void PlayGraphics::Destroy()
-{
-	PLAY_ASSERT_MSG( s_pInstance, "Trying to use destroy PlayGraphics when it hasn't been instanced!" );
-	delete s_pInstance;
-	s_pInstance = nullptr;
+	int index = GetDebugCharacterIndex( c );
+	if( index < 0 )
+		return FONT_CHAR_WIDTH;
+
+	pos = ToRenderTarget( pos );
+	int destX = static_cast<int>( std::floor( pos.x + 0.5f ) );
+	int destY = static_cast<int>( std::floor( pos.y + 0.5f ) );
+
+	for( int y = 0; y < FONT_CHAR_HEIGHT; y++ )
+	{
+		uint64_t mask = m_debugFontMasks[index][y];
+		m_blitter.DrawMaskedSpan( destX, destY + y, &mask, FONT_CHAR_WIDTH, pix );
+	}
+
+	return FONT_CHAR_WIDTH;
 }
 
 //********************************************************************************************************************************
-// Loading functions
+// Function:	DrawDebugString - draws text using the debug font a whole row of the string at a time
+// Parameters:	pos = the position of the text, s = the text, pix = the text colour, centred = whether pos is the centre
+//				outlinePix = the outline colour (fully transparent for no outline)
+// Notes:		The character row masks are combined into bitmasks for each row of the whole string (with a pixel either side
+//				for the outline), which are drawn with DrawMaskedSpan. The outline is every pixel diagonally next to the text,
+//				and as it never overlaps the text both are drawn in the same pass without any pixel being drawn twice.
 //********************************************************************************************************************************
-
-int PlayGraphics::LoadSpriteSheet( const std::string& path, const std::string& filename )
+int PlayGraphics::DrawDebugString( Point2f pos, const std::string& s, Pixel pix, bool centred, Pixel outlinePix )
 {
-	PixelData canvasBuffer;
-	std::string spriteName = filename;
-	int hCount = 1;
-	int vCount = 1;
+	FlushDeferredDraws();
 
-	// Switch everything to uppercase to avoid need to check case each time
-	for( char& c : spriteName ) c = static_cast<char>( toupper( c ) );
+	if( !m_bDebugFontReady )
+		DecompressDubugFont();
 
-	// Look for the final number in the filename to pull out the number of frames across the width
-	size_t frameWidthEnd = spriteName.find_last_of( "0123456789" );
-	size_t frameWidthStart = spriteName.find_last_not_of( "0123456789" );
+	// The text keeps its size in pixels when the resolution is scaled
+	pos = ToRenderTarget( pos );
 
-	if( frameWidthEnd == spriteName.length() - 1 )
-	{
-		// Grab the number of frames
-		std::string widthString = spriteName.substr( frameWidthStart + 1, frameWidthEnd - frameWidthStart );
+	if( centred )
+		pos.x -= GetDebugStringWidth( s ) / 2;
 
-		// Make sure the number is valid 
-		size_t num = widthString.find_first_of( "0123456789" );
-		PLAY_ASSERT_MSG( num == 0, std::string( "Incorrectly named sprite: " + filename ).c_str() );
+	pos.y -= 6; // half the height of the debug font
 
-		hCount = stoi( widthString );
+	int width = static_cast<int>( s.length() ) * ( FONT_CHAR_WIDTH + 1 ) + 2;
+	int height = FONT_CHAR_HEIGHT + 2;
+	int words = ( width + 63 ) / 64;
 
-		if( spriteName[frameWidthStart] == 'X' )
+	m_vDebugTextMasks.assign( static_cast<size_t>( words ) * height, 0 );
+
+	for( size_t i = 0; i < s.length(); i++ )
+	{
+		int index = GetDebugCharacterIndex( static_cast<char>( toupper( s[i] ) ) );
+		if( index < 0 )
+			continue;
+
+		int bit = 1 + static_cast<int>( i ) * ( FONT_CHAR_WIDTH + 1 );
+
+		for( int y = 0; y < FONT_CHAR_HEIGHT; y++ )
 		{
-			//Two dimensional sprite sheet so the width was actually the height: copy it over and work out the real width
-			vCount = hCount;
+			uint64_t mask = m_debugFontMasks[index][y];
+			uint64_t* pRow = &m_vDebugTextMasks[static_cast<size_t>( y + 1 ) * words];
 
-			// Cut off the last number we just found plus an "x", then check for another number indicating a frame height (optional)
-			std::string truncated = spriteName.substr( 0, frameWidthStart );
-			frameWidthEnd = truncated.find_last_of( "0123456789" );
-			frameWidthStart = truncated.find_last_not_of( "0123456789" );
+			pRow[bit >> 6] |= mask << ( bit & 63 );
+			if( ( bit & 63 ) > 64 - FONT_CHAR_WIDTH )
+				pRow[( bit >> 6 ) + 1] |= mask >> ( 64 - ( bit & 63 ) );
+		}
+	}
 
-			if( frameWidthEnd == truncated.length() - 1 && frameWidthStart != std::string::npos )
-			{
-				// Grab the number of images in the height
-				widthString = truncated.substr( frameWidthStart + 1, frameWidthEnd - frameWidthStart );
+	// Rounded down after adding a half (like the other shapes) so text partly off the top left stays in place
+	int destX = static_cast<int>( std::floor( pos.x + 0.5f ) ) - 1;
+	int destY = static_cast<int>( std::floor( pos.y + 0.5f ) ) - 1;
+	bool outline = outlinePix.a != 0x00;
 
-				// Make sure the number is valid
-				num = widthString.find_first_of( "0123456789" );
-				PLAY_ASSERT_MSG( num == 0, std::string( "Incorrectly named sprite: " + filename ).c_str() );
+	if( outline )
+		m_vDebugOutlineMask.resize( words );
 
-				hCount = stoi( widthString );
-			}
-			else
+	for( int y = 0; y < height; y++ )
+	{
+		const uint64_t* pRow = &m_vDebugTextMasks[static_cast<size_t>( y ) * words];
+
+		if( outline )
+		{
+			// The text pixels in the rows above and below shifted one pixel left and right
+			for( int w = 0; w < words; w++ )
 			{
-				PLAY_ASSERT_MSG( false, std::string( "Incorrectly named sprite: " + filename ).c_str() );
+				uint64_t diagonals = 0;
+
+				for( int dy = -1; dy <= 1; dy += 2 )
+				{
+					if( y + dy < 0 || y + dy >= height )
+						continue;
+
+					const uint64_t* pNext = &m_vDebugTextMasks[static_cast<size_t>( y + dy ) * words];
+					diagonals |= ( pNext[w] << 1 ) | ( pNext[w] >> 1 );
+					if( w > 0 )
+						diagonals |= pNext[w - 1] >> 63;
+					if( w + 1 < words )
+						diagonals |= pNext[w + 1] << 63;
+				}
+
+				m_vDebugOutlineMask[w] = diagonals & ~pRow[w];
 			}
+
+			m_blitter.DrawMaskedSpan( destX, destY + y, m_vDebugOutlineMask.data(), width, outlinePix );
 		}
-		else
-		{
-			vCount = 1;
-		}
+
+		m_blitter.DrawMaskedSpan( destX, destY + y, pRow, width, pix );
 	}
 
-	std::string fileAndPath( path + spriteName + ".PNG" );
-	PlayWindow::LoadPNGImage( fileAndPath, canvasBuffer ); // Allocates memory as we don't know the size
-	
-	return AddSprite( filename, canvasBuffer, hCount, vCount );
+	// Return horizontal position at the end of the string so strings can be concatenated easily
+	return static_cast<int>( pos.x + width - 2 );
 }
 
-int PlayGraphics::AddSprite( const std::string& name, PixelData& pixelData, int hCount, int vCount )
+int PlayGraphics::GetDebugStringWidth( const std::string& s )
 {
-	// Switch everything to uppercase to avoid need to check case each time
-	std::string spriteName = name;
-	for( char& c : spriteName ) c = static_cast<char>( toupper( c ) );
-
-	Sprite s;
-	s.id = m_nTotalSprites++;
-	s.name = spriteName;
-	s.originX = s.originY = 0;
-	s.hCount = hCount;
-	s.vCount = vCount;
-	s.canvasBuffer = pixelData; // copy including pointer to pixel data
-
-	s.totalCount = s.hCount * s.vCount;
-	s.width = s.canvasBuffer.width / s.hCount;
-	s.height = s.canvasBuffer.height / s.vCount;
+	return static_cast<int>( s.length() ) * ( FONT_CHAR_WIDTH + 1 );
+}
 
-	// Create a separate buffer with the pre-multiplyied alpha
-	s.preMultAlpha.pPixels = new Pixel[static_cast<size_t>( s.canvasBuffer.width ) * s.canvasBuffer.height];
-	s.preMultAlpha.width = s.canvasBuffer.width;
-	s.preMultAlpha.height = s.canvasBuffer.height;
-	memset( s.preMultAlpha.pPixels, 0, sizeof( uint32_t ) * s.canvasBuffer.width * s.canvasBuffer.height );
-	PreMultiplyAlpha( s.canvasBuffer.pPixels, s.preMultAlpha.pPixels, s.canvasBuffer.width, s.canvasBuffer.height, s.width, 1.0f, 0x00FFFFFF );
-	s.canvasBuffer.preMultiplied = true;
+//********************************************************************************************************************************
+// Debug overlay functions
+//********************************************************************************************************************************
 
-	// Add the sprite to our vector
-	vSpriteData.push_back( s );
+void PlayGraphics::AddDebugLine( Point2f startPos, Point2f endPos, Pixel pix, int category )
+{
+	if( !( m_debugCategories & category ) )
+		return;
 
-	return s.id;
+	// Convert floating point co-ordinates to pixels (the same as DrawLine)
+	m_vDebugLines.push_back( { static_cast<int>( std::floor( startPos.x + 0.5f ) ), static_cast<int>( std::floor( startPos.y + 0.5f ) ),
+		static_cast<int>( std::floor( endPos.x + 0.5f ) ), static_cast<int>( std::floor( endPos.y + 0.5f ) ), pix } );
 }
 
-int PlayGraphics::UpdateSprite( const std::string& name, PixelData& pixelData, int hCount, int vCount )
+void PlayGraphics::AddDebugRect( Point2f topLeft, Point2f bottomRight, Pixel pix, int category )
 {
-	// Switch everything to uppercase to avoid need to check case each time
-	std::string spriteName = name;
-	for( char& c : spriteName ) c = static_cast<char>( toupper( c ) );
-
-	for( Sprite& s : vSpriteData )
-	{
-		if( s.name.find( spriteName ) != std::string::npos )
-		{
-			// delete the old premultiplied buffer
-			delete s.preMultAlpha.pPixels;
+	if( !( m_debugCategories & category ) )
+		return;
 
-			s.hCount = hCount;
-			s.vCount = vCount;
-			s.canvasBuffer = pixelData; // copy including pointer to pixel data
+	int x1 = static_cast<int>( std::floor( topLeft.x + 0.5f ) );
+	int x2 = static_cast<int>( std::floor( bottomRight.x + 0.5f ) );
+	int y1 = static_cast<int>( std::floor( topLeft.y + 0.5f ) );
+	int y2 = static_cast<int>( std::floor( bottomRight.y + 0.5f ) );
 
-			s.totalCount = s.hCount * s.vCount;
-			s.width = s.canvasBuffer.width / s.hCount;
-			s.height = s.canvasBuffer.height / s.vCount;
+	// The same edges as DrawRect, so translucent corners only blend once
+	if( x1 == x2 || y1 == y2 )
+	{
+		m_vDebugLines.push_back( { x1, y1, x2, y2, pix } );
+		return;
+	}
 
-			// Create a new buffer with the pre-multiplyied alpha
-			s.preMultAlpha.pPixels = new Pixel[static_cast<size_t>( s.canvasBuffer.width ) * s.canvasBuffer.height];
-			s.preMultAlpha.width = s.canvasBuffer.width;
-			s.preMultAlpha.height = s.canvasBuffer.height;
-			memset( s.preMultAlpha.pPixels, 0, sizeof( uint32_t ) * s.canvasBuffer.width * s.canvasBuffer.height );
-			PreMultiplyAlpha( s.canvasBuffer.pPixels, s.preMultAlpha.pPixels, s.canvasBuffer.width, s.canvasBuffer.height, s.width, 1.0f, 0x00FFFFFF );
-			s.canvasBuffer.preMultiplied = true;
+	m_vDebugLines.push_back( { x1, y1, x2, y1, pix, false } );
+	m_vDebugLines.push_back( { x2, y1, x2, y2, pix, false } );
+	m_vDebugLines.push_back( { x2, y2, x1, y2, pix, false } );
+	m_vDebugLines.push_back( { x1, y2, x1, y1, pix, false } );
+}
 
-			return s.id;
-		}
-	}
+void PlayGraphics::AddDebugCircle( Point2f centrePos, int radius, Pixel pix, int category )
+{
+	if( !( m_debugCategories & category ) )
+		return;
 
-	return -1;
+	m_vDebugCircles.push_back( { static_cast<int>( std::floor( centrePos.x + 0.5f ) ), static_cast<int>( std::floor( centrePos.y + 0.5f ) ), radius, 0, pix } );
 }
 
-
-int PlayGraphics::LoadBackground( const char* fileAndPath )
+void PlayGraphics::AddDebugLabel( Point2f pos, const std::string& text, Pixel pix, int category )
 {
-	// The background image may not be the right size for the background so we make sure the buffer is 
-	PixelData backgroundImage;
-	Pixel* pSrc, * pDest;
+	if( !( m_debugCategories & category ) )
+		return;
 
-	Pixel* correctSizeBuffer = new Pixel[static_cast<size_t>( m_playBuffer.width ) * m_playBuffer.height];
-	PLAY_ASSERT( correctSizeBuffer );
+	m_vDebugLabels.push_back( { pos, pix, m_debugLabelText.size(), text.size() } );
+	m_debugLabelText += text;
+}
 
-	std::string pngFile( fileAndPath );
-	PLAY_ASSERT_MSG( std::filesystem::exists( fileAndPath ), "The background png does not exist at the given location." );
-	PlayWindow::LoadPNGImage( pngFile, backgroundImage ); // Allocates memory in function as we don't know the size
+void PlayGraphics::DrawDebugOverlay()
+{
+	FlushDeferredDraws();
 
-	pSrc = backgroundImage.pPixels;
-	pDest = correctSizeBuffer;
+	// The overlay is culled in camera space (the blitter subtracts the camera offset)
+	PixelRect clip = m_blitter.GetClipRect();
+	clip.x += m_blitter.GetCameraOffsetX();
+	clip.y += m_blitter.GetCameraOffsetY();
+	int clipRight = clip.x + clip.width;
+	int clipBottom = clip.y + clip.height;
 
-	//Copy the image to our background buffer clipping where necessary
-	for( int h = 0; h < std::min( backgroundImage.height, m_playBuffer.height ); h++ )
+	// The shapes are recorded in display co-ordinates, so they are scaled when drawing at a reduced resolution
+	float scale = m_drawScale;
+
+	for( const DebugShape& line : m_vDebugLines )
 	{
-		for( int w = 0; w < std::min( backgroundImage.width, m_playBuffer.width ); w++ )
-			*pDest++ = *pSrc++;
+		int x1 = static_cast<int>( floor( ( line.x1 * scale ) + 0.5f ) );
+		int y1 = static_cast<int>( floor( ( line.y1 * scale ) + 0.5f ) );
+		int x2 = static_cast<int>( floor( ( line.x2 * scale ) + 0.5f ) );
+		int y2 = static_cast<int>( floor( ( line.y2 * scale ) + 0.5f ) );
+
+		if( std::max( x1, x2 ) < clip.x || std::min( x1, x2 ) >= clipRight ||
+			std::max( y1, y2 ) < clip.y || std::min( y1, y2 ) >= clipBottom )
+			continue;
 
-		// Skip pixels if we're clipping
-		pDest += std::max( m_playBuffer.width - backgroundImage.width, 0 );
-		pSrc += std::max( backgroundImage.width - m_playBuffer.width, 0 );
+		m_blitter.DrawLine( x1, y1, x2, y2, line.pix, line.drawStart );
 	}
 
-	// Free up the loading buffer
-	delete backgroundImage.pPixels;
-	backgroundImage.pPixels = correctSizeBuffer;
+	for( const DebugShape& circle : m_vDebugCircles )
+	{
+		// The blitter skips circles outside the clipping rectangle itself
+		m_blitter.DrawCircle( static_cast<int>( floor( ( circle.x1 * scale ) + 0.5f ) ), static_cast<int>( floor( ( circle.y1 * scale ) + 0.5f ) ),
+			static_cast<int>( ( circle.x2 * scale ) + 0.5f ), circle.pix );
+	}
+
+	for( const DebugLabel& label : m_vDebugLabels )
+	{
+		Point2f labelPos = ToRenderTarget( label.pos );
+		int halfWidth = static_cast<int>( label.textLength ) * ( FONT_CHAR_WIDTH + 1 ) / 2;
+		if( labelPos.x + halfWidth < clip.x || labelPos.x - halfWidth >= clipRight ||
+			labelPos.y + FONT_CHAR_HEIGHT < clip.y || labelPos.y - FONT_CHAR_HEIGHT >= clipBottom )
+			continue;
 
-	vBackgroundData.push_back( backgroundImage );
+		m_debugLabel.assign( m_debugLabelText, label.textStart, label.textLength );
+		DrawDebugString( label.pos, m_debugLabel, label.pix, true );
+	}
 
-	return static_cast<int>( vBackgroundData.size() ) - 1;
+	ClearDebugOverlay();
 }
 
+void PlayGraphics::ClearDebugOverlay()
+{
+	m_vDebugLines.clear();
+	m_vDebugCircles.clear();
+	m_vDebugLabels.clear();
+	m_debugLabelText.clear();
+}
 
 //********************************************************************************************************************************
-// Sprite Getters and Setters
+// Dynamic resolution functions
 //********************************************************************************************************************************
-int PlayGraphics::GetSpriteId( const char* name ) const
+
+void PlayGraphics::SetDynamicResolution( bool enable, const DynamicResolutionSettings& settings )
 {
-	std::string tofind( name );
-	for( char& c : tofind ) c = static_cast<char>( toupper( c ) );
+	PLAY_ASSERT_MSG( settings.minScale > 0.0f && settings.minScale <= settings.maxScale && settings.maxScale <= 1.0f, "Invalid dynamic resolution scale limits" );
+	PLAY_ASSERT_MSG( settings.frameCount > 0, "Dynamic resolution needs at least one frame to average" );
 
-	for( const Sprite& s : vSpriteData )
-	{
-		if( s.name.find( tofind ) != std::string::npos )
-			return s.id;
-	}
-	PLAY_ASSERT_MSG( false, "The sprite name is invalid!" );
-	return -1;
-}
+	FlushDeferredDraws();
 
-const std::string& PlayGraphics::GetSpriteName( int spriteId )
-{
-	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to get name of invalid sprite id" );
-	return vSpriteData[spriteId].name;
-}
+	m_bDynamicResolution = enable;
+	m_dynamicResolution = settings;
+	m_vFrameTimes.clear();
 
-Vector2f PlayGraphics::GetSpriteSize( int spriteId ) const
-{
-	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to get width of invalid sprite id" );
-	return { vSpriteData[spriteId].width, vSpriteData[spriteId].height };
+	SetResolutionScale( enable ? settings.maxScale : 1.0f );
 }
 
-int PlayGraphics::GetSpriteFrames( int spriteId ) const
+//********************************************************************************************************************************
+// Function:	UpdateDynamicResolution - chooses the next frame's resolution from the frame time
+// Parameters:	frameTime = the time taken by the frame just finished (in milliseconds)
+// Notes:		The scale only changes once the average of the last few frames is over the target (or well under it) to avoid
+//				changing every frame.
+//********************************************************************************************************************************
+void PlayGraphics::UpdateDynamicResolution( float frameTime )
 {
-	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to get frames of invalid sprite id" );
-	return vSpriteData[spriteId].totalCount;
-}
+	m_vFrameTimes.push_back( frameTime );
 
-Vector2f PlayGraphics::GetSpriteOrigin( int spriteId ) const
-{
-	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to get origin with invalid sprite id" );
-	return { vSpriteData[spriteId].originX, vSpriteData[spriteId].originY };
-}
+	if( static_cast<int>( m_vFrameTimes.size() ) < m_dynamicResolution.frameCount )
+		return;
 
-void PlayGraphics::SetSpriteOrigin( int spriteId, Vector2f newOrigin, bool relative )
-{
-	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to set origin with invalid sprite id" );
-	if( relative )
+	float average = 0.0f;
+	for( float time : m_vFrameTimes )
+		average += time;
+	average /= m_vFrameTimes.size();
+
+	float scale = m_resolutionScale;
+	if( average > m_dynamicResolution.targetMillisecs )
+		scale = std::max( scale - m_dynamicResolution.scaleStep, m_dynamicResolution.minScale );
+	else if( average < m_dynamicResolution.targetMillisecs * m_dynamicResolution.raiseThreshold )
+		scale = std::min( scale + m_dynamicResolution.scaleStep, m_dynamicResolution.maxScale );
+
+	if( scale != m_resolutionScale )
 	{
-		vSpriteData[spriteId].originX += static_cast<int>( newOrigin.x );
-		vSpriteData[spriteId].originY += static_cast<int>( newOrigin.y );
+		// Frames drawn at the old scale say nothing about the new one
+		m_vFrameTimes.clear();
+		SetResolutionScale( scale );
 	}
 	else
 	{
-		vSpriteData[spriteId].originX = static_cast<int>( newOrigin.x );
-		vSpriteData[spriteId].originY = static_cast<int>( newOrigin.y );
+		m_vFrameTimes.erase( m_vFrameTimes.begin() );
 	}
 }
 
-void PlayGraphics::CentreSpriteOrigin( int spriteId )
-{
-	SetSpriteOrigin( spriteId, GetSpriteSize( spriteId ) / 2 );
-}
-
-void PlayGraphics::CentreAllSpriteOrigins( void )
+void PlayGraphics::SetResolutionScale( float scale )
 {
-	for( Sprite& s : vSpriteData )
-		CentreSpriteOrigin( s.id );
-}
+	m_resolutionScale = scale;
 
-void PlayGraphics::SetSpriteOrigins( const char* rootName, Vector2f newOrigin, bool relative )
-{
-	std::string tofind( rootName );
-	for( char& c : tofind ) c = static_cast<char>( toupper( c ) );
+	// The buffers keep the display's stride, so changing scale never needs to reallocate them
+	int width = std::max( static_cast<int>( ( m_playBuffer.width * scale ) + 0.5f ), 1 );
+	int height = std::max( static_cast<int>( ( m_playBuffer.height * scale ) + 0.5f ), 1 );
 
-	for( Sprite& s : vSpriteData )
+	if( scale < 1.0f && m_displayFormat == PIXEL_FORMAT_ARGB )
 	{
-		if( s.name.find( tofind ) != std::string::npos )
-		{
-			if( relative )
-			{
-				s.originX += static_cast<int>( newOrigin.x );
-				s.originY += static_cast<int>( newOrigin.y );
-			}
-			else
-			{
-				s.originX = static_cast<int>( newOrigin.x );
-				s.originY = static_cast<int>( newOrigin.y );
-			}
-		}
+		if( !m_scaledBuffer.pPixels )
+			AllocateAlignedPixels( m_scaledBuffer, m_playBuffer.width, m_playBuffer.height );
+
+		m_scaledBuffer.width = width;
+		m_scaledBuffer.height = height;
 	}
-}
 
-//********************************************************************************************************************************
-// Drawing functions
-//********************************************************************************************************************************
+	if( m_displayFormat == PIXEL_FORMAT_RGB565 )
+	{
+		if( !m_display565.pPixels )
+			AllocateAlignedPixels( m_display565, m_playBuffer.width, m_playBuffer.height, PIXEL_FORMAT_RGB565 );
 
-void PlayGraphics::DrawTransparent( int spriteId, Point2f pos, int frameIndex, float alphaMultiply ) const
-{
-	const Sprite& spr = vSpriteData[spriteId];
-	int destx = static_cast<int>( pos.x + 0.5f ) - spr.originX;
-	int desty = static_cast<int>( pos.y + 0.5f ) - spr.originY;
-	frameIndex = frameIndex % spr.totalCount;
-	int frameX = frameIndex % spr.hCount;
-	int frameY = frameIndex / spr.hCount;
-	int pixelX = frameX * spr.width;
-	int pixelY = frameY * spr.height;
-	int frameOffset = pixelX + ( spr.canvasBuffer.width * pixelY );
+		m_display565.width = width;
+		m_display565.height = height;
+	}
 
-	m_blitter.BlitPixels( spr.preMultAlpha, frameOffset, destx, desty, spr.width, spr.height, alphaMultiply );
-};
+	m_vUpscaleColumns.resize( m_playBuffer.width );
+	for( int x = 0; x < m_playBuffer.width; x++ )
+		m_vUpscaleColumns[x] = ( x * width ) / m_playBuffer.width;
 
-void PlayGraphics::DrawRotated( int spriteId, Point2f pos, int frameIndex, float angle, float scale, float alphaMultiply ) const
-{
-	const Sprite& spr = vSpriteData[spriteId];
-	int destx = static_cast<int>( pos.x + 0.5f );
-	int desty = static_cast<int>( pos.y + 0.5f );
-	frameIndex = frameIndex % spr.totalCount;
-	int frameX = frameIndex % spr.hCount;
-	int frameY = frameIndex / spr.hCount;
-	int pixelX = frameX * spr.width;
-	int pixelY = frameY * spr.height;
-	int frameOffset = pixelX + ( spr.canvasBuffer.width * pixelY );
+	// Only switch buffers when drawing to the display (rather than to another render target)
+	if( IsDisplayTarget( m_blitter.GetRenderTarget() ) )
+		m_blitter.SetRenderTarget( GetDisplayTarget() );
 
-	m_blitter.RotateScalePixels( spr.preMultAlpha, frameOffset, destx, desty, spr.width, spr.height, spr.originX, spr.originY, angle, scale, alphaMultiply );
+	UpdateViewTransform();
 }
 
-
-void PlayGraphics::DrawBackground( int backgroundId )
+PixelData* PlayGraphics::GetDisplayTarget()
 {
-	PLAY_ASSERT_MSG( m_playBuffer.pPixels, "Trying to draw background without initialising display!" );
-	PLAY_ASSERT_MSG( vBackgroundData.size() > static_cast<size_t>(backgroundId), "Background image out of range!" );
-	m_blitter.BlitBackground( vBackgroundData[backgroundId] );
+	if( m_displayFormat == PIXEL_FORMAT_RGB565 )
+		return &m_display565;
+
+	return ( m_resolutionScale < 1.0f ) ? &m_scaledBuffer : &m_playBuffer;
 }
 
-void PlayGraphics::ColourSprite( int spriteId, int r, int g, int b )
+void PlayGraphics::UpscaleToDisplay( const PixelData& source )
 {
-	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to colour invalid sprite id" );
-
-	Sprite& s = vSpriteData[spriteId];
-	uint32_t col = ( ( r & 0xFF ) << 16 ) | ( ( g & 0xFF ) << 8 ) | ( b & 0xFF );
+	int lastSourceY = -1;
 
-	PreMultiplyAlpha( s.canvasBuffer.pPixels, s.preMultAlpha.pPixels, s.canvasBuffer.width, s.canvasBuffer.height, s.width, 1.0f, col );
-	s.canvasBuffer.preMultiplied = true;
-}
+	for( int y = 0; y < m_playBuffer.height; y++ )
+	{
+		int sourceY = ( y * source.height ) / m_playBuffer.height;
+		Pixel* pDest = m_playBuffer.Row( y );
 
-int PlayGraphics::DrawString( int fontId, Point2f pos, std::string text ) const
-{
-	PLAY_ASSERT_MSG( fontId >= 0 && fontId < m_nTotalSprites, "Trying to use invalid sprite id for font" );
+		// Rows which come from the same source row are copied from the one above
+		if( sourceY == lastSourceY )
+		{
+			memcpy( pDest, m_playBuffer.Row( y - 1 ), sizeof( Pixel ) * m_playBuffer.width );
+			continue;
+		}
 
-	int width = 0;
+		if( source.format == PIXEL_FORMAT_RGB565 )
+		{
+			const uint16_t* pSource = source.Row565( sourceY );
+			int x = 0;
+#ifdef PLAY_USE_SSE2
+			// At full resolution the columns line up, so eight pixels are expanded at a time
+			if( source.width == m_playBuffer.width )
+			{
+				__m128i alpha = _mm_set1_epi16( static_cast<short>( 0xFF00 ) );
+				for( ; x + 8 <= m_playBuffer.width; x += 8 )
+				{
+					__m128i red, green, blue;
+					PlayBlitter::UnpackPixels565( _mm_loadu_si128( reinterpret_cast<const __m128i*>( pSource + x ) ), red, green, blue );
+					__m128i greenBlue = _mm_or_si128( _mm_slli_epi16( green, 8 ), blue );
+					__m128i alphaRed = _mm_or_si128( alpha, red );
+					_mm_storeu_si128( reinterpret_cast<__m128i*>( pDest + x ), _mm_unpacklo_epi16( greenBlue, alphaRed ) );
+					_mm_storeu_si128( reinterpret_cast<__m128i*>( pDest + x + 4 ), _mm_unpackhi_epi16( greenBlue, alphaRed ) );
+				}
+			}
+#endif
+			for( ; x < m_playBuffer.width; x++ )
+				pDest[x] = PlayBlitter::UnpackPixel565( pSource[m_vUpscaleColumns[x]] );
+		}
+		else
+		{
+			const Pixel* pSource = source.Row( sourceY );
+			for( int x = 0; x < m_playBuffer.width; x++ )
+				pDest[x] = pSource[m_vUpscaleColumns[x]];
+		}
 
-	for( char c : text )
-	{
-		Draw( fontId, { pos.x + width, pos.y }, c - 32 );
-		width += GetFontCharWidth( fontId, c );
+		lastSourceY = sourceY;
 	}
-	return width;
+
+	m_playBuffer.preMultiplied = source.preMultiplied;
 }
 
-int PlayGraphics::DrawStringCentred( int fontId, Point2f pos, std::string text ) const
+void PlayGraphics::SetDisplayFormat( PixelFormat format )
 {
-	int totalWidth = 0;
-
-	for( char c : text )
-		totalWidth += GetFontCharWidth( fontId, c );
-
-	pos.x -= totalWidth / 2;
+	FlushDeferredDraws();
 
-	DrawString( fontId, pos, text );
-	return totalWidth;
+	m_displayFormat = format;
+	SetResolutionScale( m_resolutionScale );
 }
 
-int PlayGraphics::DrawChar( int fontId, Point2f pos, char c ) const
+//********************************************************************************************************************************
+// Quality governor functions
+//********************************************************************************************************************************
+
+void PlayGraphics::SetQualityGovernor( bool enable, float targetMillisecs )
 {
-	PLAY_ASSERT_MSG( fontId >= 0 && fontId < m_nTotalSprites, "Trying to use invalid sprite id for font" );
-	Draw( fontId, { pos.x, pos.y }, c - 32 );
-	return GetFontCharWidth( fontId, c );
+	PLAY_ASSERT_MSG( targetMillisecs > 0.0f, "The quality governor needs a positive target frame time" );
+
+	m_bQualityGovernor = enable;
+	m_targetFrameTime = targetMillisecs;
+	m_qualityLevel = 1.0f;
 }
 
-int PlayGraphics::DrawCharRotated( int fontId, Point2f pos, float angle, float scale, char c ) const
+void PlayGraphics::AddQualityKnob( const std::string& name, float lowQualityValue, float highQualityValue )
 {
-	PLAY_ASSERT_MSG( fontId >= 0 && fontId < m_nTotalSprites, "Trying to use invalid sprite id for font" );
-	DrawRotated( fontId, { pos.x, pos.y }, c - 32, angle, scale );
-	return GetFontCharWidth( fontId, c );
+	m_qualityKnobs[name] = { lowQualityValue, highQualityValue };
 }
 
-int PlayGraphics::GetFontCharWidth( int fontId, char c ) const
+float PlayGraphics::GetQualityKnob( const std::string& name ) const
 {
-	PLAY_ASSERT_MSG( fontId >= 0 && fontId < m_nTotalSprites, "Trying to use invalid sprite id for font" );
-	return (vSpriteData[fontId].canvasBuffer.pPixels + ( c - 32 ))->b; // character width hidden in pixel data
-}
+	std::map<std::string, QualityKnob>::const_iterator i = m_qualityKnobs.find( name );
+	PLAY_ASSERT_MSG( i != m_qualityKnobs.end(), "Trying to use a quality knob which hasn't been added" );
 
+	const QualityKnob& knob = i->second;
+	return knob.lowQualityValue + ( ( knob.highQualityValue - knob.lowQualityValue ) * m_qualityLevel );
+}
 
+//********************************************************************************************************************************
+// Function:	UpdateQualityGovernor - moves the quality level towards what the average frame time allows
+// Notes:		The average frame time is smoothed so that an occasional slow frame (e.g. loading a sound) has little effect.
+//				The level drops quickly while frames are over the target and only climbs slowly once there is plenty of time
+//				to spare, so that it settles rather than swinging back and forth.
+//********************************************************************************************************************************
+void PlayGraphics::UpdateQualityGovernor()
+{
+	if( !m_bQualityGovernor )
+		return;
 
+	if( m_averageFrameTime > m_targetFrameTime )
+		m_qualityLevel = std::max( m_qualityLevel - 0.05f, 0.0f );
+	else if( m_averageFrameTime < m_targetFrameTime * 0.8f )
+		m_qualityLevel = std::min( m_qualityLevel + 0.01f, 1.0f );
+}
 
 //********************************************************************************************************************************
-// Function:	SpriteCollide: function that checks by pixel if two sprites collide
-// Parameters:	s1Xpos, s1Ypos, s2Xpos, s2Ypos = the origin of rotation for both sprites.
-//				s1Id, s2Id = the ids of both sprites
-//				s1angle, s2angle = the angle of rotation for both sprites, clockwise. 0 = unrotated.
-//				s1Pixelcoll, s2Pixelcoll = the top left and bottom right co-ordinates defining the collision rectangle of both sprites
-//				
-// Returns: true if a single pixel or more overlap between the two sprites and false if not.
-// Notes:	rounding errors may cause it not to be pixel perfect.	
+// Post-process functions
 //********************************************************************************************************************************
-bool PlayGraphics::SpriteCollide( int id_1, Point2f pos_1, int frame_1, float angle_1, int s1PixelColl[4], int id_2, Point2f pos_2, int frame_2, float angle_2, int s2PixelColl[4] ) const
+
+void PlayGraphics::SetPostProcess( bool enable, const PostProcessSettings& settings )
 {
-	//transform all co-ordinates of sprite2 into the frame of sprite 1.
+	PLAY_ASSERT_MSG( settings.blurRadius >= 0 && settings.blurPasses >= 0 && settings.bloomRadius >= 0, "Post-process blurs can't have a negative size" );
+	PLAY_ASSERT_MSG( !settings.colourGrade || m_colourGradeSize > 0, "Trying to colour grade without setting a colour grade lookup table" );
 
-	//To do this we'll set up three co-ordinate systems.
-	//X,Y are screen, u,v are sprite 1 and a,b are sprite 2.
-	//The input is position of centre of rotation in screen and position of centre of rotation in sprite1 and sprite2.
+	m_bPostProcess = enable;
+	m_postProcess = settings;
+	m_postProcess.bloomThreshold = std::min( std::max( settings.bloomThreshold, 0 ), 255 );
+	m_postProcess.bloomStrength = std::min( std::max( settings.bloomStrength, 0.0f ), 4.0f );
 
-	//We define the origin of the sprite1 as the beginning of its buffer.
-	//First I calculate the offset vector for sprite one in the screen.
-	//in sprite offsetu = rotOffX, offsetv = rotOffY.
-	//When I refer to origin of the sprite I mean the 0,0 pixel.
+	if( enable && m_vWorkers.empty() )
+		StartWorkers();
+}
 
+void PlayGraphics::SetColourGrade( const PixelData& table )
+{
+	int size = table.height;
+	PLAY_ASSERT_MSG( size >= 2 && size <= 256 && table.width == size * size && table.format == PIXEL_FORMAT_ARGB, "A colour grade lookup table needs to be an N*N by N image" );
 
-	//Next define corners of sprite
-	const Sprite& s1 = vSpriteData[id_1];
-	const Sprite& s2 = vSpriteData[id_2];
+	m_colourGradeSize = size;
+	m_vColourGrade.resize( static_cast<size_t>( size ) * size * size );
 
-	//Convert collision box locations from relative to sprite origin to relative to sprite top left. Hence TL.
-	int s1PixelCollTL[4]{ 0 };
-	int s2PixelCollTL[4]{ 0 };
+	for( int blue = 0; blue < size; blue++ )
+	{
+		for( int green = 0; green < size; green++ )
+		{
+			for( int red = 0; red < size; red++ )
+				m_vColourGrade[( ( ( blue * size ) + green ) * size ) + red] = table.Row( green )[( blue * size ) + red].bits & 0x00FFFFFF;
+		}
+	}
 
-	for( int i{ 0 }; i < 2; i++ )
+	// A value of 255 uses the last pair of entries (all the way towards the last one) so that there is always a next entry
+	for( int c = 0; c < 256; c++ )
 	{
-		s1PixelCollTL[2 * i] = s1PixelColl[2 * i] + s1.originX;
-		s1PixelCollTL[2 * i + 1] = s1PixelColl[2 * i + 1] + s1.originY;
-		s2PixelCollTL[2 * i] = s2PixelColl[2 * i] + s2.originX;
-		s2PixelCollTL[2 * i + 1] = s2PixelColl[2 * i + 1] + s2.originY;
+		int position = ( ( c * ( size - 1 ) * 256 ) + 127 ) / 255;
+		int index = std::min( position >> 8, size - 2 );
+		m_gradeIndex[c] = static_cast<uint8_t>( index );
+		m_gradeFraction[c] = static_cast<uint16_t>( position - ( index * 256 ) );
 	}
+}
 
-	//in screen
-	float cosAngle1 = cos( angle_1 );
-	float sinAngle1 = sin( angle_1 );
-	float offsetSprite1X = cosAngle1 * s1.originX - sinAngle1 * s1.originY;
-	float offsetSprite1Y = cosAngle1 * s1.originY + sinAngle1 * s1.originX;
+void PlayGraphics::LoadColourGrade( const char* fileAndPath )
+{
+	PixelData table;
 
-	//Next I calculate the sprite origin in the screen.
-	float originSprite1X = pos_1.x - offsetSprite1X;
-	float originSprite1Y = pos_1.y - offsetSprite1Y;
+	std::string pngFile( fileAndPath );
+	PLAY_ASSERT_MSG( std::filesystem::exists( PlayWindow::FindFile( pngFile ) ), "The colour grade png does not exist at the given location." );
+	PlayWindow::LoadPNGImage( pngFile, table ); // Allocates memory in function as we don't know the size
 
-	//Repeat for other sprite.
-	float cosAngle2 = cos( angle_2 );
-	float sinAngle2 = sin( angle_2 );
-	float offsetSprite2X = cosAngle2 * s2.originX - sinAngle2 * s2.originY;
-	float offsetSprite2Y = cosAngle2 * s2.originY + sinAngle2 * s2.originX;
+	SetColourGrade( table );
 
-	//Next I calculate the sprite origin in the screen.
-	float originSprite2X = pos_2.x - offsetSprite2X;
-	float originSprite2Y = pos_2.y - offsetSprite2Y;
+	// Free up the loading buffer
+	delete[] table.pPixels;
+}
 
-	//calculate the difference between two sprite origins in screen
-	float originDiffX = originSprite2X - originSprite1X;
-	float originDiffY = originSprite2Y - originSprite1Y;
+void PlayGraphics::BeginPostProcessTiming( Pixel pix )
+{
+	// Frames which don't use the timing bar aren't measured
+	if( !m_vTimings.empty() )
+		SetTimingBarColour( pix );
+}
 
-	//calculation of the difference between two sprite origins in frame of sprite 1.
-	float originDiffu = originDiffX * cosAngle1 + originDiffY * sinAngle1;
-	float originDiffv = originDiffY * cosAngle1 - originDiffX * sinAngle1;
+void PlayGraphics::ApplyPostProcess()
+{
+	bool blur = m_postProcess.blurRadius > 0 && m_postProcess.blurPasses > 0;
+	bool colourGrade = m_postProcess.colourGrade && m_colourGradeSize > 0;
+	if( !blur && !m_postProcess.bloom && !colourGrade )
+		return;
 
-	int s2Width = s2.width;
-	int s2Height = s2.height;
-	int s1Width = s1.width;
+	// Whatever happens after the passes (e.g. presenting) carries on in the game's colour
+	Pixel gameColour = m_vTimings.empty() ? PIX_BLACK : m_vTimings.back().pix;
 
-	float cosAngleDiff = cos( angle_2 - angle_1 );
-	float sinAngleDiff = sin( angle_2 - angle_1 );
-	//top left, top right, bottom right, bottom left.
-	float s2Cu[4]
+	if( blur )
 	{
-		0,
-		s2Width * cosAngleDiff,
-		s2Width * cosAngleDiff - s2Height * sinAngleDiff,
-		-s2Height * sinAngleDiff
-	};
+		BeginPostProcessTiming( PIX_CYAN );
 
-	float s2Cv[4]
+		if( !m_postBuffer.pPixels )
+			AllocateAlignedPixels( m_postBuffer, m_playBuffer.width, m_playBuffer.height );
+
+		BlurImage( m_playBuffer, m_postBuffer, m_postProcess.blurRadius, m_postProcess.blurPasses );
+	}
+
+	if( m_postProcess.bloom )
 	{
-		0,
-		s2Width * sinAngleDiff,
-		s2Width * sinAngleDiff + s2Height * cosAngleDiff,
-		s2Height * cosAngleDiff
-	};
+		BeginPostProcessTiming( PIX_YELLOW );
+
+		if( !m_bloomBuffer.pPixels )
+		{
+			AllocateAlignedPixels( m_bloomBuffer, ( m_playBuffer.width + 1 ) / 2, ( m_playBuffer.height + 1 ) / 2 );
+			AllocateAlignedPixels( m_bloomTemp, m_bloomBuffer.width, m_bloomBuffer.height );
+		}
+
+		// The glow is found and blurred at half resolution, where it costs a quarter as much and spreads twice as far
+		PostProcessJob job;
+		job.step = POST_BLOOM_THRESHOLD;
+		job.pSource = &m_playBuffer;
+		job.pDest = &m_bloomBuffer;
+		job.radius = m_postProcess.bloomThreshold;
+		ForEachRowBand( job, m_bloomBuffer.height );
+
+		// Two box blurs give a smoother (triangular) falloff than one
+		BlurImage( m_bloomBuffer, m_bloomTemp, m_postProcess.bloomRadius, 2 );
+
+		job.step = POST_BLOOM_ADD;
+		job.pSource = &m_bloomBuffer;
+		job.pDest = &m_playBuffer;
+		job.radius = static_cast<int>( ( m_postProcess.bloomStrength * 64.0f ) + 0.5f );
+		ForEachRowBand( job, m_playBuffer.height );
+	}
 
+	if( colourGrade )
+	{
+		BeginPostProcessTiming( PIX_MAGENTA );
 
-	float minCu{ std::numeric_limits<float>::infinity() };
-	float minCv{ std::numeric_limits<float>::infinity() };
-	float maxCu{ -std::numeric_limits<float>::infinity() };
-	float maxCv{ -std::numeric_limits<float>::infinity() };
+		PostProcessJob job;
+		job.step = POST_COLOUR_GRADE;
+		job.pDest = &m_playBuffer;
+		ForEachRowBand( job, m_playBuffer.height );
+	}
 
-	//calculate the extremes of the rotated sprite2.
-	for( int i = 0; i < 4; i++ )
+	BeginPostProcessTiming( gameColour );
+}
+
+void PlayGraphics::BlurImage( PixelData& image, PixelData& temp, int radius, int passes )
+{
+	if( radius <= 0 )
+		return;
+
+	for( int pass = 0; pass < passes; pass++ )
 	{
-		minCu = std::min( s2Cu[i], minCu );
-		minCv = std::min( s2Cv[i], minCv );
-		maxCu = std::max( s2Cu[i], maxCu );
-		maxCv = std::max( s2Cv[i], maxCv );
+		// The rows are blurred into the working buffer, and then the columns are blurred back again
+		PostProcessJob job;
+		job.step = POST_BLUR_ROWS;
+		job.pSource = &image;
+		job.pDest = &temp;
+		job.radius = radius;
+		ForEachRowBand( job, image.height );
+
+		job.step = POST_BLUR_COLUMNS;
+		job.pSource = &temp;
+		job.pDest = &image;
+		ForEachRowBand( job, image.height );
 	}
+}
 
-	//calculate the maximum and minimum positions in the sprite1 frame of the sprite2 corners.
-	float maxu = (originDiffu)+( maxCu );
-	float maxv = (originDiffv)+( maxCv );
-	float minu = (originDiffu)+( minCu );
-	float minv = (originDiffv)+( minCv );
+void PlayGraphics::RunPostProcessJob( const PostProcessJob& job, int band, int startY, int endY ) const
+{
+	BandScratch& scratch = m_vBandScratch[band];
 
-	if( minu > s1PixelCollTL[2] || minv > s1PixelCollTL[3] || maxu < s1PixelCollTL[0] || maxv < s1PixelCollTL[1] )
+	switch( job.step )
 	{
-		return false;
+		case POST_BLUR_ROWS:
+			BlurRows( *job.pSource, *job.pDest, job.radius, startY, endY );
+			break;
+		case POST_BLUR_COLUMNS:
+			BlurColumns( *job.pSource, *job.pDest, job.radius, startY, endY, scratch.vSums );
+			break;
+		case POST_BLOOM_THRESHOLD:
+			BloomThresholdRows( *job.pSource, *job.pDest, job.radius, startY, endY );
+			break;
+		case POST_BLOOM_ADD:
+			BloomAddRows( *job.pSource, *job.pDest, job.radius, startY, endY, scratch.vBetweenRows );
+			break;
+		case POST_COLOUR_GRADE:
+			GradeRows( *job.pDest, startY, endY );
+			break;
+		case POST_LIGHTING:
+			LightRows( *job.pDest, m_lightRect.y + startY, m_lightRect.y + endY, scratch.vRowLight );
+			break;
 	}
-	else
+}
+
+//********************************************************************************************************************************
+// Function:	BlurRows - box blurs a band of rows horizontally
+// Parameters:	source = the image to blur, dest = where the blurred rows are written (the same size as the source)
+//				radius = how many pixels either side are averaged, startY/endY = the band of rows
+// Notes:		Each pixel is the average of a window of pixels, which is kept as a running sum: moving the window along adds
+//				the pixel entering it and subtracts the one leaving, so the cost doesn't depend on the radius. The four
+//				channels of a pixel are summed side by side in one SSE register.
+//********************************************************************************************************************************
+void PlayGraphics::BlurRows( const PixelData& source, PixelData& dest, int radius, int startY, int endY )
+{
+	int width = source.width;
+	float scale = 1.0f / static_cast<float>( ( radius * 2 ) + 1 );
+
+	for( int y = startY; y < endY; y++ )
 	{
-		//wrap both frame indexes just in case.
-		frame_1 = frame_1 % s1.totalCount;
-		frame_2 = frame_2 % s2.totalCount;
+		const uint32_t* pSource = &source.Row( y )->bits;
+		uint32_t* pDest = &dest.Row( y )->bits;
 
-		//clip so we loop through sprite 1.
-		//Restrict the range we look in for pixel based collisions.
-		minv = ( minv < s1PixelCollTL[1] ) ? static_cast<float>( s1PixelCollTL[1] ) : minv;
-		maxv = ( maxv > s1PixelCollTL[3] ) ? static_cast<float>( s1PixelCollTL[3] ) : maxv;
-		minu = ( minu < s1PixelCollTL[0] ) ? static_cast<float>( s1PixelCollTL[0] ) : minu;
-		maxu = ( maxu > s1PixelCollTL[2] ) ? static_cast<float>( s1PixelCollTL[2] ) : maxu;
+#ifdef PLAY_USE_SSE2
+		__m128i zero = _mm_setzero_si128();
+		__m128 multiply = _mm_set1_ps( scale );
 
-		//Set up the starting position in sprite 2 frame. We know the box corners in u, v relative to the sprite 2 origin but we need to get them in a,b.
-		float minCa = ( minu - originDiffu ) * cosAngleDiff + ( minv - originDiffv ) * sinAngleDiff;
-		float minCb = -( minu - originDiffu ) * sinAngleDiff + ( minv - originDiffv ) * cosAngleDiff;
+		__m128i sum = zero;
+		for( int x = -radius; x <= radius; x++ )
+			sum = _mm_add_epi32( sum, _mm_unpacklo_epi16( _mm_unpacklo_epi8( _mm_cvtsi32_si128( static_cast<int>( pSource[std::min( std::max( x, 0 ), width - 1 )] ) ), zero ), zero ) );
 
-		//rounding at this point
-		int iminu = static_cast<int>( minu );
-		int iminv = static_cast<int>( minv );
-		int imaxu = static_cast<int>( maxu );
-		int imaxv = static_cast<int>( maxv );
+		for( int x = 0; x < width; x++ )
+		{
+			__m128i average = _mm_cvtps_epi32( _mm_mul_ps( _mm_cvtepi32_ps( sum ), multiply ) );
+			average = _mm_packs_epi32( average, zero );
+			pDest[x] = static_cast<uint32_t>( _mm_cvtsi128_si32( _mm_packus_epi16( average, zero ) ) );
 
-		float startinga = minCa;
-		float startingb = minCb;
+			__m128i entering = _mm_unpacklo_epi16( _mm_unpacklo_epi8( _mm_cvtsi32_si128( static_cast<int>( pSource[std::min( x + radius + 1, width - 1 )] ) ), zero ), zero );
+			__m128i leaving = _mm_unpacklo_epi16( _mm_unpacklo_epi8( _mm_cvtsi32_si128( static_cast<int>( pSource[std::max( x - radius, 0 )] ) ), zero ), zero );
+			sum = _mm_sub_epi32( _mm_add_epi32( sum, entering ), leaving );
+		}
+#else
+		int sum[4] = { 0, 0, 0, 0 };
+		for( int x = -radius; x <= radius; x++ )
+		{
+			uint32_t pix = pSource[std::min( std::max( x, 0 ), width - 1 )];
+			for( int c = 0; c < 4; c++ )
+				sum[c] += ( pix >> ( c * 8 ) ) & 0xFF;
+		}
 
-		float rowstarta = startinga;
-		float rowstartb = startingb;
+		for( int x = 0; x < width; x++ )
+		{
+			uint32_t average = 0;
+			for( int c = 0; c < 4; c++ )
+				average |= static_cast<uint32_t>( ( sum[c] * scale ) + 0.5f ) << ( c * 8 );
+			pDest[x] = average;
+
+			uint32_t entering = pSource[std::min( x + radius + 1, width - 1 )];
+			uint32_t leaving = pSource[std::max( x - radius, 0 )];
+			for( int c = 0; c < 4; c++ )
+				sum[c] += static_cast<int>( ( entering >> ( c * 8 ) ) & 0xFF ) - static_cast<int>( ( leaving >> ( c * 8 ) ) & 0xFF );
+		}
+#endif
+	}
+}
 
-		//Set up starting and finishing pointers for both the sprite 1 buffer and sprite 2 buffer 
-		//starting pointer for the sprite 1 buffer is the minu and minv.
-		int sprite1Offset = s1Width * frame_1 + iminu + iminv * s1.canvasBuffer.width;
-		Pixel* sprite1Src = s1.canvasBuffer.pPixels + sprite1Offset;
+//********************************************************************************************************************************
+// Function:	BlurColumns - box blurs a band of rows vertically
+// Parameters:	source = the image to blur, dest = where the blurred rows are written (the same size as the source)
+//				radius = how many pixels above and below are averaged, startY/endY = the band of rows
+//				vSums = the band's working buffer for the column sums
+// Notes:		Keeps a running sum for every column, so each row of the band adds one row entering the window and subtracts
+//				one leaving it. The sums start from the rows around the start of the band, so bands don't depend on each other.
+//********************************************************************************************************************************
+void PlayGraphics::BlurColumns( const PixelData& source, PixelData& dest, int radius, int startY, int endY, std::vector<int>& vSums )
+{
+	int width = source.width;
+	int height = source.height;
+	float scale = 1.0f / static_cast<float>( ( radius * 2 ) + 1 );
 
-		//The base pointer for the sprite2 will just be start of the correct frame in the canvas buffer.
-		int sprite2Offset = s2Width * frame_2;
-		Pixel* sprite2Base = s2.canvasBuffer.pPixels + sprite2Offset;
-		//Define the number which we need to add to get down a row in sprite1.
-		int sprite1ChangeRow = s1.canvasBuffer.width - ( imaxu - iminu );
+	// Four channel sums for each column (the band's buffer only allocates the first time it is used)
+	vSums.assign( static_cast<size_t>( width ) * 4, 0 );
 
-		//Start of double for loop.
-		//Go through the overlapping region (warning may go out of the buffer of sprite 2.)
-		for( int v{ iminv }; v < imaxv; v++ )
+#ifdef PLAY_USE_SSE2
+	__m128i zero = _mm_setzero_si128();
+	__m128 multiply = _mm_set1_ps( scale );
+
+	for( int y = startY - radius; y <= startY + radius; y++ )
+	{
+		const uint32_t* pRow = &source.Row( std::min( std::max( y, 0 ), height - 1 ) )->bits;
+		for( int x = 0; x < width; x++ )
 		{
-			//store a and b to be the start of the row.
-			float a = rowstarta;
-			float b = rowstartb;
+			__m128i* pSum = reinterpret_cast<__m128i*>( &vSums[x * 4] );
+			_mm_storeu_si128( pSum, _mm_add_epi32( _mm_loadu_si128( pSum ), _mm_unpacklo_epi16( _mm_unpacklo_epi8( _mm_cvtsi32_si128( static_cast<int>( pRow[x] ) ), zero ), zero ) ) );
+		}
+	}
 
-			for( int u{ iminu }; u < imaxu; u++ )
-			{
+	for( int y = startY; y < endY; y++ )
+	{
+		uint32_t* pDest = &dest.Row( y )->bits;
+		const uint32_t* pEntering = &source.Row( std::min( y + radius + 1, height - 1 ) )->bits;
+		const uint32_t* pLeaving = &source.Row( std::max( y - radius, 0 ) )->bits;
 
-				//Edit this part to add a collision box.
-				//If we are in sprite 2 then extract the look at the pixels.
-				if( a >= s2PixelCollTL[0] && b >= s2PixelCollTL[1] && a < s2PixelCollTL[2] && b < s2PixelCollTL[3] )
-				{
-					int sprite2Pixel = static_cast<int>( a ) + static_cast<int>( b ) * s2.canvasBuffer.width;
-					Pixel sprite2Src = *( sprite2Base + sprite2Pixel );
+		for( int x = 0; x < width; x++ )
+		{
+			__m128i* pSum = reinterpret_cast<__m128i*>( &vSums[x * 4] );
+			__m128i sum = _mm_loadu_si128( pSum );
 
-					//If both pixels at that position are opaque then there is a collision. 
-					if( sprite2Src.bits > 0x00FFFFFF && (*sprite1Src).bits > 0x00FFFFFF )
-					{
-						return true;
-					}
+			__m128i average = _mm_cvtps_epi32( _mm_mul_ps( _mm_cvtepi32_ps( sum ), multiply ) );
+			average = _mm_packs_epi32( average, zero );
+			pDest[x] = static_cast<uint32_t>( _mm_cvtsi128_si32( _mm_packus_epi16( average, zero ) ) );
 
-				}
-				//add change in for going along u. go along a row.
-				a += cosAngleDiff;
-				b += -sinAngleDiff;
+			__m128i entering = _mm_unpacklo_epi16( _mm_unpacklo_epi8( _mm_cvtsi32_si128( static_cast<int>( pEntering[x] ) ), zero ), zero );
+			__m128i leaving = _mm_unpacklo_epi16( _mm_unpacklo_epi8( _mm_cvtsi32_si128( static_cast<int>( pLeaving[x] ) ), zero ), zero );
+			_mm_storeu_si128( pSum, _mm_sub_epi32( _mm_add_epi32( sum, entering ), leaving ) );
+		}
+	}
+#else
+	for( int y = startY - radius; y <= startY + radius; y++ )
+	{
+		const uint32_t* pRow = &source.Row( std::min( std::max( y, 0 ), height - 1 ) )->bits;
+		for( int x = 0; x < width; x++ )
+		{
+			for( int c = 0; c < 4; c++ )
+				vSums[( x * 4 ) + c] += ( pRow[x] >> ( c * 8 ) ) & 0xFF;
+		}
+	}
 
-				sprite1Src++;
+	for( int y = startY; y < endY; y++ )
+	{
+		uint32_t* pDest = &dest.Row( y )->bits;
+		const uint32_t* pEntering = &source.Row( std::min( y + radius + 1, height - 1 ) )->bits;
+		const uint32_t* pLeaving = &source.Row( std::max( y - radius, 0 ) )->bits;
 
+		for( int x = 0; x < width; x++ )
+		{
+			int* pSum = &vSums[x * 4];
+			uint32_t average = 0;
+			for( int c = 0; c < 4; c++ )
+			{
+				average |= static_cast<uint32_t>( ( pSum[c] * scale ) + 0.5f ) << ( c * 8 );
+				pSum[c] += static_cast<int>( ( pEntering[x] >> ( c * 8 ) ) & 0xFF ) - static_cast<int>( ( pLeaving[x] >> ( c * 8 ) ) & 0xFF );
 			}
-			//increment for row of sprite 1.
-			sprite1Src += sprite1ChangeRow;
-
-			//work out start of next row based on start of previous row. 
-			rowstarta += sinAngleDiff;
-			rowstartb += cosAngleDiff;
+			pDest[x] = average;
 		}
 	}
-	return false;
+#endif
 }
 
+//********************************************************************************************************************************
+// Function:	BloomThresholdRows - finds the glowing parts of a band of rows of a half size image
+// Parameters:	source = the full size image, dest = the half size glow image, threshold = the brightness a channel has to be
+//				over to glow, startY/endY = the band of rows in the half size image
+// Notes:		Each half size pixel is the average of a 2x2 block of full size pixels after subtracting the threshold from their
+//				colour channels (so anything darker than the threshold doesn't glow). The alpha channel is cleared, so the glow
+//				can be added to the colour without changing it.
+//********************************************************************************************************************************
+void PlayGraphics::BloomThresholdRows( const PixelData& source, PixelData& dest, int threshold, int startY, int endY )
+{
+	uint32_t thresholdBytes = static_cast<uint32_t>( threshold ) * 0x01010101;
+
+	for( int y = startY; y < endY; y++ )
+	{
+		const uint32_t* pTop = &source.Row( y * 2 )->bits;
+		const uint32_t* pBottom = &source.Row( std::min( ( y * 2 ) + 1, source.height - 1 ) )->bits;
+		uint32_t* pDest = &dest.Row( y )->bits;
+		int x = 0;
+
+#ifdef PLAY_USE_SSE2
+		__m128i subtract = _mm_set1_epi32( static_cast<int>( thresholdBytes ) );
+		__m128i colourMask = _mm_set1_epi32( 0x00FFFFFF );
+
+		// Eight full size pixels from each row make four half size pixels
+		for( ; ( x + 4 ) * 2 <= source.width && x + 4 <= dest.width; x += 4 )
+		{
+			__m128i left = _mm_avg_epu8( _mm_subs_epu8( _mm_loadu_si128( reinterpret_cast<const __m128i*>( pTop + ( x * 2 ) ) ), subtract ), _mm_subs_epu8( _mm_loadu_si128( reinterpret_cast<const __m128i*>( pBottom + ( x * 2 ) ) ), subtract ) );
+			__m128i right = _mm_avg_epu8( _mm_subs_epu8( _mm_loadu_si128( reinterpret_cast<const __m128i*>( pTop + ( x * 2 ) + 4 ) ), subtract ), _mm_subs_epu8( _mm_loadu_si128( reinterpret_cast<const __m128i*>( pBottom + ( x * 2 ) + 4 ) ), subtract ) );
+
+			__m128i even = _mm_castps_si128( _mm_shuffle_ps( _mm_castsi128_ps( left ), _mm_castsi128_ps( right ), _MM_SHUFFLE( 2, 0, 2, 0 ) ) );
+			__m128i odd = _mm_castps_si128( _mm_shuffle_ps( _mm_castsi128_ps( left ), _mm_castsi128_ps( right ), _MM_SHUFFLE( 3, 1, 3, 1 ) ) );
+
+			_mm_storeu_si128( reinterpret_cast<__m128i*>( pDest + x ), _mm_and_si128( _mm_avg_epu8( even, odd ), colourMask ) );
+		}
+#endif
+		for( ; x < dest.width; x++ )
+		{
+			int left = x * 2;
+			int right = std::min( left + 1, source.width - 1 );
+			uint32_t pix[4] = { pTop[left], pBottom[left], pTop[right], pBottom[right] };
 
+			// Subtracts the threshold from each channel without going below zero
+			for( uint32_t& p : pix )
+			{
+				uint32_t result = 0;
+				for( int c = 0; c < 24; c += 8 )
+					result |= static_cast<uint32_t>( std::max( static_cast<int>( ( p >> c ) & 0xFF ) - threshold, 0 ) ) << c;
+				p = result;
+			}
 
+			// Rounds each average up, like the SSE version
+			uint32_t result = 0;
+			for( int c = 0; c < 24; c += 8 )
+			{
+				uint32_t leftAverage = ( ( ( pix[0] >> c ) & 0xFF ) + ( ( pix[1] >> c ) & 0xFF ) + 1 ) >> 1;
+				uint32_t rightAverage = ( ( ( pix[2] >> c ) & 0xFF ) + ( ( pix[3] >> c ) & 0xFF ) + 1 ) >> 1;
+				result |= ( ( leftAverage + rightAverage + 1 ) >> 1 ) << c;
+			}
+			pDest[x] = result;
+		}
+	}
+}
 
 //********************************************************************************************************************************
-// Function:	PreMultiplyAlpha - calculates the (src*srcAlpha) alpha blending calculation in advance as it doesn't change
-// Parameters:	s = the sprite to pre-calculate data for
-// Notes:		Also inverts the alpha ready for the (dest*(1-srcAlpha)) calculation and stores information in the new
-//				buffer which provides the number of fully-transparent pixels in a row (so they can be skipped)
+// Function:	BloomAddRows - doubles the size of a glow image and adds it to a band of rows
+// Parameters:	bloom = the half size glow image, dest = the full size image, strength = how much of the glow to add (in 64ths)
+//				startY/endY = the band of rows in the full size image, vBetweenRows = the band's working buffer for a glow row
+// Notes:		Odd rows and columns fall between two glow pixels and use their average, so the glow doesn't look blocky. The
+//				glow is added with saturation, so bright areas stay white rather than wrapping around.
 //********************************************************************************************************************************
-void PlayGraphics::PreMultiplyAlpha( Pixel* source, Pixel* dest, int width, int height, int maxSkipWidth, float alphaMultiply = 1.0f, Pixel colourMultiply = 0x00FFFFFF )
+void PlayGraphics::BloomAddRows( const PixelData& bloom, PixelData& dest, int strength, int startY, int endY, std::vector<uint32_t>& vBetweenRows )
 {
-	Pixel* pSourcePixels = source;
-	Pixel* pDestPixels = dest;
+	// A row of the glow which is half way between two of its rows
+	vBetweenRows.resize( bloom.width );
 
-	// Iterate through all the pixels in the entire canvas
-	for( int bh = 0; bh < height; bh++ )
+	for( int y = startY; y < endY; y++ )
 	{
-		for( int bw = 0; bw < width; bw++ )
+		int bloomY = y / 2;
+		const uint32_t* pBloom = &bloom.Row( bloomY )->bits;
+		uint32_t* pDest = &dest.Row( y )->bits;
+
+		if( ( y & 1 ) && bloomY + 1 < bloom.height )
 		{
-			Pixel src = *pSourcePixels;
+			const uint32_t* pBelow = &bloom.Row( bloomY + 1 )->bits;
+			for( int x = 0; x < bloom.width; x++ )
+				vBetweenRows[x] = ( pBloom[x] | pBelow[x] ) - ( ( ( pBloom[x] ^ pBelow[x] ) >> 1 ) & 0x7F7F7F7F );
+			pBloom = vBetweenRows.data();
+		}
 
-			// Separate the channels and calculate src*srcAlpha
-			int srcAlpha = static_cast<int>( ( src.bits >> 24 ) * alphaMultiply );
+		int x = 0;
 
-			int destRed = ( srcAlpha * ( ( src.bits >> 16 ) & 0xFF ) ) >> 8;
-			int destGreen = ( srcAlpha * ( ( src.bits >> 8 ) & 0xFF ) ) >> 8;
-			int destBlue = ( srcAlpha * ( src.bits & 0xFF ) ) >> 8;
+#ifdef PLAY_USE_SSE2
+		__m128i zero = _mm_setzero_si128();
+		__m128i multiply = _mm_set1_epi16( static_cast<short>( strength ) );
 
-			destRed = ( destRed * ( ( colourMultiply.bits >> 16 ) & 0xFF ) ) >> 8;
-			destGreen = ( destGreen * ( ( colourMultiply.bits >> 8 ) & 0xFF ) ) >> 8;
-			destBlue = ( destBlue * ( colourMultiply.bits & 0xFF ) ) >> 8;
+		// Four glow pixels and the averages with their neighbours make eight display pixels
+		for( ; ( x / 2 ) + 4 < bloom.width && x + 8 <= dest.width; x += 8 )
+		{
+			__m128i glow = _mm_loadu_si128( reinterpret_cast<const __m128i*>( pBloom + ( x / 2 ) ) );
+			__m128i between = _mm_avg_epu8( glow, _mm_loadu_si128( reinterpret_cast<const __m128i*>( pBloom + ( x / 2 ) + 1 ) ) );
+			__m128i left = _mm_unpacklo_epi32( glow, between );
+			__m128i right = _mm_unpackhi_epi32( glow, between );
+
+			if( strength != 64 )
+			{
+				left = _mm_packus_epi16( _mm_srli_epi16( _mm_mullo_epi16( _mm_unpacklo_epi8( left, zero ), multiply ), 6 ), _mm_srli_epi16( _mm_mullo_epi16( _mm_unpackhi_epi8( left, zero ), multiply ), 6 ) );
+				right = _mm_packus_epi16( _mm_srli_epi16( _mm_mullo_epi16( _mm_unpacklo_epi8( right, zero ), multiply ), 6 ), _mm_srli_epi16( _mm_mullo_epi16( _mm_unpackhi_epi8( right, zero ), multiply ), 6 ) );
+			}
 
-			srcAlpha = 0xFF - srcAlpha; // invert the alpha ready to multiply with the destination pixels
-			*pDestPixels = ( srcAlpha << 24 ) | ( destRed << 16 ) | ( destGreen << 8 ) | destBlue;
+			__m128i* pDestLeft = reinterpret_cast<__m128i*>( pDest + x );
+			__m128i* pDestRight = reinterpret_cast<__m128i*>( pDest + x + 4 );
+			_mm_storeu_si128( pDestLeft, _mm_adds_epu8( _mm_loadu_si128( pDestLeft ), left ) );
+			_mm_storeu_si128( pDestRight, _mm_adds_epu8( _mm_loadu_si128( pDestRight ), right ) );
+		}
+#endif
+		for( ; x < dest.width; x++ )
+		{
+			uint32_t glow = pBloom[x / 2];
+			if( ( x & 1 ) && ( x / 2 ) + 1 < bloom.width )
+				glow = ( glow | pBloom[( x / 2 ) + 1] ) - ( ( ( glow ^ pBloom[( x / 2 ) + 1] ) >> 1 ) & 0x7F7F7F7F );
 
-			if( srcAlpha == 0xFF ) // Completely transparent pixel
+			uint32_t result = 0;
+			for( int c = 0; c < 32; c += 8 )
 			{
-				int repeats = 0;
+				int channel = ( ( ( glow >> c ) & 0xFF ) * strength ) >> 6;
+				result |= static_cast<uint32_t>( std::min( static_cast<int>( ( pDest[x] >> c ) & 0xFF ) + channel, 255 ) ) << c;
+			}
+			pDest[x] = result;
+		}
+	}
+}
 
-				// We can only skip to the end of the row because the sprite frames are arranged on a continuous canvas
-				int maxSkip = maxSkipWidth - ( bw % maxSkipWidth );
+//********************************************************************************************************************************
+// Function:	GradeRows - maps a band of rows through the colour grade lookup table
+// Parameters:	image = the image to grade in place, startY/endY = the band of rows
+// Notes:		Each colour lies in a cube of eight table entries, which are blended by how far along the cube the colour is in
+//				each direction (trilinear interpolation). The eight entries are fetched one at a time, but they are blended two
+//				or four at a time using 16-bit channels: first along red, then green and then blue.
+//********************************************************************************************************************************
+void PlayGraphics::GradeRows( PixelData& image, int startY, int endY ) const
+{
+	const uint32_t* pTable = m_vColourGrade.data();
+	int greenStep = m_colourGradeSize;
+	int blueStep = m_colourGradeSize * m_colourGradeSize;
 
-				for( int zw = 1; zw < maxSkip; zw++ )
-				{
-					if( ( pSourcePixels + zw )->bits >> 24 == 0x00 ) // Another transparent pixel
-						repeats++;
-					else
-						break;
-				}
+#ifdef PLAY_USE_SSE2
+	__m128i zero = _mm_setzero_si128();
+	__m128i half = _mm_set1_epi16( 128 );
+	__m128i whole = _mm_set1_epi16( 256 );
+#endif
 
-				*pDestPixels = 0xFF000000 | repeats; // Doesn't matter what the colour was so we use it to store the skip value
-			}
+	for( int y = startY; y < endY; y++ )
+	{
+		uint32_t* pRow = &image.Row( y )->bits;
+		for( int x = 0; x < image.width; x++ )
+		{
+			uint32_t pix = pRow[x];
+			int red = ( pix >> 16 ) & 0xFF;
+			int green = ( pix >> 8 ) & 0xFF;
+			int blue = pix & 0xFF;
+
+			const uint32_t* pCube = pTable + ( ( ( ( m_gradeIndex[blue] * greenStep ) + m_gradeIndex[green] ) * greenStep ) + m_gradeIndex[red] );
+			int redFraction = m_gradeFraction[red];
+			int greenFraction = m_gradeFraction[green];
+			int blueFraction = m_gradeFraction[blue];
+
+#ifdef PLAY_USE_SSE2
+			// Each blend is ( a * ( 256 - f ) ) + ( b * f ), which never goes over 16 bits when treated as unsigned
+			__m128i fraction = _mm_set1_epi16( static_cast<short>( redFraction ) );
+			__m128i inverse = _mm_sub_epi16( whole, fraction );
+			__m128i low = _mm_unpacklo_epi8( _mm_set_epi32( 0, 0, static_cast<int>( pCube[greenStep] ), static_cast<int>( pCube[0] ) ), zero );
+			__m128i high = _mm_unpacklo_epi8( _mm_set_epi32( 0, 0, static_cast<int>( pCube[greenStep + 1] ), static_cast<int>( pCube[1] ) ), zero );
+			__m128i nearBlue = _mm_srli_epi16( _mm_add_epi16( _mm_add_epi16( _mm_mullo_epi16( low, inverse ), _mm_mullo_epi16( high, fraction ) ), half ), 8 );
+
+			low = _mm_unpacklo_epi8( _mm_set_epi32( 0, 0, static_cast<int>( pCube[blueStep + greenStep] ), static_cast<int>( pCube[blueStep] ) ), zero );
+			high = _mm_unpacklo_epi8( _mm_set_epi32( 0, 0, static_cast<int>( pCube[blueStep + greenStep + 1] ), static_cast<int>( pCube[blueStep + 1] ) ), zero );
+			__m128i farBlue = _mm_srli_epi16( _mm_add_epi16( _mm_add_epi16( _mm_mullo_epi16( low, inverse ), _mm_mullo_epi16( high, fraction ) ), half ), 8 );
+
+			// Low green entries on the left and high green entries on the right (for near and far blue)
+			fraction = _mm_set1_epi16( static_cast<short>( greenFraction ) );
+			inverse = _mm_sub_epi16( whole, fraction );
+			low = _mm_unpacklo_epi64( nearBlue, farBlue );
+			high = _mm_unpackhi_epi64( nearBlue, farBlue );
+			__m128i blended = _mm_srli_epi16( _mm_add_epi16( _mm_add_epi16( _mm_mullo_epi16( low, inverse ), _mm_mullo_epi16( high, fraction ) ), half ), 8 );
+
+			fraction = _mm_set1_epi16( static_cast<short>( blueFraction ) );
+			inverse = _mm_sub_epi16( whole, fraction );
+			blended = _mm_srli_epi16( _mm_add_epi16( _mm_add_epi16( _mm_mullo_epi16( blended, inverse ), _mm_mullo_epi16( _mm_srli_si128( blended, 8 ), fraction ) ), half ), 8 );
+
+			uint32_t result = static_cast<uint32_t>( _mm_cvtsi128_si32( _mm_packus_epi16( blended, zero ) ) );
+#else
+			uint32_t result = 0;
+			for( int c = 0; c < 24; c += 8 )
+			{
+				int corner[8];
+				for( int i = 0; i < 8; i++ )
+					corner[i] = ( pCube[( ( i & 4 ) ? blueStep : 0 ) + ( ( i & 2 ) ? greenStep : 0 ) + ( i & 1 )] >> c ) & 0xFF;
 
-			pDestPixels++;
-			pSourcePixels++;
+				for( int i = 0; i < 4; i++ )
+					corner[i] = ( ( corner[i * 2] * ( 256 - redFraction ) ) + ( corner[( i * 2 ) + 1] * redFraction ) + 128 ) >> 8;
+				for( int i = 0; i < 2; i++ )
+					corner[i] = ( ( corner[i * 2] * ( 256 - greenFraction ) ) + ( corner[( i * 2 ) + 1] * greenFraction ) + 128 ) >> 8;
+
+				result |= static_cast<uint32_t>( ( ( corner[0] * ( 256 - blueFraction ) ) + ( corner[1] * blueFraction ) + 128 ) >> 8 ) << c;
+			}
+#endif
+			// The table doesn't hold alpha, so the frame's alpha is kept
+			pRow[x] = ( result & 0x00FFFFFF ) | ( pix & 0xFF000000 );
 		}
 	}
 }
 
 //********************************************************************************************************************************
-// Basic drawing functions
+// Lighting functions
 //********************************************************************************************************************************
 
+void PlayGraphics::SetAmbientLight( Pixel colour )
+{
+	m_ambientLight = colour;
+}
 
-
-void PlayGraphics::DrawPixel( Point2f pos, Pixel srcPix )
+void PlayGraphics::AddLight( Point2f pos, float radius, Pixel colour, float intensity )
 {
-	// Convert floating point co-ordinates to pixels
-	m_blitter.DrawPixel( static_cast<int>( pos.x + 0.5f ), static_cast<int>( pos.y + 0.5f ), srcPix );
+	// Lights are positioned like sprites, so they use the camera and resolution scale at the time they are added
+	Light light;
+	light.pos = { ( pos.x * m_drawScale ) - m_blitter.GetCameraOffsetX(), ( pos.y * m_drawScale ) - m_blitter.GetCameraOffsetY() };
+	light.radius = radius * m_drawScale;
+	light.colour = colour;
+	light.intensity = intensity;
+	m_vLights.push_back( light );
 }
 
-void PlayGraphics::DrawLine( Point2f startPos, Point2f endPos, Pixel pix )
+void PlayGraphics::DrawLighting()
 {
-	// Convert floating point co-ordinates to pixels
-	int x1 = static_cast<int>( startPos.x + 0.5f );
-	int y1 = static_cast<int>( startPos.y + 0.5f );
-	int x2 = static_cast<int>( endPos.x + 0.5f );
-	int y2 = static_cast<int>( endPos.y + 0.5f );
+	FlushDeferredDraws();
 
-	m_blitter.DrawLine( x1, y1, x2, y2, pix );
+	const PixelData* pTarget = m_blitter.GetRenderTarget();
+	m_lightRect = m_blitter.GetClipRect();
+
+	// The light map covers the whole render target, with an extra column and row so that every pixel has a next one to blend towards
+	m_lightMapWidth = ( pTarget->width >> LIGHT_MAP_SHIFT ) + 2;
+	m_lightMapHeight = ( pTarget->height >> LIGHT_MAP_SHIFT ) + 2;
+	m_vLightMap.resize( static_cast<size_t>( m_lightMapWidth ) * m_lightMapHeight * 4 );
+
+	// Everything starts with the ambient light (and alpha is always at full brightness so that it doesn't change)
+	uint16_t ambient[4] = { static_cast<uint16_t>( m_ambientLight.b + ( m_ambientLight.b >> 7 ) ), static_cast<uint16_t>( m_ambientLight.g + ( m_ambientLight.g >> 7 ) ),
+		static_cast<uint16_t>( m_ambientLight.r + ( m_ambientLight.r >> 7 ) ), 256 };
+	for( size_t i = 0; i < m_vLightMap.size(); i += 4 )
+		memcpy( &m_vLightMap[i], ambient, sizeof( ambient ) );
+
+	for( const Light& light : m_vLights )
+		AddLightToMap( light );
+
+	m_vLights.clear();
+
+	// How each column is scaled up is the same for every row, so it is only worked out once
+	m_vLightColumns.resize( pTarget->width );
+	m_vLightColumnWeights.resize( pTarget->width );
+	for( int x = 0; x < pTarget->width; x++ )
+	{
+		// The position in the light map (in 8ths) of the centre of the pixel, where light map pixel centres are at whole numbers
+		int position = ( ( ( x * 8 ) + 4 ) >> LIGHT_MAP_SHIFT ) - 4;
+		m_vLightColumns[x] = std::max( position, 0 ) >> 3;
+		m_vLightColumnWeights[x] = std::max( position, 0 ) & 7;
+	}
+
+	Pixel gameColour = m_vTimings.empty() ? PIX_BLACK : m_vTimings.back().pix;
+	BeginPostProcessTiming( PIX_ORANGE );
+
+	if( m_vWorkers.empty() )
+		StartWorkers();
+
+	PostProcessJob job;
+	job.step = POST_LIGHTING;
+	job.pDest = m_blitter.GetRenderTarget();
+	ForEachRowBand( job, m_lightRect.height );
+
+	BeginPostProcessTiming( gameColour );
 }
 
+//********************************************************************************************************************************
+// Function:	AddLightToMap - adds the light from a point light to the light map pixels it reaches
+// Parameters:	light = the light (in render target co-ordinates)
+// Notes:		The brightness falls off with the square of ( 1 - distance squared / radius squared ), which reaches zero at the
+//				radius without a visible edge. Two light map pixels are added at a time with 16-bit channels, and the channels are
+//				kept below LIGHT_MAP_MAX so that scaling up and multiplying can't overflow.
+//********************************************************************************************************************************
+void PlayGraphics::AddLightToMap( const Light& light )
+{
+	// Light map pixel i covers render target positions ( i * 4 ) to ( i * 4 ) + 4, so its centre is at ( i * 4 ) + 2
+	// > This is where LightRows scales it up from, as the centre of render target pixel x is at x + 0.5
+	float scale = 1.0f / static_cast<float>( 1 << LIGHT_MAP_SHIFT );
+	float centreX = ( light.pos.x * scale ) - 0.5f;
+	float centreY = ( light.pos.y * scale ) - 0.5f;
+	float radius = light.radius * scale;
+	if( radius <= 0.0f || light.intensity <= 0.0f )
+		return;
 
+	int left = std::max( static_cast<int>( ceil( centreX - radius ) ), 0 );
+	int right = std::min( static_cast<int>( floor( centreX + radius ) ), m_lightMapWidth - 1 );
+	int top = std::max( static_cast<int>( ceil( centreY - radius ) ), 0 );
+	int bottom = std::min( static_cast<int>( floor( centreY + radius ) ), m_lightMapHeight - 1 );
+	if( left > right || top > bottom )
+		return;
 
+	// Each channel is a fraction of 65535, so multiplying by a brightness (in 256ths) and keeping the top 16 bits gives 256ths
+	uint16_t colour[4] = { static_cast<uint16_t>( light.colour.b * 257 ), static_cast<uint16_t>( light.colour.g * 257 ), static_cast<uint16_t>( light.colour.r * 257 ), 0 };
+	float inverseRadiusSq = 1.0f / ( radius * radius );
+	float strength = light.intensity * 256.0f;
+	int brightness[2] = { 0, 0 };
 
-void PlayGraphics::DrawRect( Point2f topLeft, Point2f bottomRight, Pixel pix, bool fill )
-{
-	// Convert floating point co-ordinates to pixels
-	int x1 = static_cast<int>( topLeft.x + 0.5f );
-	int x2 = static_cast<int>( bottomRight.x + 0.5f );
-	int y1 = static_cast<int>( topLeft.y + 0.5f );
-	int y2 = static_cast<int>( bottomRight.y + 0.5f );
+#ifdef PLAY_USE_SSE2
+	__m128i colourPair = _mm_set_epi16( 0, static_cast<short>( colour[2] ), static_cast<short>( colour[1] ), static_cast<short>( colour[0] ),
+		0, static_cast<short>( colour[2] ), static_cast<short>( colour[1] ), static_cast<short>( colour[0] ) );
+	__m128i maximum = _mm_set1_epi16( LIGHT_MAP_MAX );
+#endif
 
-	if( fill )
+	for( int y = top; y <= bottom; y++ )
 	{
-		for( int x = x1; x < x2; x++ )
+		float dy = static_cast<float>( y ) - centreY;
+		uint16_t* pRow = &m_vLightMap[static_cast<size_t>( y ) * m_lightMapWidth * 4];
+
+		for( int x = left; x <= right; x += 2 )
 		{
-			for( int y = y1; y < y2; y++ )
-				m_blitter.DrawPixel( x, y, pix );
+			int count = std::min( right - x + 1, 2 );
+			for( int i = 0; i < count; i++ )
+			{
+				float dx = static_cast<float>( x + i ) - centreX;
+				float fade = std::max( 1.0f - ( ( ( dx * dx ) + ( dy * dy ) ) * inverseRadiusSq ), 0.0f );
+				brightness[i] = std::min( static_cast<int>( fade * fade * strength ), LIGHT_MAP_MAX );
+			}
+
+			uint16_t* pPixels = pRow + ( x * 4 );
+#ifdef PLAY_USE_SSE2
+			if( count == 2 )
+			{
+				__m128i light = _mm_mulhi_epu16( colourPair, _mm_set_epi16( static_cast<short>( brightness[1] ), static_cast<short>( brightness[1] ), static_cast<short>( brightness[1] ), static_cast<short>( brightness[1] ),
+					static_cast<short>( brightness[0] ), static_cast<short>( brightness[0] ), static_cast<short>( brightness[0] ), static_cast<short>( brightness[0] ) ) );
+				__m128i* pPair = reinterpret_cast<__m128i*>( pPixels );
+				_mm_storeu_si128( pPair, _mm_min_epi16( _mm_add_epi16( _mm_loadu_si128( pPair ), light ), maximum ) );
+				continue;
+			}
+#endif
+			for( int i = 0; i < count * 4; i++ )
+				pPixels[i] = static_cast<uint16_t>( std::min( pPixels[i] + ( ( colour[i & 3] * brightness[i >> 2] ) >> 16 ), LIGHT_MAP_MAX ) );
 		}
 	}
-	else
-	{
-		m_blitter.DrawLine( x1, y1, x2, y1, pix );
-		m_blitter.DrawLine( x2, y1, x2, y2, pix );
-		m_blitter.DrawLine( x2, y2, x1, y2, pix );
-		m_blitter.DrawLine( x1, y2, x1, y1, pix );
-	}
 }
 
-// Private function called by DrawCircle
-void PlayGraphics::DrawCircleOctants( int posX, int posY, int offX, int offY, Pixel pix )
-{
-	DrawPixel( { posX + offX , posY + offY }, pix );
-	DrawPixel( { posX - offX , posY + offY }, pix );
-	DrawPixel( { posX + offX , posY - offY }, pix );
-	DrawPixel( { posX - offX , posY - offY }, pix );
-	DrawPixel( { posX - offY , posY + offX }, pix );
-	DrawPixel( { posX + offY , posY - offX }, pix );
-	DrawPixel( { posX - offY , posY - offX }, pix );
-	DrawPixel( { posX + offY , posY + offX }, pix );
-}
-
-void PlayGraphics::DrawCircle( Point2f pos, int radius, Pixel pix )
+//********************************************************************************************************************************
+// Function:	LightRows - multiplies a band of rows by the light map
+// Parameters:	image = the render target, startY/endY = the band of rows, vRowLight = the band's working buffer for a light map row
+// Notes:		Each row blends the two nearest light map rows first, then each pixel blends the two nearest columns of that
+//				(bilinear scaling with weights in 8ths). Full brightness is 256, so multiplying a channel shifted up by 8 bits by
+//				the light and keeping the top 16 bits of the result lights it. Brighter than full saturates at white.
+//********************************************************************************************************************************
+void PlayGraphics::LightRows( PixelData& image, int startY, int endY, std::vector<uint16_t>& vRowLight ) const
 {
-	// Convert floating point co-ordinates to pixels
-	int x = static_cast<int>( pos.x + 0.5f );
-	int y = static_cast<int>( pos.y + 0.5f );
+	int mapStride = m_lightMapWidth * 4;
+	int startX = m_lightRect.x;
+	int endX = m_lightRect.x + m_lightRect.width;
 
-	int dx = 0;
-	int dy = radius;
+	// The light map blended to the height of the current row
+	vRowLight.resize( mapStride );
 
-	int d = 3 - 2 * radius;
-	DrawCircleOctants( x, y, dx, dy, pix );
+#ifdef PLAY_USE_SSE2
+	__m128i zero = _mm_setzero_si128();
+	__m128i columnWeights[8];
+	for( int w = 0; w < 8; w++ )
+		columnWeights[w] = _mm_set_epi16( static_cast<short>( w ), static_cast<short>( w ), static_cast<short>( w ), static_cast<short>( w ),
+			static_cast<short>( 8 - w ), static_cast<short>( 8 - w ), static_cast<short>( 8 - w ), static_cast<short>( 8 - w ) );
+#endif
 
-	while( dy >= dx )
+	for( int y = startY; y < endY; y++ )
 	{
-		dx++;
-		if( d > 0 )
+		int position = std::max( ( ( ( y * 8 ) + 4 ) >> LIGHT_MAP_SHIFT ) - 4, 0 );
+		int rowWeight = position & 7;
+		const uint16_t* pAbove = &m_vLightMap[static_cast<size_t>( position >> 3 ) * mapStride];
+		const uint16_t* pBelow = pAbove + mapStride;
+		int i = 0;
+
+#ifdef PLAY_USE_SSE2
+		__m128i aboveWeight = _mm_set1_epi16( static_cast<short>( 8 - rowWeight ) );
+		__m128i belowWeight = _mm_set1_epi16( static_cast<short>( rowWeight ) );
+		for( ; i + 8 <= mapStride; i += 8 )
 		{
-			dy--;
-			d = static_cast<int>( d + 4 * ( dx - dy ) + 10 );
+			__m128i above = _mm_loadu_si128( reinterpret_cast<const __m128i*>( pAbove + i ) );
+			__m128i below = _mm_loadu_si128( reinterpret_cast<const __m128i*>( pBelow + i ) );
+			_mm_storeu_si128( reinterpret_cast<__m128i*>( &vRowLight[i] ), _mm_srli_epi16( _mm_add_epi16( _mm_mullo_epi16( above, aboveWeight ), _mm_mullo_epi16( below, belowWeight ) ), 3 ) );
+		}
+#endif
+		for( ; i < mapStride; i++ )
+			vRowLight[i] = static_cast<uint16_t>( ( ( pAbove[i] * ( 8 - rowWeight ) ) + ( pBelow[i] * rowWeight ) ) >> 3 );
+
+		int x = startX;
+
+		if( image.format == PIXEL_FORMAT_RGB565 )
+		{
+			// 16-bit pixels are lit a channel at a time and dithered back down
+			uint16_t* pRow = image.Row565( y );
+			for( ; x < endX; x++ )
+			{
+				const uint16_t* pLight = &vRowLight[m_vLightColumns[x] * 4];
+				int columnWeight = m_vLightColumnWeights[x];
+				uint32_t pix = PlayBlitter::UnpackPixel565( pRow[x] );
+				uint32_t result = 0;
+				bool unchanged = true;
+				for( int c = 0; c < 24; c += 8 )
+				{
+					int light = ( ( pLight[c / 8] * ( 8 - columnWeight ) ) + ( pLight[( c / 8 ) + 4] * columnWeight ) ) >> 3;
+					result |= static_cast<uint32_t>( std::min( ( static_cast<int>( ( pix >> c ) & 0xFF ) * light ) >> 8, 255 ) ) << c;
+					unchanged = unchanged && light == 256;
+				}
+
+				// Dithering again would change pixels which are lit at exactly full brightness
+				if( !unchanged )
+					pRow[x] = PlayBlitter::PackPixel565( result, x, y );
+			}
+			continue;
+		}
+
+		uint32_t* pRow = &image.Row( y )->bits;
+
+#ifdef PLAY_USE_SSE2
+		for( ; x + 4 <= endX; x += 4 )
+		{
+			__m128i light[4];
+			for( int p = 0; p < 4; p++ )
+			{
+				__m128i pair = _mm_mullo_epi16( _mm_loadu_si128( reinterpret_cast<const __m128i*>( &vRowLight[m_vLightColumns[x + p] * 4] ) ), columnWeights[m_vLightColumnWeights[x + p]] );
+				light[p] = _mm_srli_epi16( _mm_add_epi16( pair, _mm_srli_si128( pair, 8 ) ), 3 );
+			}
+
+			__m128i pixels = _mm_loadu_si128( reinterpret_cast<const __m128i*>( pRow + x ) );
+			__m128i lo = _mm_mulhi_epu16( _mm_slli_epi16( _mm_unpacklo_epi8( pixels, zero ), 8 ), _mm_unpacklo_epi64( light[0], light[1] ) );
+			__m128i hi = _mm_mulhi_epu16( _mm_slli_epi16( _mm_unpackhi_epi8( pixels, zero ), 8 ), _mm_unpacklo_epi64( light[2], light[3] ) );
+			_mm_storeu_si128( reinterpret_cast<__m128i*>( pRow + x ), _mm_packus_epi16( lo, hi ) );
 		}
-		else
+#endif
+		for( ; x < endX; x++ )
 		{
-			d = static_cast<int>( d + 4 * dx + 6 );
+			const uint16_t* pLight = &vRowLight[m_vLightColumns[x] * 4];
+			int columnWeight = m_vLightColumnWeights[x];
+			uint32_t result = 0;
+			for( int c = 0; c < 32; c += 8 )
+			{
+				int light = ( ( pLight[c / 8] * ( 8 - columnWeight ) ) + ( pLight[( c / 8 ) + 4] * columnWeight ) ) >> 3;
+				result |= static_cast<uint32_t>( std::min( ( static_cast<int>( ( pRow[x] >> c ) & 0xFF ) * light ) >> 8, 255 ) ) << c;
+			}
+			pRow[x] = result;
 		}
-		DrawCircleOctants( x, y, dx, dy, pix );
-	}
-};
-
-void PlayGraphics::DrawPixelData( PixelData* pixelData, Point2f pos, float alpha )
-{
-	if( !pixelData->preMultiplied )
-	{
-		PreMultiplyAlpha( pixelData->pPixels, pixelData->pPixels, pixelData->width, pixelData->height, pixelData->width );
-		pixelData->preMultiplied = true;
 	}
-	m_blitter.BlitPixels( *pixelData, 0, static_cast<int>(pos.x), static_cast<int>(pos.y), pixelData->width, pixelData->height, alpha );
 }
 
-
 //********************************************************************************************************************************
-// Debug font functions
+// Worker thread functions
 //********************************************************************************************************************************
 
-// Settings for the embedded debug font
-#define FONT_IMAGE_WIDTH	96
-#define FONT_IMAGE_HEIGHT	36
-#define FONT_CHAR_WIDTH		6
-#define FONT_CHAR_HEIGHT	12
+void PlayGraphics::SetWorkerThreads( int count )
+{
+	PLAY_ASSERT_MSG( count >= 0, "Trying to set a negative number of worker threads" );
 
-// A 96x36 font image @ 1bpp containing basic ASCII characters from 0x30 (0) to 0x5F (underscore) at 6x12 pixels each
-static const uint32_t debugFontData[] =
+	StopWorkers();
+	m_workerCount = count;
+
+	// The workers are otherwise started by the first pass which needs them
+	if( m_bPostProcess )
+		StartWorkers();
+}
+
+void PlayGraphics::StartWorkers()
 {
-	0x87304178, 0x0800861F, 0xFFFFFFE1, 0x7BBFBE79, 0xF7FE79EF, 0xFFFFFFFE, 0x7BBFBE79, 0xF7FE79EC, 0xFFFFFFFE, 0x7BBFBE79, 0xF7FE79EC, 0xFFFFFFFE, 0x7BBFBE79, 0xF7FE79EF, 0xFFEE3DFE, 0x6BB86080,
-	0x1078860F, 0xE3DFFEFE, 0x5BB7FEFB, 0xE7BE7BEF, 0xFFBFFF41, 0x7BB7FEFB, 0xE7BE7BEC, 0xFFDFFEDF, 0x7BB7FEFB, 0xE7BE7BEC, 0xFFEE3DDF, 0x7BB7FEFB, 0xE7BE7BEF, 0xFFFFFFFF, 0x7BB7BEF9, 0xE7BE7BEF,
-	0xFFFFFFDF, 0x87B001F8, 0x187E87EF, 0xFFFFFFDF, 0x86106104, 0x00007A30, 0x1E7C5061, 0x79E79E79, 0xF7DF7B7F, 0x5E7DA79E, 0x79E79F79, 0xF7DF7B7F, 0x5E7DA79E, 0x79E79F79, 0xF7DF7B7F, 0x5E7DA79E,
-	0x59E79F79, 0xF7DF7B7F, 0x597DA79E, 0x58005F78, 0x30D0037F, 0x477DA79E, 0x59E79F79, 0xF7DE7B7F, 0x597DA79E, 0x59E79F79, 0xF7DE7B7F, 0x5E7DA79E, 0x41E79F79, 0xF7DE7B7F, 0x5E7DA79E, 0x7DE79F79,
-	0xF7DE7B7F, 0x5E7DA79E, 0x7DE79E79, 0xF7DE7B7F, 0x5E7DA79E, 0x81E06104, 0x07C17A38, 0xDE01A7A1, 0x06106101, 0xE79E79E0, 0x337F3FFF, 0x79E79EED, 0xE79E79EF, 0xB77FBFFF, 0x79E79FED, 0xE79E79EF,
-	0xB7BFBFFF, 0x79E79FED, 0xE79A79EF, 0xB7BFBFFF, 0x79E75FED, 0xE79AB5EF, 0x77DFBFFF, 0x05E0E1ED, 0xE79ACC0E, 0xF7DFBFFF, 0x7DE77EED, 0xE79AB7ED, 0xF7EFBFFF, 0x7DE7BEED, 0xE79A7BEB, 0xF7EFBFFF,
-	0x7DE7BEED, 0xE79A7BE7, 0xF7F7BFFF, 0x7DA7BEED, 0xE79A7BE7, 0xF7F7BCFF, 0x7DD79EED, 0xEB5A7BE7, 0xF7FBBCFF, 0x7C27A1EE, 0x1CE57810, 0x33FB3EC0
-};
+	int count = ( m_workerCount >= 0 ) ? m_workerCount : static_cast<int>( std::thread::hardware_concurrency() ) - 1;
+	for( int i = 0; i < count; i++ )
+		m_vWorkers.push_back( std::thread( &PlayGraphics::WorkerLoop, this ) );
+}
 
-void PlayGraphics::DecompressDubugFont( void )
+void PlayGraphics::StopWorkers()
+{
+	{
+		std::lock_guard<std::mutex> lock( m_workerMutex );
+		m_bWorkersQuit = true;
+	}
+	m_workerWake.notify_all();
+
+	for( std::thread& worker : m_vWorkers )
+		worker.join();
+
+	m_vWorkers.clear();
+	m_bWorkersQuit = false;
+}
+
+void PlayGraphics::WorkerLoop()
 {
-	m_pDebugFontBuffer = new uint8_t[FONT_IMAGE_WIDTH * FONT_IMAGE_HEIGHT];
+	int jobNumber = 0;
 
-	for( int y = 0; y < FONT_IMAGE_HEIGHT; y++ )
+	for( ;; )
 	{
-		for( int x = 0; x < FONT_IMAGE_WIDTH; x++ )
 		{
-			int bufferIndex = ( y * FONT_IMAGE_WIDTH ) + x;
-			int dataIndex = bufferIndex / 32;
-			int dataShift = 31 - ( bufferIndex % 32 );
+			std::unique_lock<std::mutex> lock( m_workerMutex );
+			while( !m_bWorkersQuit && m_workerJobNumber == jobNumber )
+				m_workerWake.wait( lock );
 
-			// Convert 1bpp to an 8-bit array for easy data access
-			if( ( debugFontData[dataIndex] >> dataShift ) & 0x01 )
-				m_pDebugFontBuffer[( y * FONT_IMAGE_WIDTH ) + x] = 0; // not ARGB just 0 (no pixel)
-			else
-				m_pDebugFontBuffer[( y * FONT_IMAGE_WIDTH ) + x] = 1; // not ARGB just 1 (a pixel)
+			if( m_bWorkersQuit )
+				return;
+
+			jobNumber = m_workerJobNumber;
 		}
+
+		RunWorkerBands();
 	}
 }
 
-int PlayGraphics::DrawDebugCharacter( Point2f pos, char c, Pixel pix )
+void PlayGraphics::RunWorkerBands()
 {
-	// Limited character set in the font (0x30-0x5F) so includes translation of useful chars outside that range
-	switch( c )
+	for( ;; )
 	{
-		case 0x2C: c = 0x5E; break; // Map full stop to comma (nearly the same!)
-		case 0x2D: c = 0x3B; break; // Map minus to semi-colon (rarely used)
-		case 0x28: c = 0x5B; break; // Map brackets to square brackets
-		case 0x29: c = 0x5D; break; // Map brackets to square brackets
-		case 0x2E: c = 0x5E; break; // Map full stop to carot (never used)
-	}
-
-	if( c < 0x30 || c > 0x5F )
-		return FONT_CHAR_WIDTH;
+		// A worker which arrives late (even after the next job has started) just claims a band of whichever job is current
+		int claim = m_workerClaims++;
+		int band = claim & 0xFFFF;
+		int bandCount = claim >> 16;
+		if( band >= bandCount )
+			return;
 
-	int sourceX = ( ( c - 0x30 ) % 16 ) * FONT_CHAR_WIDTH;
-	int sourceY = ( ( c - 0x30 ) / 16 ) * FONT_CHAR_HEIGHT;
+		// The job can't change until every band (including this one) has finished
+		int startY = ( m_workerRows * band ) / bandCount;
+		int endY = ( m_workerRows * ( band + 1 ) ) / bandCount;
+		RunPostProcessJob( m_workerJob, band, startY, endY );
 
-	// Loop over the bounding box of the glyph
-	for( int x = 0; x < FONT_CHAR_WIDTH; x++ )
-	{
-		for( int y = 0; y < FONT_CHAR_HEIGHT; y++ )
+		if( --m_workerBandsLeft == 0 )
 		{
-			if( m_pDebugFontBuffer[( ( sourceY + y ) * FONT_IMAGE_WIDTH ) + ( sourceX + x )] > 0 )
-				DrawPixel( { pos.x + x, pos.y + y }, pix );
+			std::lock_guard<std::mutex> lock( m_workerMutex );
+			m_workerDone.notify_all();
 		}
 	}
-
-	return FONT_CHAR_WIDTH;
 }
 
-int PlayGraphics::DrawDebugString( Point2f pos, const std::string& s, Pixel pix, bool centred )
+void PlayGraphics::ForEachRowBand( const PostProcessJob& job, int height )
 {
-	if( m_pDebugFontBuffer == nullptr )
-		DecompressDubugFont();
+	// Bands of fewer than 16 rows aren't worth waking a thread for
+	int bandCount = std::min( static_cast<int>( m_vWorkers.size() ) + 1, std::max( height / 16, 1 ) );
 
-	if( centred )
-		pos.x -= GetDebugStringWidth( s ) / 2;
+	// Each band has its own working buffers, which keep their memory from one pass (and frame) to the next
+	if( m_vBandScratch.size() < static_cast<size_t>( bandCount ) )
+		m_vBandScratch.resize( bandCount );
 
-	pos.y -= 6; // half the height of the debug font
+	if( bandCount == 1 )
+	{
+		RunPostProcessJob( job, 0, 0, height );
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock( m_workerMutex );
+		m_workerJob = job;
+		m_workerRows = height;
+		m_workerBandsLeft = bandCount;
+		m_workerClaims = bandCount << 16;
+		m_workerJobNumber++;
+	}
+	m_workerWake.notify_all();
 
-	for( char c : s )
-		pos.x += DrawDebugCharacter( pos, static_cast<char>( toupper( c ) ), pix ) + 1;
+	// This thread works on the bands too, rather than just waiting
+	RunWorkerBands();
 
-	// Return horizontal position at the end of the string so strings can be concatenated easily
-	return static_cast<int>( pos.x );
+	std::unique_lock<std::mutex> lock( m_workerMutex );
+	while( m_workerBandsLeft > 0 )
+		m_workerDone.wait( lock );
 }
 
-int PlayGraphics::GetDebugStringWidth( const std::string& s )
+//********************************************************************************************************************************
+// Frame functions
+//********************************************************************************************************************************
+
+void PlayGraphics::EndFrame( float frameMillisecs )
 {
-	return static_cast<int>( s.length() ) * ( FONT_CHAR_WIDTH + 1 );
+	FlushDeferredDraws();
+
+	// This is the only place a 16-bit frame is expanded to 32 bits (straight into the window's memory when it draws there)
+	PixelData* pRenderTarget = m_blitter.GetRenderTarget();
+	if( pRenderTarget == &m_scaledBuffer || pRenderTarget == &m_display565 )
+		UpscaleToDisplay( *pRenderTarget );
+
+	// The passes work on the whole frame at display resolution
+	if( m_bPostProcess )
+		ApplyPostProcess();
+
+	float frameTime = frameMillisecs;
+	if( frameTime < 0.0f )
+	{
+		// Frames which don't use the timing bar (or give their own time) aren't measured
+		if( m_vTimings.empty() )
+			return;
+
+		LARGE_INTEGER now, freq;
+		QueryPerformanceCounter( &now );
+		QueryPerformanceFrequency( &freq );
+		frameTime = static_cast<float>( ( ( now.QuadPart - m_vTimings[0].begin ) * 1000.0 ) / freq.QuadPart );
+	}
+
+	// A moving average, so the headroom doesn't jump around from frame to frame
+	m_averageFrameTime = ( m_averageFrameTime == 0.0f ) ? frameTime : m_averageFrameTime + ( ( frameTime - m_averageFrameTime ) * 0.1f );
+
+	UpdateQualityGovernor();
+
+	if( m_bDynamicResolution )
+		UpdateDynamicResolution( frameTime );
 }
 
 //********************************************************************************************************************************
@@ -3241,6 +10455,161 @@ void PlayGraphics::TimingBarBegin( Pixel pix )
 	m_vTimings.clear();
 	SetTimingBarColour( pix );
 }
+//********************************************************************************************************************************
+// File:		PlayTileMap.cpp
+// Description:	Implementation of a grid of tiles drawn using the frames of a sprite sheet
+// Platform:	Independent
+// Notes:		Tiles never overlap, so a chunk is built by copying the pre-multiplied pixels each tile is drawn with (including
+//				its colour), which draws exactly the same pixels as drawing each tile as a sprite
+//********************************************************************************************************************************
+
+TileMap::TileMap( int tileSpriteId, int width, int height, int chunkSize )
+{
+	PLAY_ASSERT_MSG( width > 0 && height > 0 && chunkSize > 0, "Trying to create a tile map with an invalid size" );
+
+	m_tileSpriteId = tileSpriteId;
+	m_width = width;
+	m_height = height;
+	m_chunkSize = chunkSize;
+	m_chunksWide = ( width + chunkSize - 1 ) / chunkSize;
+	m_chunksHigh = ( height + chunkSize - 1 ) / chunkSize;
+
+	m_vTiles.assign( static_cast<size_t>( width ) * height, -1 );
+	m_vChunks.resize( static_cast<size_t>( m_chunksWide ) * m_chunksHigh );
+}
+
+void TileMap::SetTile( int x, int y, int tileIndex )
+{
+	PLAY_ASSERT_MSG( x >= 0 && y >= 0 && x < m_width && y < m_height, "Trying to set a tile outside the tile map" );
+	if( x < 0 || y < 0 || x >= m_width || y >= m_height )
+		return;
+
+	int& tile = m_vTiles[static_cast<size_t>( y ) * m_width + x];
+	if( tile == tileIndex )
+		return;
+
+	Chunk& chunk = m_vChunks[( y / m_chunkSize ) * m_chunksWide + ( x / m_chunkSize )];
+	chunk.tileCount += ( tileIndex >= 0 ) - ( tile >= 0 );
+	chunk.dirty = true;
+	tile = tileIndex;
+}
+
+int TileMap::GetTile( int x, int y ) const
+{
+	if( x < 0 || y < 0 || x >= m_width || y >= m_height )
+		return -1;
+
+	return m_vTiles[static_cast<size_t>( y ) * m_width + x];
+}
+
+void TileMap::Fill( int tileIndex )
+{
+	std::fill( m_vTiles.begin(), m_vTiles.end(), tileIndex );
+
+	for( int chunkY = 0; chunkY < m_chunksHigh; chunkY++ )
+	{
+		for( int chunkX = 0; chunkX < m_chunksWide; chunkX++ )
+		{
+			Chunk& chunk = m_vChunks[chunkY * m_chunksWide + chunkX];
+			int tilesWide = std::min( m_chunkSize, m_width - chunkX * m_chunkSize );
+			int tilesHigh = std::min( m_chunkSize, m_height - chunkY * m_chunkSize );
+			chunk.tileCount = ( tileIndex >= 0 ) ? tilesWide * tilesHigh : 0;
+			chunk.dirty = true;
+		}
+	}
+}
+
+void TileMap::InvalidateAll()
+{
+	for( Chunk& chunk : m_vChunks )
+		chunk.dirty = true;
+}
+
+void TileMap::Draw( Point2f cameraPos )
+{
+	PlayGraphics& graphics = PlayGraphics::Instance();
+	Vector2f tileSize = graphics.GetSpriteSize( m_tileSpriteId );
+	int chunkWidth = m_chunkSize * static_cast<int>( tileSize.width );
+	int chunkHeight = m_chunkSize * static_cast<int>( tileSize.height );
+
+	int cameraX = static_cast<int>( floor( cameraPos.x + 0.5f ) );
+	int cameraY = static_cast<int>( floor( cameraPos.y + 0.5f ) );
+
+	// Work out which chunks overlap the clipping rectangle (in map pixels) as seen through both cameras
+	PixelRect clip = graphics.GetClipRect();
+	Point2f graphicsCamera = graphics.GetCameraPosition();
+	int left = clip.x + cameraX + static_cast<int>( floor( graphicsCamera.x + 0.5f ) );
+	int top = clip.y + cameraY + static_cast<int>( floor( graphicsCamera.y + 0.5f ) );
+	int right = left + clip.width - 1;
+	int bottom = top + clip.height - 1;
+
+	if( clip.width <= 0 || clip.height <= 0 || right < 0 || bottom < 0 )
+		return;
+
+	int firstChunkX = std::max( left, 0 ) / chunkWidth;
+	int firstChunkY = std::max( top, 0 ) / chunkHeight;
+	int lastChunkX = std::min( right / chunkWidth, m_chunksWide - 1 );
+	int lastChunkY = std::min( bottom / chunkHeight, m_chunksHigh - 1 );
+
+	for( int chunkY = firstChunkY; chunkY <= lastChunkY; chunkY++ )
+	{
+		for( int chunkX = firstChunkX; chunkX <= lastChunkX; chunkX++ )
+		{
+			Chunk& chunk = m_vChunks[chunkY * m_chunksWide + chunkX];
+			if( chunk.tileCount == 0 )
+				continue;
+
+			if( chunk.dirty )
+				DrawChunk( chunkX, chunkY );
+
+			graphics.DrawPixelData( &chunk.pixelData, { static_cast<float>( chunkX * chunkWidth - cameraX ), static_cast<float>( chunkY * chunkHeight - cameraY ) } );
+		}
+	}
+}
+
+void TileMap::DrawChunk( int chunkX, int chunkY )
+{
+	PlayGraphics& graphics = PlayGraphics::Instance();
+	Vector2f tileSize = graphics.GetSpriteSize( m_tileSpriteId );
+	int tileWidth = static_cast<int>( tileSize.width );
+	int tileHeight = static_cast<int>( tileSize.height );
+
+	// Chunks at the right and bottom edges of the map may be smaller
+	int tilesWide = std::min( m_chunkSize, m_width - chunkX * m_chunkSize );
+	int tilesHigh = std::min( m_chunkSize, m_height - chunkY * m_chunkSize );
+
+	// Empty tiles are left fully transparent
+	Chunk& chunk = m_vChunks[chunkY * m_chunksWide + chunkX];
+	chunk.vPixels.assign( static_cast<size_t>( tilesWide ) * tileWidth * tilesHigh * tileHeight, Pixel( 0xFF000000 ) );
+	chunk.pixelData.width = tilesWide * tileWidth;
+	chunk.pixelData.height = tilesHigh * tileHeight;
+	chunk.pixelData.pPixels = chunk.vPixels.data();
+	chunk.pixelData.preMultiplied = true;
+
+	for( int y = 0; y < tilesHigh; y++ )
+	{
+		for( int x = 0; x < tilesWide; x++ )
+		{
+			int tile = m_vTiles[static_cast<size_t>( chunkY * m_chunkSize + y ) * m_width + ( chunkX * m_chunkSize + x )];
+			if( tile >= 0 )
+				graphics.CopySpriteFrameDrawData( m_tileSpriteId, tile, chunk.pixelData, x * tileWidth, y * tileHeight );
+		}
+	}
+
+	// Work from right to left so each transparent pixel's skip value can be worked out from its neighbour
+	for( int y = 0; y < chunk.pixelData.height; y++ )
+	{
+		uint32_t* pRow = &chunk.pixelData.Row( y )->bits;
+		for( int x = chunk.pixelData.width - 2; x >= 0; x-- )
+		{
+			if( pRow[x] >= 0xFF000000 && pRow[x + 1] >= 0xFF000000 )
+				pRow[x] = pRow[x + 1] + 1;
+		}
+	}
+
+	chunk.dirty = false;
+}
+
 //********************************************************************************************************************************
 // File:		PlaySpeaker.cpp
 // Description:	Implementation of a very simple audio manager using the MCI
@@ -3262,10 +10631,11 @@ PlayAudio* PlayAudio::s_pInstance = nullptr;
 PlayAudio::PlayAudio( const char* path )
 {
 	PLAY_ASSERT_MSG( !s_pInstance, "PlayAudio is a singleton class: multiple instances not allowed!" );
-	PLAY_ASSERT_MSG( std::filesystem::is_directory( path ), "Audio directory does not exist!" );
+	std::string directory = PlayWindow::FindFile( path );
+	PLAY_ASSERT_MSG( std::filesystem::is_directory( directory ), "Audio directory does not exist!" );
 
 	// Iterate through the directory
-	for( auto& p : std::filesystem::directory_iterator( path ) )
+	for( auto& p : std::filesystem::directory_iterator( directory ) )
 	{
 		// Switch everything to uppercase to avoid need to check case each time
 		std::string filename = p.path().string();
@@ -3502,8 +10872,8 @@ namespace Play
 	void DestroyManager()
 	{
 		PlayAudio::Destroy();
+		PlayWindow::Destroy(); // Before PlayGraphics, as the window can be using the display buffer's memory
 		PlayGraphics::Destroy();
-		PlayWindow::Destroy();
 		PlayInput::Destroy();
 #ifdef PLAY_USING_GAMEOBJECT_MANAGER
 		for( std::pair<const int, GameObject&>& p : objectMap )
@@ -3539,9 +10909,106 @@ namespace Play
 		return PlayGraphics::Instance().LoadBackground( pngFilename );
 	}
 
-	void DrawBackground( int background )
+	void DrawBackground( int background, Vector2D scrollFactor )
+	{
+		PlayGraphics::Instance().DrawBackground( background, scrollFactor );
+	}
+
+	void SetCameraPosition( Point2D pos )
+	{
+		PlayGraphics::Instance().SetCameraPosition( pos );
+	}
+
+	Point2D GetCameraPosition()
+	{
+		return PlayGraphics::Instance().GetCameraPosition();
+	}
+
+	void SetDynamicResolution( bool enable, float targetMillisecs, float minScale )
+	{
+		DynamicResolutionSettings settings;
+		settings.targetMillisecs = targetMillisecs;
+		settings.minScale = minScale;
+		PlayGraphics::Instance().SetDynamicResolution( enable, settings );
+	}
+
+	float GetResolutionScale()
+	{
+		return PlayGraphics::Instance().GetResolutionScale();
+	}
+
+	void SetSixteenBitDisplay( bool enable )
+	{
+		PlayGraphics::Instance().SetDisplayFormat( enable ? PIXEL_FORMAT_RGB565 : PIXEL_FORMAT_ARGB );
+	}
+
+	void SetFrameBudget( float targetMillisecs )
+	{
+		PlayGraphics::Instance().SetQualityGovernor( true, targetMillisecs );
+	}
+
+	float GetFrameHeadroom()
+	{
+		return PlayGraphics::Instance().GetFrameHeadroom();
+	}
+
+	float GetQualityLevel()
+	{
+		return PlayGraphics::Instance().GetQualityLevel();
+	}
+
+	void AddQualityKnob( const char* name, float lowQualityValue, float highQualityValue )
+	{
+		PlayGraphics::Instance().AddQualityKnob( name, lowQualityValue, highQualityValue );
+	}
+
+	float GetQualityKnob( const char* name )
+	{
+		return PlayGraphics::Instance().GetQualityKnob( name );
+	}
+
+	void SetScreenBlur( int radius )
+	{
+		PlayGraphics& graphics = PlayGraphics::Instance();
+		PostProcessSettings settings = graphics.GetPostProcessSettings();
+		settings.blurRadius = radius;
+		graphics.SetPostProcess( true, settings );
+	}
+
+	void SetBloom( bool enable, int threshold, float strength )
+	{
+		PlayGraphics& graphics = PlayGraphics::Instance();
+		PostProcessSettings settings = graphics.GetPostProcessSettings();
+		settings.bloom = enable;
+		settings.bloomThreshold = threshold;
+		settings.bloomStrength = strength;
+		graphics.SetPostProcess( true, settings );
+	}
+
+	void SetColourGrade( const char* pngFilename )
+	{
+		PlayGraphics& graphics = PlayGraphics::Instance();
+		if( pngFilename )
+			graphics.LoadColourGrade( pngFilename );
+
+		PostProcessSettings settings = graphics.GetPostProcessSettings();
+		settings.colourGrade = ( pngFilename != nullptr );
+		graphics.SetPostProcess( true, settings );
+	}
+
+	void SetAmbientLight( Colour col )
+	{
+		PlayGraphics::Instance().SetAmbientLight( Pixel( col.red * 2.55f, col.green * 2.55f, col.blue * 2.55f ) );
+	}
+
+	void AddLight( Point2D pos, float radius, Colour col, float intensity )
+	{
+		PlayGraphics::Instance().AddLight( pos, radius, Pixel( col.red * 2.55f, col.green * 2.55f, col.blue * 2.55f ), intensity );
+	}
+
+	void DrawLighting()
 	{
-		PlayGraphics::Instance().DrawBackground( background );
+		PlayGraphics::Instance().DrawLighting();
 	}
 
 	void DrawDebugText( Point2D pos, const char* text, Colour c, bool centred )
@@ -3561,15 +11028,33 @@ namespace Play
 		{
 			int textX = 10;
 			int textY = 10;
+
+			// The information text stays still when the camera moves
+			Point2f cameraPos = pblt.GetCameraPosition();
+			pblt.SetCameraPosition( { 0.0f, 0.0f } );
+
 			std::string s = "PlayBuffer Version:" + std::string( PLAY_VERSION );
-			pblt.DrawDebugString( { textX - 1, textY - 1 }, s, PIX_BLACK, false );
-			pblt.DrawDebugString( { textX + 1, textY + 1 }, s, PIX_BLACK, false );
-			pblt.DrawDebugString( { textX + 1, textY - 1 }, s, PIX_BLACK, false );
-			pblt.DrawDebugString( { textX - 1, textY + 1 }, s, PIX_BLACK, false );
-			pblt.DrawDebugString( { textX, textY }, s, PIX_YELLOW, false );
+			pblt.DrawDebugString( { textX, textY }, s, PIX_YELLOW, false, PIX_BLACK );
+
+			textY += 20;
+			s = "Occluded Pixels:" + std::to_string( pblt.GetOccludedPixelCount() );
+			pblt.DrawDebugString( { textX, textY }, s, PIX_YELLOW, false, PIX_BLACK );
+
+			if( pblt.GetDynamicResolution() )
+			{
+				int percent = static_cast<int>( ( pblt.GetResolutionScale() * 100.0f ) + 0.5f );
+				textY += 20;
+				s = "Resolution Scale:" + std::to_string( percent / 100 ) + "." + std::to_string( ( percent / 10 ) % 10 ) + std::to_string( percent % 10 );
+				pblt.DrawDebugString( { textX, textY }, s, PIX_YELLOW, false, PIX_BLACK );
+			}
+
+			pblt.SetCameraPosition( cameraPos );
 
 #ifdef PLAY_USING_GAMEOBJECT_MANAGER
 			
+			// Labels are only built for objects whose label could be on screen (the clip rectangle doesn't move with the camera)
+			PixelRect clip = pblt.GetClipRect();
+
 			for( std::pair<const int, GameObject&>& i : objectMap )
 			{
 				GameObject& obj = i.second;
@@ -3580,25 +11065,32 @@ namespace Play
 				// Corners of sprite drawing area
 				Point2D p0 = obj.pos - origin;
 				Point2D p2 = { obj.pos.x + size.width - origin.x, obj.pos.y + size.height - origin.y };
-				Point2D p1 = { p2.x, p0.y };
-				Point2D p3 = { p0.x, p2.y };
 
-				DrawLine( p0, p1, cRed );
-				DrawLine( p1, p2, cRed );
-				DrawLine( p2, p3, cRed );
-				DrawLine( p3, p0, cRed );
+				pblt.AddDebugRect( p0, p2, PIX_RED, PlayGraphics::DEBUG_BOUNDS );
+				pblt.AddDebugCircle( obj.pos, obj.radius, PIX_BLUE, PlayGraphics::DEBUG_COLLISION );
+				pblt.AddDebugLine( { obj.pos.x - 20,  obj.pos.y - 20 }, { obj.pos.x + 20, obj.pos.y + 20 }, PIX_WHITE, PlayGraphics::DEBUG_ORIGINS );
+				pblt.AddDebugLine( { obj.pos.x + 20, obj.pos.y - 20 }, { obj.pos.x - 20, obj.pos.y + 20 }, PIX_WHITE, PlayGraphics::DEBUG_ORIGINS );
 
-				DrawCircle( obj.pos, obj.radius, cBlue );
-
-				DrawLine( { obj.pos.x - 20,  obj.pos.y - 20 }, { obj.pos.x + 20, obj.pos.y + 20 }, cWhite );
-				DrawLine( { obj.pos.x + 20, obj.pos.y - 20 }, { obj.pos.x - 20, obj.pos.y + 20 }, cWhite );
-
-				s = pblt.GetSpriteName( obj.spriteId ) + " f[" + std::to_string( obj.frame ) + "]";
-				pblt.DrawDebugString( { ( p0.x + p1.x ) / 2.0f, p0.y - 20 }, s, PIX_WHITE, true );
+				Point2f labelPos = { ( p0.x + p2.x ) / 2.0f, p0.y - 20 };
+				if( ( pblt.GetDebugCategories() & PlayGraphics::DEBUG_LABELS ) && labelPos.y - cameraPos.y + 20 >= clip.y && labelPos.y - cameraPos.y - 20 < clip.y + clip.height )
+				{
+					// Re-uses the same string so that building labels doesn't allocate every frame
+					s.assign( pblt.GetSpriteName( obj.spriteId ) );
+					s.append( " f[" );
+					s.append( std::to_string( obj.frame ) );
+					s.append( "]" );
+					pblt.AddDebugLabel( labelPos, s, PIX_WHITE, PlayGraphics::DEBUG_LABELS );
+				}
 			}
 #endif
+			pblt.DrawDebugOverlay();
+		}
+		else
+		{
+			pblt.ClearDebugOverlay();
 		}
 
+		pblt.EndFrame();
 		PlayWindow::Instance().Present();
 	}
 
@@ -3688,6 +11180,22 @@ namespace Play
 		PlayGraphics::Instance().ColourSprite( spriteId, static_cast<int>( c.red * 2.55f ), static_cast<int>( c.green * 2.55f), static_cast<int>( c.blue * 2.55f ) );
 	}
 
+	void CompressSprite( const char* spriteName, bool compress )
+	{
+		int spriteId = PlayGraphics::Instance().GetSpriteId( spriteName );
+		PlayGraphics::Instance().CompressSprite( spriteId, compress );
+	}
+
+	void SetSpriteMemorySaving( bool enable )
+	{
+		PlayGraphics::Instance().SetSpriteMemorySaving( enable );
+	}
+
+	void ReportSpriteMemory()
+	{
+		PlayGraphics::Instance().ReportSpriteMemory();
+	}
+
 	void CentreSpriteOrigin( const char* spriteName )
 	{
 		PlayGraphics& pblt = PlayGraphics::Instance();
@@ -3779,9 +11287,9 @@ namespace Play
 		return PlayGraphics::Instance().DrawLine( start, end, { c.red * 2.55f, c.green * 2.55f, c.blue * 2.55f }  );
 	}
 
-	void DrawCircle( Point2D pos, int radius, Colour c )
+	void DrawCircle( Point2D pos, int radius, Colour c, bool fill )
 	{
-		PlayGraphics::Instance().DrawCircle( pos, radius, { c.red * 2.55f, c.green * 2.55f, c.blue * 2.55f } );
+		PlayGraphics::Instance().DrawCircle( pos, radius, { c.red * 2.55f, c.green * 2.55f, c.blue * 2.55f }, fill );
 	}
 
 	void DrawRect( Point2D topLeft, Point2D bottomRight, Colour c, bool fill )
@@ -3791,94 +11299,20 @@ namespace Play
 
 	void DrawSpriteLine( Point2f startPos, Point2f endPos, const char* penSprite, Colour c )
 	{
-		int spriteId = PlayGraphics::Instance().GetSpriteId( penSprite );
-		ColourSprite( penSprite, c );
-
-		//Draws a line in any angle
-		int x1 = static_cast<int>( startPos.x );
-		int y1 = static_cast<int>( startPos.y );
-		int x2 = static_cast<int>( endPos.x );
-		int y2 = static_cast<int>( endPos.y );
-
-		//Implementation of Bresenham's Line Drawing Algorithm
-		int dx = abs( x2 - x1 );
-		int sx = 1;
-		if( x2 < x1 ) { sx = -1; }
-
-		int dy = -abs( y2 - y1 );
-		int sy = 1;
-		if( y2 < y1 ) { sy = -1; }
-		
-		int err = dx + dy;
-
-		if( err == 0 ) return;
-
-		while( true )
-		{
-			Play::DrawSprite( spriteId, { x1, y1 }, 0 );
-			
-			if( x1 == x2 && y1 == y2 )
-				break;
-
-			int e2 = 2 * err;
-			if( e2 >= dy )
-			{
-				err += dy;
-				x1 += sx;
-			}
-			if( e2 <= dx )
-			{
-				err += dx;
-				y1 += sy;
-			}
-		}
-	}
-
-	void DrawCircleOctants( int spriteId, int x, int y, int ox, int oy )
-	{
-		//displaying all 8 coordinates of(x,y) residing in 8-octants
-		Play::DrawSprite( spriteId, { x + ox, y + oy }, 0 );
-		Play::DrawSprite( spriteId, { x - ox, y + oy }, 0 );
-		Play::DrawSprite( spriteId, { x + ox, y - oy }, 0 );
-		Play::DrawSprite( spriteId, { x - ox, y - oy }, 0 );
-		Play::DrawSprite( spriteId, { x + oy, y + ox }, 0 );
-		Play::DrawSprite( spriteId, { x - oy, y + ox }, 0 );
-		Play::DrawSprite( spriteId, { x + oy, y - ox }, 0 );
-		Play::DrawSprite( spriteId, { x - oy, y - ox }, 0 );
+		PlayGraphics& pblt = PlayGraphics::Instance();
+		pblt.DrawBrushLine( pblt.GetSpriteId( penSprite ), startPos, endPos, { c.red * 2.55f, c.green * 2.55f, c.blue * 2.55f } );
 	}
 
 	void DrawSpriteCircle( int x, int y, int radius, const char* penSprite, Colour c )
 	{
-		int spriteId = PlayGraphics::Instance().GetSpriteId( penSprite );
-		ColourSprite( penSprite, c );
-
-		int ox = 0, oy = radius;
-		int d = 3 - 2 * radius;
-		DrawCircleOctants( spriteId, x, y, ox, oy );
-
-		while( oy >= ox )
-		{
-			ox++;
-			if( d > 0 )
-			{
-				oy--;
-				d = d + 4 * ( ox - oy ) + 10;
-			}
-			else
-			{
-				d = d + 4 * ox + 6;
-			}
-			DrawCircleOctants( spriteId, x, y, ox, oy );
-		}
-	};
+		PlayGraphics& pblt = PlayGraphics::Instance();
+		pblt.DrawBrushCircle( pblt.GetSpriteId( penSprite ), { x, y }, radius, { c.red * 2.55f, c.green * 2.55f, c.blue * 2.55f } );
+	}
 
 	void DrawFontText( const char* fontId, std::string text, Point2D pos, Align justify )
 	{
 		int font = PlayGraphics::Instance().GetSpriteId( fontId );
-
-		int totalWidth{ 0 };
-		for( char c : text )
-			totalWidth += PlayGraphics::Instance().GetFontCharWidth( font, c );
+		int totalWidth = PlayGraphics::Instance().GetStringWidth( font, text );
 
 		switch( justify )
 		{
@@ -0,0 +1,201 @@
+#ifndef PLAY_PLAYTEST_H
+#define PLAY_PLAYTEST_H
+//********************************************************************************************************************************
+// File:		PlayTest.h
+// Description:	A minimal harness for the PlayBuffer behaviour tests
+// Notes:		Each test is a headless PlayBuffer program. RunTest is called from the first MainGameUpdate with an empty
+//				PlayGraphics (PLAY_TEST_DIRECTORY holds no sprites to load), and the number of failed checks is returned
+//				from MainGameExit as the program's exit code.
+//********************************************************************************************************************************
+
+#define PLAY_IMPLEMENTATION
+#include "Play.h"
+
+// The size of the display buffer the tests draw into
+constexpr int TEST_DISPLAY_WIDTH = 320;
+constexpr int TEST_DISPLAY_HEIGHT = 200;
+
+// Checks a condition, reporting where it failed without stopping the test
+#define PLAY_TEST_CHECK( condition ) PlayTest::Check( ( condition ), #condition, __FILE__, __LINE__ )
+
+// Implemented by each test
+void RunTest();
+
+namespace PlayTest
+{
+	static int s_failures = 0;
+
+	// Counts and reports a failed check
+	inline void Check( bool bPassed, const char* condition, const char* file, int line )
+	{
+		if( !bPassed )
+		{
+			fprintf( stderr, "%s(%d): check failed: %s\n", file, line, condition );
+			s_failures++;
+		}
+	}
+
+	// A hash of the visible pixels, for comparing images drawn in different ways
+	inline uint64_t Hash( const PixelData& pixelData )
+	{
+		uint64_t hash = 1469598103934665603ull;
+		for( int y = 0; y < pixelData.height; y++ )
+		{
+			const Pixel* pRow = pixelData.Row( y );
+			for( int x = 0; x < pixelData.width; x++ )
+			{
+				hash ^= pRow[x].bits;
+				hash *= 1099511628211ull;
+			}
+		}
+		return hash;
+	}
+
+	// Makes a canvas of frames for AddSprite: each frame is a soft edged disc in its own colours
+	// > The pixels are new[]'d, as the PlayGraphics takes ownership of a sprite's canvas
+	inline PixelData MakeDiscs( int frameWidth, int frameHeight, int frames, uint32_t seed )
+	{
+		PixelData canvas;
+		canvas.width = frameWidth * frames;
+		canvas.height = frameHeight;
+		canvas.pPixels = new Pixel[canvas.width * canvas.height];
+
+		for( int f = 0; f < frames; f++ )
+		{
+			for( int y = 0; y < frameHeight; y++ )
+			{
+				for( int x = 0; x < frameWidth; x++ )
+				{
+					float dx = ( x + 0.5f - frameWidth / 2.0f ) / ( frameWidth / 2.0f );
+					float dy = ( y + 0.5f - frameHeight / 2.0f ) / ( frameHeight / 2.0f );
+					float d = dx * dx + dy * dy;
+					int alpha = d > 1.0f ? 0 : ( d < 0.5f ? 255 : static_cast<int>( ( 1.0f - d ) * 2 * 255 ) );
+					uint32_t c = ( seed * 2654435761u ) ^ ( x * 7 + y * 13 + f * 101 );
+					canvas.pPixels[y * canvas.width + f * frameWidth + x] = Pixel( alpha, ( c >> 16 ) & 0xFF, ( c >> 8 ) & 0xFF, c & 0xFF );
+				}
+			}
+		}
+
+		return canvas;
+	}
+
+	// PNG files written by the tests go in a sub-directory, so the PlayGraphics doesn't load them as sprites on the next run
+	static const std::string PNG_DIRECTORY = std::string( PLAY_TEST_DIRECTORY ) + "png/";
+
+	inline void PutUint32( std::vector<uint8_t>& out, uint32_t value )
+	{
+		for( int shift = 24; shift >= 0; shift -= 8 )
+			out.push_back( static_cast<uint8_t>( value >> shift ) );
+	}
+
+	inline uint32_t Crc32( const uint8_t* pBytes, size_t count )
+	{
+		uint32_t crc = 0xFFFFFFFF;
+		for( size_t i = 0; i < count; i++ )
+		{
+			crc ^= pBytes[i];
+			for( int bit = 0; bit < 8; bit++ )
+				crc = ( crc >> 1 ) ^ ( 0xEDB88320 & ( 0 - ( crc & 1 ) ) );
+		}
+		return ~crc;
+	}
+
+	inline void PutChunk( std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& data )
+	{
+		PutUint32( out, static_cast<uint32_t>( data.size() ) );
+		size_t start = out.size();
+		out.insert( out.end(), type, type + 4 );
+		out.insert( out.end(), data.begin(), data.end() );
+		PutUint32( out, Crc32( out.data() + start, out.size() - start ) );
+	}
+
+	// Wraps data in a zlib stream made of uncompressed deflate blocks
+	inline std::vector<uint8_t> ZlibStore( const std::vector<uint8_t>& raw )
+	{
+		std::vector<uint8_t> out = { 0x78, 0x01 };
+		size_t position = 0;
+
+		do
+		{
+			size_t count = std::min<size_t>( raw.size() - position, 65535 );
+			bool bLast = position + count == raw.size();
+			out.push_back( bLast ? 1 : 0 );
+			out.push_back( static_cast<uint8_t>( count ) );
+			out.push_back( static_cast<uint8_t>( count >> 8 ) );
+			out.push_back( static_cast<uint8_t>( ~count ) );
+			out.push_back( static_cast<uint8_t>( ~count >> 8 ) );
+			out.insert( out.end(), raw.begin() + position, raw.begin() + position + count );
+			position += count;
+		} while( position < raw.size() );
+
+		uint32_t a = 1, b = 0;
+		for( uint8_t value : raw )
+		{
+			a = ( a + value ) % 65521;
+			b = ( b + a ) % 65521;
+		}
+		PutUint32( out, ( b << 16 ) | a );
+		return out;
+	}
+
+	// Writes a file into PNG_DIRECTORY, returning its path
+	inline std::string WriteFile( const std::string& name, const std::vector<uint8_t>& bytes )
+	{
+		std::filesystem::create_directories( PNG_DIRECTORY );
+		std::string path = PNG_DIRECTORY + name;
+		std::ofstream file( path, std::ios::binary );
+		file.write( reinterpret_cast<const char*>( bytes.data() ), bytes.size() );
+		return path;
+	}
+
+	// Writes an image as an 8-bit RGBA PNG file in PNG_DIRECTORY (e.g. for LoadBackground), returning its path
+	inline std::string WritePNG( const std::string& name, const PixelData& image )
+	{
+		static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+		std::vector<uint8_t> file( signature, signature + 8 );
+
+		std::vector<uint8_t> header;
+		PutUint32( header, static_cast<uint32_t>( image.width ) );
+		PutUint32( header, static_cast<uint32_t>( image.height ) );
+		header.insert( header.end(), { 8, 6, 0, 0, 0 } );
+		PutChunk( file, "IHDR", header );
+
+		std::vector<uint8_t> rows;
+		for( int y = 0; y < image.height; y++ )
+		{
+			rows.push_back( 0 ); // No filtering
+			for( int x = 0; x < image.width; x++ )
+			{
+				Pixel pix = image.Row( y )[x];
+				rows.insert( rows.end(), { pix.r, pix.g, pix.b, pix.a } );
+			}
+		}
+		PutChunk( file, "IDAT", ZlibStore( rows ) );
+		PutChunk( file, "IEND", {} );
+
+		return WriteFile( name, file );
+	}
+}
+
+void MainGameEntry( PLAY_IGNORE_COMMAND_LINE )
+{
+	PlayGraphics::Instance( TEST_DISPLAY_WIDTH, TEST_DISPLAY_HEIGHT, PLAY_TEST_DIRECTORY );
+	PlayWindow::Instance( PlayGraphics::Instance().GetDrawingBuffer(), 1 );
+}
+
+bool MainGameUpdate( float elapsedTime )
+{
+	UNREFERENCED_PARAMETER( elapsedTime );
+	RunTest();
+	return true;
+}
+
+int MainGameExit( void )
+{
+	PlayWindow::Destroy();
+	PlayGraphics::Destroy();
+	printf( "%d checks failed\n", PlayTest::s_failures );
+	return PlayTest::s_failures;
+}
+
+#endif
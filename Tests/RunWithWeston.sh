@@ -0,0 +1,29 @@
+#!/bin/sh
+# Runs a test program against its own headless Weston compositor, returning the program's exit code
+# Usage: RunWithWeston.sh <weston> <program> [arguments...]
+weston="$1"
+shift
+
+# Wayland sockets live in the runtime directory, which a test machine may not have
+if [ -z "$XDG_RUNTIME_DIR" ]; then
+	XDG_RUNTIME_DIR=$(mktemp -d)
+	export XDG_RUNTIME_DIR
+fi
+
+socket="play-test-$$"
+"$weston" --backend=headless-backend.so --socket="$socket" --idle-time=0 &
+westonPid=$!
+
+# Wait up to ten seconds for the compositor to start listening
+tries=0
+while [ ! -S "$XDG_RUNTIME_DIR/$socket" ] && [ $tries -lt 100 ]; do
+	sleep 0.1
+	tries=$((tries + 1))
+done
+
+WAYLAND_DISPLAY="$socket" "$@"
+result=$?
+
+kill $westonPid
+wait $westonPid 2>/dev/null
+exit $result
@@ -0,0 +1,214 @@
+// Draws brush lines and circles and checks them against the stroke's coverage worked out here and blended once
+#include "PlayTest.h"
+#include <climits>
+
+static const int PEN_SIZE = 9;
+
+static int s_penId = -1;
+static std::vector<Pixel> s_penPixels;
+
+// The pen positions along a line, in the order they are stamped
+static std::vector<std::pair<int, int>> LineStamps( int x1, int y1, int x2, int y2 )
+{
+	std::vector<std::pair<int, int>> stamps;
+	int dx = std::abs( x2 - x1 ), sx = x2 < x1 ? -1 : 1;
+	int dy = -std::abs( y2 - y1 ), sy = y2 < y1 ? -1 : 1;
+	int err = dx + dy;
+	while( true )
+	{
+		stamps.push_back( { x1, y1 } );
+		if( x1 == x2 && y1 == y2 )
+			break;
+		int e2 = 2 * err;
+		if( e2 >= dy ) { err += dy; x1 += sx; }
+		if( e2 <= dx ) { err += dx; y1 += sy; }
+	}
+	return stamps;
+}
+
+// The pen positions around a circle, reflecting the midpoint algorithm's steps into every octant
+static std::vector<std::pair<int, int>> CircleStamps( int cx, int cy, int radius )
+{
+	std::vector<std::pair<int, int>> stamps;
+	int ox = 0, oy = radius, d = 3 - 2 * radius;
+	while( true )
+	{
+		const int reflections[8][2] = { { ox, oy }, { -ox, oy }, { ox, -oy }, { -ox, -oy }, { oy, ox }, { -oy, ox }, { oy, -ox }, { -oy, -ox } };
+		for( const int* r : reflections )
+			stamps.push_back( { cx + r[0], cy + r[1] } );
+		if( oy < ox )
+			break;
+		ox++;
+		if( d > 0 )
+		{
+			oy--;
+			d += 4 * ( ox - oy ) + 10;
+		}
+		else
+		{
+			d += 4 * ox + 6;
+		}
+	}
+	return stamps;
+}
+
+// Draws the expected stroke: the most opaque pen pixel at each position (later stamps winning ties), tinted and blended once
+static void DrawExpected( PlayBlitter& blitter, const std::vector<std::pair<int, int>>& stamps, Pixel colour )
+{
+	const int origin = PEN_SIZE / 2;
+	int left = INT_MAX, top = INT_MAX, right = INT_MIN, bottom = INT_MIN;
+	for( const std::pair<int, int>& s : stamps )
+	{
+		left = std::min( left, s.first - origin );
+		top = std::min( top, s.second - origin );
+		right = std::max( right, s.first - origin + PEN_SIZE );
+		bottom = std::max( bottom, s.second - origin + PEN_SIZE );
+	}
+
+	std::vector<Pixel> coverage( ( right - left ) * ( bottom - top ), Pixel( 0x00000000 ) );
+	for( const std::pair<int, int>& s : stamps )
+	{
+		for( int y = 0; y < PEN_SIZE; y++ )
+		{
+			for( int x = 0; x < PEN_SIZE; x++ )
+			{
+				Pixel pen = s_penPixels[y * PEN_SIZE + x];
+				Pixel& dest = coverage[( s.second - origin + y - top ) * ( right - left ) + ( s.first - origin + x - left )];
+				if( pen.a != 0x00 && pen.a >= dest.a )
+					dest = pen;
+			}
+		}
+	}
+
+	PixelData stroke;
+	stroke.width = right - left;
+	stroke.height = bottom - top;
+	stroke.pPixels = coverage.data();
+	blitter.BlitTinted( stroke, left, top, colour );
+}
+
+// A reference render target the size of the display, filled with the same colour the display is cleared to
+struct Reference
+{
+	std::vector<Pixel> pixels;
+	PixelData data;
+	PlayBlitter blitter;
+
+	Reference()
+	{
+		pixels.assign( TEST_DISPLAY_WIDTH * TEST_DISPLAY_HEIGHT, PIX_BLUE );
+		data.width = TEST_DISPLAY_WIDTH;
+		data.height = TEST_DISPLAY_HEIGHT;
+		data.pPixels = pixels.data();
+		blitter.SetRenderTarget( &data );
+	}
+};
+
+static bool SameAsDisplay( const Reference& reference )
+{
+	const PixelData* pDisplay = PlayGraphics::Instance().GetDrawingBuffer();
+	int wrong = 0;
+	for( int y = 0; y < pDisplay->height; y++ )
+	{
+		for( int x = 0; x < pDisplay->width; x++ )
+			wrong += pDisplay->Row( y )[x].bits != reference.data.Row( y )[x].bits;
+	}
+	return wrong == 0;
+}
+
+static void CheckLine( PixelRect clip, int x1, int y1, int x2, int y2, Pixel colour )
+{
+	PlayGraphics& graphics = PlayGraphics::Instance();
+	Reference reference;
+	reference.blitter.PushClipRect( clip );
+	DrawExpected( reference.blitter, LineStamps( x1, y1, x2, y2 ), colour );
+
+	graphics.ClearBuffer( PIX_BLUE );
+	graphics.PushClipRect( clip );
+	// The fractions are rounded down to the same whole pixels
+	graphics.DrawBrushLine( s_penId, { x1 + 0.7f, y1 + 0.2f }, { x2 + 0.5f, y2 + 0.9f }, colour );
+	graphics.PopClipRect();
+
+	bool bMatches = SameAsDisplay( reference );
+	PLAY_TEST_CHECK( bMatches );
+	if( !bMatches )
+		fprintf( stderr, "Brush line from %d,%d to %d,%d in clip %d,%d %dx%d\n", x1, y1, x2, y2, clip.x, clip.y, clip.width, clip.height );
+}
+
+static void CheckCircle( PixelRect clip, int cx, int cy, int radius, Pixel colour )
+{
+	PlayGraphics& graphics = PlayGraphics::Instance();
+	Reference reference;
+	reference.blitter.PushClipRect( clip );
+	DrawExpected( reference.blitter, CircleStamps( cx, cy, radius ), colour );
+
+	graphics.ClearBuffer( PIX_BLUE );
+	graphics.PushClipRect( clip );
+	graphics.DrawBrushCircle( s_penId, { cx + 0.3f, cy + 0.6f }, radius, colour );
+	graphics.PopClipRect();
+
+	bool bMatches = SameAsDisplay( reference );
+	PLAY_TEST_CHECK( bMatches );
+	if( !bMatches )
+		fprintf( stderr, "Brush circle at %d,%d radius %d in clip %d,%d %dx%d\n", cx, cy, radius, clip.x, clip.y, clip.width, clip.height );
+}
+
+void RunTest()
+{
+	PlayGraphics& graphics = PlayGraphics::Instance();
+	PixelData* pDisplay = graphics.GetDrawingBuffer();
+
+	// A soft edged pen in different colours, so ties between stamps show up
+	PixelData pen = PlayTest::MakeDiscs( PEN_SIZE, PEN_SIZE, 1, 17 );
+	s_penPixels.assign( pen.pPixels, pen.pPixels + PEN_SIZE * PEN_SIZE );
+	s_penId = graphics.AddSprite( "pen", pen, 1, 1 );
+	graphics.CentreSpriteOrigin( s_penId );
+
+	const Pixel colours[] = { PIX_WHITE, Pixel( 0x60, 0xFF, 0x80, 0x20 ) };
+	const PixelRect clips[] = { { 0, 0, TEST_DISPLAY_WIDTH, TEST_DISPLAY_HEIGHT }, { 50, 40, 120, 90 }, { 100, 0, 1, TEST_DISPLAY_HEIGHT } };
+	for( const PixelRect& clip : clips )
+	{
+		for( Pixel colour : colours )
+		{
+			// Horizontal, vertical, diagonal and shallow lines, and lines which cross each edge of the display
+			CheckLine( clip, 10, 20, 200, 20, colour );
+			CheckLine( clip, 150, 190, 150, 5, colour );
+			CheckLine( clip, 20, 20, 120, 120, colour );
+			CheckLine( clip, 300, 30, 10, 70, colour );
+			CheckLine( clip, -30, -20, 90, 60, colour );
+			CheckLine( clip, 280, 150, 360, 240, colour );
+			CheckLine( clip, 5, -40, 60, 250, colour );
+
+			CheckCircle( clip, 100, 80, 40, colour );
+			CheckCircle( clip, 3, 5, 20, colour );
+			CheckCircle( clip, 310, 190, 1, colour );
+		}
+	}
+
+	// A line which starts and ends at the same position draws nothing
+	graphics.ClearBuffer( PIX_BLUE );
+	uint64_t empty = PlayTest::Hash( *pDisplay );
+	graphics.DrawBrushLine( s_penId, { 50.2f, 60.0f }, { 50.9f, 60.5f } );
+	PLAY_TEST_CHECK( PlayTest::Hash( *pDisplay ) == empty );
+
+	// The stroke's colour isn't left on the pen
+	graphics.Draw( s_penId, { 100, 100 }, 0 );
+	uint64_t drawn = PlayTest::Hash( *pDisplay );
+	graphics.DrawBrushLine( s_penId, { 10, 10 }, { 60, 40 }, PIX_RED );
+	graphics.ClearBuffer( PIX_BLUE );
+	graphics.Draw( s_penId, { 100, 100 }, 0 );
+	PLAY_TEST_CHECK( PlayTest::Hash( *pDisplay ) == drawn );
+
+	// Moving the strokes and the camera by the same whole number of pixels draws the same pixels, even across the edges
+	graphics.ClearBuffer( PIX_BLUE );
+	graphics.DrawBrushLine( s_penId, { -10.5f, 30.0f }, { 90.0f, -6.0f }, colours[1] );
+	graphics.DrawBrushCircle( s_penId, { 2.0f, 190.0f }, 15, colours[1] );
+	uint64_t unmoved = PlayTest::Hash( *pDisplay );
+
+	graphics.SetCameraPosition( { -37.0f, -23.0f } );
+	graphics.ClearBuffer( PIX_BLUE );
+	graphics.DrawBrushLine( s_penId, { -47.5f, 7.0f }, { 53.0f, -29.0f }, colours[1] );
+	graphics.DrawBrushCircle( s_penId, { -35.0f, 167.0f }, 15, colours[1] );
+	graphics.SetCameraPosition( { 0.0f, 0.0f } );
+	PLAY_TEST_CHECK( PlayTest::Hash( *pDisplay ) == unmoved );
+}
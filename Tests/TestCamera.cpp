@@ -0,0 +1,192 @@
+// Scrolls backgrounds, sprites and shapes with the camera and checks them against drawing them moved by hand
+#include "PlayTest.h"
+
+static int s_discsId = -1;
+
+// Makes the pixels of a background, which can be larger or smaller than the display
+static std::vector<Pixel> MakeBackground( int width, int height, bool transparent )
+{
+	std::vector<Pixel> pixels( width * height );
+	for( int y = 0; y < height; y++ )
+	{
+		for( int x = 0; x < width; x++ )
+		{
+			int alpha = transparent ? ( ( ( x / 16 ) + ( y / 12 ) ) % 3 ) * 0x60 : 0xFF;
+			pixels[y * width + x] = Pixel( alpha, x & 0xFF, y & 0xFF, ( x * 3 + y * 5 ) & 0xFF );
+		}
+	}
+	return pixels;
+}
+
+static int LoadBackground( PlayGraphics& graphics, const char* name, std::vector<Pixel>& pixels, int width, int height )
+{
+	PixelData image;
+	image.width = width;
+	image.height = height;
+	image.pPixels = pixels.data();
+	return graphics.LoadBackground( PlayTest::WritePNG( name, image ).c_str() );
+}
+
+// The scroll of a background seen through the camera, rounded like the other positions
+static int Scroll( float camera, float factor )
+{
+	return static_cast<int>( std::floor( ( camera * factor ) + 0.5f ) );
+}
+
+// Checks the display shows an opaque background repeated from the scrolled position inside the clip, and nothing outside it
+static bool ShowsBackground( const std::vector<Pixel>& pixels, int width, int height, int scrollX, int scrollY, PixelRect clip )
+{
+	const PixelData* pDisplay = PlayGraphics::Instance().GetDrawingBuffer();
+	int wrong = 0;
+	for( int y = 0; y < pDisplay->height; y++ )
+	{
+		for( int x = 0; x < pDisplay->width; x++ )
+		{
+			bool inside = x >= clip.x && x < clip.x + clip.width && y >= clip.y && y < clip.y + clip.height;
+			int bx = ( ( x + scrollX ) % width + width ) % width;
+			int by = ( ( y + scrollY ) % height + height ) % height;
+			Pixel expected = inside ? pixels[by * width + bx] : PIX_MAGENTA;
+			wrong += pDisplay->Row( y )[x].bits != expected.bits;
+		}
+	}
+	return wrong == 0;
+}
+
+// Draws a scene of sprites and shapes, moved left and up by the given offset
+static void DrawScene( PlayGraphics& graphics, float offsetX, float offsetY )
+{
+	for( int i = 0; i < 30; i++ )
+		graphics.Draw( s_discsId, { ( i * 53 ) % 360 - 20.0f - offsetX, ( i * 31 ) % 240 - 20.0f - offsetY }, i % 3 );
+	graphics.DrawTransparent( s_discsId, { 60.0f - offsetX, 150.0f - offsetY }, 1, 0.5f );
+	graphics.DrawRotated( s_discsId, { 250.0f - offsetX, 40.0f - offsetY }, 2, 0.7f, 1.5f );
+	graphics.DrawRect( { 30.0f - offsetX, 40.0f - offsetY }, { 90.0f - offsetX, 70.0f - offsetY }, PIX_YELLOW, true );
+	graphics.DrawLine( { -10.0f - offsetX, 5.0f - offsetY }, { 330.0f - offsetX, 190.0f - offsetY }, PIX_WHITE );
+	graphics.DrawCircle( { 160.0f - offsetX, 100.0f - offsetY }, 70, PIX_CYAN );
+}
+
+void RunTest()
+{
+	PlayGraphics& graphics = PlayGraphics::Instance();
+	PixelData* pDisplay = graphics.GetDrawingBuffer();
+
+	PixelData discs = PlayTest::MakeDiscs( 32, 32, 3, 5 );
+	s_discsId = graphics.AddSprite( "discs_3", discs, 3, 1 );
+
+	// A background larger than the display (kept whole rather than cropped), and one smaller than it which repeats
+	std::vector<Pixel> large = MakeBackground( 500, 310, false );
+	std::vector<Pixel> small = MakeBackground( 70, 45, false );
+	int largeId = LoadBackground( graphics, "large.png", large, 500, 310 );
+	int smallId = LoadBackground( graphics, "small.png", small, 70, 45 );
+
+	const Point2f cameras[] = { { 0.0f, 0.0f }, { 130.4f, 77.6f }, { -45.5f, -1000.2f }, { 480.0f, 300.0f } };
+	const Vector2f factors[] = { { 0.0f, 0.0f }, { 1.0f, 1.0f }, { 0.5f, 0.25f }, { -1.5f, 2.0f } };
+	const PixelRect clips[] = { { 0, 0, TEST_DISPLAY_WIDTH, TEST_DISPLAY_HEIGHT }, { 0, 50, TEST_DISPLAY_WIDTH, 60 }, { 75, 30, 130, 110 } };
+
+	// Opaque backgrounds are copied in from the scrolled position, repeating past their edges
+	for( const PixelRect& clip : clips )
+	{
+		for( Point2f camera : cameras )
+		{
+			for( Vector2f factor : factors )
+			{
+				graphics.ClearBuffer( PIX_MAGENTA );
+				graphics.SetCameraPosition( camera );
+				graphics.PushClipRect( clip );
+				graphics.DrawBackground( largeId, factor );
+				graphics.PopClipRect();
+				graphics.SetCameraPosition( { 0.0f, 0.0f } );
+				bool bLarge = ShowsBackground( large, 500, 310, Scroll( camera.x, factor.x ), Scroll( camera.y, factor.y ), clip );
+
+				graphics.ClearBuffer( PIX_MAGENTA );
+				graphics.SetCameraPosition( camera );
+				graphics.PushClipRect( clip );
+				graphics.DrawBackground( smallId, factor );
+				graphics.PopClipRect();
+				graphics.SetCameraPosition( { 0.0f, 0.0f } );
+				bool bSmall = ShowsBackground( small, 70, 45, Scroll( camera.x, factor.x ), Scroll( camera.y, factor.y ), clip );
+
+				PLAY_TEST_CHECK( bLarge && bSmall );
+				if( !( bLarge && bSmall ) )
+					fprintf( stderr, "Camera at %.1f,%.1f with scroll factor %.2f,%.2f in clip %d,%d %dx%d\n", camera.x, camera.y, factor.x, factor.y, clip.x, clip.y, clip.width, clip.height );
+			}
+		}
+	}
+
+	// A transparent parallax layer blends the same as drawing each repeat of it as a sprite
+	std::vector<Pixel> layer = MakeBackground( 150, 90, true );
+	int layerId = LoadBackground( graphics, "layer.png", layer, 150, 90 );
+	PixelData layerCanvas;
+	layerCanvas.width = 150;
+	layerCanvas.height = 90;
+	layerCanvas.pPixels = new Pixel[150 * 90];
+	std::copy( layer.begin(), layer.end(), layerCanvas.pPixels );
+	int layerSpriteId = graphics.AddSprite( "layer", layerCanvas, 1, 1 );
+
+	for( Point2f camera : cameras )
+	{
+		int scrollX = Scroll( camera.x, 0.5f );
+		int scrollY = Scroll( camera.y, 0.5f );
+		graphics.ClearBuffer( PIX_MAGENTA );
+		graphics.DrawBackground( largeId );
+		for( int y = -( ( scrollY % 90 + 90 ) % 90 ); y < TEST_DISPLAY_HEIGHT; y += 90 )
+		{
+			for( int x = -( ( scrollX % 150 + 150 ) % 150 ); x < TEST_DISPLAY_WIDTH; x += 150 )
+				graphics.Draw( layerSpriteId, { static_cast<float>( x ), static_cast<float>( y ) }, 0 );
+		}
+		uint64_t expected = PlayTest::Hash( *pDisplay );
+
+		graphics.ClearBuffer( PIX_MAGENTA );
+		graphics.SetCameraPosition( camera );
+		graphics.DrawBackground( largeId );
+		graphics.DrawBackground( layerId, { 0.5f, 0.5f } );
+		graphics.SetCameraPosition( { 0.0f, 0.0f } );
+		PLAY_TEST_CHECK( PlayTest::Hash( *pDisplay ) == expected );
+	}
+
+	// Everything else scrolls with the camera rounded to whole pixels, while the clip rectangle stays where it is
+	for( const PixelRect& clip : clips )
+	{
+		for( Point2f camera : cameras )
+		{
+			float cameraX = static_cast<float>( Scroll( camera.x, 1.0f ) );
+			float cameraY = static_cast<float>( Scroll( camera.y, 1.0f ) );
+			graphics.ClearBuffer( PIX_MAGENTA );
+			graphics.PushClipRect( clip );
+			DrawScene( graphics, cameraX, cameraY );
+			graphics.PopClipRect();
+			uint64_t expected = PlayTest::Hash( *pDisplay );
+
+			graphics.ClearBuffer( PIX_MAGENTA );
+			graphics.PushClipRect( clip );
+			graphics.SetCameraPosition( camera );
+			PLAY_TEST_CHECK( graphics.GetCameraPosition().x == camera.x && graphics.GetCameraPosition().y == camera.y );
+			DrawScene( graphics, 0.0f, 0.0f );
+			graphics.SetCameraPosition( { 0.0f, 0.0f } );
+			graphics.PopClipRect();
+			PLAY_TEST_CHECK( PlayTest::Hash( *pDisplay ) == expected );
+
+			// Deferred draws use the camera they were recorded with, even when it moves before they are drawn
+			graphics.ClearBuffer( PIX_MAGENTA );
+			graphics.PushClipRect( clip );
+			graphics.BeginDeferredDraw();
+			graphics.SetCameraPosition( camera );
+			graphics.DrawBackground( smallId, { 1.0f, 1.0f } );
+			DrawScene( graphics, 0.0f, 0.0f );
+			graphics.SetCameraPosition( { 0.0f, 0.0f } );
+			graphics.Draw( s_discsId, { 150.0f, 90.0f }, 0 );
+			graphics.EndDeferredDraw();
+			graphics.PopClipRect();
+			uint64_t deferred = PlayTest::Hash( *pDisplay );
+
+			graphics.ClearBuffer( PIX_MAGENTA );
+			graphics.PushClipRect( clip );
+			graphics.SetCameraPosition( camera );
+			graphics.DrawBackground( smallId, { 1.0f, 1.0f } );
+			DrawScene( graphics, 0.0f, 0.0f );
+			graphics.SetCameraPosition( { 0.0f, 0.0f } );
+			graphics.Draw( s_discsId, { 150.0f, 90.0f }, 0 );
+			graphics.PopClipRect();
+			PLAY_TEST_CHECK( PlayTest::Hash( *pDisplay ) == deferred );
+		}
+	}
+}
@@ -0,0 +1,119 @@
+// Captures render targets into sprites, and checks that recapturing re-uses the sprite
+#include "PlayTest.h"
+
+// Checks that a sprite's canvas holds the same pixels as a render target
+static bool SameAsCanvas( PlayGraphics& graphics, int spriteId, const PixelData& target )
+{
+	PixelData canvas;
+	canvas.width = target.width;
+	canvas.height = target.height;
+	std::vector<Pixel> pixels( static_cast<size_t>( target.width ) * target.height );
+	canvas.pPixels = pixels.data();
+	graphics.CopySpriteFrame( spriteId, 0, canvas, 0, 0 );
+
+	for( int y = 0; y < target.height; y++ )
+	{
+		for( int x = 0; x < target.width; x++ )
+		{
+			if( canvas.Row( y )[x].bits != target.Row( y )[x].bits )
+				return false;
+		}
+	}
+	return true;
+}
+
+// Draws a sprite over a blue display, returning a hash of the result
+static uint64_t DrawnHash( PlayGraphics& graphics, int spriteId )
+{
+	graphics.ClearBuffer( PIX_BLUE );
+	graphics.Draw( spriteId, { 100, 50 }, 0 );
+	return PlayTest::Hash( *graphics.GetDrawingBuffer() );
+}
+
+// Adds a copy of a render target as an ordinary sprite, to compare the capture against
+static int AddCopy( PlayGraphics& graphics, const PixelData& target, const char* name )
+{
+	PixelData canvas;
+	canvas.width = target.width;
+	canvas.height = target.height;
+	canvas.pPixels = new Pixel[target.width * target.height];
+	for( int y = 0; y < target.height; y++ )
+		memcpy( canvas.pPixels + y * target.width, target.Row( y ), sizeof( Pixel ) * target.width );
+	return graphics.AddSprite( name, canvas, 1, 1 );
+}
+
+void RunTest()
+{
+	PlayGraphics& graphics = PlayGraphics::Instance();
+	PixelData* pDisplay = graphics.GetDrawingBuffer();
+
+	PixelData discs = PlayTest::MakeDiscs( 24, 20, 3, 7 );
+	int discId = graphics.AddSprite( "discs_3", discs, 3, 1 );
+
+	// Draw into a render target with a transparent background
+	std::vector<Pixel> targetPixels( 64 * 48 );
+	PixelData target;
+	target.width = 64;
+	target.height = 48;
+	target.pPixels = targetPixels.data();
+
+	PixelData* pOldTarget = graphics.SetRenderTarget( &target );
+	graphics.ClearBuffer( PIX_TRANS );
+	graphics.DrawRect( { 2, 2 }, { 30, 20 }, PIX_RED, true );
+	graphics.Draw( discId, { 20, 10 }, 1 );
+	graphics.SetRenderTarget( pOldTarget );
+
+	int spritesBefore = graphics.GetTotalLoadedSprites();
+	int captureId = graphics.CaptureToSprite( &target, "panel" );
+	PLAY_TEST_CHECK( captureId == spritesBefore );
+	PLAY_TEST_CHECK( graphics.GetSpriteSize( captureId ).x == 64 && graphics.GetSpriteSize( captureId ).y == 48 );
+	PLAY_TEST_CHECK( SameAsCanvas( graphics, captureId, target ) );
+
+	// Drawing the capture leaves the display untouched where the render target was transparent, and blends the rest like any sprite
+	uint64_t drawn = DrawnHash( graphics, captureId );
+	PLAY_TEST_CHECK( pDisplay->Row( 50 + 40 )[100 + 60].bits == PIX_BLUE.bits );
+	PLAY_TEST_CHECK( pDisplay->Row( 50 + 5 )[100 + 5].bits != PIX_BLUE.bits );
+	PLAY_TEST_CHECK( drawn == DrawnHash( graphics, AddCopy( graphics, target, "panel_copy" ) ) );
+
+	// Recapturing with the same name and size updates the sprite in place
+	int sprites = graphics.GetTotalLoadedSprites();
+	pOldTarget = graphics.SetRenderTarget( &target );
+	graphics.ClearBuffer( PIX_GREEN );
+	graphics.SetRenderTarget( pOldTarget );
+	PLAY_TEST_CHECK( graphics.CaptureToSprite( &target, "PANEL" ) == captureId );
+	PLAY_TEST_CHECK( graphics.GetTotalLoadedSprites() == sprites );
+	PLAY_TEST_CHECK( SameAsCanvas( graphics, captureId, target ) );
+	PLAY_TEST_CHECK( DrawnHash( graphics, captureId ) == DrawnHash( graphics, AddCopy( graphics, target, "green_copy" ) ) );
+	PLAY_TEST_CHECK( pDisplay->Row( 50 + 40 )[100 + 60].bits != PIX_BLUE.bits );
+
+	// A different size replaces the sprite's buffers but keeps its id
+	PixelData smaller = target.View( { 8, 4, 32, 16 } );
+	smaller.Row( 0 )[0] = PIX_YELLOW;
+	PLAY_TEST_CHECK( graphics.CaptureToSprite( &smaller, "panel" ) == captureId );
+	PLAY_TEST_CHECK( graphics.GetSpriteSize( captureId ).x == 32 && graphics.GetSpriteSize( captureId ).y == 16 );
+	PLAY_TEST_CHECK( SameAsCanvas( graphics, captureId, smaller ) );
+
+	// Names are matched exactly, so a shorter name is a new sprite
+	int shortId = graphics.CaptureToSprite( &target, "pan" );
+	PLAY_TEST_CHECK( shortId != captureId );
+	PLAY_TEST_CHECK( graphics.GetSpriteSize( captureId ).x == 32 );
+
+	// Memory saving leaves the canvases of captured sprites for the next capture to re-use, and a sprite whose canvas it
+	// has freed gets one back when it is captured over
+	int greenCopyId = graphics.GetSpriteId( "green_copy" );
+	graphics.SetSpriteMemorySaving( true );
+	PLAY_TEST_CHECK( graphics.GetSpriteMemoryInfo( captureId ).canvasBytes > 0 && graphics.GetSpriteMemoryInfo( greenCopyId ).canvasBytes == 0 );
+	pOldTarget = graphics.SetRenderTarget( &target );
+	graphics.DrawRect( { 10, 10 }, { 50, 40 }, PIX_MAGENTA, true );
+	graphics.SetRenderTarget( pOldTarget );
+	uint64_t magenta = DrawnHash( graphics, AddCopy( graphics, target, "magenta_copy" ) );
+	for( const char* name : { "panel", "green_copy", "saving" } )
+	{
+		int spriteId = graphics.CaptureToSprite( &target, name );
+		PLAY_TEST_CHECK( SameAsCanvas( graphics, spriteId, target ) && DrawnHash( graphics, spriteId ) == magenta );
+	}
+	graphics.SetSpriteMemorySaving( true );
+	for( const char* name : { "panel", "green_copy", "saving" } )
+		PLAY_TEST_CHECK( graphics.GetSpriteMemoryInfo( graphics.GetSpriteId( name ) ).canvasBytes > 0 );
+	graphics.SetSpriteMemorySaving( false );
+}
@@ -0,0 +1,145 @@
+// Draws with stacks of clipping rectangles and checks drawing is the same as without them, but only inside the clip
+#include "PlayTest.h"
+
+static int s_spriteId = -1;
+
+static void DrawSprites( PlayGraphics& graphics )
+{
+	graphics.Draw( s_spriteId, { 40, 30 }, 0 );
+	graphics.Draw( s_spriteId, { 140, 115 }, 1 );
+	graphics.DrawTransparent( s_spriteId, { -10, 185 }, 2, 0.6f );
+	graphics.DrawRotated( s_spriteId, { 95, 45 }, 1, 0.4f, 2.5f );
+	graphics.DrawRotated( s_spriteId, { 230.3f, 60.7f }, 2, -1.1f, 3.0f, 0.8f );
+}
+
+static void DrawShapes( PlayGraphics& graphics )
+{
+	graphics.DrawLine( { -30, 5 }, { 350, 190 }, PIX_WHITE );
+	graphics.DrawLine( { 100, -40 }, { 60, 240 }, PIX_YELLOW );
+	graphics.DrawRect( { 20, 60 }, { 180, 140 }, PIX_GREEN, true );
+	graphics.DrawRect( { 70, 20 }, { 260, 170 }, PIX_RED );
+	graphics.DrawCircle( { 110, 90 }, 70, PIX_MAGENTA );
+	graphics.DrawCircle( { 250, 40 }, 45, Pixel( 0x80, 0xFF, 0x80, 0x00 ), true );
+}
+
+static void DrawPointsAndText( PlayGraphics& graphics )
+{
+	std::vector<Point2f> points;
+	std::vector<Pixel> colours;
+	for( int i = 0; i < 400; i++ )
+	{
+		points.push_back( { ( i * 37 ) % 360 - 20.0f, ( i * 53 ) % 240 - 20.0f } );
+		colours.push_back( Pixel( 0xFF, i & 0xFF, 0x80, 0xFF - ( i & 0xFF ) ) );
+	}
+	graphics.DrawPoints( points, colours );
+	graphics.DrawPolyline( { { 10, 10 }, { 300, 50 }, { 40, 190 }, { 330, 180 } }, PIX_CYAN, true );
+	graphics.DrawDebugString( { 100, 95 }, "Clipped debug text", PIX_WHITE, true, PIX_BLACK );
+}
+
+static void Clear( PlayGraphics& graphics )
+{
+	graphics.ClearBuffer( PIX_RED );
+}
+
+typedef void ( *DrawFunction )( PlayGraphics& graphics );
+
+// The overlap of two rectangles (or an empty rectangle)
+static PixelRect Overlap( PixelRect a, PixelRect b )
+{
+	int left = std::max( a.x, b.x );
+	int top = std::max( a.y, b.y );
+	int right = std::min( a.x + a.width, b.x + b.width );
+	int bottom = std::min( a.y + a.height, b.y + b.height );
+	return { left, top, std::max( right - left, 0 ), std::max( bottom - top, 0 ) };
+}
+
+static bool SameRect( PixelRect a, PixelRect b )
+{
+	if( a.width == 0 || a.height == 0 )
+		return b.width == 0 || b.height == 0;
+	return a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height;
+}
+
+// Draws without and then with the clipping rectangles pushed, and compares the two
+static void CheckClipped( PlayGraphics& graphics, DrawFunction draw, const std::vector<PixelRect>& clips )
+{
+	PixelData* pDisplay = graphics.GetDrawingBuffer();
+
+	graphics.ClearBuffer( PIX_BLUE );
+	draw( graphics );
+	std::vector<Pixel> unclipped( pDisplay->pPixels, pDisplay->pPixels + pDisplay->width * pDisplay->height );
+
+	PixelRect expected = { 0, 0, pDisplay->width, pDisplay->height };
+	graphics.ClearBuffer( PIX_BLUE );
+	for( const PixelRect& clip : clips )
+	{
+		graphics.PushClipRect( clip );
+		expected = Overlap( expected, clip );
+	}
+	PLAY_TEST_CHECK( SameRect( graphics.GetClipRect(), expected ) );
+
+	draw( graphics );
+
+	for( size_t i = 0; i < clips.size(); i++ )
+		graphics.PopClipRect();
+	PLAY_TEST_CHECK( SameRect( graphics.GetClipRect(), { 0, 0, pDisplay->width, pDisplay->height } ) );
+
+	int wrongInside = 0, wrongOutside = 0;
+	for( int y = 0; y < pDisplay->height; y++ )
+	{
+		for( int x = 0; x < pDisplay->width; x++ )
+		{
+			Pixel pix = pDisplay->Row( y )[x];
+			if( x >= expected.x && x < expected.x + expected.width && y >= expected.y && y < expected.y + expected.height )
+				wrongInside += pix.bits != unclipped[y * pDisplay->width + x].bits;
+			else
+				wrongOutside += pix.bits != PIX_BLUE.bits;
+		}
+	}
+	PLAY_TEST_CHECK( wrongInside == 0 );
+	PLAY_TEST_CHECK( wrongOutside == 0 );
+}
+
+void RunTest()
+{
+	PlayGraphics& graphics = PlayGraphics::Instance();
+
+	PixelData discs = PlayTest::MakeDiscs( 30, 26, 3, 5 );
+	s_spriteId = graphics.AddSprite( "discs_3", discs, 3, 1 );
+	graphics.CentreSpriteOrigin( s_spriteId );
+
+	const DrawFunction draws[] = { DrawSprites, DrawShapes, DrawPointsAndText, Clear };
+	const std::vector<PixelRect> clipStacks[] =
+	{
+		{ { 50, 40, 100, 80 } },
+		{ { -20, -10, 60, 50 } }, // Partly off the top left of the display
+		{ { 300, 150, 100, 100 } }, // Partly off the bottom right
+		{ { 37, 11, 1, 150 } }, // A single column
+		{ { 10, 10, 0, 5 } }, // Nothing can be drawn
+		{ { 40, 30, 200, 100 }, { 100, 0, 300, 90 } }, // Nested rectangles only draw where they overlap
+		{ { 40, 30, 50, 50 }, { 200, 100, 50, 50 } }, // Nested rectangles which don't overlap at all
+	};
+
+	for( DrawFunction draw : draws )
+	{
+		for( const std::vector<PixelRect>& clips : clipStacks )
+			CheckClipped( graphics, draw, clips );
+	}
+
+	// The clipping rectangle is restricted to each render target it's used with
+	std::vector<Pixel> targetPixels( 64 * 48 );
+	PixelData target;
+	target.width = 64;
+	target.height = 48;
+	target.pPixels = targetPixels.data();
+
+	graphics.PushClipRect( { 20, 30, 100, 100 } );
+	PixelData* pOldTarget = graphics.SetRenderTarget( &target );
+	PLAY_TEST_CHECK( SameRect( graphics.GetClipRect(), { 20, 30, 44, 18 } ) );
+	graphics.ClearBuffer( PIX_RED );
+	PLAY_TEST_CHECK( target.Row( 29 )[25].bits == PIX_BLACK.bits && target.Row( 30 )[19].bits == PIX_BLACK.bits );
+	PLAY_TEST_CHECK( target.Row( 30 )[20].bits == PIX_RED.bits && target.Row( 47 )[63].bits == PIX_RED.bits );
+	graphics.SetRenderTarget( pOldTarget );
+	PLAY_TEST_CHECK( SameRect( graphics.GetClipRect(), { 20, 30, 100, 100 } ) );
+	graphics.PopClipRect();
+}
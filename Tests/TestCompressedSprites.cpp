@@ -0,0 +1,131 @@
+// Compresses sprites into runs of pixels and checks they draw exactly as they did before, and how their frames are cached
+#include "PlayTest.h"
+
+static const int FRAMES = 20;
+
+// Makes frames whose rows start, end and are filled with runs of every length, including rows with no runs at all
+// > Frames 1 and 3 are the same as frame 0, so they can share its runs
+static PixelData MakeRuns( int frameWidth, int frameHeight, int frames )
+{
+	PixelData canvas;
+	canvas.width = frameWidth * frames;
+	canvas.height = frameHeight;
+	canvas.pPixels = new Pixel[canvas.width * canvas.height];
+
+	for( int f = 0; f < frames; f++ )
+	{
+		int pattern = ( f == 1 || f == 3 ) ? 0 : f;
+		for( int y = 0; y < frameHeight; y++ )
+		{
+			for( int x = 0; x < frameWidth; x++ )
+			{
+				bool visible = y != 0 && ( y == 1 || ( ( x / ( 1 + ( y % 5 ) ) ) + pattern ) % 3 != 0 );
+				int alpha = visible ? ( ( x + y ) % 4 == 0 ? 0x40 : 0xFF ) : 0x00;
+				canvas.pPixels[y * canvas.width + f * frameWidth + x] = Pixel( alpha, x * 9, y * 7, ( pattern * 40 ) & 0xFF );
+			}
+		}
+	}
+	return canvas;
+}
+
+// Draws every frame in a scene across the display's edges, the clipping rectangle, and with every kind of draw
+static void DrawScene( PlayGraphics& graphics, int spriteId, int frames )
+{
+	graphics.ClearBuffer( PIX_MAGENTA );
+	graphics.PushClipRect( { 12, 7, 280, 180 } );
+	for( int f = 0; f < frames; f++ )
+	{
+		graphics.Draw( spriteId, { ( f * 47 ) % 340 - 20.0f, ( f * 29 ) % 220 - 15.0f }, f );
+		graphics.DrawTransparent( spriteId, { ( f * 31 ) % 300 + 0.0f, ( f * 43 ) % 190 + 0.0f }, f, 0.6f );
+	}
+	graphics.DrawRotated( spriteId, { 160.0f, 100.0f }, 2, 0.5f, 2.0f );
+	graphics.PopClipRect();
+	graphics.Draw( spriteId, { -10.0f, -10.0f }, 4 );
+}
+
+// Draws a scene with each sprite and compares them
+static bool DrawsTheSame( PlayGraphics& graphics, int spriteA, int spriteB, int frames )
+{
+	PixelData* pDisplay = graphics.GetDrawingBuffer();
+	DrawScene( graphics, spriteA, frames );
+	uint64_t expected = PlayTest::Hash( *pDisplay );
+	DrawScene( graphics, spriteB, frames );
+	return PlayTest::Hash( *pDisplay ) == expected;
+}
+
+// Draws a frame of a compressed sprite and returns the number of frames the sprite has had to decode in total
+static int DrawFrame( PlayGraphics& graphics, int spriteId, int frameIndex )
+{
+	graphics.Draw( spriteId, { 100.0f, 80.0f }, frameIndex );
+	return graphics.GetSpriteMemoryInfo( spriteId ).frameDecodes;
+}
+
+void RunTest()
+{
+	PlayGraphics& graphics = PlayGraphics::Instance();
+
+	PixelData discs = PlayTest::MakeDiscs( 30, 26, FRAMES, 3 );
+	PixelData discsCopy = PlayTest::MakeDiscs( 30, 26, FRAMES, 3 );
+	PixelData runs = MakeRuns( 37, 21, 6 );
+	PixelData runsCopy = MakeRuns( 37, 21, 6 );
+	int discsId = graphics.AddSprite( "discs", discsCopy, FRAMES, 1 );
+	int compressedId = graphics.AddSprite( "compressed discs", discs, FRAMES, 1 );
+	int runsId = graphics.AddSprite( "runs", runsCopy, 6, 1 );
+	int compressedRunsId = graphics.AddSprite( "compressed runs", runs, 6, 1 );
+
+	// Compressed frames are decoded into exactly the pixels they were made from
+	graphics.CompressSprite( compressedId );
+	graphics.CompressSprite( compressedRunsId );
+	SpriteMemoryInfo info = graphics.GetSpriteMemoryInfo( compressedId );
+	PLAY_TEST_CHECK( info.compressed && info.drawBytes < info.uncompressedBytes && info.frameDecodes == 0 );
+	PLAY_TEST_CHECK( DrawsTheSame( graphics, discsId, compressedId, FRAMES ) );
+	PLAY_TEST_CHECK( DrawsTheSame( graphics, runsId, compressedRunsId, 6 ) );
+
+	// Frames which encode the same share their runs
+	info = graphics.GetSpriteMemoryInfo( compressedRunsId );
+	PLAY_TEST_CHECK( info.compressed && info.sharedFrames == 2 && info.sharedBytes > 0 );
+
+	// Colouring a compressed sprite re-encodes it, so frames decoded before then aren't drawn again
+	graphics.ColourSprite( discsId, 0x80, 0xFF, 0x40 );
+	graphics.ColourSprite( compressedId, 0x80, 0xFF, 0x40 );
+	PLAY_TEST_CHECK( DrawsTheSame( graphics, discsId, compressedId, FRAMES ) );
+	graphics.ColourSprite( discsId, 0xFF, 0xFF, 0xFF );
+	graphics.ColourSprite( compressedId, 0xFF, 0xFF, 0xFF );
+
+	// Decompressing makes 32-bit drawing data again, whose frames are all the same as the sprite which was never compressed
+	graphics.CompressSprite( compressedRunsId, false );
+	info = graphics.GetSpriteMemoryInfo( compressedRunsId );
+	PLAY_TEST_CHECK( !info.compressed && info.sharedFrames == 6 );
+	PLAY_TEST_CHECK( DrawsTheSame( graphics, runsId, compressedRunsId, 6 ) );
+
+	// Frames are decoded into a cache of 16, so drawing them again doesn't decode them again
+	graphics.CompressSprite( compressedId, false );
+	graphics.CompressSprite( compressedId );
+	int decodes = 0;
+	for( int f = 0; f < 16; f++ )
+		decodes = DrawFrame( graphics, compressedId, f );
+	PLAY_TEST_CHECK( decodes == 16 );
+	for( int f = 15; f >= 0; f-- )
+		decodes = DrawFrame( graphics, compressedId, f );
+	PLAY_TEST_CHECK( decodes == 16 );
+
+	// A new frame replaces the least recently drawn one (frame 15, as they were last drawn backwards)
+	PLAY_TEST_CHECK( DrawFrame( graphics, compressedId, 16 ) == 17 );
+	for( int f = 0; f < 15; f++ )
+		decodes = DrawFrame( graphics, compressedId, f );
+	PLAY_TEST_CHECK( decodes == 17 );
+	PLAY_TEST_CHECK( DrawFrame( graphics, compressedId, 15 ) == 18 );
+	PLAY_TEST_CHECK( DrawFrame( graphics, compressedId, 16 ) == 19 );
+
+	// Drawing more frames in turn than the cache holds decodes every one of them
+	for( int f = 0; f < 17; f++ )
+		decodes = DrawFrame( graphics, compressedId, f );
+	PLAY_TEST_CHECK( decodes == 19 + 17 );
+	PLAY_TEST_CHECK( graphics.GetSpriteMemoryInfo( compressedId ).decodeMillisecs > 0.0f );
+
+	// Decoded frames are kept per sprite, so another sprite's frames never stand in for them
+	graphics.CompressSprite( compressedRunsId );
+	DrawFrame( graphics, compressedRunsId, 0 );
+	PLAY_TEST_CHECK( DrawsTheSame( graphics, discsId, compressedId, FRAMES ) );
+	PLAY_TEST_CHECK( DrawsTheSame( graphics, runsId, compressedRunsId, 6 ) );
+}
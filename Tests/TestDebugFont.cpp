@@ -0,0 +1,174 @@
+// Draws debug text with and without an outline and checks every pixel against the embedded font bitmap
+#include "PlayTest.h"
+#include <set>
+
+// Translucent colours, so that any pixel blended twice shows up
+static const Pixel TEXT_COLOUR( 0x90, 0xFF, 0xE0, 0x40 );
+static const Pixel OUTLINE_COLOUR( 0x70, 0x20, 0x40, 0xFF );
+
+// The colours a black pixel becomes when the text and outline colours are blended into it once
+static Pixel s_textOnce;
+static Pixel s_outlineOnce;
+
+typedef std::set<std::pair<int, int>> PointSet;
+
+// Whether a pixel of a character is set in the 1bpp font image (which uses a clear bit for a pixel)
+static bool GlyphPixel( int index, int x, int y )
+{
+	int dataIndex = ( ( ( index / 16 ) * FONT_CHAR_HEIGHT + y ) * FONT_IMAGE_WIDTH ) + ( ( index % 16 ) * FONT_CHAR_WIDTH ) + x;
+	return ( ( debugFontData[dataIndex / 32] >> ( 31 - ( dataIndex % 32 ) ) ) & 0x01 ) == 0;
+}
+
+// The font image index of a character, including the characters which are drawn with similar looking ones
+static int GlyphIndex( char c )
+{
+	c = static_cast<char>( toupper( c ) );
+	if( c == ',' || c == '.' ) c = '^';
+	if( c == '-' ) c = ';';
+	if( c == '(' ) c = '[';
+	if( c == ')' ) c = ']';
+	return ( c < '0' || c > '_' ) ? -1 : c - '0';
+}
+
+// The pixels of a string whose first character's top left is at x, y
+static PointSet TextPoints( int x, int y, const std::string& text )
+{
+	PointSet points;
+	for( size_t i = 0; i < text.size(); i++ )
+	{
+		int index = GlyphIndex( text[i] );
+		for( int gy = 0; gy < FONT_CHAR_HEIGHT && index >= 0; gy++ )
+		{
+			for( int gx = 0; gx < FONT_CHAR_WIDTH; gx++ )
+			{
+				if( GlyphPixel( index, gx, gy ) )
+					points.insert( { x + static_cast<int>( i ) * ( FONT_CHAR_WIDTH + 1 ) + gx, y + gy } );
+			}
+		}
+	}
+	return points;
+}
+
+// The pixels diagonally next to the text which aren't part of it
+static PointSet OutlinePoints( const PointSet& text )
+{
+	PointSet points;
+	const int diagonals[4][2] = { { -1, -1 }, { 1, -1 }, { -1, 1 }, { 1, 1 } };
+	for( const std::pair<int, int>& p : text )
+	{
+		for( const int* d : diagonals )
+		{
+			if( !text.count( { p.first + d[0], p.second + d[1] } ) )
+				points.insert( { p.first + d[0], p.second + d[1] } );
+		}
+	}
+	return points;
+}
+
+// Checks the display has each colour blended once into exactly its expected pixels inside the clip, and nothing else
+static bool Matches( const PointSet& text, const PointSet& outline, PixelRect clip )
+{
+	const PixelData* pDisplay = PlayGraphics::Instance().GetDrawingBuffer();
+	int wrong = 0;
+	for( int y = 0; y < pDisplay->height; y++ )
+	{
+		for( int x = 0; x < pDisplay->width; x++ )
+		{
+			bool inside = x >= clip.x && x < clip.x + clip.width && y >= clip.y && y < clip.y + clip.height;
+			Pixel expected = PIX_BLACK;
+			if( inside && text.count( { x, y } ) )
+				expected = s_textOnce;
+			else if( inside && outline.count( { x, y } ) )
+				expected = s_outlineOnce;
+			wrong += pDisplay->Row( y )[x].bits != expected.bits;
+		}
+	}
+	return wrong == 0;
+}
+
+// Draws a string with and without an outline and compares it with the font image
+// > The text is centred vertically on the position, and the half height (6) is rounded with the position like the other shapes
+static void CheckString( Point2f pos, const std::string& text, bool centred, PixelRect clip )
+{
+	PlayGraphics& graphics = PlayGraphics::Instance();
+	int width = static_cast<int>( text.size() ) * ( FONT_CHAR_WIDTH + 1 );
+	float left = centred ? pos.x - ( width / 2 ) : pos.x;
+	PointSet points = TextPoints( static_cast<int>( std::floor( left + 0.5f ) ), static_cast<int>( std::floor( pos.y - 6.0f + 0.5f ) ), text );
+
+	for( int outline = 0; outline < 2; outline++ )
+	{
+		graphics.ClearBuffer( PIX_BLACK );
+		graphics.PushClipRect( clip );
+		int end = graphics.DrawDebugString( pos, text, TEXT_COLOUR, centred, outline ? OUTLINE_COLOUR : Pixel( 0x00000000 ) );
+		graphics.PopClipRect();
+		PLAY_TEST_CHECK( end == static_cast<int>( left + width ) );
+
+		bool bMatches = Matches( points, outline ? OutlinePoints( points ) : PointSet(), clip );
+		PLAY_TEST_CHECK( bMatches );
+		if( !bMatches )
+			fprintf( stderr, "\"%s\" at %.1f,%.1f%s%s in clip %d,%d %dx%d\n", text.c_str(), pos.x, pos.y, centred ? " centred" : "", outline ? " outlined" : "", clip.x, clip.y, clip.width, clip.height );
+	}
+}
+
+void RunTest()
+{
+	PlayGraphics& graphics = PlayGraphics::Instance();
+	PixelData* pDisplay = graphics.GetDrawingBuffer();
+
+	graphics.ClearBuffer( PIX_BLACK );
+	graphics.DrawPixel( { 0, 0 }, TEXT_COLOUR );
+	graphics.DrawPixel( { 1, 0 }, OUTLINE_COLOUR );
+	s_textOnce = pDisplay->Row( 0 )[0];
+	s_outlineOnce = pDisplay->Row( 0 )[1];
+
+	// Each character matches the font image
+	for( char c = '0'; c <= '_'; c++ )
+	{
+		graphics.ClearBuffer( PIX_BLACK );
+		PLAY_TEST_CHECK( graphics.DrawDebugCharacter( { 20.4f, 30.6f }, c, TEXT_COLOUR ) == FONT_CHAR_WIDTH );
+		PLAY_TEST_CHECK( Matches( TextPoints( 20, 31, std::string( 1, c ) ), {}, { 0, 0, TEST_DISPLAY_WIDTH, TEST_DISPLAY_HEIGHT } ) );
+	}
+
+	// Long strings need more than one 64 bit word for each row, and the characters are spaced so they cross between them
+	std::string alphabet;
+	for( char c = '0'; c <= '_'; c++ )
+		alphabet += c;
+	const std::string strings[] = { "SCORE: 12345", "lower case (and) punctuation, mapped - to others.", alphabet, "" };
+
+	const PixelRect clips[] = { { 0, 0, TEST_DISPLAY_WIDTH, TEST_DISPLAY_HEIGHT }, { 40, 20, 150, 30 }, { 0, 96, TEST_DISPLAY_WIDTH, 1 } };
+	for( const PixelRect& clip : clips )
+	{
+		for( const std::string& text : strings )
+		{
+			CheckString( { 10.0f, 30.0f }, text, false, clip );
+			CheckString( { 160.5f, 100.5f }, text, true, clip );
+			CheckString( { -40.3f, 2.4f }, text, false, clip ); // Off the top left of the display
+			CheckString( { 250.7f, 197.5f }, text, false, clip ); // Off the bottom right
+		}
+	}
+
+	// With opaque colours the outline looks the same as the text drawn at each diagonal with the text on top
+	graphics.ClearBuffer( PIX_BLACK );
+	const int diagonals[4][2] = { { -1, -1 }, { 1, -1 }, { -1, 1 }, { 1, 1 } };
+	for( const int* d : diagonals )
+		graphics.DrawDebugString( { 100.0f + d[0], 60.0f + d[1] }, alphabet, PIX_BLUE );
+	graphics.DrawDebugString( { 100.0f, 60.0f }, alphabet, PIX_WHITE );
+	uint64_t expected = PlayTest::Hash( *pDisplay );
+
+	graphics.ClearBuffer( PIX_BLACK );
+	graphics.DrawDebugString( { 100.0f, 60.0f }, alphabet, PIX_WHITE, true, PIX_BLUE );
+	PLAY_TEST_CHECK( PlayTest::Hash( *pDisplay ) == expected );
+
+	// Moving the text and the camera by the same whole number of pixels draws the same pixels, even across the edges
+	graphics.ClearBuffer( PIX_BLACK );
+	graphics.DrawDebugString( { -10.5f, 3.0f }, strings[1], TEXT_COLOUR, false, OUTLINE_COLOUR );
+	graphics.DrawDebugCharacter( { -2.5f, 190.0f }, 'X', TEXT_COLOUR );
+	uint64_t unmoved = PlayTest::Hash( *pDisplay );
+
+	graphics.SetCameraPosition( { -37.0f, -23.0f } );
+	graphics.ClearBuffer( PIX_BLACK );
+	graphics.DrawDebugString( { -47.5f, -20.0f }, strings[1], TEXT_COLOUR, false, OUTLINE_COLOUR );
+	graphics.DrawDebugCharacter( { -39.5f, 167.0f }, 'X', TEXT_COLOUR );
+	graphics.SetCameraPosition( { 0.0f, 0.0f } );
+	PLAY_TEST_CHECK( PlayTest::Hash( *pDisplay ) == unmoved );
+}
@@ -0,0 +1,120 @@
+// Adds shapes and labels to the debug overlay and checks it draws the same as drawing them straight away
+#include "PlayTest.h"
+
+// Translucent colours, so that any pixel blended twice shows up
+static const Pixel LINE_COLOUR( 0x80, 0xFF, 0x40, 0x40 );
+static const Pixel RECT_COLOUR( 0x90, 0x40, 0xFF, 0x40 );
+static const Pixel CIRCLE_COLOUR( 0x70, 0x40, 0x40, 0xFF );
+static const Pixel LABEL_COLOUR( 0xA0, 0xFF, 0xFF, 0x00 );
+
+struct DebugLine { Point2f start, end; int category; };
+struct DebugCircle { Point2f centre; int radius; int category; };
+struct DebugLabel { Point2f pos; const char* text; int category; };
+
+// Lines and rectangles (drawn in the order they were added), then circles and then labels, partly off every edge
+static const DebugLine s_lines[] = { { { -20.6f, 10.2f }, { 340.0f, 150.7f }, PlayGraphics::DEBUG_USER }, { { 100.0f, -30.0f }, { 80.4f, 230.0f }, PlayGraphics::DEBUG_COLLISION } };
+static const DebugLine s_rects[] = { { { 20.0f, 20.0f }, { 120.0f, 90.0f }, PlayGraphics::DEBUG_BOUNDS }, { { -10.5f, 150.0f }, { 40.0f, 210.0f }, PlayGraphics::DEBUG_BOUNDS }, { { 200.0f, 40.0f }, { 300.0f, 40.0f }, PlayGraphics::DEBUG_USER } };
+static const DebugCircle s_circles[] = { { { 160.0f, 100.0f }, 60, PlayGraphics::DEBUG_COLLISION }, { { 310.5f, 5.0f }, 25, PlayGraphics::DEBUG_ORIGINS }, { { 60.0f, 60.0f }, 0, PlayGraphics::DEBUG_ORIGINS } };
+static const DebugLabel s_labels[] = { { { 60.0f, 55.0f }, "PLAYER", PlayGraphics::DEBUG_LABELS }, { { 315.0f, 197.0f }, "OFF THE EDGE", PlayGraphics::DEBUG_LABELS }, { { 100.0f, -17.5f }, "HIDDEN", PlayGraphics::DEBUG_USER } };
+
+static void AddToOverlay( PlayGraphics& graphics )
+{
+	graphics.AddDebugLine( s_lines[0].start, s_lines[0].end, LINE_COLOUR, s_lines[0].category );
+	graphics.AddDebugRect( s_rects[0].start, s_rects[0].end, RECT_COLOUR, s_rects[0].category );
+	graphics.AddDebugLine( s_lines[1].start, s_lines[1].end, LINE_COLOUR, s_lines[1].category );
+	graphics.AddDebugRect( s_rects[1].start, s_rects[1].end, RECT_COLOUR, s_rects[1].category );
+	graphics.AddDebugRect( s_rects[2].start, s_rects[2].end, RECT_COLOUR, s_rects[2].category );
+
+	// Labels and circles added before the lines are still drawn after them
+	for( const DebugLabel& label : s_labels )
+		graphics.AddDebugLabel( label.pos, label.text, LABEL_COLOUR, label.category );
+	for( const DebugCircle& circle : s_circles )
+		graphics.AddDebugCircle( circle.centre, circle.radius, CIRCLE_COLOUR, circle.category );
+}
+
+// Draws the same shapes in the categories which are shown, in the order the overlay draws them
+static void DrawImmediately( PlayGraphics& graphics, int categories )
+{
+	if( s_lines[0].category & categories )
+		graphics.DrawLine( s_lines[0].start, s_lines[0].end, LINE_COLOUR );
+	if( s_rects[0].category & categories )
+		graphics.DrawRect( s_rects[0].start, s_rects[0].end, RECT_COLOUR );
+	if( s_lines[1].category & categories )
+		graphics.DrawLine( s_lines[1].start, s_lines[1].end, LINE_COLOUR );
+	for( int i = 1; i < 3; i++ )
+	{
+		if( s_rects[i].category & categories )
+			graphics.DrawRect( s_rects[i].start, s_rects[i].end, RECT_COLOUR );
+	}
+
+	for( const DebugCircle& circle : s_circles )
+	{
+		if( circle.category & categories )
+			graphics.DrawCircle( circle.centre, circle.radius, CIRCLE_COLOUR );
+	}
+	for( const DebugLabel& label : s_labels )
+	{
+		if( label.category & categories )
+			graphics.DrawDebugString( label.pos, label.text, LABEL_COLOUR );
+	}
+}
+
+static void CheckOverlay( int categories, PixelRect clip, Point2f camera )
+{
+	PlayGraphics& graphics = PlayGraphics::Instance();
+	PixelData* pDisplay = graphics.GetDrawingBuffer();
+
+	graphics.PushClipRect( clip );
+	graphics.SetCameraPosition( camera );
+
+	graphics.ClearBuffer( PIX_BLACK );
+	DrawImmediately( graphics, categories );
+	uint64_t expected = PlayTest::Hash( *pDisplay );
+
+	graphics.SetDebugCategories( categories );
+	graphics.ClearBuffer( PIX_BLACK );
+	AddToOverlay( graphics );
+	graphics.DrawDebugOverlay();
+	bool bMatches = PlayTest::Hash( *pDisplay ) == expected;
+	PLAY_TEST_CHECK( bMatches );
+	if( !bMatches )
+		fprintf( stderr, "Categories %02x in clip %d,%d %dx%d with the camera at %.1f,%.1f\n", categories, clip.x, clip.y, clip.width, clip.height, camera.x, camera.y );
+
+	// Drawing the overlay empties it
+	graphics.ClearBuffer( PIX_BLACK );
+	uint64_t empty = PlayTest::Hash( *pDisplay );
+	graphics.DrawDebugOverlay();
+	PLAY_TEST_CHECK( PlayTest::Hash( *pDisplay ) == empty );
+
+	graphics.SetDebugCategories( PlayGraphics::DEBUG_ALL );
+	graphics.SetCameraPosition( { 0.0f, 0.0f } );
+	graphics.PopClipRect();
+}
+
+void RunTest()
+{
+	PlayGraphics& graphics = PlayGraphics::Instance();
+	PixelData* pDisplay = graphics.GetDrawingBuffer();
+
+	const int categories[] = { PlayGraphics::DEBUG_ALL, PlayGraphics::DEBUG_BOUNDS | PlayGraphics::DEBUG_LABELS, PlayGraphics::DEBUG_COLLISION, 0 };
+	const PixelRect clips[] = { { 0, 0, TEST_DISPLAY_WIDTH, TEST_DISPLAY_HEIGHT }, { 30, 25, 200, 120 }, { 0, 190, TEST_DISPLAY_WIDTH, 10 } };
+	const Point2f cameras[] = { { 0.0f, 0.0f }, { 45.0f, -30.0f } };
+
+	for( int category : categories )
+	{
+		for( const PixelRect& clip : clips )
+		{
+			for( Point2f camera : cameras )
+				CheckOverlay( category, clip, camera );
+		}
+	}
+
+	// Clearing the overlay removes everything without drawing it
+	graphics.ClearBuffer( PIX_BLACK );
+	uint64_t empty = PlayTest::Hash( *pDisplay );
+	AddToOverlay( graphics );
+	graphics.ClearDebugOverlay();
+	graphics.DrawDebugOverlay();
+	PLAY_TEST_CHECK( PlayTest::Hash( *pDisplay ) == empty );
+	PLAY_TEST_CHECK( graphics.GetDebugCategories() == PlayGraphics::DEBUG_ALL );
+}
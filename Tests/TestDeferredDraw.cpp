@@ -0,0 +1,124 @@
+// Draws the same scene immediately and deferred, with and without occlusion culling, and checks the results are identical
+#include "PlayTest.h"
+
+static int s_discsId = -1;
+static int s_blockId = -1;
+static int s_opaqueBackground = -1;
+static int s_layerBackground = -1;
+
+// Makes a fully opaque sprite with a gradient in each frame
+static int AddBlock( PlayGraphics& graphics, int size )
+{
+	PixelData canvas;
+	canvas.width = size * 2;
+	canvas.height = size;
+	canvas.pPixels = new Pixel[canvas.width * canvas.height];
+	for( int y = 0; y < canvas.height; y++ )
+	{
+		for( int x = 0; x < canvas.width; x++ )
+			canvas.pPixels[y * canvas.width + x] = Pixel( 0xFF, x * 2, y * 3, ( x + y ) & 0xFF );
+	}
+	return graphics.AddSprite( "block_2", canvas, 2, 1 );
+}
+
+// Writes a display sized background and loads it
+static int AddBackground( PlayGraphics& graphics, const char* name, bool transparent )
+{
+	std::vector<Pixel> pixels( TEST_DISPLAY_WIDTH * TEST_DISPLAY_HEIGHT );
+	PixelData image;
+	image.width = TEST_DISPLAY_WIDTH;
+	image.height = TEST_DISPLAY_HEIGHT;
+	image.pPixels = pixels.data();
+	for( int y = 0; y < image.height; y++ )
+	{
+		for( int x = 0; x < image.width; x++ )
+		{
+			int alpha = transparent ? ( ( ( x / 20 ) + ( y / 20 ) ) % 2 ) * 0x90 : 0xFF;
+			image.pPixels[y * image.width + x] = Pixel( alpha, x & 0xFF, y, 0x40 );
+		}
+	}
+	return graphics.LoadBackground( PlayTest::WritePNG( name, image ).c_str() );
+}
+
+// Draws a scene mixing sprites which hide each other with ones which can't hide anything, and calls which stop recording
+static void DrawScene( PlayGraphics& graphics )
+{
+	// Restore the sprite which is updated part way through
+	std::vector<Pixel> region( 16 * 16, PIX_RED );
+	graphics.UpdateSpriteRegion( s_blockId, { 8, 8, 16, 16 }, region.data() );
+
+	graphics.ClearBuffer( PIX_BLUE );
+	graphics.DrawBackground( s_opaqueBackground );
+
+	for( int i = 0; i < 40; i++ )
+		graphics.Draw( s_discsId, { ( i * 53 ) % 300 + 10.0f, ( i * 31 ) % 180 + 10.0f }, i % 3 );
+
+	// Opaque blocks in front of the discs, at positions which do and don't line up with the culling tiles
+	graphics.Draw( s_blockId, { 0, 0 }, 0 );
+	graphics.Draw( s_blockId, { 96, 64 }, 1 );
+	graphics.Draw( s_blockId, { 170.5f, 101.25f }, 0 );
+	graphics.DrawTransparent( s_blockId, { 40, 120 }, 1, 0.5f );
+	graphics.DrawRotated( s_blockId, { 250, 50 }, 0, 0.3f, 1.2f );
+
+	// Drawing anything else draws what has been recorded first
+	graphics.DrawLine( { 0, 0 }, { 319, 199 }, PIX_WHITE );
+	for( int i = 0; i < 10; i++ )
+		graphics.Draw( s_discsId, { 20.0f + i * 8, 30.0f }, i % 3 );
+	graphics.Draw( s_blockId, { 10, 20 }, 1 );
+
+	// Updates need the draws which used the old pixels to happen first
+	std::fill( region.begin(), region.end(), PIX_GREEN );
+	graphics.UpdateSpriteRegion( s_blockId, { 8, 8, 16, 16 }, region.data() );
+	graphics.Draw( s_blockId, { 200, 10 }, 0 );
+
+	// Everything recorded so far is hidden by the opaque background, apart from inside the clipping rectangle
+	graphics.DrawBackground( s_layerBackground );
+	graphics.PushClipRect( { 100, 20, 150, 120 } );
+	graphics.DrawBackground( s_opaqueBackground );
+	graphics.Draw( s_blockId, { 120, 30 }, 0 );
+	graphics.Draw( s_discsId, { 130, 40 }, 2 );
+	graphics.PopClipRect();
+	graphics.Draw( s_discsId, { 5, 190 }, 1 );
+}
+
+void RunTest()
+{
+	PlayGraphics& graphics = PlayGraphics::Instance();
+	PixelData* pDisplay = graphics.GetDrawingBuffer();
+
+	PixelData discs = PlayTest::MakeDiscs( 26, 22, 3, 9 );
+	s_discsId = graphics.AddSprite( "discs_3", discs, 3, 1 );
+	s_blockId = AddBlock( graphics, 64 );
+	s_opaqueBackground = AddBackground( graphics, "opaque.png", false );
+	s_layerBackground = AddBackground( graphics, "layer.png", true );
+
+	DrawScene( graphics );
+	uint64_t immediate = PlayTest::Hash( *pDisplay );
+
+	graphics.BeginDeferredDraw( false );
+	DrawScene( graphics );
+	graphics.EndDeferredDraw();
+	PLAY_TEST_CHECK( PlayTest::Hash( *pDisplay ) == immediate );
+	PLAY_TEST_CHECK( graphics.GetOccludedPixelCount() == 0 );
+
+	graphics.BeginDeferredDraw( true );
+	DrawScene( graphics );
+	graphics.EndDeferredDraw();
+	PLAY_TEST_CHECK( PlayTest::Hash( *pDisplay ) == immediate );
+	PLAY_TEST_CHECK( graphics.GetOccludedPixelCount() > 0 );
+
+	// A sprite completely behind an opaque block draws nothing, and the whole of it is counted
+	graphics.BeginDeferredDraw( true );
+	graphics.Draw( s_discsId, { 10, 10 }, 0 );
+	graphics.Draw( s_blockId, { 0, 0 }, 0 );
+	graphics.EndDeferredDraw();
+	PLAY_TEST_CHECK( graphics.GetOccludedPixelCount() == 26 * 22 );
+
+	// Translucent and rotated sprites don't hide anything
+	graphics.BeginDeferredDraw( true );
+	graphics.Draw( s_discsId, { 10, 10 }, 0 );
+	graphics.DrawTransparent( s_blockId, { 0, 0 }, 0, 0.99f );
+	graphics.DrawRotated( s_blockId, { 32, 32 }, 0, 0.0001f, 1.0f );
+	graphics.EndDeferredDraw();
+	PLAY_TEST_CHECK( graphics.GetOccludedPixelCount() == 0 );
+}
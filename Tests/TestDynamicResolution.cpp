@@ -0,0 +1,128 @@
+// Drives dynamic resolution with slow and fast frames and checks the scale it picks and the upscaled frames it draws
+#include "PlayTest.h"
+
+// The target frame time, with slow frames well over it and fast frames well under it
+static const float TARGET_MILLISECS = 20.0f;
+static const float SLOW_MILLISECS = 40.0f;
+// Under the target but over the fraction of it (0.75) which the frame time has to drop below before the scale goes up
+static const float NEAR_TARGET_MILLISECS = 17.0f;
+// Just over the target, and just under the fraction of it which raises the scale
+static const float JUST_OVER_MILLISECS = 20.01f;
+static const float JUST_UNDER_MILLISECS = 14.99f;
+
+// Runs a frame, telling EndFrame exactly how long it took rather than letting it measure the time
+static void RunFrame( PlayGraphics& graphics, float millisecs )
+{
+	graphics.EndFrame( millisecs );
+}
+
+// Makes a display sized background made of 2x2 blocks, which looks the same drawn at half resolution and upscaled
+static int AddBlockBackground( PlayGraphics& graphics )
+{
+	std::vector<Pixel> pixels( TEST_DISPLAY_WIDTH * TEST_DISPLAY_HEIGHT );
+	PixelData image;
+	image.width = TEST_DISPLAY_WIDTH;
+	image.height = TEST_DISPLAY_HEIGHT;
+	image.pPixels = pixels.data();
+	for( int y = 0; y < image.height; y++ )
+	{
+		for( int x = 0; x < image.width; x++ )
+			image.pPixels[y * image.width + x] = Pixel( 0xFF, ( x / 2 ) * 3, ( y / 2 ) * 5, ( ( x / 2 ) ^ ( y / 2 ) ) & 0xFF );
+	}
+	return graphics.LoadBackground( PlayTest::WritePNG( "blocks.png", image ).c_str() );
+}
+
+// Draws a scene whose edges all fall on even display co-ordinates
+static void DrawScene( PlayGraphics& graphics, int backgroundId )
+{
+	graphics.DrawBackground( backgroundId );
+	graphics.DrawRect( { 40.0f, 20.0f }, { 120.0f, 100.0f }, PIX_YELLOW, true );
+	graphics.DrawRect( { 200.0f, 150.0f }, { 330.0f, 210.0f }, Pixel( 0x80, 0x00, 0xFF, 0x00 ), true );
+}
+
+void RunTest()
+{
+	PlayGraphics& graphics = PlayGraphics::Instance();
+	PixelData* pDisplay = graphics.GetDrawingBuffer();
+
+	DynamicResolutionSettings settings;
+	settings.targetMillisecs = TARGET_MILLISECS;
+	settings.minScale = 0.5f;
+	settings.maxScale = 1.0f;
+	settings.scaleStep = 0.25f;
+	settings.frameCount = 3;
+
+	PLAY_TEST_CHECK( !graphics.GetDynamicResolution() && graphics.GetResolutionScale() == 1.0f );
+	graphics.SetDynamicResolution( true, settings );
+	PLAY_TEST_CHECK( graphics.GetDynamicResolution() && graphics.GetResolutionScale() == 1.0f );
+
+	// The scale only changes once enough slow frames have been averaged, and not below the lowest scale
+	RunFrame( graphics, SLOW_MILLISECS );
+	RunFrame( graphics, SLOW_MILLISECS );
+	PLAY_TEST_CHECK( graphics.GetResolutionScale() == 1.0f );
+	RunFrame( graphics, SLOW_MILLISECS );
+	PLAY_TEST_CHECK( graphics.GetResolutionScale() == 0.75f );
+	for( int i = 0; i < 3; i++ )
+		RunFrame( graphics, SLOW_MILLISECS );
+	PLAY_TEST_CHECK( graphics.GetResolutionScale() == 0.5f );
+	for( int i = 0; i < 3; i++ )
+		RunFrame( graphics, SLOW_MILLISECS );
+	PLAY_TEST_CHECK( graphics.GetResolutionScale() == 0.5f );
+
+	// At half resolution the frame is drawn into a smaller buffer, and the display only changes when it is upscaled
+	int backgroundId = AddBlockBackground( graphics );
+	uint64_t before = PlayTest::Hash( *pDisplay );
+	graphics.ClearBuffer( PIX_BLACK );
+	DrawScene( graphics, backgroundId );
+	PLAY_TEST_CHECK( PlayTest::Hash( *pDisplay ) == before );
+	graphics.EndFrame( SLOW_MILLISECS );
+	uint64_t halfScale = PlayTest::Hash( *pDisplay );
+	PLAY_TEST_CHECK( halfScale != before && graphics.GetResolutionScale() == 0.5f );
+
+	// Clipping rectangles are still given and returned in display co-ordinates
+	graphics.PushClipRect( { 40, 30, 100, 60 } );
+	PixelRect clip = graphics.GetClipRect();
+	PLAY_TEST_CHECK( clip.x == 40 && clip.y == 30 && clip.width == 100 && clip.height == 60 );
+	graphics.PopClipRect();
+
+	// Fast frames raise the scale back up to the highest scale
+	for( int i = 0; i < 3; i++ )
+		RunFrame( graphics, 0.0f );
+	PLAY_TEST_CHECK( graphics.GetResolutionScale() == 0.75f );
+	for( int i = 0; i < 6; i++ )
+		RunFrame( graphics, 0.0f );
+	PLAY_TEST_CHECK( graphics.GetResolutionScale() == 1.0f );
+
+	// The scene's edges fall on whole pixels of the half resolution buffer, so it upscales to exactly the full resolution frame
+	graphics.ClearBuffer( PIX_BLACK );
+	DrawScene( graphics, backgroundId );
+	graphics.EndFrame( 0.0f );
+	PLAY_TEST_CHECK( PlayTest::Hash( *pDisplay ) == halfScale && graphics.GetResolutionScale() == 1.0f );
+
+	// Frames just under the target leave the scale where it is, so it doesn't keep flipping
+	graphics.SetDynamicResolution( true, settings );
+	for( int i = 0; i < 3; i++ )
+		RunFrame( graphics, SLOW_MILLISECS );
+	PLAY_TEST_CHECK( graphics.GetResolutionScale() == 0.75f );
+	for( int i = 0; i < 6; i++ )
+		RunFrame( graphics, NEAR_TARGET_MILLISECS );
+	PLAY_TEST_CHECK( graphics.GetResolutionScale() == 0.75f );
+
+	// The scale moves as soon as the average is past either threshold
+	for( int i = 0; i < 3; i++ )
+		RunFrame( graphics, JUST_OVER_MILLISECS );
+	PLAY_TEST_CHECK( graphics.GetResolutionScale() == 0.5f );
+	for( int i = 0; i < 3; i++ )
+		RunFrame( graphics, JUST_UNDER_MILLISECS );
+	PLAY_TEST_CHECK( graphics.GetResolutionScale() == 0.75f );
+
+	// Turning it off goes back to drawing straight into the display buffer at full resolution
+	graphics.SetDynamicResolution( false );
+	PLAY_TEST_CHECK( !graphics.GetDynamicResolution() && graphics.GetResolutionScale() == 1.0f );
+	for( int i = 0; i < 3; i++ )
+		RunFrame( graphics, SLOW_MILLISECS );
+	PLAY_TEST_CHECK( graphics.GetResolutionScale() == 1.0f );
+	graphics.ClearBuffer( PIX_BLACK );
+	DrawScene( graphics, backgroundId );
+	PLAY_TEST_CHECK( PlayTest::Hash( *pDisplay ) == halfScale );
+}
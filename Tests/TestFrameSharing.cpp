@@ -0,0 +1,127 @@
+// Loads sprites with repeated frames and checks every frame still draws its own pixels once identical frames share them
+#include "PlayTest.h"
+
+static const int FRAME_SIZE = 24;
+// Patterns from here on have few enough colours for the sprite to be indexed
+static const int FEW = 100;
+
+// Makes an opaque frame which is different for each pattern
+static Pixel FramePixel( int pattern, int x, int y )
+{
+	if( pattern >= FEW )
+		return Pixel( 0xFF, ( ( x / 4 + y / 6 + pattern ) % 5 ) * 60, ( pattern - FEW ) * 20, 0x80 );
+	return Pixel( 0xFF, ( x * 9 + pattern * 40 ) & 0xFF, ( y * 7 + pattern * 90 ) & 0xFF, ( pattern * 30 + x + y ) & 0xFF );
+}
+
+// Makes a sheet of frames laid out in rows, where each frame shows the given pattern
+static PixelData MakeSheet( const std::vector<int>& patterns, int hCount )
+{
+	int vCount = static_cast<int>( patterns.size() ) / hCount;
+	PixelData canvas;
+	canvas.width = FRAME_SIZE * hCount;
+	canvas.height = FRAME_SIZE * vCount;
+	canvas.pPixels = new Pixel[canvas.width * canvas.height];
+	for( size_t f = 0; f < patterns.size(); f++ )
+	{
+		int frameX = ( static_cast<int>( f ) % hCount ) * FRAME_SIZE;
+		int frameY = ( static_cast<int>( f ) / hCount ) * FRAME_SIZE;
+		for( int y = 0; y < FRAME_SIZE; y++ )
+		{
+			for( int x = 0; x < FRAME_SIZE; x++ )
+				canvas.pPixels[( frameY + y ) * canvas.width + frameX + x] = FramePixel( patterns[f], x, y );
+		}
+	}
+	return canvas;
+}
+
+static int AddSheet( PlayGraphics& graphics, const char* name, const std::vector<int>& patterns, int hCount )
+{
+	PixelData canvas = MakeSheet( patterns, hCount );
+	return graphics.AddSprite( name, canvas, hCount, static_cast<int>( patterns.size() ) / hCount );
+}
+
+// Opaque pixels are drawn as their channels pre-multiplied by full alpha and by the white colour multiply
+static uint32_t Drawn( Pixel pix )
+{
+	uint32_t r = ( ( ( pix.r * 0xFF ) >> 8 ) * 0xFF ) >> 8;
+	uint32_t g = ( ( ( pix.g * 0xFF ) >> 8 ) * 0xFF ) >> 8;
+	uint32_t b = ( ( ( pix.b * 0xFF ) >> 8 ) * 0xFF ) >> 8;
+	return 0xFF000000 | ( r << 16 ) | ( g << 8 ) | b;
+}
+
+// Checks every frame of a sprite draws the pattern it was loaded with
+static bool DrawsPatterns( PlayGraphics& graphics, int spriteId, const std::vector<int>& patterns )
+{
+	const PixelData* pDisplay = graphics.GetDrawingBuffer();
+	int wrong = 0;
+	for( size_t f = 0; f < patterns.size(); f++ )
+	{
+		graphics.ClearBuffer( PIX_BLACK );
+		graphics.Draw( spriteId, { 50.0f, 40.0f }, static_cast<int>( f ) );
+		for( int y = 0; y < FRAME_SIZE; y++ )
+		{
+			for( int x = 0; x < FRAME_SIZE; x++ )
+				wrong += pDisplay->Row( 40 + y )[50 + x].bits != Drawn( FramePixel( patterns[f], x, y ) );
+		}
+	}
+	return wrong == 0;
+}
+
+void RunTest()
+{
+	PlayGraphics& graphics = PlayGraphics::Instance();
+	const int frameBytes = FRAME_SIZE * FRAME_SIZE * static_cast<int>( sizeof( Pixel ) );
+
+	// A ping-pong cycle stores each pose once, and the repeats draw from the earlier frames
+	const std::vector<int> pingPong = { 0, 1, 2, 3, 2, 1 };
+	int pingPongId = AddSheet( graphics, "ping pong", pingPong, 6 );
+	SpriteMemoryInfo info = graphics.GetSpriteMemoryInfo( pingPongId );
+	PLAY_TEST_CHECK( !info.indexed && info.sharedFrames == 2 && info.sharedBytes == 2 * frameBytes );
+	PLAY_TEST_CHECK( DrawsPatterns( graphics, pingPongId, pingPong ) );
+
+	// Frames in later rows of a sheet are packed into the strip in order, whichever row they came from
+	const std::vector<int> rows = { 4, 5, 4, 6, 5, 7, 7, 4, 8 };
+	int rowsId = AddSheet( graphics, "rows", rows, 3 );
+	info = graphics.GetSpriteMemoryInfo( rowsId );
+	PLAY_TEST_CHECK( info.sharedFrames == 4 && info.sharedBytes == 4 * frameBytes );
+	PLAY_TEST_CHECK( DrawsPatterns( graphics, rowsId, rows ) );
+
+	// The same images under another name draw every frame from the sprites which loaded them first
+	const std::vector<int> mixed = { 3, 8, 0, 5, 1, 7 };
+	int mixedId = AddSheet( graphics, "mixed", mixed, 2 );
+	info = graphics.GetSpriteMemoryInfo( mixedId );
+	PLAY_TEST_CHECK( info.sharedFrames == 6 && info.sharedBytes == 6 * frameBytes );
+	PLAY_TEST_CHECK( info.drawBytes < frameBytes );
+	PLAY_TEST_CHECK( DrawsPatterns( graphics, mixedId, mixed ) );
+
+	// Frames of a different size are never shared, even where their pixels match
+	PixelData tall = MakeSheet( { 0, 1 }, 1 );
+	int tallId = graphics.AddSprite( "tall", tall, 1, 1 );
+	PLAY_TEST_CHECK( graphics.GetSpriteMemoryInfo( tallId ).sharedFrames == 0 );
+
+	// Indexed frames are compared as they are drawn, so a 32-bit sprite can draw a frame from an indexed one
+	const std::vector<int> indexed = { FEW, FEW + 1, FEW + 1, FEW + 2, FEW, FEW + 3, FEW + 3, FEW + 2 };
+	int indexedId = AddSheet( graphics, "indexed", indexed, 4 );
+	info = graphics.GetSpriteMemoryInfo( indexedId );
+	PLAY_TEST_CHECK( info.indexed && info.sharedFrames == 4 && info.sharedBytes == 4 * FRAME_SIZE * FRAME_SIZE );
+	PLAY_TEST_CHECK( DrawsPatterns( graphics, indexedId, indexed ) );
+
+	const std::vector<int> withIndexed = { FEW + 2, 9 };
+	int withIndexedId = AddSheet( graphics, "with indexed", withIndexed, 2 );
+	info = graphics.GetSpriteMemoryInfo( withIndexedId );
+	PLAY_TEST_CHECK( !info.indexed && info.sharedFrames == 1 && info.sharedBytes == frameBytes );
+	PLAY_TEST_CHECK( DrawsPatterns( graphics, withIndexedId, withIndexed ) );
+
+	// Changing a sprite whose frames are shared leaves the sprites sharing them drawing what they loaded
+	std::vector<Pixel> patch( FRAME_SIZE * FRAME_SIZE, PIX_RED );
+	for( int f = 0; f < 4; f++ )
+		graphics.UpdateSpriteRegion( pingPongId, { f * FRAME_SIZE, 0, FRAME_SIZE, FRAME_SIZE }, patch.data() );
+	PLAY_TEST_CHECK( DrawsPatterns( graphics, rowsId, rows ) );
+	PLAY_TEST_CHECK( DrawsPatterns( graphics, mixedId, mixed ) );
+	PLAY_TEST_CHECK( DrawsPatterns( graphics, indexedId, indexed ) );
+
+	// Sprites loaded afterwards don't share the changed frames
+	int laterId = AddSheet( graphics, "later", pingPong, 6 );
+	PLAY_TEST_CHECK( DrawsPatterns( graphics, laterId, pingPong ) );
+	PLAY_TEST_CHECK( graphics.GetSpriteMemoryInfo( laterId ).sharedFrames >= 2 );
+}
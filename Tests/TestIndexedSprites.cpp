@@ -0,0 +1,124 @@
+// Stores sprites as palette indices and checks their size and that they draw exactly like the same pixels stored in 32 bits
+#include "PlayTest.h"
+
+static const int FRAME_WIDTH = 40;
+static const int FRAME_HEIGHT = 36;
+static const int FRAMES = 4;
+
+// Makes a canvas of distinct frames using the given number of colours (opaque, translucent and one transparent colour)
+// > Transparent pixels have different colour channels, which are all counted as the same colour
+static PixelData MakeCanvas( int width, int height, int frames, int colours )
+{
+	PixelData canvas;
+	canvas.width = width * frames;
+	canvas.height = height;
+	canvas.pPixels = new Pixel[canvas.width * canvas.height];
+
+	for( int y = 0; y < height; y++ )
+	{
+		for( int x = 0; x < canvas.width; x++ )
+		{
+			int f = x / width;
+			int c = ( ( x % width ) * 7 + y * 3 + f * 5 ) % colours;
+			if( c == 0 )
+				canvas.pPixels[y * canvas.width + x] = Pixel( 0x00, x & 0xFF, y, f );
+			else
+				canvas.pPixels[y * canvas.width + x] = Pixel( ( c % 3 == 0 ) ? 0x80 : 0xFF, c * 37, 255 - c, c * 11 );
+		}
+	}
+	return canvas;
+}
+
+static int AddSprite( PlayGraphics& graphics, const char* name, int width, int height, int frames, int colours )
+{
+	PixelData canvas = MakeCanvas( width, height, frames, colours );
+	return graphics.AddSprite( name, canvas, frames, 1 );
+}
+
+// Draws the sprite in every way it can be drawn, across the edges of the display and the clipping rectangle
+static void DrawSprite( PlayGraphics& graphics, int spriteId )
+{
+	graphics.ClearBuffer( PIX_BLUE );
+	graphics.PushClipRect( { 10, 15, 290, 170 } );
+	for( int f = 0; f < FRAMES; f++ )
+	{
+		graphics.Draw( spriteId, { 30.0f + f * 60, 40.0f }, f );
+		graphics.Draw( spriteId, { -12.0f + f * 80, 170.5f }, f );
+		graphics.DrawTransparent( spriteId, { 50.0f + f * 55, 90.0f }, f, 0.5f );
+		graphics.DrawRotated( spriteId, { 70.0f + f * 60, 140.0f }, f, 0.4f * f, 1.3f );
+	}
+	graphics.PopClipRect();
+	graphics.Draw( spriteId, { 300.0f, -10.0f }, 1 );
+}
+
+// Checks two sprites with the same pixels draw the same in 32 and 16 bits, and deferred
+static bool DrawsTheSame( PlayGraphics& graphics, int spriteA, int spriteB )
+{
+	PixelData* pDisplay = graphics.GetDrawingBuffer();
+	bool bSame = true;
+
+	for( int format = 0; format < 2; format++ )
+	{
+		graphics.SetDisplayFormat( format ? PIXEL_FORMAT_RGB565 : PIXEL_FORMAT_ARGB );
+		DrawSprite( graphics, spriteA );
+		graphics.EndFrame();
+		uint64_t expected = PlayTest::Hash( *pDisplay );
+		DrawSprite( graphics, spriteB );
+		graphics.EndFrame();
+		bSame = bSame && PlayTest::Hash( *pDisplay ) == expected;
+	}
+	graphics.SetDisplayFormat( PIXEL_FORMAT_ARGB );
+
+	DrawSprite( graphics, spriteA );
+	uint64_t expected = PlayTest::Hash( *pDisplay );
+	graphics.BeginDeferredDraw();
+	DrawSprite( graphics, spriteB );
+	graphics.EndDeferredDraw();
+	return bSame && PlayTest::Hash( *pDisplay ) == expected;
+}
+
+void RunTest()
+{
+	PlayGraphics& graphics = PlayGraphics::Instance();
+
+	// A sprite with few colours is stored as indices into a palette of only the colours it uses
+	int fewId = AddSprite( graphics, "few", FRAME_WIDTH, FRAME_HEIGHT, FRAMES, 20 );
+	int manyId = AddSprite( graphics, "many", FRAME_WIDTH, FRAME_HEIGHT, FRAMES, 200 );
+	SpriteMemoryInfo few = graphics.GetSpriteMemoryInfo( fewId );
+	SpriteMemoryInfo many = graphics.GetSpriteMemoryInfo( manyId );
+	PLAY_TEST_CHECK( few.indexed && many.indexed );
+	PLAY_TEST_CHECK( many.drawBytes - few.drawBytes == ( 200 - 20 ) * static_cast<int>( sizeof( uint32_t ) ) );
+	PLAY_TEST_CHECK( few.drawBytes * 3 < few.uncompressedBytes );
+
+	// Sprites where the palette and the padding of the index rows would take more memory than 32-bit pixels aren't indexed
+	int smallId = AddSprite( graphics, "small", 8, 8, 1, 64 );
+	int twoColourId = AddSprite( graphics, "two colours", 8, 8, 1, 2 );
+	int narrowId = AddSprite( graphics, "narrow", 16, 64, 1, 2 );
+	int squareId = AddSprite( graphics, "square", 64, 64, 1, 2 );
+	PLAY_TEST_CHECK( !graphics.GetSpriteMemoryInfo( smallId ).indexed );
+	PLAY_TEST_CHECK( !graphics.GetSpriteMemoryInfo( twoColourId ).indexed );
+	PLAY_TEST_CHECK( !graphics.GetSpriteMemoryInfo( narrowId ).indexed );
+	PLAY_TEST_CHECK( graphics.GetSpriteMemoryInfo( squareId ).indexed );
+	PLAY_TEST_CHECK( graphics.GetSpriteMemoryInfo( squareId ).drawBytes < graphics.GetSpriteMemoryInfo( squareId ).uncompressedBytes );
+
+	// Too many colours can't be indexed at all
+	int fullColourId = AddSprite( graphics, "full colour", 64, 64, 1, 300 );
+	PLAY_TEST_CHECK( !graphics.GetSpriteMemoryInfo( fullColourId ).indexed );
+
+	// The same pixels written over a copy of the sprite turn it into 32-bit pixels, which must draw exactly the same
+	int copyId = AddSprite( graphics, "few copy", FRAME_WIDTH, FRAME_HEIGHT, FRAMES, 20 );
+	PixelData canvas = MakeCanvas( FRAME_WIDTH, FRAME_HEIGHT, FRAMES, 20 );
+	graphics.UpdateSpriteRegion( copyId, { 0, 0, canvas.width, canvas.height }, canvas.pPixels );
+	delete[] canvas.pPixels;
+	PLAY_TEST_CHECK( graphics.GetSpriteMemoryInfo( fewId ).indexed && !graphics.GetSpriteMemoryInfo( copyId ).indexed );
+	PLAY_TEST_CHECK( DrawsTheSame( graphics, fewId, copyId ) );
+
+	// Colouring an indexed sprite swaps its palette, which draws the same as re-colouring 32-bit pixels
+	graphics.ColourSprite( fewId, 0xFF, 0x60, 0x20 );
+	graphics.ColourSprite( copyId, 0xFF, 0x60, 0x20 );
+	PLAY_TEST_CHECK( graphics.GetSpriteMemoryInfo( fewId ).indexed );
+	PLAY_TEST_CHECK( DrawsTheSame( graphics, fewId, copyId ) );
+	graphics.ColourSprite( fewId, 0xFF, 0xFF, 0xFF );
+	graphics.ColourSprite( copyId, 0xFF, 0xFF, 0xFF );
+	PLAY_TEST_CHECK( DrawsTheSame( graphics, fewId, copyId ) );
+}
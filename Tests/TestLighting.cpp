@@ -0,0 +1,182 @@
+// Lights frames with ambient and point lights and checks the light map's brightness, falloff, clipping and worker threads
+#include "PlayTest.h"
+
+// Light map pixel 40 (across) and 25 (down) are centred here (each covers 4x4 pixels), so the light falls off the same way in
+// every direction
+static const Point2f CENTRE = { 162.0f, 102.0f };
+
+// Fills the display buffer with a pattern of opaque colours, or a single grey
+static void FillPattern( PixelData& display, int grey = -1 )
+{
+	for( int y = 0; y < display.height; y++ )
+	{
+		for( int x = 0; x < display.width; x++ )
+			display.Row( y )[x] = ( grey >= 0 ) ? Pixel( 0xFF, grey, grey, grey ) : Pixel( 0xFF, ( x * 3 ) & 0xFF, ( y * 5 ) & 0xFF, ( x + y ) & 0xFF );
+	}
+}
+
+static std::vector<Pixel> CopyDisplay( const PixelData& display )
+{
+	std::vector<Pixel> pixels;
+	for( int y = 0; y < display.height; y++ )
+		pixels.insert( pixels.end(), display.Row( y ), display.Row( y ) + display.width );
+	return pixels;
+}
+
+// Checks every pixel is a pattern pixel with each colour channel multiplied by the given light (in 256ths)
+static bool LitBy( const std::vector<Pixel>& pattern, const PixelData& display, int red, int green, int blue )
+{
+	int wrong = 0;
+	for( int y = 0; y < display.height; y++ )
+	{
+		for( int x = 0; x < display.width; x++ )
+		{
+			Pixel pix = pattern[y * display.width + x];
+			wrong += display.Row( y )[x].bits != Pixel( pix.a, ( pix.r * red ) >> 8, ( pix.g * green ) >> 8, ( pix.b * blue ) >> 8 ).bits;
+		}
+	}
+	return wrong == 0;
+}
+
+// Checks a light in the dark lights the pixels around its centre evenly, fading with distance to nothing beyond its radius
+static bool LightsEvenly( const PixelData& display, int radius )
+{
+	int cx = static_cast<int>( CENTRE.x );
+	int cy = static_cast<int>( CENTRE.y );
+	int wrong = 0;
+	for( int d = 0; d < radius + 8; d++ )
+	{
+		// The centre of pixel x is at x + 0.5, so pixels cx + d and cx - 1 - d are the same distance from the light's centre
+		Pixel right = display.Row( cy )[cx + d];
+		wrong += right.bits != display.Row( cy )[cx - 1 - d].bits;
+		wrong += right.bits != display.Row( cy + d )[cx].bits;
+		wrong += right.bits != display.Row( cy - 1 - d )[cx].bits;
+		wrong += display.Row( cy )[cx + d + 1].r > right.r;
+	}
+	wrong += display.Row( cy )[cx + radius + 6].bits != PIX_BLACK.bits;
+	wrong += display.Row( cy + radius + 6 )[cx].bits != PIX_BLACK.bits;
+	wrong += display.Row( cy )[cx].r < 0xF0;
+	return wrong == 0;
+}
+
+static void LightFrame( PlayGraphics& graphics, Pixel ambient, int grey = -1 )
+{
+	FillPattern( *graphics.GetDrawingBuffer(), grey );
+	graphics.SetAmbientLight( ambient );
+}
+
+void RunTest()
+{
+	PlayGraphics& graphics = PlayGraphics::Instance();
+	PixelData* pDisplay = graphics.GetDrawingBuffer();
+	graphics.SetWorkerThreads( 0 );
+
+	FillPattern( *pDisplay );
+	std::vector<Pixel> pattern = CopyDisplay( *pDisplay );
+
+	// White ambient light leaves everything as it is, and other colours multiply each channel (keeping alpha)
+	LightFrame( graphics, PIX_WHITE );
+	graphics.DrawLighting();
+	PLAY_TEST_CHECK( LitBy( pattern, *pDisplay, 256, 256, 256 ) );
+
+	LightFrame( graphics, Pixel( 0xFF, 0x80, 0x80, 0x80 ) );
+	graphics.DrawLighting();
+	PLAY_TEST_CHECK( LitBy( pattern, *pDisplay, 129, 129, 129 ) );
+
+	LightFrame( graphics, Pixel( 0xFF, 0xFF, 0x40, 0x00 ) );
+	graphics.DrawLighting();
+	PLAY_TEST_CHECK( LitBy( pattern, *pDisplay, 256, 64, 0 ) );
+
+	// A point light in the dark fades smoothly from its centre to nothing at its radius
+	LightFrame( graphics, PIX_BLACK, 0xFF );
+	graphics.AddLight( CENTRE, 40.0f, PIX_WHITE );
+	graphics.DrawLighting();
+	PLAY_TEST_CHECK( LightsEvenly( *pDisplay, 40 ) );
+	uint64_t lit = PlayTest::Hash( *pDisplay );
+
+	// Lights only last until they have been drawn
+	LightFrame( graphics, PIX_BLACK );
+	graphics.DrawLighting();
+	PLAY_TEST_CHECK( LitBy( pattern, *pDisplay, 0, 0, 0 ) );
+
+	// Lights are positioned like sprites, so they move with the camera
+	graphics.SetCameraPosition( { 100.0f, 50.0f } );
+	LightFrame( graphics, PIX_BLACK, 0xFF );
+	graphics.AddLight( { CENTRE.x + 100.0f, CENTRE.y + 50.0f }, 40.0f, PIX_WHITE );
+	graphics.DrawLighting();
+	graphics.SetCameraPosition( { 0.0f, 0.0f } );
+	PLAY_TEST_CHECK( PlayTest::Hash( *pDisplay ) == lit );
+
+	// Lights are coloured, add together, and brighten beyond full brightness without overflowing
+	Pixel* pCentre = &pDisplay->Row( static_cast<int>( CENTRE.y ) )[static_cast<int>( CENTRE.x )];
+	LightFrame( graphics, PIX_BLACK, 0xFF );
+	graphics.AddLight( CENTRE, 40.0f, Pixel( 0xFF, 0xFF, 0x80, 0x00 ) );
+	graphics.DrawLighting();
+	PLAY_TEST_CHECK( pCentre->r > 0xF0 && std::abs( pCentre->g - 0x80 ) <= 8 && pCentre->b == 0x00 );
+
+	LightFrame( graphics, PIX_BLACK, 0x40 );
+	graphics.AddLight( CENTRE, 40.0f, PIX_WHITE );
+	graphics.AddLight( CENTRE, 40.0f, PIX_WHITE );
+	graphics.DrawLighting();
+	int twoLights = pCentre->r;
+	LightFrame( graphics, PIX_BLACK, 0x40 );
+	graphics.AddLight( CENTRE, 40.0f, PIX_WHITE, 2.0f );
+	graphics.DrawLighting();
+	PLAY_TEST_CHECK( std::abs( twoLights - 0x80 ) <= 4 && std::abs( pCentre->r - twoLights ) <= 1 );
+
+	LightFrame( graphics, PIX_WHITE, 0x40 );
+	for( int i = 0; i < 40; i++ )
+		graphics.AddLight( CENTRE, 40.0f, PIX_WHITE, 4.0f );
+	graphics.DrawLighting();
+	PLAY_TEST_CHECK( pCentre->bits == PIX_WHITE.bits );
+
+	// Only the pixels inside the clipping rectangle are lit
+	LightFrame( graphics, PIX_BLACK );
+	graphics.PushClipRect( { 40, 30, 200, 120 } );
+	graphics.DrawLighting();
+	graphics.PopClipRect();
+	int wrong = 0;
+	for( int y = 0; y < pDisplay->height; y++ )
+	{
+		for( int x = 0; x < pDisplay->width; x++ )
+		{
+			bool inside = x >= 40 && x < 240 && y >= 30 && y < 150;
+			wrong += pDisplay->Row( y )[x].bits != ( inside ? PIX_BLACK.bits : pattern[y * pDisplay->width + x].bits );
+		}
+	}
+	PLAY_TEST_CHECK( wrong == 0 );
+
+	// Splitting the rows between worker threads lights exactly the same
+	uint64_t lights[2] = { 0, 0 };
+	for( int workers = 0; workers < 2; workers++ )
+	{
+		graphics.SetWorkerThreads( workers * 5 );
+		LightFrame( graphics, Pixel( 0xFF, 0x30, 0x20, 0x40 ) );
+		for( int i = 0; i < 12; i++ )
+			graphics.AddLight( { ( i * 53 ) % 330 - 5.0f, ( i * 37 ) % 210 - 5.0f }, 20.0f + ( i * 7 ) % 50, Pixel( 0xFF, i * 20, 0xFF - i * 20, 0x80 ), 0.5f + ( i % 3 ) );
+		graphics.DrawLighting();
+		lights[workers] = PlayTest::Hash( *pDisplay );
+	}
+	PLAY_TEST_CHECK( lights[0] == lights[1] && graphics.GetWorkerThreads() == 5 );
+	graphics.SetWorkerThreads( 0 );
+
+	// 16-bit render targets are lit too, leaving pixels at full brightness alone
+	graphics.SetDisplayFormat( PIXEL_FORMAT_RGB565 );
+	graphics.ClearBuffer( Pixel( 0xFF, 0xC0, 0x60, 0x30 ) );
+	graphics.EndFrame();
+	uint64_t unlit = PlayTest::Hash( *pDisplay );
+	graphics.ClearBuffer( Pixel( 0xFF, 0xC0, 0x60, 0x30 ) );
+	graphics.SetAmbientLight( PIX_WHITE );
+	graphics.DrawLighting();
+	graphics.EndFrame();
+	PLAY_TEST_CHECK( PlayTest::Hash( *pDisplay ) == unlit );
+
+	graphics.ClearBuffer( PIX_WHITE );
+	graphics.SetAmbientLight( PIX_BLACK );
+	graphics.AddLight( CENTRE, 40.0f, PIX_WHITE );
+	graphics.DrawLighting();
+	graphics.EndFrame();
+	PLAY_TEST_CHECK( pCentre->r > 0xE0 && pDisplay->Row( 30 )[160].bits == PIX_BLACK.bits && pDisplay->Row( 101 )[100].bits == PIX_BLACK.bits );
+	graphics.SetDisplayFormat( PIXEL_FORMAT_ARGB );
+	graphics.SetAmbientLight( PIX_WHITE );
+}
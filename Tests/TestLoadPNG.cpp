@@ -0,0 +1,326 @@
+// Decodes PNG files of every colour type and bit depth, and checks that malformed files are rejected
+#include "PlayTest.h"
+
+// The samples and expected pixels of a test image, along with how to write it
+struct TestImage
+{
+	int width{ 0 };
+	int height{ 0 };
+	int bitDepth{ 8 };
+	int colourType{ 6 };
+	// The samples of each pixel, channel by channel (palette indices for colour type 3)
+	std::vector<int> samples;
+	std::vector<uint8_t> palette;
+	std::vector<uint8_t> transparency;
+	std::vector<uint32_t> expected;
+	// Overrides the filter type written for every row when not negative
+	int forceFilter{ -1 };
+	int interlace{ 0 };
+};
+
+static uint32_t s_random = 12345;
+
+// A small deterministic random number generator, so every run writes the same files
+static int Random( int range )
+{
+	s_random = s_random * 1103515245u + 12345u;
+	return static_cast<int>( ( s_random >> 8 ) % static_cast<uint32_t>( range ) );
+}
+
+static int Channels( int colourType )
+{
+	return colourType == 2 ? 3 : colourType == 4 ? 2 : colourType == 6 ? 4 : 1;
+}
+
+// Packs the samples into filtered rows, each starting with its filter type
+static std::vector<uint8_t> FilterRows( const TestImage& image )
+{
+	int channels = Channels( image.colourType );
+	size_t rowBytes = ( static_cast<size_t>( image.width ) * channels * image.bitDepth + 7 ) / 8;
+	int pixelBytes = std::max( 1, channels * image.bitDepth / 8 );
+	std::vector<uint8_t> previous( rowBytes, 0 );
+	std::vector<uint8_t> out;
+
+	for( int y = 0; y < image.height; y++ )
+	{
+		std::vector<uint8_t> row( rowBytes, 0 );
+		for( int i = 0; i < image.width * channels; i++ )
+		{
+			int sample = image.samples[y * image.width * channels + i];
+			if( image.bitDepth == 16 )
+			{
+				row[i * 2] = static_cast<uint8_t>( sample >> 8 );
+				row[i * 2 + 1] = static_cast<uint8_t>( sample );
+			}
+			else
+			{
+				int bit = i * image.bitDepth;
+				row[bit >> 3] |= static_cast<uint8_t>( sample << ( 8 - image.bitDepth - ( bit & 7 ) ) );
+			}
+		}
+
+		// Cycle through the filter types so that every one is undone
+		int filter = image.forceFilter >= 0 ? image.forceFilter : y % 5;
+		out.push_back( static_cast<uint8_t>( filter ) );
+
+		for( size_t i = 0; i < rowBytes; i++ )
+		{
+			int left = i >= static_cast<size_t>( pixelBytes ) ? row[i - pixelBytes] : 0;
+			int up = previous[i];
+			int upLeft = i >= static_cast<size_t>( pixelBytes ) ? previous[i - pixelBytes] : 0;
+			int predictor = 0;
+
+			if( filter == 1 )
+				predictor = left;
+			else if( filter == 2 )
+				predictor = up;
+			else if( filter == 3 )
+				predictor = ( left + up ) >> 1;
+			else if( filter == 4 )
+			{
+				int estimate = left + up - upLeft;
+				int distanceLeft = abs( estimate - left ), distanceUp = abs( estimate - up ), distanceUpLeft = abs( estimate - upLeft );
+				predictor = ( distanceLeft <= distanceUp && distanceLeft <= distanceUpLeft ) ? left : ( distanceUp <= distanceUpLeft ) ? up : upLeft;
+			}
+
+			out.push_back( static_cast<uint8_t>( row[i] - predictor ) );
+		}
+
+		previous = row;
+	}
+
+	return out;
+}
+
+static std::vector<uint8_t> EncodePNG( const TestImage& image )
+{
+	static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+	std::vector<uint8_t> file( signature, signature + 8 );
+
+	std::vector<uint8_t> header;
+	PlayTest::PutUint32( header, static_cast<uint32_t>( image.width ) );
+	PlayTest::PutUint32( header, static_cast<uint32_t>( image.height ) );
+	header.push_back( static_cast<uint8_t>( image.bitDepth ) );
+	header.push_back( static_cast<uint8_t>( image.colourType ) );
+	header.push_back( 0 );
+	header.push_back( 0 );
+	header.push_back( static_cast<uint8_t>( image.interlace ) );
+	PlayTest::PutChunk( file, "IHDR", header );
+
+	if( !image.palette.empty() )
+		PlayTest::PutChunk( file, "PLTE", image.palette );
+	if( !image.transparency.empty() )
+		PlayTest::PutChunk( file, "tRNS", image.transparency );
+	if( !image.samples.empty() )
+		PlayTest::PutChunk( file, "IDAT", PlayTest::ZlibStore( FilterRows( image ) ) );
+
+	PlayTest::PutChunk( file, "IEND", {} );
+	return file;
+}
+
+// Makes an image of random samples and works out the straight alpha pixels it should decode to
+static TestImage MakeImage( int colourType, int bitDepth, bool bTransparency )
+{
+	TestImage image;
+	image.width = 1 + Random( 37 );
+	image.height = 1 + Random( 11 );
+	image.bitDepth = bitDepth;
+	image.colourType = colourType;
+
+	int channels = Channels( colourType );
+	int maxValue = ( 1 << bitDepth ) - 1;
+	int paletteSize = colourType == 3 ? 1 + Random( maxValue + 1 ) : 0;
+
+	for( int i = 0; i < paletteSize * 3; i++ )
+		image.palette.push_back( static_cast<uint8_t>( Random( 256 ) ) );
+
+	// A transparent key colour is picked from the samples so that some pixels match it
+	int key[3] = { Random( maxValue + 1 ), Random( maxValue + 1 ), Random( maxValue + 1 ) };
+
+	if( bTransparency && colourType == 3 )
+	{
+		for( int i = 0; i < paletteSize - 1; i++ )
+			image.transparency.push_back( static_cast<uint8_t>( Random( 256 ) ) );
+	}
+	else if( bTransparency )
+	{
+		for( int c = 0; c < channels; c++ )
+		{
+			image.transparency.push_back( static_cast<uint8_t>( key[c] >> 8 ) );
+			image.transparency.push_back( static_cast<uint8_t>( key[c] ) );
+		}
+	}
+
+	for( int p = 0; p < image.width * image.height; p++ )
+	{
+		int sample[4];
+		bool bKey = bTransparency && Random( 3 ) == 0;
+		for( int c = 0; c < channels; c++ )
+		{
+			sample[c] = colourType == 3 ? Random( paletteSize ) : ( bKey ? key[c] : Random( maxValue + 1 ) );
+			image.samples.push_back( sample[c] );
+		}
+
+		uint32_t argb;
+		if( colourType == 3 )
+		{
+			int i = sample[0];
+			int alpha = i < static_cast<int>( image.transparency.size() ) ? image.transparency[i] : 255;
+			argb = ( alpha << 24 ) | ( image.palette[i * 3] << 16 ) | ( image.palette[i * 3 + 1] << 8 ) | image.palette[i * 3 + 2];
+		}
+		else if( colourType == 0 || colourType == 4 )
+		{
+			int grey = sample[0] * 255 / maxValue;
+			int alpha = colourType == 4 ? sample[1] * 255 / maxValue : ( bTransparency && sample[0] == key[0] ? 0 : 255 );
+			argb = ( alpha << 24 ) | ( grey << 16 ) | ( grey << 8 ) | grey;
+		}
+		else
+		{
+			bool bMatch = bTransparency && sample[0] == key[0] && sample[1] == key[1] && sample[2] == key[2];
+			int alpha = colourType == 6 ? sample[3] * 255 / maxValue : ( bMatch ? 0 : 255 );
+			argb = ( alpha << 24 ) | ( sample[0] * 255 / maxValue << 16 ) | ( sample[1] * 255 / maxValue << 8 ) | ( sample[2] * 255 / maxValue );
+		}
+		image.expected.push_back( argb );
+	}
+
+	return image;
+}
+
+static void CheckDecodes( const TestImage& image, const std::string& name )
+{
+	std::string path = PlayTest::WriteFile( name, EncodePNG( image ) );
+
+	int width = 0, height = 0;
+	PLAY_TEST_CHECK( PlayWindow::ReadPNGImage( path, width, height ) != PLAY_ERROR );
+	PLAY_TEST_CHECK( width == image.width && height == image.height );
+
+	PixelData decoded;
+	PLAY_TEST_CHECK( PlayWindow::LoadPNGImage( path, decoded ) != PLAY_ERROR );
+	if( !decoded.pPixels )
+		return;
+
+	int wrong = 0;
+	for( int i = 0; i < image.width * image.height; i++ )
+		wrong += decoded.pPixels[i].bits != image.expected[i];
+	PLAY_TEST_CHECK( wrong == 0 );
+	if( wrong )
+		fprintf( stderr, "%s: %d of %d pixels wrong\n", name.c_str(), wrong, image.width * image.height );
+
+	delete[] decoded.pPixels;
+}
+
+static void CheckRejected( const std::vector<uint8_t>& bytes, const std::string& name )
+{
+	// Sprite sheets are looked for by their upper case name
+	std::string upperName = name;
+	for( char& c : upperName ) c = static_cast<char>( toupper( c ) );
+	std::string path = PlayTest::WriteFile( upperName, bytes );
+
+	PixelData decoded;
+	PLAY_TEST_CHECK( PlayWindow::LoadPNGImage( path, decoded ) == PLAY_ERROR );
+	PLAY_TEST_CHECK( decoded.pPixels == nullptr );
+	delete[] decoded.pPixels;
+
+	// Loading it as a sprite sheet fails without adding a sprite
+	PlayGraphics& graphics = PlayGraphics::Instance();
+	int sprites = graphics.GetTotalLoadedSprites();
+	PLAY_TEST_CHECK( graphics.LoadSpriteSheet( PlayTest::PNG_DIRECTORY, upperName.substr( 0, upperName.find( '.' ) ) ) == -1 );
+	PLAY_TEST_CHECK( graphics.GetTotalLoadedSprites() == sprites );
+}
+
+void RunTest()
+{
+	// Every combination of colour type and bit depth the PNG specification allows, with and without transparency
+	const int depths[5][5] = { { 1, 2, 4, 8, 16 }, { 0 }, { 8, 16 }, { 1, 2, 4, 8 }, { 8, 16 } };
+	const int types[5] = { 0, 1, 2, 3, 4 };
+
+	for( int t = 0; t < 5; t++ )
+	{
+		if( types[t] == 1 )
+			continue;
+
+		for( int d = 0; d < 5 && depths[t][d]; d++ )
+		{
+			for( int transparency = 0; transparency < 2; transparency++ )
+			{
+				int type = types[t];
+				std::string name = "type" + std::to_string( type ) + "_depth" + std::to_string( depths[t][d] ) + ( transparency ? "_trns.png" : ".png" );
+				CheckDecodes( MakeImage( type, depths[t][d], transparency && type != 4 ), name );
+			}
+		}
+	}
+
+	CheckDecodes( MakeImage( 6, 8, false ), "type6_depth8.png" );
+	CheckDecodes( MakeImage( 6, 16, false ), "type6_depth16.png" );
+
+	// Images larger than one stored deflate block
+	TestImage large = MakeImage( 6, 8, false );
+	large.width = 300;
+	large.height = 90;
+	large.samples.clear();
+	large.expected.clear();
+	for( int p = 0; p < large.width * large.height; p++ )
+	{
+		int r = Random( 256 ), g = Random( 256 ), b = Random( 256 ), a = Random( 256 );
+		large.samples.insert( large.samples.end(), { r, g, b, a } );
+		large.expected.push_back( ( a << 24 ) | ( r << 16 ) | ( g << 8 ) | b );
+	}
+	CheckDecodes( large, "large.png" );
+
+	// Bit depths the colour type doesn't allow
+	TestImage deepPalette = MakeImage( 3, 8, false );
+	deepPalette.bitDepth = 16;
+	for( int& sample : deepPalette.samples )
+		sample |= 0x4000;
+	CheckRejected( EncodePNG( deepPalette ), "palette_depth16.png" );
+
+	TestImage shallowColour = MakeImage( 2, 8, false );
+	shallowColour.bitDepth = 4;
+	for( int& sample : shallowColour.samples )
+		sample &= 15;
+	CheckRejected( EncodePNG( shallowColour ), "rgb_depth4.png" );
+
+	TestImage oddDepth = MakeImage( 0, 8, false );
+	oddDepth.bitDepth = 3;
+	CheckRejected( EncodePNG( oddDepth ), "grey_depth3.png" );
+
+	// Palette indices past the end of the palette
+	TestImage pastPalette = MakeImage( 3, 8, false );
+	pastPalette.palette.resize( 4 * 3 );
+	pastPalette.samples.back() = 4;
+	CheckRejected( EncodePNG( pastPalette ), "palette_index.png" );
+
+	TestImage noPalette = MakeImage( 3, 4, false );
+	noPalette.palette.clear();
+	CheckRejected( EncodePNG( noPalette ), "palette_missing.png" );
+
+	// Sizes which would overflow, or allocate more than the decoder allows, with no data to back them up
+	TestImage huge;
+	huge.width = 0x7FFFFFFF;
+	huge.height = 3;
+	CheckRejected( EncodePNG( huge ), "huge_width.png" );
+	huge.width = 70000;
+	huge.height = 70000;
+	CheckRejected( EncodePNG( huge ), "huge_area.png" );
+	huge.width = 0;
+	huge.height = 10;
+	CheckRejected( EncodePNG( huge ), "zero_width.png" );
+
+	// A filter type which doesn't exist
+	TestImage badFilter = MakeImage( 6, 8, false );
+	badFilter.forceFilter = 5;
+	CheckRejected( EncodePNG( badFilter ), "filter5.png" );
+
+	// Image data which stops short of the rows the header claims
+	std::vector<uint8_t> truncated = EncodePNG( MakeImage( 2, 8, false ) );
+	truncated[23]++; // The low byte of the height
+	CheckRejected( truncated, "truncated.png" );
+
+	// Interlacing isn't supported
+	TestImage interlaced = MakeImage( 6, 8, false );
+	interlaced.interlace = 1;
+	CheckRejected( EncodePNG( interlaced ), "interlaced.png" );
+
+	// Not a PNG file at all
+	CheckRejected( { 'n', 'o', 't', ' ', 'a', ' ', 'p', 'n', 'g' }, "text.png" );
+}
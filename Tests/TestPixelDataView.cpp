@@ -0,0 +1,105 @@
+// Draws into views and strided render targets and checks the result matches drawing into the whole display
+#include "PlayTest.h"
+
+static int s_spriteId = -1;
+
+// Draws a mixture of sprites and shapes relative to an offset
+static void DrawScene( PlayGraphics& graphics, int offsetX, int offsetY )
+{
+	graphics.Draw( s_spriteId, { offsetX + 10.0f, offsetY + 8.0f }, 0 );
+	graphics.DrawTransparent( s_spriteId, { offsetX + 50.0f, offsetY + 30.0f }, 1, 0.5f );
+	graphics.DrawRotated( s_spriteId, { offsetX + 90.0f, offsetY + 20.0f }, 2, 0.8f, 2.0f );
+	graphics.DrawLine( { offsetX + 2.0f, offsetY + 5.0f }, { offsetX + 150.0f, offsetY + 70.0f }, PIX_WHITE );
+	graphics.DrawRect( { offsetX + 20.0f, offsetY + 40.0f }, { offsetX + 60.0f, offsetY + 90.0f }, PIX_GREEN, true );
+	graphics.DrawCircle( { offsetX + 100.0f, offsetY + 50.0f }, 30, PIX_YELLOW );
+}
+
+static bool SameArea( const PixelData& a, const PixelData& b )
+{
+	for( int y = 0; y < a.height; y++ )
+	{
+		for( int x = 0; x < a.width; x++ )
+		{
+			if( a.Row( y )[x].bits != b.Row( y )[x].bits )
+				return false;
+		}
+	}
+	return true;
+}
+
+void RunTest()
+{
+	PlayGraphics& graphics = PlayGraphics::Instance();
+	PixelData* pDisplay = graphics.GetDrawingBuffer();
+
+	PixelData discs = PlayTest::MakeDiscs( 28, 24, 3, 3 );
+	s_spriteId = graphics.AddSprite( "discs_3", discs, 3, 1 );
+	graphics.CentreSpriteOrigin( s_spriteId );
+
+	// The display's rows are aligned to cache lines
+	PLAY_TEST_CHECK( pDisplay->Stride() % 16 == 0 && pDisplay->Stride() >= pDisplay->width );
+	for( int y = 0; y < pDisplay->height; y++ )
+		PLAY_TEST_CHECK( reinterpret_cast<uintptr_t>( pDisplay->Row( y ) ) % 64 == 0 );
+
+	// Drawing into a view of the display is the same as drawing into the display clipped to the view
+	const PixelRect area = { 37, 21, 130, 95 };
+	graphics.ClearBuffer( PIX_BLUE );
+	graphics.PushClipRect( area );
+	DrawScene( graphics, area.x, area.y );
+	graphics.PopClipRect();
+	std::vector<Pixel> expected( pDisplay->pPixels, pDisplay->pPixels + pDisplay->Stride() * pDisplay->height );
+
+	graphics.ClearBuffer( PIX_BLUE );
+	PixelData view = pDisplay->View( area );
+	PixelData* pOldTarget = graphics.SetRenderTarget( &view );
+	DrawScene( graphics, 0, 0 );
+	graphics.SetRenderTarget( pOldTarget );
+
+	int wrong = 0;
+	for( size_t i = 0; i < expected.size(); i++ )
+		wrong += pDisplay->pPixels[i].bits != expected[i].bits;
+	PLAY_TEST_CHECK( wrong == 0 );
+
+	// A render target with padding at the end of each row draws the same as a tightly packed one, and leaves the padding alone
+	std::vector<Pixel> packedPixels( area.width * area.height );
+	PixelData packed;
+	packed.width = area.width;
+	packed.height = area.height;
+	packed.pPixels = packedPixels.data();
+
+	const int padding = 13;
+	std::vector<Pixel> stridedPixels( ( area.width + padding ) * area.height, PIX_MAGENTA );
+	PixelData strided = packed;
+	strided.stride = area.width + padding;
+	strided.pPixels = stridedPixels.data();
+
+	pOldTarget = graphics.SetRenderTarget( &packed );
+	graphics.ClearBuffer( PIX_BLUE );
+	DrawScene( graphics, 0, 0 );
+	graphics.SetRenderTarget( &strided );
+	graphics.ClearBuffer( PIX_BLUE );
+	DrawScene( graphics, 0, 0 );
+	graphics.SetRenderTarget( pOldTarget );
+
+	PLAY_TEST_CHECK( SameArea( packed, strided ) );
+	int paddingChanged = 0;
+	for( int y = 0; y < strided.height; y++ )
+	{
+		for( int x = strided.width; x < strided.stride; x++ )
+			paddingChanged += strided.Row( y )[x].bits != PIX_MAGENTA.bits;
+	}
+	PLAY_TEST_CHECK( paddingChanged == 0 );
+
+	// Views of views share the same pixels
+	PixelData inner = strided.View( { 5, 7, 20, 10 } ).View( { 2, 3, 4, 4 } );
+	PLAY_TEST_CHECK( inner.Row( 0 ) == strided.Row( 10 ) + 7 );
+	PLAY_TEST_CHECK( inner.Stride() == strided.stride );
+
+	// Capturing a view copies just the pixels inside it
+	int captureId = graphics.CaptureToSprite( &view, "view" );
+	PixelData copy = packed;
+	copy.pPixels = new Pixel[area.width * area.height];
+	graphics.CopySpriteFrame( captureId, 0, copy, 0, 0 );
+	PLAY_TEST_CHECK( SameArea( copy, view ) );
+	delete[] copy.pPixels;
+}
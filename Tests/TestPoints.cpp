@@ -0,0 +1,130 @@
+// Draws batches of points and polylines, and checks them against drawing the same pixels and lines one at a time
+#include "PlayTest.h"
+
+static const Pixel TRANSLUCENT( 0x90, 0xFF, 0xC0, 0x40 );
+
+static uint32_t s_random = 77;
+
+static float RandomFloat( float low, float high )
+{
+	s_random = s_random * 1103515245u + 12345u;
+	return low + ( high - low ) * static_cast<float>( s_random >> 8 ) / static_cast<float>( 1 << 24 );
+}
+
+// Draws the points one at a time, in order, as the reference for DrawPoints
+static void DrawPixels( PlayGraphics& graphics, const std::vector<Point2f>& points, const std::vector<Pixel>& colours )
+{
+	for( size_t i = 0; i < points.size(); i++ )
+		graphics.DrawPixel( points[i], colours.size() == 1 ? colours[0] : colours[i] );
+}
+
+// Draws a set of shapes offset by a whole number of pixels
+static void DrawShapes( PlayGraphics& graphics, float offsetX, float offsetY )
+{
+	std::vector<Point2f> points;
+	for( int i = 0; i < 200; i++ )
+		points.push_back( { offsetX + RandomFloat( -3.0f, 12.0f ), offsetY + RandomFloat( -3.0f, 203.0f ) } );
+	graphics.DrawPoints( points, { PIX_WHITE } );
+
+	graphics.DrawLine( { offsetX - 10.7f, offsetY + 5.2f }, { offsetX + 150.4f, offsetY + 70.5f }, PIX_YELLOW );
+	graphics.DrawPolyline( { { offsetX - 0.6f, offsetY - 0.5f }, { offsetX + 60.5f, offsetY - 20.3f }, { offsetX + 30.0f, offsetY + 90.49f } }, PIX_CYAN, true );
+	graphics.DrawRect( { offsetX - 4.5f, offsetY + 100.5f }, { offsetX + 20.7f, offsetY + 120.1f }, PIX_GREEN );
+	graphics.DrawCircle( { offsetX - 0.5f, offsetY + 150.6f }, 15, PIX_MAGENTA, true );
+}
+
+void RunTest()
+{
+	PlayGraphics& graphics = PlayGraphics::Instance();
+	PixelData* pDisplay = graphics.GetDrawingBuffer();
+
+	// Points which round to just off the top left of the display are left out, and halves round up onto it
+	graphics.ClearBuffer( PIX_BLACK );
+	graphics.DrawPoints( { { -0.6f, 5.0f }, { 5.0f, -0.51f }, { -1.0f, -1.0f }, { -0.5f, 7.0f }, { 9.0f, -0.5f }, { 12.49f, 13.5f } }, { PIX_WHITE } );
+	PLAY_TEST_CHECK( pDisplay->Row( 5 )[0].bits == PIX_BLACK.bits );
+	PLAY_TEST_CHECK( pDisplay->Row( 0 )[5].bits == PIX_BLACK.bits );
+	PLAY_TEST_CHECK( pDisplay->Row( 0 )[0].bits == PIX_BLACK.bits );
+	PLAY_TEST_CHECK( pDisplay->Row( 7 )[0].bits == PIX_WHITE.bits );
+	PLAY_TEST_CHECK( pDisplay->Row( 0 )[9].bits == PIX_WHITE.bits );
+	PLAY_TEST_CHECK( pDisplay->Row( 14 )[12].bits == PIX_WHITE.bits );
+
+	// Translucent points which land on the same pixel blend in the order they were given, however they are sorted into rows
+	std::vector<Point2f> points;
+	std::vector<Pixel> colours;
+	for( int i = 0; i < 5000; i++ )
+	{
+		points.push_back( { RandomFloat( -20.0f, 340.0f ), RandomFloat( -20.0f, 220.0f ) } );
+		if( i % 4 == 0 )
+			points.back() = { 100.0f + ( i % 7 ), 50.0f + ( i % 3 ) };
+		colours.push_back( Pixel( 0x40 + ( i % 0xA0 ), ( i * 13 ) & 0xFF, ( i * 29 ) & 0xFF, ( i * 7 ) & 0xFF ) );
+	}
+
+	const PixelRect clips[] = { { 0, 0, TEST_DISPLAY_WIDTH, TEST_DISPLAY_HEIGHT }, { 90, 45, 20, 10 }, { -30, 150, 100, 100 } };
+	for( const PixelRect& clip : clips )
+	{
+		graphics.PushClipRect( clip );
+		graphics.SetCameraPosition( { clip.x / 3.0f, 0.0f } );
+
+		graphics.ClearBuffer( PIX_BLACK );
+		DrawPixels( graphics, points, colours );
+		uint64_t expected = PlayTest::Hash( *pDisplay );
+
+		graphics.ClearBuffer( PIX_BLACK );
+		graphics.DrawPoints( points, colours );
+		PLAY_TEST_CHECK( PlayTest::Hash( *pDisplay ) == expected );
+
+		graphics.ClearBuffer( PIX_BLACK );
+		DrawPixels( graphics, points, { TRANSLUCENT } );
+		expected = PlayTest::Hash( *pDisplay );
+
+		graphics.ClearBuffer( PIX_BLACK );
+		graphics.DrawPoints( points, { TRANSLUCENT } );
+		PLAY_TEST_CHECK( PlayTest::Hash( *pDisplay ) == expected );
+
+		graphics.SetCameraPosition( { 0.0f, 0.0f } );
+		graphics.PopClipRect();
+	}
+
+	// The wrong number of colours draws nothing
+	graphics.ClearBuffer( PIX_BLACK );
+	uint64_t empty = PlayTest::Hash( *pDisplay );
+	graphics.DrawPoints( points, { PIX_WHITE, PIX_RED } );
+	graphics.DrawPoints( points, {} );
+	PLAY_TEST_CHECK( PlayTest::Hash( *pDisplay ) == empty );
+
+	// A translucent polyline draws its joins once, so it matches the union of its lines drawn in an opaque colour
+	// > The turns are all gentle enough that neighbouring lines only share the pixel where they join
+	const std::vector<Point2f> path = { { 10.2f, 150.0f }, { 60.0f, 40.6f }, { 150.0f, 20.0f }, { 150.0f, 20.0f }, { 280.0f, 60.3f }, { 300.0f, 160.0f }, { 150.0f, 190.0f } };
+	for( int closed = 0; closed < 2; closed++ )
+	{
+		graphics.ClearBuffer( PIX_BLACK );
+		for( size_t i = 0; i + 1 < path.size(); i++ )
+			graphics.DrawLine( path[i], path[i + 1], PIX_WHITE );
+		if( closed )
+			graphics.DrawLine( path.back(), path.front(), PIX_WHITE );
+		std::vector<Pixel> opaque( pDisplay->pPixels, pDisplay->pPixels + pDisplay->Stride() * pDisplay->height );
+
+		graphics.ClearBuffer( PIX_BLACK );
+		graphics.DrawPixel( { 0, 0 }, TRANSLUCENT );
+		Pixel blendedOnce = pDisplay->Row( 0 )[0];
+
+		graphics.ClearBuffer( PIX_BLACK );
+		graphics.DrawPolyline( path, TRANSLUCENT, closed != 0 );
+		int wrong = 0;
+		for( size_t i = 0; i < opaque.size(); i++ )
+			wrong += pDisplay->pPixels[i].bits != ( opaque[i].bits == PIX_WHITE.bits ? blendedOnce.bits : PIX_BLACK.bits );
+		PLAY_TEST_CHECK( wrong == 0 );
+	}
+
+	// Moving the shapes and the camera by the same whole number of pixels draws the same pixels, even across the edges
+	s_random = 5;
+	graphics.ClearBuffer( PIX_BLACK );
+	DrawShapes( graphics, 0.0f, 0.0f );
+	uint64_t unmoved = PlayTest::Hash( *pDisplay );
+
+	s_random = 5;
+	graphics.SetCameraPosition( { -37.0f, -23.0f } );
+	graphics.ClearBuffer( PIX_BLACK );
+	DrawShapes( graphics, -37.0f, -23.0f );
+	graphics.SetCameraPosition( { 0.0f, 0.0f } );
+	PLAY_TEST_CHECK( PlayTest::Hash( *pDisplay ) == unmoved );
+}
@@ -0,0 +1,220 @@
+// Applies the post-process passes to known frames and checks the results, and that the worker threads split them and shut down
+#include "PlayTest.h"
+
+static const int GRADE_SIZE = 17;
+
+// Fills the display buffer with a pattern of gradients and edges (with the given alpha)
+static void FillPattern( PixelData& display, int alpha )
+{
+	for( int y = 0; y < display.height; y++ )
+	{
+		for( int x = 0; x < display.width; x++ )
+			display.Row( y )[x] = Pixel( alpha, ( x * 3 + ( ( y / 20 ) % 2 ) * 120 ) & 0xFF, ( y * 5 ) & 0xFF, ( ( x / 8 + y / 8 ) % 2 ) * 200 + 20 );
+	}
+}
+
+static std::vector<Pixel> CopyDisplay( const PixelData& display )
+{
+	std::vector<Pixel> pixels;
+	for( int y = 0; y < display.height; y++ )
+		pixels.insert( pixels.end(), display.Row( y ), display.Row( y ) + display.width );
+	return pixels;
+}
+
+// Gets the largest difference in any channel (including alpha) between two frames
+static int Difference( const std::vector<Pixel>& a, const std::vector<Pixel>& b )
+{
+	int worst = 0;
+	for( size_t i = 0; i < a.size(); i++ )
+		worst = std::max( { worst, std::abs( a[i].a - b[i].a ), std::abs( a[i].r - b[i].r ), std::abs( a[i].g - b[i].g ), std::abs( a[i].b - b[i].b ) } );
+	return worst;
+}
+
+// Box blurs an image along one direction, repeating the edge pixels beyond the edges and rounding each channel
+static std::vector<Pixel> BoxBlur( const std::vector<Pixel>& image, int width, int height, int radius, bool vertical )
+{
+	std::vector<Pixel> blurred( image.size() );
+	for( int y = 0; y < height; y++ )
+	{
+		for( int x = 0; x < width; x++ )
+		{
+			int sums[4] = { 0, 0, 0, 0 };
+			for( int i = -radius; i <= radius; i++ )
+			{
+				int sx = vertical ? x : std::min( std::max( x + i, 0 ), width - 1 );
+				int sy = vertical ? std::min( std::max( y + i, 0 ), height - 1 ) : y;
+				Pixel pix = image[sy * width + sx];
+				sums[0] += pix.a;
+				sums[1] += pix.r;
+				sums[2] += pix.g;
+				sums[3] += pix.b;
+			}
+			int count = ( radius * 2 ) + 1;
+			blurred[y * width + x] = Pixel( ( sums[0] + radius ) / count, ( sums[1] + radius ) / count, ( sums[2] + radius ) / count, ( sums[3] + radius ) / count );
+		}
+	}
+	return blurred;
+}
+
+// Makes a colour grade lookup table, which leaves colours as they are or swaps red and blue
+static PixelData MakeGrade( std::vector<Pixel>& pixels, bool swapRedBlue )
+{
+	pixels.resize( GRADE_SIZE * GRADE_SIZE * GRADE_SIZE );
+	PixelData table;
+	table.width = GRADE_SIZE * GRADE_SIZE;
+	table.height = GRADE_SIZE;
+	table.pPixels = pixels.data();
+	for( int green = 0; green < GRADE_SIZE; green++ )
+	{
+		for( int blue = 0; blue < GRADE_SIZE; blue++ )
+		{
+			for( int red = 0; red < GRADE_SIZE; red++ )
+			{
+				int r = ( ( red * 255 ) + ( GRADE_SIZE / 2 ) ) / ( GRADE_SIZE - 1 );
+				int g = ( ( green * 255 ) + ( GRADE_SIZE / 2 ) ) / ( GRADE_SIZE - 1 );
+				int b = ( ( blue * 255 ) + ( GRADE_SIZE / 2 ) ) / ( GRADE_SIZE - 1 );
+				table.Row( green )[( blue * GRADE_SIZE ) + red] = swapRedBlue ? Pixel( 0xFF, b, g, r ) : Pixel( 0xFF, r, g, b );
+			}
+		}
+	}
+	return table;
+}
+
+// Counts the threads in this process
+static int CountThreads()
+{
+	int count = 0;
+	for( const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator( "/proc/self/task" ) )
+	{
+		UNREFERENCED_PARAMETER( entry );
+		count++;
+	}
+	return count;
+}
+
+// Runs the post-process passes on the pattern with no worker threads and then with several, which must give the same frame
+static bool SameWithWorkers( PlayGraphics& graphics, std::vector<Pixel>& frame )
+{
+	PixelData* pDisplay = graphics.GetDrawingBuffer();
+	graphics.SetWorkerThreads( 0 );
+	FillPattern( *pDisplay, 0xFF );
+	graphics.EndFrame();
+	frame = CopyDisplay( *pDisplay );
+
+	graphics.SetWorkerThreads( 5 );
+	FillPattern( *pDisplay, 0xFF );
+	graphics.EndFrame();
+	return Difference( frame, CopyDisplay( *pDisplay ) ) == 0;
+}
+
+void RunTest()
+{
+	PlayGraphics& graphics = PlayGraphics::Instance();
+	PixelData* pDisplay = graphics.GetDrawingBuffer();
+	const int width = pDisplay->width;
+	const int height = pDisplay->height;
+	const int threads = CountThreads();
+
+	// Nothing changes until the passes are turned on, and then only when the frame ends
+	FillPattern( *pDisplay, 0xFF );
+	std::vector<Pixel> pattern = CopyDisplay( *pDisplay );
+	graphics.EndFrame();
+	PLAY_TEST_CHECK( Difference( CopyDisplay( *pDisplay ), pattern ) == 0 );
+
+	PostProcessSettings settings;
+	settings.blurRadius = 3;
+	settings.blurPasses = 2;
+	graphics.SetPostProcess( true, settings );
+	graphics.SetWorkerThreads( 0 );
+	FillPattern( *pDisplay, 0xFF );
+	PLAY_TEST_CHECK( Difference( CopyDisplay( *pDisplay ), pattern ) == 0 );
+
+	// The blur is a box blur of the rows and then the columns, once for each pass
+	std::vector<Pixel> expected = pattern;
+	for( int pass = 0; pass < 2; pass++ )
+		expected = BoxBlur( BoxBlur( expected, width, height, 3, false ), width, height, 3, true );
+	graphics.EndFrame();
+	PLAY_TEST_CHECK( Difference( CopyDisplay( *pDisplay ), expected ) <= 1 );
+
+	// Splitting the rows between worker threads gives exactly the same frame
+	std::vector<Pixel> frame;
+	PLAY_TEST_CHECK( SameWithWorkers( graphics, frame ) );
+	PLAY_TEST_CHECK( graphics.GetWorkerThreads() == 5 && CountThreads() == threads + 5 );
+
+	// Bloom makes bright areas glow into the dark areas around them, but leaves areas which aren't bright enough alone
+	settings = PostProcessSettings();
+	settings.bloom = true;
+	settings.bloomThreshold = 128;
+	settings.bloomRadius = 4;
+	graphics.SetPostProcess( true, settings );
+	graphics.ClearBuffer( Pixel( 0xFF, 0x7F, 0x40, 0x10 ) );
+	graphics.EndFrame();
+	PLAY_TEST_CHECK( pDisplay->Row( 100 )[160].bits == Pixel( 0xFF, 0x7F, 0x40, 0x10 ).bits );
+
+	graphics.ClearBuffer( PIX_BLACK );
+	graphics.DrawRect( { 100.0f, 80.0f }, { 140.0f, 120.0f }, PIX_WHITE, true );
+	graphics.EndFrame();
+	PLAY_TEST_CHECK( pDisplay->Row( 100 )[120].bits == PIX_WHITE.bits );
+	PLAY_TEST_CHECK( pDisplay->Row( 100 )[145].r > 0 && pDisplay->Row( 100 )[145].r == pDisplay->Row( 100 )[145].b );
+	PLAY_TEST_CHECK( pDisplay->Row( 100 )[145].r > pDisplay->Row( 100 )[150].r && pDisplay->Row( 74 )[120].g > 0 );
+	PLAY_TEST_CHECK( pDisplay->Row( 100 )[200].bits == PIX_BLACK.bits && pDisplay->Row( 20 )[120].bits == PIX_BLACK.bits );
+
+	settings.bloomStrength = 0.0f;
+	graphics.SetPostProcess( true, settings );
+	FillPattern( *pDisplay, 0xFF );
+	graphics.EndFrame();
+	PLAY_TEST_CHECK( Difference( CopyDisplay( *pDisplay ), pattern ) == 0 );
+
+	settings.bloomStrength = 2.5f;
+	settings.bloomThreshold = 100;
+	graphics.SetPostProcess( true, settings );
+	PLAY_TEST_CHECK( SameWithWorkers( graphics, frame ) );
+	PLAY_TEST_CHECK( Difference( frame, pattern ) > 0 );
+
+	// The colour grade looks colours up in the table, keeping the frame's alpha
+	std::vector<Pixel> tablePixels;
+	graphics.SetColourGrade( MakeGrade( tablePixels, false ) );
+	settings = PostProcessSettings();
+	settings.colourGrade = true;
+	graphics.SetPostProcess( true, settings );
+	FillPattern( *pDisplay, 0x80 );
+	std::vector<Pixel> translucent = CopyDisplay( *pDisplay );
+	graphics.EndFrame();
+	PLAY_TEST_CHECK( Difference( CopyDisplay( *pDisplay ), translucent ) <= 1 );
+
+	graphics.SetColourGrade( MakeGrade( tablePixels, true ) );
+	FillPattern( *pDisplay, 0x80 );
+	graphics.EndFrame();
+	for( Pixel& pix : translucent )
+		pix = Pixel( pix.a, pix.b, pix.g, pix.r );
+	PLAY_TEST_CHECK( Difference( CopyDisplay( *pDisplay ), translucent ) <= 1 );
+	PLAY_TEST_CHECK( SameWithWorkers( graphics, frame ) );
+
+	// All the passes together still split between the workers exactly
+	settings.blurRadius = 2;
+	settings.bloom = true;
+	graphics.SetPostProcess( true, settings );
+	PLAY_TEST_CHECK( SameWithWorkers( graphics, frame ) );
+
+	// Turning the passes off leaves frames alone, with the workers kept for next time
+	graphics.SetPostProcess( false );
+	FillPattern( *pDisplay, 0xFF );
+	graphics.EndFrame();
+	PLAY_TEST_CHECK( Difference( CopyDisplay( *pDisplay ), pattern ) == 0 );
+	PLAY_TEST_CHECK( graphics.GetWorkerThreads() == 5 );
+
+	// The workers stop when there are to be none, and start again the next time they're needed
+	graphics.SetWorkerThreads( 0 );
+	PLAY_TEST_CHECK( graphics.GetWorkerThreads() == 0 && CountThreads() == threads );
+	graphics.SetWorkerThreads( 3 );
+	PLAY_TEST_CHECK( graphics.GetWorkerThreads() == 0 );
+	graphics.SetPostProcess( true, settings );
+	PLAY_TEST_CHECK( graphics.GetWorkerThreads() == 3 && CountThreads() == threads + 3 );
+
+	// Destroying the PlayGraphics straight after a frame stops every worker
+	FillPattern( *pDisplay, 0xFF );
+	graphics.EndFrame();
+	PlayGraphics::Destroy();
+	PLAY_TEST_CHECK( CountThreads() == threads );
+	PlayGraphics::Instance( TEST_DISPLAY_WIDTH, TEST_DISPLAY_HEIGHT, PLAY_TEST_DIRECTORY );
+}
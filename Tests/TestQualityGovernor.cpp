@@ -0,0 +1,92 @@
+// Drives the quality governor with slow and fast frames and checks the quality level and the knobs which follow it
+#include "PlayTest.h"
+
+// The target frame time, with slow frames well over it and fast frames well under it
+static const float TARGET_MILLISECS = 20.0f;
+static const float SLOW_MILLISECS = 40.0f;
+// Under the target but over the fraction of it (0.8) which the average has to drop below before the level goes up
+static const float NEAR_TARGET_MILLISECS = 16.5f;
+
+// Runs a frame, telling EndFrame exactly how long it took rather than letting it measure the time
+static void RunFrame( PlayGraphics& graphics, float millisecs )
+{
+	graphics.EndFrame( millisecs );
+}
+
+// Runs a frame and checks the average frame time and the quality level moved as they should
+// > The average moves a tenth of the way to each frame's time, and the level drops while the average is over the target,
+//   climbs slowly while it is under 80% of it, and otherwise stays put
+static bool RunCheckedFrame( PlayGraphics& graphics, float millisecs )
+{
+	float level = graphics.GetQualityLevel();
+	float average = graphics.GetAverageFrameTime();
+	average = average + ( ( millisecs - average ) * 0.1f );
+	RunFrame( graphics, millisecs );
+
+	if( average > TARGET_MILLISECS )
+		level = std::max( level - 0.05f, 0.0f );
+	else if( average < TARGET_MILLISECS * 0.8f )
+		level = std::min( level + 0.01f, 1.0f );
+
+	return graphics.GetAverageFrameTime() == average && graphics.GetQualityLevel() == level && graphics.GetFrameHeadroom() == TARGET_MILLISECS - average;
+}
+
+void RunTest()
+{
+	PlayGraphics& graphics = PlayGraphics::Instance();
+
+	// The quality level stays at the highest until the governor is turned on
+	graphics.AddQualityKnob( "spawn rate", 1.0f, 9.0f );
+	graphics.AddQualityKnob( "sparks", 50.0f, 10.0f );
+	for( int i = 0; i < 3; i++ )
+		RunFrame( graphics, SLOW_MILLISECS );
+	PLAY_TEST_CHECK( graphics.GetQualityLevel() == 1.0f && graphics.GetQualityKnob( "spawn rate" ) == 9.0f );
+
+	graphics.SetQualityGovernor( true, TARGET_MILLISECS );
+	PLAY_TEST_CHECK( graphics.GetTargetFrameTime() == TARGET_MILLISECS && graphics.GetQualityLevel() == 1.0f );
+
+	// Slow frames drop the level quickly, down to the lowest
+	for( int i = 0; i < 25; i++ )
+		PLAY_TEST_CHECK( RunCheckedFrame( graphics, SLOW_MILLISECS ) );
+	PLAY_TEST_CHECK( graphics.GetQualityLevel() == 0.0f && graphics.GetFrameHeadroom() < 0.0f );
+	PLAY_TEST_CHECK( graphics.GetQualityKnob( "spawn rate" ) == 1.0f && graphics.GetQualityKnob( "sparks" ) == 50.0f );
+
+	// Fast frames raise it slowly once the average has come down, up to the highest
+	// > The average is under 80% of the target from the ninth fast frame, and from there the level climbs 0.01 a frame (with
+	//   rounding leaving it just short of the highest after a hundred of them)
+	int frames = 0;
+	for( ; frames < 200 && graphics.GetQualityLevel() < 1.0f; frames++ )
+		PLAY_TEST_CHECK( RunCheckedFrame( graphics, 0.0f ) );
+	PLAY_TEST_CHECK( graphics.GetQualityLevel() == 1.0f && frames == 109 && graphics.GetFrameHeadroom() > 0.0f );
+	for( int i = 0; i < 5; i++ )
+		PLAY_TEST_CHECK( RunCheckedFrame( graphics, 0.0f ) );
+	PLAY_TEST_CHECK( graphics.GetQualityKnob( "spawn rate" ) == 9.0f && graphics.GetQualityKnob( "sparks" ) == 10.0f );
+
+	// The average frame time is smoothed, so a few slow frames after fast ones don't lower the level at all
+	for( int i = 0; i < 3; i++ )
+		PLAY_TEST_CHECK( RunCheckedFrame( graphics, SLOW_MILLISECS ) );
+	PLAY_TEST_CHECK( graphics.GetQualityLevel() == 1.0f );
+
+	// Knobs follow the level in a straight line between their values, and adding one again replaces them
+	for( int i = 0; i < 7; i++ )
+		PLAY_TEST_CHECK( RunCheckedFrame( graphics, SLOW_MILLISECS ) );
+	float level = graphics.GetQualityLevel();
+	PLAY_TEST_CHECK( level > 0.0f && level < 1.0f );
+	PLAY_TEST_CHECK( graphics.GetQualityKnob( "spawn rate" ) == 1.0f + ( 8.0f * level ) );
+	graphics.AddQualityKnob( "spawn rate", 100.0f, 200.0f );
+	PLAY_TEST_CHECK( graphics.GetQualityKnob( "spawn rate" ) == 100.0f + ( 100.0f * level ) );
+
+	// Frames just under the target leave the level where it is once the average has settled, so it doesn't keep changing
+	for( int i = 0; i < 40; i++ )
+		PLAY_TEST_CHECK( RunCheckedFrame( graphics, NEAR_TARGET_MILLISECS ) );
+	level = graphics.GetQualityLevel();
+	for( int i = 0; i < 40; i++ )
+		PLAY_TEST_CHECK( RunCheckedFrame( graphics, NEAR_TARGET_MILLISECS ) );
+	PLAY_TEST_CHECK( graphics.GetQualityLevel() == level && level > 0.0f );
+
+	// Turning it off goes back to the highest level, whatever the frame time
+	graphics.SetQualityGovernor( false );
+	for( int i = 0; i < 3; i++ )
+		RunFrame( graphics, SLOW_MILLISECS );
+	PLAY_TEST_CHECK( graphics.GetQualityLevel() == 1.0f && graphics.GetQualityKnob( "sparks" ) == 10.0f );
+}
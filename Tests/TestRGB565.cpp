@@ -0,0 +1,202 @@
+// Draws scenes into a 16-bit display buffer and checks the presented frames against the same scenes drawn in 32 bits
+#include "PlayTest.h"
+
+static int s_discsId = -1;
+static int s_blockId = -1;
+static int s_backgroundId = -1;
+
+// Makes a fully opaque sprite with a gradient in each frame
+static int AddBlock( PlayGraphics& graphics, int size )
+{
+	PixelData canvas;
+	canvas.width = size * 2;
+	canvas.height = size;
+	canvas.pPixels = new Pixel[canvas.width * canvas.height];
+	for( int y = 0; y < canvas.height; y++ )
+	{
+		for( int x = 0; x < canvas.width; x++ )
+			canvas.pPixels[y * canvas.width + x] = Pixel( 0xFF, x * 2, y * 3, ( x * 5 + y ) & 0xFF );
+	}
+	return graphics.AddSprite( "block_2", canvas, 2, 1 );
+}
+
+static int AddBackground( PlayGraphics& graphics )
+{
+	std::vector<Pixel> pixels( TEST_DISPLAY_WIDTH * TEST_DISPLAY_HEIGHT );
+	PixelData image;
+	image.width = TEST_DISPLAY_WIDTH;
+	image.height = TEST_DISPLAY_HEIGHT;
+	image.pPixels = pixels.data();
+	for( int y = 0; y < image.height; y++ )
+	{
+		for( int x = 0; x < image.width; x++ )
+			image.pPixels[y * image.width + x] = Pixel( 0xFF, ( x * 4 / 5 ) & 0xFF, y, ( x + y ) & 0xFF );
+	}
+	return graphics.LoadBackground( PlayTest::WritePNG( "background.png", image ).c_str() );
+}
+
+// Draws a scene where every pixel ends up with an opaque colour written over whatever was there
+static void DrawOpaqueScene( PlayGraphics& graphics )
+{
+	graphics.ClearBuffer( Pixel( 0xFF, 0x37, 0x81, 0xC5 ) );
+	graphics.PushClipRect( { 0, 0, TEST_DISPLAY_WIDTH, 150 } );
+	graphics.DrawBackground( s_backgroundId );
+	graphics.PopClipRect();
+	graphics.Draw( s_blockId, { 20.0f, 30.0f }, 0 );
+	graphics.Draw( s_blockId, { 290.0f, 170.0f }, 1 );
+	graphics.DrawRect( { 100.0f, 60.0f }, { 180.0f, 120.0f }, Pixel( 0xFF, 0x90, 0x10, 0x65 ), true );
+	graphics.DrawLine( { -10.0f, 190.0f }, { 330.0f, 10.0f }, PIX_WHITE );
+	graphics.DrawCircle( { 200.0f, 100.0f }, 50, Pixel( 0xFF, 0x12, 0xEE, 0x7B ) );
+	graphics.DrawPixel( { 5.0f, 5.0f }, Pixel( 0xFF, 0x81, 0x82, 0x83 ) );
+}
+
+// Draws a scene which blends translucent sprites and shapes over each other
+// > The sprites are drawn with an alpha multiply, as without one the 32-bit blend only keeps the top 4 bits of the background
+static void DrawTranslucentScene( PlayGraphics& graphics )
+{
+	DrawOpaqueScene( graphics );
+	for( int i = 0; i < 40; i++ )
+		graphics.DrawTransparent( s_discsId, { ( i * 53 ) % 340 - 10.0f, ( i * 31 ) % 220 - 10.0f }, i % 3, 0.9f );
+	graphics.DrawTransparent( s_blockId, { 60.0f, 90.0f }, 1, 0.4f );
+	graphics.DrawRotated( s_discsId, { 250.0f, 60.0f }, 2, 0.7f, 1.5f, 0.6f );
+	graphics.DrawRect( { 30.0f, 120.0f }, { 150.0f, 190.0f }, Pixel( 0x70, 0xFF, 0x40, 0x00 ), true );
+	graphics.DrawCircle( { 160.0f, 100.0f }, 80, Pixel( 0x90, 0x00, 0xFF, 0x80 ), true );
+}
+
+// Draws the scene's sprites without an alpha multiply
+static void DrawSpriteScene( PlayGraphics& graphics )
+{
+	DrawOpaqueScene( graphics );
+	for( int i = 0; i < 40; i++ )
+		graphics.Draw( s_discsId, { ( i * 53 ) % 340 - 10.0f, ( i * 31 ) % 220 - 10.0f }, i % 3 );
+}
+
+// Draws the sprite scene with translucent shapes over it
+static void DrawBlendedScene( PlayGraphics& graphics )
+{
+	DrawSpriteScene( graphics );
+	graphics.DrawRect( { 30.0f, 120.0f }, { 150.0f, 190.0f }, Pixel( 0x70, 0xFF, 0x40, 0x00 ), true );
+	graphics.DrawCircle( { 160.0f, 100.0f }, 80, Pixel( 0x90, 0x00, 0xFF, 0x80 ), true );
+}
+
+// Gets the largest difference in any channel between two frames, and the total of the differences (to show any bias)
+static int Difference( const std::vector<Pixel>& full, const std::vector<Pixel>& sixteen, int64_t& total )
+{
+	int worst = 0;
+	total = 0;
+	for( size_t i = 0; i < full.size(); i++ )
+	{
+		const int differences[3] = { full[i].r - sixteen[i].r, full[i].g - sixteen[i].g, full[i].b - sixteen[i].b };
+		for( int difference : differences )
+		{
+			worst = std::max( worst, std::abs( difference ) );
+			total += difference;
+		}
+	}
+	return worst;
+}
+
+static std::vector<Pixel> CopyDisplay()
+{
+	const PixelData* pDisplay = PlayGraphics::Instance().GetDrawingBuffer();
+	std::vector<Pixel> pixels;
+	for( int y = 0; y < pDisplay->height; y++ )
+		pixels.insert( pixels.end(), pDisplay->Row( y ), pDisplay->Row( y ) + pDisplay->width );
+	return pixels;
+}
+
+// Draws a scene in 32 bits and then in 16 bits, returning both presented frames
+static void DrawBothWays( PlayGraphics& graphics, void ( *drawScene )( PlayGraphics& ), std::vector<Pixel>& full, std::vector<Pixel>& sixteen )
+{
+	drawScene( graphics );
+	graphics.EndFrame();
+	full = CopyDisplay();
+
+	graphics.SetDisplayFormat( PIXEL_FORMAT_RGB565 );
+	drawScene( graphics );
+	graphics.EndFrame();
+	sixteen = CopyDisplay();
+	graphics.SetDisplayFormat( PIXEL_FORMAT_ARGB );
+}
+
+void RunTest()
+{
+	PlayGraphics& graphics = PlayGraphics::Instance();
+	PixelData* pDisplay = graphics.GetDrawingBuffer();
+
+	PixelData discs = PlayTest::MakeDiscs( 32, 32, 3, 11 );
+	s_discsId = graphics.AddSprite( "discs_3", discs, 3, 1 );
+	s_blockId = AddBlock( graphics, 24 );
+	s_backgroundId = AddBackground( graphics );
+
+	// Opaque pixels are the 32-bit colour dithered to 16 bits (where it is drawn) and expanded again
+	std::vector<Pixel> full, sixteen;
+	DrawBothWays( graphics, DrawOpaqueScene, full, sixteen );
+	int wrong = 0;
+	for( int y = 0; y < TEST_DISPLAY_HEIGHT; y++ )
+	{
+		for( int x = 0; x < TEST_DISPLAY_WIDTH; x++ )
+			wrong += sixteen[y * TEST_DISPLAY_WIDTH + x].bits != PlayBlitter::UnpackPixel565( PlayBlitter::PackPixel565( full[y * TEST_DISPLAY_WIDTH + x].bits, x, y ) );
+	}
+	PLAY_TEST_CHECK( wrong == 0 );
+
+	// Without an alpha multiply the 16-bit blend uses the whole background, so it can differ from the 32-bit blend by more
+	int64_t total = 0;
+	DrawBothWays( graphics, DrawSpriteScene, full, sixteen );
+	PLAY_TEST_CHECK( Difference( full, sixteen, total ) <= 48 );
+
+	// Blended pixels are blended with the 16-bit colour behind them, so they stay within a couple of 5-bit steps of the 32-bit
+	// blend, and the dithering keeps them from drifting lighter or darker overall
+	DrawBothWays( graphics, DrawTranslucentScene, full, sixteen );
+	PLAY_TEST_CHECK( Difference( full, sixteen, total ) <= 16 );
+	PLAY_TEST_CHECK( std::abs( total ) < static_cast<int64_t>( full.size() ) );
+
+	// Runs of pixels are filled and blended eight at a time, giving exactly the pixels blended one at a time when each
+	// column is drawn on its own
+	graphics.SetDisplayFormat( PIXEL_FORMAT_RGB565 );
+	DrawBlendedScene( graphics );
+	graphics.EndFrame();
+	uint64_t whole = PlayTest::Hash( *pDisplay );
+	for( int x = 0; x < TEST_DISPLAY_WIDTH; x++ )
+	{
+		graphics.PushClipRect( { x, 0, 1, TEST_DISPLAY_HEIGHT } );
+		DrawBlendedScene( graphics );
+		graphics.PopClipRect();
+	}
+	graphics.EndFrame();
+	PLAY_TEST_CHECK( PlayTest::Hash( *pDisplay ) == whole );
+
+	// Dithering keeps the average of a colour which can't be stored in 16 bits
+	const Pixel flat( 0xFF, 0x83, 0x45, 0x6A );
+	graphics.ClearBuffer( flat );
+	graphics.EndFrame();
+	int sums[3] = { 0, 0, 0 };
+	for( int y = 0; y < 4; y++ )
+	{
+		for( int x = 0; x < 4; x++ )
+		{
+			Pixel pix = pDisplay->Row( 40 + y )[80 + x];
+			sums[0] += pix.r;
+			sums[1] += pix.g;
+			sums[2] += pix.b;
+		}
+	}
+	PLAY_TEST_CHECK( std::abs( sums[0] - ( flat.r * 16 ) ) <= 16 && std::abs( sums[1] - ( flat.g * 16 ) ) <= 16 && std::abs( sums[2] - ( flat.b * 16 ) ) <= 16 );
+
+	// The 32-bit display buffer is only written when the frame ends
+	uint64_t before = PlayTest::Hash( *pDisplay );
+	DrawTranslucentScene( graphics );
+	PLAY_TEST_CHECK( PlayTest::Hash( *pDisplay ) == before );
+	graphics.EndFrame();
+	PLAY_TEST_CHECK( PlayTest::Hash( *pDisplay ) != before );
+
+	// Going back to 32 bits draws straight into the display buffer again
+	graphics.SetDisplayFormat( PIXEL_FORMAT_ARGB );
+	PLAY_TEST_CHECK( graphics.GetDisplayFormat() == PIXEL_FORMAT_ARGB );
+	DrawTranslucentScene( graphics );
+	std::vector<Pixel> direct = CopyDisplay();
+	wrong = 0;
+	for( size_t i = 0; i < full.size(); i++ )
+		wrong += direct[i].bits != full[i].bits;
+	PLAY_TEST_CHECK( wrong == 0 );
+}
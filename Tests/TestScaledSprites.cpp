@@ -0,0 +1,128 @@
+// Draws unrotated sprites scaled and checks they sample the nearest pixel, skip transparent runs and get faster as the scale falls
+#include "PlayTest.h"
+#include <chrono>
+
+static const int FRAME_WIDTH = 24;
+static const int FRAME_HEIGHT = 20;
+static const int ORIGIN_X = 8;
+static const int ORIGIN_Y = 6;
+
+// Makes a frame of 2x2 blocks, with runs of transparent and translucent blocks, repeating each block the given number of times
+static PixelData MakeBlocks( int repeat )
+{
+	PixelData canvas;
+	canvas.width = FRAME_WIDTH * repeat;
+	canvas.height = FRAME_HEIGHT * repeat;
+	canvas.pPixels = new Pixel[canvas.width * canvas.height];
+
+	for( int y = 0; y < canvas.height; y++ )
+	{
+		for( int x = 0; x < canvas.width; x++ )
+		{
+			int bx = x / ( 2 * repeat );
+			int by = y / ( 2 * repeat );
+			int c = ( bx * 5 + by * 3 ) % 7;
+			int alpha = ( c < 2 ) ? 0x00 : ( ( c == 4 ) ? 0x80 : 0xFF );
+			canvas.pPixels[y * canvas.width + x] = Pixel( alpha, bx * 20, by * 25, c * 36 );
+		}
+	}
+	return canvas;
+}
+
+// Draws the sprite across the edges of the display and the clipping rectangle, with and without an alpha multiply
+// > Sprites which aren't scaled are drawn without DrawRotated, so they are blitted directly (unless the resolution is reduced)
+static void DrawSprites( PlayGraphics& graphics, int spriteId, float scale )
+{
+	graphics.ClearBuffer( PIX_BLUE );
+	graphics.PushClipRect( { 20, 14, 260, 160 } );
+	for( int i = 0; i < 6; i++ )
+	{
+		Point2f pos = { 16.0f + i * 56, 20.0f };
+		Point2f transparentPos = { 4.0f + i * 60, 170.0f };
+		if( scale == 1.0f )
+		{
+			graphics.Draw( spriteId, pos, 0 );
+			graphics.DrawTransparent( spriteId, transparentPos, 0, 0.5f );
+		}
+		else
+		{
+			graphics.DrawRotated( spriteId, pos, 0, 0.0f, scale );
+			graphics.DrawRotated( spriteId, transparentPos, 0, 0.0f, scale, 0.5f );
+		}
+	}
+	graphics.PopClipRect();
+	graphics.DrawRotated( spriteId, { 316.0f, 100.0f }, 0, 0.0f, scale );
+}
+
+// Draws lots of sprites at the given resolution scale, returning how long the frame took (in milliseconds)
+static double FrameTime( PlayGraphics& graphics, int spriteId, float scale )
+{
+	DynamicResolutionSettings settings;
+	settings.minScale = scale;
+	settings.maxScale = scale;
+	graphics.SetDynamicResolution( true, settings );
+
+	auto start = std::chrono::steady_clock::now();
+	graphics.ClearBuffer( PIX_BLACK );
+	for( int i = 0; i < 4000; i++ )
+		graphics.Draw( spriteId, { static_cast<float>( ( i * 37 ) % 340 ) - 10.0f, static_cast<float>( ( i * 23 ) % 220 ) - 10.0f }, 0 );
+	graphics.EndFrame();
+	double time = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+
+	graphics.SetDynamicResolution( false );
+	return time;
+}
+
+void RunTest()
+{
+	PlayGraphics& graphics = PlayGraphics::Instance();
+	PixelData* pDisplay = graphics.GetDrawingBuffer();
+
+	PixelData blocks = MakeBlocks( 1 );
+	int spriteId = graphics.AddSprite( "blocks", blocks, 1, 1 );
+	graphics.SetSpriteOrigin( spriteId, { ORIGIN_X, ORIGIN_Y } );
+
+	// Scaling by a whole number repeats each pixel, so it draws exactly like a sprite which is already that size
+	for( int scale = 2; scale <= 3; scale++ )
+	{
+		PixelData big = MakeBlocks( scale );
+		int bigId = graphics.AddSprite( "blocks" + std::to_string( scale ), big, 1, 1 );
+		graphics.SetSpriteOrigin( bigId, { static_cast<float>( ORIGIN_X * scale ), static_cast<float>( ORIGIN_Y * scale ) } );
+		DrawSprites( graphics, bigId, 1.0f );
+		uint64_t expected = PlayTest::Hash( *pDisplay );
+		DrawSprites( graphics, spriteId, static_cast<float>( scale ) );
+		PLAY_TEST_CHECK( PlayTest::Hash( *pDisplay ) == expected );
+	}
+
+	// Half size samples one pixel from each block, so at half resolution it upscales to exactly the full size sprite
+	DrawSprites( graphics, spriteId, 1.0f );
+	uint64_t fullSize = PlayTest::Hash( *pDisplay );
+	DynamicResolutionSettings settings;
+	settings.minScale = 0.5f;
+	settings.maxScale = 0.5f;
+	graphics.SetDynamicResolution( true, settings );
+	DrawSprites( graphics, spriteId, 1.0f );
+	graphics.EndFrame();
+	PLAY_TEST_CHECK( PlayTest::Hash( *pDisplay ) == fullSize );
+
+	// Recorded draws are scaled in the same way
+	graphics.BeginDeferredDraw();
+	DrawSprites( graphics, spriteId, 1.0f );
+	graphics.EndDeferredDraw();
+	graphics.EndFrame();
+	PLAY_TEST_CHECK( PlayTest::Hash( *pDisplay ) == fullSize );
+	graphics.SetDynamicResolution( false );
+
+	// Drawing at a lower resolution only visits the pixels it draws, so frames get quicker as the scale falls
+	PixelData discs = PlayTest::MakeDiscs( 32, 32, 1, 7 );
+	int discsId = graphics.AddSprite( "discs", discs, 1, 1 );
+	// > The scales take turns, keeping the quickest frame of each, so a change in the machine's speed affects them all alike
+	double times[3] = { 1e9, 1e9, 1e9 };
+	for( int frame = 0; frame < 10; frame++ )
+	{
+		for( int i = 0; i < 3; i++ )
+			times[i] = std::min( times[i], FrameTime( graphics, discsId, 1.0f - ( i * 0.25f ) ) );
+	}
+	printf( "Frame times at scales 1, 0.75 and 0.5: %.2fms %.2fms %.2fms\n", times[0], times[1], times[2] );
+	PLAY_TEST_CHECK( times[1] < times[0] && times[2] < times[1] );
+}
@@ -0,0 +1,244 @@
+// Draws lines, rectangles and circles clipped in different ways, and checks every pixel against shapes worked out here
+#include "PlayTest.h"
+#include <set>
+
+// A translucent colour, so that any pixel blended twice shows up
+static const Pixel TRANSLUCENT( 0x90, 0xFF, 0xC0, 0x40 );
+
+// A test render target with its own blitter
+struct TestTarget
+{
+	std::vector<Pixel> pixels;
+	PixelData data;
+	PlayBlitter blitter;
+	Pixel blendedOnce;
+
+	TestTarget( int width, int height )
+	{
+		pixels.assign( width * height, PIX_BLACK );
+		data.width = width;
+		data.height = height;
+		data.pPixels = pixels.data();
+		blitter.SetRenderTarget( &data );
+
+		// The colour a black pixel becomes when the translucent colour is blended into it once
+		blitter.DrawPixel( 0, 0, TRANSLUCENT );
+		blendedOnce = pixels[0];
+		pixels[0] = PIX_BLACK;
+	}
+
+	void Clear() { std::fill( pixels.begin(), pixels.end(), PIX_BLACK ); }
+};
+
+typedef std::set<std::pair<int, int>> PointSet;
+
+// Checks the target has the translucent colour blended once into exactly the expected pixels inside the clip, and nothing else
+static bool Matches( const TestTarget& target, const PointSet& expected, PixelRect clip )
+{
+	int wrong = 0;
+	for( int y = 0; y < target.data.height; y++ )
+	{
+		for( int x = 0; x < target.data.width; x++ )
+		{
+			bool inside = x >= clip.x && x < clip.x + clip.width && y >= clip.y && y < clip.y + clip.height;
+			bool set = inside && expected.count( { x, y } ) != 0;
+			wrong += target.data.Row( y )[x].bits != ( set ? target.blendedOnce.bits : PIX_BLACK.bits );
+		}
+	}
+	return wrong == 0;
+}
+
+// The pixels of a line, stepping along the major axis and rounding the minor axis position (halves round away from the start)
+static PointSet LinePoints( int x1, int y1, int x2, int y2, bool drawStart )
+{
+	PointSet points;
+	long long dx = std::abs( x2 - x1 ), dy = std::abs( y2 - y1 );
+	long long major = std::max( dx, dy ), minor = std::min( dx, dy );
+	int sx = x2 < x1 ? -1 : 1, sy = y2 < y1 ? -1 : 1;
+
+	for( long long k = drawStart ? 0 : 1; k <= major && major > 0; k++ )
+	{
+		long long m = ( ( 2 * minor * k ) + major ) / ( 2 * major );
+		long long x = x1 + sx * ( dx >= dy ? k : m );
+		long long y = y1 + sy * ( dx >= dy ? m : k );
+		// Only the points near the target are kept, as the longest lines have millions of them
+		if( x >= -1 && x <= 400 && y >= -1 && y <= 400 )
+			points.insert( { static_cast<int>( x ), static_cast<int>( y ) } );
+	}
+	return points;
+}
+
+// The pixels of a circle outline: every reflection of the midpoint algorithm's steps around one octant
+static PointSet CirclePoints( int cx, int cy, int radius )
+{
+	PointSet points;
+	int dx = 0, dy = radius, d = 3 - 2 * radius;
+	while( dx <= dy )
+	{
+		const int reflections[8][2] = { { dx, dy }, { -dx, dy }, { dx, -dy }, { -dx, -dy }, { dy, dx }, { -dy, dx }, { dy, -dx }, { -dy, -dx } };
+		for( const int* r : reflections )
+			points.insert( { cx + r[0], cy + r[1] } );
+
+		dx++;
+		if( d > 0 )
+		{
+			dy--;
+			d += 4 * ( dx - dy ) + 10;
+		}
+		else
+		{
+			d += 4 * dx + 6;
+		}
+	}
+	return points;
+}
+
+// The pixels of a filled circle: every pixel on each row between the outline's leftmost and rightmost pixels
+static PointSet FilledCirclePoints( int cx, int cy, int radius )
+{
+	PointSet outline = CirclePoints( cx, cy, radius );
+	PointSet points;
+	for( int y = cy - radius; y <= cy + radius; y++ )
+	{
+		int halfWidth = 0;
+		for( const std::pair<int, int>& p : outline )
+		{
+			if( p.second == y )
+				halfWidth = std::max( halfWidth, std::abs( p.first - cx ) );
+		}
+		for( int x = cx - halfWidth; x <= cx + halfWidth; x++ )
+			points.insert( { x, y } );
+	}
+	return points;
+}
+
+static int s_random = 1;
+
+static int Random( int low, int high )
+{
+	s_random = s_random * 1103515245 + 12345;
+	return low + static_cast<int>( ( static_cast<uint32_t>( s_random ) >> 8 ) % static_cast<uint32_t>( high - low + 1 ) );
+}
+
+static void CheckLines( TestTarget& target, PixelRect clip )
+{
+	PixelRect visible = target.blitter.GetClipRect();
+
+	for( int i = 0; i < 300; i++ )
+	{
+		// Mostly lines which cross the target's edges, with some exactly horizontal, vertical and diagonal ones
+		int x1 = Random( -150, 250 ), y1 = Random( -150, 200 );
+		int x2 = Random( -150, 250 ), y2 = Random( -150, 200 );
+		if( i % 10 == 1 ) y2 = y1;
+		if( i % 10 == 2 ) x2 = x1;
+		if( i % 10 == 3 ) y2 = y1 + ( x2 - x1 );
+		if( i % 10 == 4 ) y2 = y1 - ( x2 - x1 );
+		bool drawStart = i % 7 != 0;
+
+		target.Clear();
+		target.blitter.DrawLine( x1, y1, x2, y2, TRANSLUCENT, drawStart );
+		bool bMatches = Matches( target, LinePoints( x1, y1, x2, y2, drawStart ), visible );
+		PLAY_TEST_CHECK( bMatches );
+		if( !bMatches )
+			fprintf( stderr, "Line from %d,%d to %d,%d in clip %d,%d %dx%d\n", x1, y1, x2, y2, clip.x, clip.y, clip.width, clip.height );
+	}
+
+	// Lines whose ends are far enough away that the clipping maths needs more than 32 bits
+	const int farLines[][4] = { { -1000000, -999000, 1000000, 1001000 }, { 2000000, 50, -2000000, 60 }, { 30, -1500000, 90, 1500000 }, { -900000, 1200000, 1100000, -800000 } };
+	for( const int* l : farLines )
+	{
+		target.Clear();
+		target.blitter.DrawLine( l[0], l[1], l[2], l[3], TRANSLUCENT );
+		PLAY_TEST_CHECK( Matches( target, LinePoints( l[0], l[1], l[2], l[3], true ), visible ) );
+	}
+}
+
+static void CheckCircles( TestTarget& target )
+{
+	PixelRect visible = target.blitter.GetClipRect();
+
+	for( int i = 0; i < 120; i++ )
+	{
+		// Circles of every size around the edges of the clip, and some small enough to test the axes and diagonals
+		int radius = i < 20 ? i : Random( 0, 150 );
+		int cx = Random( -100, 200 ), cy = Random( -100, 160 );
+		bool fill = i % 2 != 0;
+
+		target.Clear();
+		target.blitter.DrawCircle( cx, cy, radius, TRANSLUCENT, fill );
+		PointSet expected = fill ? FilledCirclePoints( cx, cy, radius ) : CirclePoints( cx, cy, radius );
+		bool bMatches = Matches( target, expected, visible );
+		PLAY_TEST_CHECK( bMatches );
+		if( !bMatches )
+			fprintf( stderr, "%s circle at %d,%d radius %d\n", fill ? "Filled" : "Outline", cx, cy, radius );
+	}
+
+	// A filled circle much larger than the target covers all of it, and its outline misses it completely
+	target.Clear();
+	target.blitter.DrawCircle( 80, 60, 5000, TRANSLUCENT, true );
+	PointSet everything;
+	for( int y = 0; y < target.data.height; y++ )
+	{
+		for( int x = 0; x < target.data.width; x++ )
+			everything.insert( { x, y } );
+	}
+	PLAY_TEST_CHECK( Matches( target, everything, visible ) );
+
+	target.Clear();
+	target.blitter.DrawCircle( 80, 60, 5000, TRANSLUCENT, false );
+	PLAY_TEST_CHECK( Matches( target, {}, visible ) );
+}
+
+void RunTest()
+{
+	TestTarget target( 160, 120 );
+
+	const PixelRect clips[] = { { 0, 0, 160, 120 }, { 20, 15, 100, 70 }, { 0, 50, 160, 1 }, { 77, 0, 1, 120 }, { 150, 110, 40, 40 } };
+	for( const PixelRect& clip : clips )
+	{
+		target.blitter.PushClipRect( clip );
+		CheckLines( target, clip );
+		CheckCircles( target );
+		target.blitter.PopClipRect();
+	}
+
+	// Rectangle outlines through PlayGraphics only draw each corner once
+	PlayGraphics& graphics = PlayGraphics::Instance();
+	PixelData* pDisplay = graphics.GetDrawingBuffer();
+	const int rects[][4] = { { 10, 10, 50, 40 }, { 60, 70, 20, 30 }, { -5, 100, 40, 180 }, { 200, 20, 200, 90 }, { 220, 50, 300, 50 } };
+	for( const int* r : rects )
+	{
+		graphics.ClearBuffer( PIX_BLACK );
+		graphics.DrawRect( { static_cast<float>( r[0] ), static_cast<float>( r[1] ) }, { static_cast<float>( r[2] ), static_cast<float>( r[3] ) }, TRANSLUCENT );
+
+		PointSet expected;
+		for( int x = std::min( r[0], r[2] ); x <= std::max( r[0], r[2] ); x++ )
+		{
+			expected.insert( { x, r[1] } );
+			expected.insert( { x, r[3] } );
+		}
+		for( int y = std::min( r[1], r[3] ); y <= std::max( r[1], r[3] ); y++ )
+		{
+			expected.insert( { r[0], y } );
+			expected.insert( { r[2], y } );
+		}
+
+		int wrong = 0;
+		for( int y = 0; y < pDisplay->height; y++ )
+		{
+			for( int x = 0; x < pDisplay->width; x++ )
+				wrong += pDisplay->Row( y )[x].bits != ( expected.count( { x, y } ) ? target.blendedOnce.bits : PIX_BLACK.bits );
+		}
+		PLAY_TEST_CHECK( wrong == 0 );
+	}
+
+	// Filled rectangles leave out their right and bottom edges
+	graphics.ClearBuffer( PIX_BLACK );
+	graphics.DrawRect( { 300, 190 }, { 340, 220 }, TRANSLUCENT, true );
+	PLAY_TEST_CHECK( pDisplay->Row( 190 )[300].bits == target.blendedOnce.bits && pDisplay->Row( 199 )[319].bits == target.blendedOnce.bits );
+	PLAY_TEST_CHECK( pDisplay->Row( 189 )[300].bits == PIX_BLACK.bits && pDisplay->Row( 190 )[299].bits == PIX_BLACK.bits );
+	graphics.ClearBuffer( PIX_BLACK );
+	graphics.DrawRect( { 10, 10 }, { 20, 15 }, TRANSLUCENT, true );
+	PLAY_TEST_CHECK( pDisplay->Row( 14 )[19].bits == target.blendedOnce.bits );
+	PLAY_TEST_CHECK( pDisplay->Row( 15 )[19].bits == PIX_BLACK.bits && pDisplay->Row( 14 )[20].bits == PIX_BLACK.bits );
+}
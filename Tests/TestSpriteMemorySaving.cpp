@@ -0,0 +1,201 @@
+// Frees the sprites' canvases and checks drawing, colouring, collisions and font widths are the same as they were with them
+#include "PlayTest.h"
+
+static const int GLYPH_WIDTH = 9;
+static const int GLYPH_HEIGHT = 12;
+static const int GLYPHS = 96;
+
+// Makes a font whose characters are blocks of their own widths, with the widths in the blue channel of its first pixels
+static PixelData MakeFont()
+{
+	PixelData canvas;
+	canvas.width = GLYPH_WIDTH * GLYPHS;
+	canvas.height = GLYPH_HEIGHT;
+	canvas.pPixels = new Pixel[canvas.width * canvas.height];
+	for( int y = 0; y < canvas.height; y++ )
+	{
+		for( int x = 0; x < canvas.width; x++ )
+		{
+			int width = 2 + ( ( x / GLYPH_WIDTH ) * 5 ) % 7;
+			canvas.pPixels[y * canvas.width + x] = ( x % GLYPH_WIDTH < width ) ? Pixel( 0xFF, 0xF0, 0xE0, 0xD0 ) : Pixel( 0x00, 0x00, 0x00, 0x00 );
+		}
+	}
+	for( int i = 0; i < GLYPHS; i++ )
+		canvas.pPixels[i] = Pixel( 0x00, 0x00, 0x00, 2 + ( i * 3 ) % 8 );
+	return canvas;
+}
+
+// Makes a few coloured rings, which are stored as palette indices
+static PixelData MakeRings( int size, int frames )
+{
+	PixelData canvas;
+	canvas.width = size * frames;
+	canvas.height = size;
+	canvas.pPixels = new Pixel[canvas.width * canvas.height];
+	for( int y = 0; y < size; y++ )
+	{
+		for( int x = 0; x < canvas.width; x++ )
+		{
+			int dx = ( x % size ) - ( size / 2 );
+			int dy = y - ( size / 2 );
+			int ring = ( dx * dx + dy * dy ) / ( 12 + ( x / size ) * 4 );
+			canvas.pPixels[y * canvas.width + x] = ( ring < 8 ) ? Pixel( ( ring % 2 ) ? 0x90 : 0xFF, ring * 30, 200 - ring * 20, 0x40 ) : Pixel( 0x00, 0x10, 0x20, 0x30 );
+		}
+	}
+	return canvas;
+}
+
+static void DrawScene( PlayGraphics& graphics, int spriteId, int fontId )
+{
+	graphics.ClearBuffer( PIX_BLUE );
+	graphics.PushClipRect( { 5, 10, 300, 170 } );
+	for( int i = 0; i < 12; i++ )
+	{
+		graphics.Draw( spriteId, { ( i * 47 ) % 340 - 20.0f, ( i * 29 ) % 220 - 20.0f }, i % 3 );
+		graphics.DrawTransparent( spriteId, { ( i * 31 ) % 300 + 0.0f, ( i * 43 ) % 190 + 0.0f }, i % 3, 0.7f );
+	}
+	graphics.DrawRotated( spriteId, { 160.0f, 100.0f }, 1, 0.8f, 1.7f );
+	graphics.PopClipRect();
+	graphics.DrawString( fontId, { 10.0f, 180.0f }, "Memory saving { 0123 }" );
+}
+
+static std::vector<Pixel> CopyDisplay()
+{
+	const PixelData* pDisplay = PlayGraphics::Instance().GetDrawingBuffer();
+	std::vector<Pixel> pixels;
+	for( int y = 0; y < pDisplay->height; y++ )
+		pixels.insert( pixels.end(), pDisplay->Row( y ), pDisplay->Row( y ) + pDisplay->width );
+	return pixels;
+}
+
+// Gets the largest difference in any channel between two frames
+static int Difference( const std::vector<Pixel>& a, const std::vector<Pixel>& b )
+{
+	int worst = 0;
+	for( size_t i = 0; i < a.size(); i++ )
+		worst = std::max( { worst, std::abs( a[i].r - b[i].r ), std::abs( a[i].g - b[i].g ), std::abs( a[i].b - b[i].b ) } );
+	return worst;
+}
+
+// Draws the scene plainly and then with the sprite coloured
+static void DrawScenes( PlayGraphics& graphics, int spriteId, int fontId, std::vector<Pixel>& plain, std::vector<Pixel>& coloured )
+{
+	DrawScene( graphics, spriteId, fontId );
+	plain = CopyDisplay();
+	graphics.ColourSprite( spriteId, 0xFF, 0x80, 0x30 );
+	graphics.ColourSprite( fontId, 0x40, 0xC0, 0xFF );
+	DrawScene( graphics, spriteId, fontId );
+	coloured = CopyDisplay();
+	graphics.ColourSprite( spriteId, 0xFF, 0xFF, 0xFF );
+	graphics.ColourSprite( fontId, 0xFF, 0xFF, 0xFF );
+}
+
+// Tests the sprites for collisions with each other across a grid of positions and angles
+static std::vector<bool> Collisions( PlayGraphics& graphics, int spriteA, int spriteB )
+{
+	int rectA[4] = { 0, 0, 39, 39 };
+	int rectB[4] = { 0, 0, 47, 47 };
+	std::vector<bool> collisions;
+	for( int y = -50; y <= 50; y += 5 )
+	{
+		for( int x = -50; x <= 50; x += 5 )
+			collisions.push_back( graphics.SpriteCollide( spriteA, { 100.0f, 100.0f }, 1, 0.3f, rectA, spriteB, { 100.0f + x, 100.0f + y }, ( x + y ) & 3, -0.5f, rectB ) );
+	}
+	return collisions;
+}
+
+static int TotalBytes( const SpriteMemoryInfo& info )
+{
+	return info.canvasBytes + info.maskBytes + info.drawBytes;
+}
+
+void RunTest()
+{
+	PlayGraphics& graphics = PlayGraphics::Instance();
+
+	PixelData discs = PlayTest::MakeDiscs( 40, 40, 3, 9 );
+	PixelData rings = MakeRings( 48, 4 );
+	PixelData font = MakeFont();
+	int discsId = graphics.AddSprite( "discs", discs, 3, 1 );
+	int ringsId = graphics.AddSprite( "rings", rings, 4, 1 );
+	int fontId = graphics.AddSprite( "font", font, GLYPHS, 1 );
+	PLAY_TEST_CHECK( graphics.GetSpriteMemoryInfo( ringsId ).indexed && !graphics.GetSpriteMemoryInfo( discsId ).indexed );
+
+	// Record everything with the canvases
+	std::vector<Pixel> discsPlain, discsColoured, ringsPlain, ringsColoured;
+	DrawScenes( graphics, discsId, fontId, discsPlain, discsColoured );
+	DrawScenes( graphics, ringsId, fontId, ringsPlain, ringsColoured );
+	std::vector<bool> collisions = Collisions( graphics, discsId, ringsId );
+	std::vector<int> widths;
+	for( char c = ' '; c < 127; c++ )
+		widths.push_back( graphics.GetFontCharWidth( fontId, c ) );
+	int stringWidth = graphics.GetStringWidth( fontId, "Memory saving" );
+	int discsBytes = TotalBytes( graphics.GetSpriteMemoryInfo( discsId ) );
+	PixelData ringFrame;
+	ringFrame.width = 48;
+	ringFrame.height = 48;
+	std::vector<Pixel> ringPixels( 48 * 48 ), restoredPixels( 48 * 48 );
+	ringFrame.pPixels = ringPixels.data();
+	graphics.CopySpriteFrame( ringsId, 2, ringFrame, 0, 0 );
+
+	// Freeing the canvases roughly halves the memory a sprite takes
+	graphics.SetSpriteMemorySaving( true );
+	SpriteMemoryInfo info = graphics.GetSpriteMemoryInfo( discsId );
+	PLAY_TEST_CHECK( info.canvasBytes == 0 && info.maskBytes > 0 && graphics.GetSpriteMemoryInfo( fontId ).canvasBytes == 0 );
+	PLAY_TEST_CHECK( TotalBytes( info ) * 100 < discsBytes * 55 );
+
+	// Sprites draw exactly the same, and coloured ones are tinted (through the palette for indexed sprites) to exactly the
+	// pixels re-colouring the canvas gave
+	std::vector<Pixel> plain, coloured;
+	DrawScenes( graphics, discsId, fontId, plain, coloured );
+	PLAY_TEST_CHECK( Difference( plain, discsPlain ) == 0 && Difference( coloured, discsColoured ) == 0 );
+	DrawScenes( graphics, ringsId, fontId, plain, coloured );
+	PLAY_TEST_CHECK( Difference( plain, ringsPlain ) == 0 && Difference( coloured, ringsColoured ) == 0 );
+
+	// The tinted frames are kept with the sprite until its colour changes again
+	int plainBytes = graphics.GetSpriteMemoryInfo( discsId ).drawBytes;
+	graphics.ColourSprite( discsId, 0xFF, 0x80, 0x30 );
+	graphics.Draw( discsId, { 100.0f, 100.0f }, 0 );
+	PLAY_TEST_CHECK( graphics.GetSpriteMemoryInfo( discsId ).drawBytes > plainBytes );
+	graphics.ColourSprite( discsId, 0xFF, 0xFF, 0xFF );
+	PLAY_TEST_CHECK( graphics.GetSpriteMemoryInfo( discsId ).drawBytes == plainBytes );
+
+	// Collisions use the mask, and font widths the table, giving the same answers as the canvas did
+	PLAY_TEST_CHECK( Collisions( graphics, discsId, ringsId ) == collisions );
+	for( char c = ' '; c < 127; c++ )
+		PLAY_TEST_CHECK( graphics.GetFontCharWidth( fontId, c ) == widths[c - ' '] );
+	PLAY_TEST_CHECK( graphics.GetStringWidth( fontId, "Memory saving" ) == stringWidth );
+
+	// The visible pixels of indexed sprites unpack exactly as they were loaded
+	ringFrame.pPixels = restoredPixels.data();
+	graphics.CopySpriteFrame( ringsId, 2, ringFrame, 0, 0 );
+	int wrong = 0;
+	for( size_t i = 0; i < ringPixels.size(); i++ )
+		wrong += ( ringPixels[i].a == 0x00 ) ? restoredPixels[i].a != 0x00 : restoredPixels[i].bits != ringPixels[i].bits;
+	PLAY_TEST_CHECK( wrong == 0 );
+
+	// Sprites added while saving memory free their canvas once they are loaded
+	PixelData moreDiscs = PlayTest::MakeDiscs( 40, 40, 3, 9 );
+	int moreDiscsId = graphics.AddSprite( "more discs", moreDiscs, 3, 1 );
+	PLAY_TEST_CHECK( graphics.GetSpriteMemoryInfo( moreDiscsId ).canvasBytes == 0 );
+	DrawScenes( graphics, moreDiscsId, fontId, plain, coloured );
+	PLAY_TEST_CHECK( Difference( plain, discsPlain ) == 0 && Difference( coloured, discsColoured ) == 0 );
+
+	// Compressed frames are tinted as they are decoded, in the same way
+	graphics.CompressSprite( moreDiscsId );
+	DrawScenes( graphics, moreDiscsId, fontId, plain, coloured );
+	PLAY_TEST_CHECK( Difference( plain, discsPlain ) == 0 && Difference( coloured, discsColoured ) == 0 );
+
+	// Writing to a sprite brings its canvas back, with the rest of its pixels as they were
+	Pixel patch[4] = { PIX_RED, PIX_RED, PIX_RED, PIX_RED };
+	graphics.UpdateSpriteRegion( discsId, { 19, 19, 2, 2 }, patch );
+	PLAY_TEST_CHECK( graphics.GetSpriteMemoryInfo( discsId ).canvasBytes > 0 );
+	graphics.ClearBuffer( PIX_BLACK );
+	graphics.Draw( discsId, { 100.0f, 60.0f }, 0 );
+	graphics.Draw( moreDiscsId, { 200.0f, 60.0f }, 0 );
+	const PixelData* pDisplay = graphics.GetDrawingBuffer();
+	PLAY_TEST_CHECK( pDisplay->Row( 80 )[120].g == 0x00 && pDisplay->Row( 80 )[120].r > 0xF0 );
+	PLAY_TEST_CHECK( pDisplay->Row( 62 )[110].bits == pDisplay->Row( 62 )[210].bits );
+
+	graphics.SetSpriteMemorySaving( false );
+}
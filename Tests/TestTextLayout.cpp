@@ -0,0 +1,162 @@
+// Draws strings through the text layout cache and checks them against drawing each character in turn
+#include "PlayTest.h"
+
+static const int CHAR_WIDTH = 10;
+static const int CHAR_HEIGHT = 12;
+static const int CHARS = 96;
+
+// Makes a font sheet with a character for every printable ASCII code
+// > The width of each character is kept in the blue channel of the first row of the sheet, which is otherwise transparent
+// > Characters can spill past their width into the next one (like italics), so that neighbours overlap
+static int AddFont( PlayGraphics& graphics, const char* name, int alpha, bool spill )
+{
+	PixelData canvas;
+	canvas.width = CHAR_WIDTH * CHARS;
+	canvas.height = CHAR_HEIGHT;
+	canvas.pPixels = new Pixel[canvas.width * canvas.height];
+
+	for( int f = 0; f < CHARS; f++ )
+	{
+		int charWidth = 4 + ( f % 6 );
+		for( int y = 0; y < CHAR_HEIGHT; y++ )
+		{
+			for( int x = 0; x < CHAR_WIDTH; x++ )
+			{
+				bool set = y > 0 && ( x < charWidth || spill ) && ( ( x * 3 ) + ( y * 5 ) + f ) % 4 != 0;
+				canvas.pPixels[y * canvas.width + f * CHAR_WIDTH + x] = set ? Pixel( alpha, f * 2, 0xFF - ( y * 9 ), x * 25 ) : Pixel( 0x00000000 );
+			}
+		}
+	}
+
+	for( int c = 0; c < CHARS; c++ )
+		canvas.pPixels[c].b = 4 + ( c % 6 );
+
+	return graphics.AddSprite( name, canvas, CHARS, 1 );
+}
+
+// Draws a string one character at a time, as the reference for the cached layouts
+static int DrawCharacters( PlayGraphics& graphics, int fontId, Point2f pos, const std::string& text )
+{
+	int width = 0;
+	for( char c : text )
+	{
+		graphics.Draw( fontId, { pos.x + width, pos.y }, c - 32 );
+		width += graphics.GetFontCharWidth( fontId, c );
+	}
+	return width;
+}
+
+static bool SameAsDisplay( const std::vector<Pixel>& expected )
+{
+	const PixelData* pDisplay = PlayGraphics::Instance().GetDrawingBuffer();
+	int wrong = 0;
+	for( int y = 0; y < pDisplay->height; y++ )
+	{
+		for( int x = 0; x < pDisplay->width; x++ )
+			wrong += pDisplay->Row( y )[x].bits != expected[y * pDisplay->width + x].bits;
+	}
+	return wrong == 0;
+}
+
+static std::vector<Pixel> CopyDisplay()
+{
+	const PixelData* pDisplay = PlayGraphics::Instance().GetDrawingBuffer();
+	std::vector<Pixel> pixels;
+	for( int y = 0; y < pDisplay->height; y++ )
+		pixels.insert( pixels.end(), pDisplay->Row( y ), pDisplay->Row( y ) + pDisplay->width );
+	return pixels;
+}
+
+// Draws a string with the cache twice and compares both with the reference
+// > The first time a string is drawn it is laid out and drawn a character at a time, and after that as a pre-rendered run
+static void CheckString( int fontId, Point2f pos, const std::string& text )
+{
+	PlayGraphics& graphics = PlayGraphics::Instance();
+
+	graphics.ClearBuffer( PIX_BLUE );
+	int expectedWidth = DrawCharacters( graphics, fontId, pos, text );
+	std::vector<Pixel> expected = CopyDisplay();
+
+	for( int pass = 0; pass < 2; pass++ )
+	{
+		graphics.ClearBuffer( PIX_BLUE );
+		PLAY_TEST_CHECK( graphics.DrawString( fontId, pos, text ) == expectedWidth );
+		bool bMatches = SameAsDisplay( expected );
+		PLAY_TEST_CHECK( bMatches );
+		if( !bMatches )
+			fprintf( stderr, "\"%s\" at %.1f,%.1f (pass %d)\n", text.c_str(), pos.x, pos.y, pass );
+	}
+	PLAY_TEST_CHECK( graphics.GetStringWidth( fontId, text ) == expectedWidth );
+}
+
+void RunTest()
+{
+	PlayGraphics& graphics = PlayGraphics::Instance();
+	PixelData* pDisplay = graphics.GetDrawingBuffer();
+
+	const int fonts[] = { AddFont( graphics, "opaque", 0xFF, false ), AddFont( graphics, "translucent", 0x90, false ), AddFont( graphics, "italic", 0x90, true ) };
+	const std::string strings[] = { "PRESS <- AND -> ARROW KEYS", "Score: 12345", "~}|{ `_^]", " ", "" };
+
+	// Cached strings draw exactly as they would one character at a time, whether or not the characters overlap
+	for( int fontId : fonts )
+	{
+		for( const std::string& text : strings )
+		{
+			CheckString( fontId, { 10.0f, 20.0f }, text );
+			CheckString( fontId, { 200.4f, 190.6f }, text ); // Off the bottom right of the display
+			CheckString( fontId, { -7.5f, -3.0f }, text ); // Off the top left
+		}
+	}
+
+	// Centred strings are drawn half their width to the left
+	graphics.ClearBuffer( PIX_BLUE );
+	int width = graphics.DrawString( fonts[0], { 160.0f - ( graphics.GetStringWidth( fonts[0], strings[0] ) / 2 ), 100.0f }, strings[0] );
+	uint64_t expected = PlayTest::Hash( *pDisplay );
+	graphics.ClearBuffer( PIX_BLUE );
+	PLAY_TEST_CHECK( graphics.DrawStringCentred( fonts[0], { 160.0f, 100.0f }, strings[0] ) == width );
+	PLAY_TEST_CHECK( PlayTest::Hash( *pDisplay ) == expected );
+
+	// Recolouring a font re-renders its cached strings
+	graphics.ColourSprite( fonts[1], 0xFF, 0x40, 0x00 );
+	CheckString( fonts[1], { 30.0f, 40.0f }, strings[0] );
+	graphics.ColourSprite( fonts[1], 0xFF, 0xFF, 0xFF );
+	CheckString( fonts[1], { 30.0f, 40.0f }, strings[0] );
+
+	// Updating a font's pixels drops its cached strings, including their widths
+	std::vector<Pixel> block( CHAR_WIDTH * CHAR_HEIGHT, PIX_RED );
+	graphics.UpdateSpriteRegion( fonts[0], { ( 'S' - 32 ) * CHAR_WIDTH, 1, CHAR_WIDTH, CHAR_HEIGHT - 1 }, block.data() );
+	PLAY_TEST_CHECK( !graphics.IsTextLayoutCached( fonts[0], strings[0] ) && graphics.IsTextLayoutCached( fonts[1], strings[0] ) );
+	CheckString( fonts[0], { 10.0f, 20.0f }, strings[0] );
+	Pixel widthPixel = Pixel( 0x00, 0x00, 0x00, 9 );
+	graphics.UpdateSpriteRegion( fonts[0], { 'E' - 32, 0, 1, 1 }, &widthPixel );
+	PLAY_TEST_CHECK( graphics.GetFontCharWidth( fonts[0], 'E' ) == 9 );
+	CheckString( fonts[0], { 10.0f, 20.0f }, strings[0] );
+
+	// Strings recorded for a deferred draw are drawn the same way
+	graphics.ClearBuffer( PIX_BLUE );
+	DrawCharacters( graphics, fonts[1], { 50.0f, 60.0f }, strings[1] );
+	expected = PlayTest::Hash( *pDisplay );
+	graphics.ClearBuffer( PIX_BLUE );
+	graphics.BeginDeferredDraw( false );
+	graphics.DrawString( fonts[1], { 50.0f, 60.0f }, strings[1] );
+	graphics.EndDeferredDraw();
+	PLAY_TEST_CHECK( PlayTest::Hash( *pDisplay ) == expected );
+
+	// Lots of different strings (more than the cache holds) don't disturb the strings drawn before or after them
+	for( int i = 0; i < 600; i++ )
+	{
+		PLAY_TEST_CHECK( graphics.GetStringWidth( fonts[i % 3], std::to_string( i * 7919 ) ) == DrawCharacters( graphics, fonts[i % 3], { 0, 0 }, std::to_string( i * 7919 ) ) );
+		graphics.GetStringWidth( fonts[2], strings[1] );
+	}
+
+	// The least recently used strings are forgotten first, so a string used all along and the most recent ones are still cached
+	// > The cache holds 256 strings, one of which is the string used all along
+	int cached = 0;
+	for( int i = 0; i < 600; i++ )
+		cached += graphics.IsTextLayoutCached( fonts[i % 3], std::to_string( i * 7919 ) ) ? 1 : 0;
+	PLAY_TEST_CHECK( cached == 255 && graphics.IsTextLayoutCached( fonts[2], strings[1] ) );
+	PLAY_TEST_CHECK( graphics.IsTextLayoutCached( fonts[0], std::to_string( 345 * 7919 ) ) && !graphics.IsTextLayoutCached( fonts[2], std::to_string( 344 * 7919 ) ) );
+
+	CheckString( fonts[1], { 30.0f, 40.0f }, strings[0] );
+	CheckString( fonts[1], { 30.0f, 40.0f }, "1234567" );
+}
@@ -0,0 +1,161 @@
+// Draws tile maps through their pre-drawn chunks and checks them against drawing every tile as a sprite
+#include "PlayTest.h"
+
+static const int TILE_WIDTH = 16;
+static const int TILE_HEIGHT = 12;
+static const int TILE_FRAMES = 8;
+
+static int s_tilesId = -1;
+
+static uint32_t s_random = 3;
+
+static int Random( int count )
+{
+	s_random = s_random * 1103515245u + 12345u;
+	return static_cast<int>( ( s_random >> 8 ) % static_cast<uint32_t>( count ) );
+}
+
+// Makes a sheet of opaque, translucent and holed tiles
+static PixelData MakeTiles()
+{
+	PixelData canvas;
+	canvas.width = TILE_WIDTH * TILE_FRAMES;
+	canvas.height = TILE_HEIGHT;
+	canvas.pPixels = new Pixel[canvas.width * canvas.height];
+
+	for( int f = 0; f < TILE_FRAMES; f++ )
+	{
+		for( int y = 0; y < TILE_HEIGHT; y++ )
+		{
+			for( int x = 0; x < TILE_WIDTH; x++ )
+			{
+				int alpha = 0xFF;
+				if( f % 3 == 1 ) alpha = 0x30 + x * 8; // Translucent
+				if( f % 3 == 2 && ( x + y ) % 5 == 0 ) alpha = 0x00; // Holes
+				canvas.pPixels[y * canvas.width + f * TILE_WIDTH + x] = Pixel( alpha, f * 30, x * 15, y * 20 );
+			}
+		}
+	}
+	return canvas;
+}
+
+// Draws each tile of the map as a sprite, as the reference for drawing it in chunks
+static void DrawTiles( const TileMap& map, int cameraX, int cameraY )
+{
+	PlayGraphics& graphics = PlayGraphics::Instance();
+	for( int y = 0; y < map.GetHeight(); y++ )
+	{
+		for( int x = 0; x < map.GetWidth(); x++ )
+		{
+			if( map.GetTile( x, y ) >= 0 )
+				graphics.Draw( s_tilesId, { static_cast<float>( x * TILE_WIDTH - cameraX ), static_cast<float>( y * TILE_HEIGHT - cameraY ) }, map.GetTile( x, y ) );
+		}
+	}
+}
+
+// Draws the map both ways over a background and checks they are the same
+static bool SameAsTiles( TileMap& map, int cameraX, int cameraY )
+{
+	PlayGraphics& graphics = PlayGraphics::Instance();
+	PixelData* pDisplay = graphics.GetDrawingBuffer();
+
+	graphics.ClearBuffer( PIX_MAGENTA );
+	DrawTiles( map, cameraX, cameraY );
+	uint64_t expected = PlayTest::Hash( *pDisplay );
+
+	graphics.ClearBuffer( PIX_MAGENTA );
+	map.Draw( { static_cast<float>( cameraX ), static_cast<float>( cameraY ) } );
+	return PlayTest::Hash( *pDisplay ) == expected;
+}
+
+static void CheckViews( TileMap& map )
+{
+	PlayGraphics& graphics = PlayGraphics::Instance();
+
+	// Views inside the map, across each edge of it and completely outside it
+	const int cameras[][2] = { { 0, 0 }, { 37, 23 }, { -50, -31 }, { map.GetWidth() * TILE_WIDTH - 100, map.GetHeight() * TILE_HEIGHT - 80 }, { -400, 10 }, { 10, 5000 } };
+	const PixelRect clips[] = { { 0, 0, TEST_DISPLAY_WIDTH, TEST_DISPLAY_HEIGHT }, { 40, 30, 100, 70 }, { 300, 0, 20, TEST_DISPLAY_HEIGHT } };
+	for( const PixelRect& clip : clips )
+	{
+		graphics.PushClipRect( clip );
+		for( const int* camera : cameras )
+		{
+			bool bMatches = SameAsTiles( map, camera[0], camera[1] );
+			PLAY_TEST_CHECK( bMatches );
+			if( !bMatches )
+				fprintf( stderr, "%dx%d map seen from %d,%d in clip %d,%d %dx%d\n", map.GetWidth(), map.GetHeight(), camera[0], camera[1], clip.x, clip.y, clip.width, clip.height );
+		}
+		graphics.PopClipRect();
+	}
+}
+
+void RunTest()
+{
+	PlayGraphics& graphics = PlayGraphics::Instance();
+	PixelData* pDisplay = graphics.GetDrawingBuffer();
+
+	PixelData tiles = MakeTiles();
+	s_tilesId = graphics.AddSprite( "tiles_8", tiles, TILE_FRAMES, 1 );
+
+	// A map whose size isn't a whole number of chunks, with empty tiles and chunks
+	TileMap map( s_tilesId, 45, 37, 8 );
+	for( int y = 0; y < map.GetHeight(); y++ )
+	{
+		for( int x = 0; x < map.GetWidth(); x++ )
+			map.SetTile( x, y, ( x >= 16 && x < 24 && y < 8 ) ? -1 : Random( TILE_FRAMES + 2 ) - 2 );
+	}
+	CheckViews( map );
+
+	// Changing tiles redraws their chunks
+	map.SetTile( 3, 4, 1 );
+	map.SetTile( 44, 36, 5 );
+	map.SetTile( 20, 3, 0 );
+	map.SetTile( 8, 0, -1 );
+	CheckViews( map );
+	PLAY_TEST_CHECK( map.GetTile( 3, 4 ) == 1 && map.GetTile( 8, 0 ) == -1 );
+	PLAY_TEST_CHECK( map.GetTile( -1, 0 ) == -1 && map.GetTile( 45, 0 ) == -1 && map.GetTile( 0, 37 ) == -1 );
+
+	// Updating the tile sprite is only seen once the chunks are invalidated
+	std::vector<Pixel> region( TILE_WIDTH * TILE_HEIGHT, Pixel( 0x80, 0xFF, 0xFF, 0x00 ) );
+	graphics.UpdateSpriteRegion( s_tilesId, { 0, 0, TILE_WIDTH, TILE_HEIGHT }, region.data() );
+	map.InvalidateAll();
+	CheckViews( map );
+
+	// Recolouring the tile sprite is seen in the same way
+	graphics.ColourSprite( s_tilesId, 0xFF, 0x80, 0x40 );
+	map.InvalidateAll();
+	CheckViews( map );
+	graphics.ColourSprite( s_tilesId, 0xFF, 0xFF, 0xFF );
+	map.InvalidateAll();
+
+	// The map's camera is added to the PlayGraphics camera, and fractions are rounded
+	graphics.ClearBuffer( PIX_MAGENTA );
+	map.Draw( { 30.0f, 20.0f } );
+	uint64_t expected = PlayTest::Hash( *pDisplay );
+	graphics.ClearBuffer( PIX_MAGENTA );
+	graphics.SetCameraPosition( { 20.0f, -10.0f } );
+	map.Draw( { 10.4f, 29.6f } );
+	graphics.SetCameraPosition( { 0.0f, 0.0f } );
+	PLAY_TEST_CHECK( PlayTest::Hash( *pDisplay ) == expected );
+
+	// Filling the map with a tile, and then with nothing
+	map.Fill( 2 );
+	CheckViews( map );
+	map.Fill( -1 );
+	graphics.ClearBuffer( PIX_MAGENTA );
+	uint64_t empty = PlayTest::Hash( *pDisplay );
+	map.Draw( { 0.0f, 0.0f } );
+	PLAY_TEST_CHECK( PlayTest::Hash( *pDisplay ) == empty );
+	map.SetTile( 0, 0, 1 );
+	CheckViews( map );
+
+	// A map of a single chunk, and a map with chunks of a single tile
+	TileMap small( s_tilesId, 5, 3, 16 );
+	TileMap single( s_tilesId, 30, 20, 1 );
+	for( int i = 0; i < 15; i++ )
+		small.SetTile( i % 5, i / 5, i % TILE_FRAMES );
+	for( int i = 0; i < 600; i++ )
+		single.SetTile( i % 30, i / 30, Random( TILE_FRAMES + 1 ) - 1 );
+	CheckViews( small );
+	CheckViews( single );
+}
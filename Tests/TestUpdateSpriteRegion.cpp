@@ -0,0 +1,87 @@
+// Updates regions of sprites and checks they draw the same as sprites made from the updated pixels
+#include "PlayTest.h"
+
+constexpr int FRAME_WIDTH = 24;
+constexpr int FRAME_HEIGHT = 20;
+constexpr int FRAMES = 3;
+
+// Draws every frame of a sprite, normally and rotated, returning a hash of the display
+static uint64_t DrawnHash( PlayGraphics& graphics, int spriteId )
+{
+	graphics.ClearBuffer( PIX_BLUE );
+	for( int f = 0; f < FRAMES; f++ )
+	{
+		graphics.Draw( spriteId, { 10.0f + f * 40, 10.0f }, f );
+		graphics.DrawTransparent( spriteId, { 10.0f + f * 40, 40.0f }, f, 0.5f );
+		graphics.DrawRotated( spriteId, { 20.0f + f * 40, 100.0f }, f, 0.7f, 1.5f );
+	}
+	return PlayTest::Hash( *graphics.GetDrawingBuffer() );
+}
+
+// Adds a sprite from a copy of the reference pixels
+static int AddReference( PlayGraphics& graphics, const std::vector<Pixel>& reference )
+{
+	PixelData canvas;
+	canvas.width = FRAME_WIDTH * FRAMES;
+	canvas.height = FRAME_HEIGHT;
+	canvas.pPixels = new Pixel[reference.size()];
+	std::copy( reference.begin(), reference.end(), canvas.pPixels );
+	return graphics.AddSprite( "reference_3", canvas, FRAMES, 1 );
+}
+
+// Updates a region of both the sprite and the reference pixels with a single colour
+static void Update( PlayGraphics& graphics, int spriteId, std::vector<Pixel>& reference, PixelRect rect, Pixel pix )
+{
+	std::vector<Pixel> region( rect.width * rect.height, pix );
+	graphics.UpdateSpriteRegion( spriteId, rect, region.data() );
+
+	for( int y = rect.y; y < rect.y + rect.height; y++ )
+		std::fill_n( reference.begin() + y * FRAME_WIDTH * FRAMES + rect.x, rect.width, pix );
+}
+
+// Makes a sprite, updates it in ways which change its skip values and opaque areas, and compares it with the reference each time
+static void CheckUpdates( PlayGraphics& graphics, const char* name, bool compress )
+{
+	PixelData discs = PlayTest::MakeDiscs( FRAME_WIDTH, FRAME_HEIGHT, FRAMES, 11 );
+	std::vector<Pixel> reference( discs.pPixels, discs.pPixels + discs.width * discs.height );
+	int spriteId = graphics.AddSprite( name, discs, FRAMES, 1 );
+	if( compress )
+		graphics.CompressSprite( spriteId );
+
+	// An opaque block inside a frame
+	Update( graphics, spriteId, reference, { 4, 4, 8, 6 }, PIX_RED );
+	PLAY_TEST_CHECK( DrawnHash( graphics, spriteId ) == DrawnHash( graphics, AddReference( graphics, reference ) ) );
+
+	// Transparent pixels across the edge between two frames, so skips must stop at the edge
+	Update( graphics, spriteId, reference, { FRAME_WIDTH - 4, 0, 8, FRAME_HEIGHT }, PIX_TRANS );
+	PLAY_TEST_CHECK( DrawnHash( graphics, spriteId ) == DrawnHash( graphics, AddReference( graphics, reference ) ) );
+
+	// Opaque pixels to the right of transparent ones, whose skip values need cutting short
+	Update( graphics, spriteId, reference, { FRAME_WIDTH * 2 + 3, 1, 2, 3 }, PIX_GREEN );
+	PLAY_TEST_CHECK( DrawnHash( graphics, spriteId ) == DrawnHash( graphics, AddReference( graphics, reference ) ) );
+
+	// Translucent pixels, and then making a frame entirely transparent
+	Update( graphics, spriteId, reference, { 30, 6, 10, 8 }, Pixel( 0x80, 0x40, 0xC0, 0xFF ) );
+	PLAY_TEST_CHECK( DrawnHash( graphics, spriteId ) == DrawnHash( graphics, AddReference( graphics, reference ) ) );
+	Update( graphics, spriteId, reference, { FRAME_WIDTH * 2, 0, FRAME_WIDTH, FRAME_HEIGHT }, PIX_TRANS );
+	PLAY_TEST_CHECK( DrawnHash( graphics, spriteId ) == DrawnHash( graphics, AddReference( graphics, reference ) ) );
+
+	// Regions outside the canvas are ignored
+	uint64_t before = DrawnHash( graphics, spriteId );
+	std::vector<Pixel> outside( 16, PIX_YELLOW );
+	graphics.UpdateSpriteRegion( spriteId, { FRAME_WIDTH * FRAMES - 2, 0, 4, 4 }, outside.data() );
+	PLAY_TEST_CHECK( DrawnHash( graphics, spriteId ) == before );
+}
+
+void RunTest()
+{
+	PlayGraphics& graphics = PlayGraphics::Instance();
+
+	CheckUpdates( graphics, "plain_3", false );
+	CheckUpdates( graphics, "compressed_3", true );
+
+	// Sprites which have dropped their canvas get it back when updated
+	graphics.SetSpriteMemorySaving( true );
+	CheckUpdates( graphics, "saving_3", false );
+	graphics.SetSpriteMemorySaving( false );
+}
@@ -0,0 +1,68 @@
+// Presents frames to a Wayland window at several scales and checks where the display buffer's pixels are drawn
+// > Runs against a headless Weston compositor started by RunWithWeston.sh
+#include "PlayTest.h"
+
+// Fills the display buffer with a pattern which is different for each frame
+static void FillPattern( PixelData& display, int frame )
+{
+	for( int y = 0; y < display.height; y++ )
+	{
+		for( int x = 0; x < display.width; x++ )
+			display.Row( y )[x] = Pixel( 0xFF, ( x * 3 + frame * 50 ) & 0xFF, ( y * 5 ) & 0xFF, ( x + y + frame * 90 ) & 0xFF );
+	}
+}
+
+void RunTest()
+{
+	PixelData* pDisplay = PlayGraphics::Instance().GetDrawingBuffer();
+
+	// The display buffer only has its own pixels while there is no window drawing straight into the shared buffers
+	PlayWindow::Destroy();
+	Pixel* pPixels = pDisplay->pPixels;
+	PlayWindow::Instance( pDisplay, 1 );
+
+	// At a scale of one each frame is drawn straight into a shared buffer, so presenting moves the display buffer on to
+	// another one (without copying), and larger scales copy each frame out, leaving the display buffer as it was
+	for( int scale = 1; scale <= 3; scale++ )
+	{
+		if( scale > 1 )
+		{
+			PlayWindow::Destroy();
+			PlayWindow::Instance( pDisplay, scale );
+		}
+
+		// More frames than there are buffers, so every buffer is reused while the compositor releases them
+		std::vector<Pixel*> drawnInto;
+		for( int frame = 0; frame < 8; frame++ )
+		{
+			int presents = PlayWindow::Instance().GetPresentCount();
+			Pixel* pDrawn = pDisplay->pPixels;
+			FillPattern( *pDisplay, frame );
+			uint64_t drawn = PlayTest::Hash( *pDisplay );
+			PlayWindow::Instance().Present();
+			PLAY_TEST_CHECK( PlayWindow::Instance().GetPresentCount() == presents + 1 );
+
+			if( scale == 1 )
+			{
+				PLAY_TEST_CHECK( pDrawn != pPixels && pDisplay->pPixels != pDrawn );
+				if( std::find( drawnInto.begin(), drawnInto.end(), pDrawn ) == drawnInto.end() )
+					drawnInto.push_back( pDrawn );
+			}
+			else
+			{
+				PLAY_TEST_CHECK( pDisplay->pPixels == pPixels && PlayTest::Hash( *pDisplay ) == drawn );
+			}
+		}
+		PLAY_TEST_CHECK( scale > 1 || ( drawnInto.size() >= 2 && drawnInto.size() <= 3 ) );
+	}
+
+	// Destroying the window gives the display buffer its own pixels back for PlayGraphics to free, holding the frame being drawn
+	PlayWindow::Destroy();
+	PlayWindow::Instance( pDisplay, 1 );
+	FillPattern( *pDisplay, 3 );
+	uint64_t drawn = PlayTest::Hash( *pDisplay );
+	PLAY_TEST_CHECK( pDisplay->pPixels != pPixels );
+	PlayWindow::Destroy();
+	PLAY_TEST_CHECK( pDisplay->pPixels == pPixels && PlayTest::Hash( *pDisplay ) == drawn );
+	PlayWindow::Instance( pDisplay, 1 );
+}
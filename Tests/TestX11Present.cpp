@@ -0,0 +1,77 @@
+// Presents frames to an X11 window at several scales and reads them back from the server to check every pixel arrived
+// > Runs under Xvfb, with PLAY_TEST_SHARED_MEMORY set to 1 when the server has MIT-SHM and 0 when it has been turned off
+#include "PlayTest.h"
+
+// Fills the display buffer with a pattern which is different for each frame
+static void FillPattern( PixelData& display, int frame )
+{
+	for( int y = 0; y < display.height; y++ )
+	{
+		for( int x = 0; x < display.width; x++ )
+			display.Row( y )[x] = Pixel( 0xFF, ( x * 3 + frame * 50 ) & 0xFF, ( y * 5 ) & 0xFF, ( x + y + frame * 90 ) & 0xFF );
+	}
+}
+
+// Reads the window back from the X server and counts the pixels which aren't the display buffer pixel they were scaled from
+static int WrongPixels( const PixelData& display, int scale )
+{
+	PlayWindow& window = PlayWindow::Instance();
+	XImage* pImage = XGetImage( window.GetX11Display(), window.GetX11Window(), 0, 0, display.width * scale, display.height * scale, AllPlanes, ZPixmap );
+	if( !pImage )
+		return display.width * display.height * scale * scale;
+
+	int wrong = 0;
+	for( int y = 0; y < pImage->height; y++ )
+	{
+		for( int x = 0; x < pImage->width; x++ )
+			wrong += ( XGetPixel( pImage, x, y ) & 0xFFFFFF ) != ( display.Row( y / scale )[x / scale].bits & 0xFFFFFF );
+	}
+	XDestroyImage( pImage );
+	return wrong;
+}
+
+void RunTest()
+{
+	PixelData* pDisplay = PlayGraphics::Instance().GetDrawingBuffer();
+
+	// The image is only in shared memory when the server offers it
+	const char* pShared = getenv( "PLAY_TEST_SHARED_MEMORY" );
+	PLAY_TEST_CHECK( pShared != nullptr );
+	bool bShared = pShared && atoi( pShared ) != 0;
+	PLAY_TEST_CHECK( PlayWindow::Instance().IsSharedMemory() == bShared );
+	PLAY_TEST_CHECK( bShared == ( XShmQueryExtension( PlayWindow::Instance().GetX11Display() ) == True ) );
+
+	// The display buffer only has its own pixels while there is no window drawing straight into the image
+	PlayWindow::Destroy();
+	Pixel* pPixels = pDisplay->pPixels;
+	PlayWindow::Instance( pDisplay, 1 );
+
+	// Every scale repeats each pixel (scales of 2 and more than 2 are replicated differently), and each present replaces the last
+	// > At a scale of one frames are drawn straight into the image, with or without shared memory
+	for( int scale = 1; scale <= 5; scale++ )
+	{
+		if( scale > 1 )
+		{
+			PlayWindow::Destroy();
+			PlayWindow::Instance( pDisplay, scale );
+		}
+		PLAY_TEST_CHECK( PlayWindow::Instance().IsSharedMemory() == bShared );
+		PLAY_TEST_CHECK( ( pDisplay->pPixels == pPixels ) == ( scale > 1 ) );
+
+		for( int frame = 0; frame < 3; frame++ )
+		{
+			FillPattern( *pDisplay, frame );
+			PlayWindow::Instance().Present();
+			PLAY_TEST_CHECK( WrongPixels( *pDisplay, scale ) == 0 );
+		}
+	}
+
+	// Destroying the window gives the display buffer its own pixels back for PlayGraphics to free, holding the frame being drawn
+	PlayWindow::Destroy();
+	PlayWindow::Instance( pDisplay, 1 );
+	FillPattern( *pDisplay, 3 );
+	uint64_t drawn = PlayTest::Hash( *pDisplay );
+	PlayWindow::Destroy();
+	PLAY_TEST_CHECK( pDisplay->pPixels == pPixels && PlayTest::Hash( *pDisplay ) == drawn );
+	PlayWindow::Instance( pDisplay, 1 );
+}